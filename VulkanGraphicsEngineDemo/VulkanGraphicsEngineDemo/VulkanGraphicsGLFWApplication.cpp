@@ -1,7 +1,14 @@
 #include "VulkanGraphicsGLFWApplication.h"
 
+#include "VulkanGraphicsMemoryTelemetry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <memory>
 #include <sstream>
 #include <iostream>
+#include <vector>
 
 using namespace demo;
 
@@ -102,9 +109,58 @@ GLFWApplication::~GLFWApplication()
 void GLFWApplication::run()
 {
     vgfx::Renderer& renderer = getRenderer();
+    bool wasLoadingImages = false;
+    std::vector<double> renderFrameTimesMs;
+    std::unique_ptr<vgfx::MemoryTelemetry> spMemoryTelemetry;
+    if (!m_memoryTelemetryFilePath.empty()) {
+        spMemoryTelemetry = std::make_unique<vgfx::MemoryTelemetry>(
+            getContext().getMemoryAllocator(),
+            vgfx::MemoryTelemetry::Config(),
+            getContext().getAppConfig().pHostAllocator);
+    }
     while (!glfwWindowShouldClose(m_pGLFWwindow)) {
         glfwPollEvents();
+        if (spMemoryTelemetry != nullptr) {
+            spMemoryTelemetry->sample();
+        }
+        getSceneLoader().update();
+
+        // Report the frame time spikes once the images that were streaming in have all loaded.
+        vgfx::AsyncImageLoader* pImageLoader = getSceneLoader().getModelLibrary().getAsyncImageLoader();
+        if (pImageLoader != nullptr) {
+            if (wasLoadingImages && !pImageLoader->isLoading()) {
+                vgfx::AsyncImageLoader::Stats stats = pImageLoader->getStats();
+                std::cout << "Loaded " << stats.loadedCount << " images in " << stats.batchCount << " batches, "
+                    << stats.frameCount << " frames: median " << stats.medianFrameTimeMs << "ms, p99 "
+                    << stats.p99FrameTimeMs << "ms, max " << stats.maxFrameTimeMs << "ms, "
+                    << stats.frameSpikeCount << " spikes" << std::endl;
+                pImageLoader->resetFrameTimes();
+
+                vgfx::TextureResidencyManager* pResidencyManager =
+                    getSceneLoader().getModelLibrary().getTextureResidencyManager();
+                if (pResidencyManager != nullptr) {
+                    const vgfx::TextureResidencyManager::Stats& residencyStats = pResidencyManager->getStats();
+                    std::cout << "Textures: " << residencyStats.residentTextureCount << "/"
+                        << residencyStats.textureCount << " resident, "
+                        << (residencyStats.residentBytes >> 20u) << "/" << (residencyStats.budgetBytes >> 20u)
+                        << "MB of budget, " << residencyStats.streamedInCount << " streamed in, "
+                        << residencyStats.reducedCount << " reduced, " << residencyStats.evictedCount
+                        << " evicted" << std::endl;
+                }
+            }
+            wasLoadingImages = pImageLoader->isLoading();
+        }
+
+        auto renderStartTime = std::chrono::high_resolution_clock::now();
         renderer.renderFrame(*m_spSceneRoot.get());
+        if (m_benchmarkFrameCount > 0u) {
+            auto renderEndTime = std::chrono::high_resolution_clock::now();
+            renderFrameTimesMs.push_back(
+                std::chrono::duration<double, std::milli>(renderEndTime - renderStartTime).count());
+            if (renderFrameTimesMs.size() == m_benchmarkFrameCount) {
+                glfwSetWindowShouldClose(m_pGLFWwindow, GLFW_TRUE);
+            }
+        }
         VkResult result = renderer.getPresenter().present(renderer);
         if (result == VK_ERROR_OUT_OF_DATE_KHR || m_frameBufferResized) {
             uint32_t width = 0u, height = 0u;
@@ -115,4 +171,61 @@ void GLFWApplication::run()
             break;
         }
     }
+
+    if (!renderFrameTimesMs.empty()) {
+        std::sort(renderFrameTimesMs.begin(), renderFrameTimesMs.end());
+        size_t p99Index = std::min(renderFrameTimesMs.size() - 1u, renderFrameTimesMs.size() * 99u / 100u);
+        const char* pDescriptorPath =
+            getContext().areDescriptorBuffersEnabled() ? "descriptor buffers" : "descriptor pools";
+        std::cout << "Recorded " << renderFrameTimesMs.size() << " frames with " << pDescriptorPath
+            << ": median " << renderFrameTimesMs[renderFrameTimesMs.size() / 2u] << "ms, p99 "
+            << renderFrameTimesMs[p99Index] << "ms" << std::endl;
+    }
+
+    if (spMemoryTelemetry != nullptr) {
+        std::ofstream telemetryFile(m_memoryTelemetryFilePath);
+        spMemoryTelemetry->writeJson(telemetryFile, true);
+        std::cout << "Peak device local memory usage " << (spMemoryTelemetry->getPeakDeviceLocalUsageBytes() >> 20u)
+            << "MB, telemetry written to " << m_memoryTelemetryFilePath << std::endl;
+        const vgfx::HostAllocator* pHostAllocator = getContext().getAppConfig().pHostAllocator;
+        if (pHostAllocator != nullptr) {
+            vgfx::HostAllocator::Stats hostStats = pHostAllocator->getStats();
+            std::cout << "Peak host memory allocated by the driver " << (hostStats.total.peakBytes >> 10u)
+                << "KB in " << hostStats.total.totalAllocationCount << " allocations" << std::endl;
+        }
+
+        vgfx::GeometryArena* pGeometryArena = getSceneLoader().getModelLibrary().getGeometryArena();
+        if (pGeometryArena != nullptr) {
+            vgfx::GeometryArena::Stats arenaStats = pGeometryArena->getStats();
+            std::cout << "Geometry arena: " << (arenaStats.usedBytes >> 10u) << "/" << (arenaStats.capacityBytes >> 10u)
+                << "KB used in " << arenaStats.blockCount << " blocks, " << arenaStats.freeRangeCount
+                << " free ranges, " << arenaStats.defragmentedPoolCount << " pools defragmented moving "
+                << (arenaStats.movedBytes >> 10u) << "KB" << std::endl;
+        }
+
+        vgfx::DescriptorAllocator::Stats descriptorStats;
+        for (const auto& spDescriptorAllocator : renderer.getDescriptorAllocators()) {
+            const vgfx::DescriptorAllocator::Stats& stats = spDescriptorAllocator->getStats();
+            descriptorStats.peakSetCount = std::max(descriptorStats.peakSetCount, stats.peakSetCount);
+            descriptorStats.peakDescriptorCount =
+                std::max(descriptorStats.peakDescriptorCount, stats.peakDescriptorCount);
+            descriptorStats.chainedPoolCount += stats.chainedPoolCount;
+            descriptorStats.resizeCount += stats.resizeCount;
+        }
+        std::cout << "Peak of " << descriptorStats.peakSetCount << " descriptor sets and "
+            << descriptorStats.peakDescriptorCount << " descriptors per frame, "
+            << descriptorStats.chainedPoolCount << " pools chained, " << descriptorStats.resizeCount
+            << " resized" << std::endl;
+
+        vgfx::DescriptorBuffer::Stats descriptorBufferStats;
+        for (const auto& spDescriptorBuffer : renderer.getDescriptorBuffers()) {
+            const vgfx::DescriptorBuffer::Stats& stats = spDescriptorBuffer->getStats();
+            descriptorBufferStats.peakSetCount = std::max(descriptorBufferStats.peakSetCount, stats.peakSetCount);
+            descriptorBufferStats.peakUsedBytes = std::max(descriptorBufferStats.peakUsedBytes, stats.peakUsedBytes);
+        }
+        if (!renderer.getDescriptorBuffers().empty()) {
+            std::cout << "Peak of " << descriptorBufferStats.peakSetCount << " descriptor buffer sets in "
+                << (descriptorBufferStats.peakUsedBytes >> 10u) << "KB per frame" << std::endl;
+        }
+    }
 }
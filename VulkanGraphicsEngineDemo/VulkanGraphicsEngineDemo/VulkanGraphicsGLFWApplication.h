@@ -5,6 +5,8 @@
 #include <GLFW/glfw3.h>
 #include <vulkan/vulkan.h>
 
+#include <string>
+
 namespace demo
 {
     class GLFWApplication : public vgfx::WindowApplication
@@ -19,7 +21,15 @@ namespace demo
         virtual ~GLFWApplication();
 
         void run() override;
+
+        // Samples the GPU memory every frame and writes the telemetry to the file on exit.
+        void setMemoryTelemetryFilePath(const std::string& filePath) { m_memoryTelemetryFilePath = filePath; }
+
+        // Exits after the frames have been rendered and prints the CPU time of recording them.
+        void setBenchmarkFrameCount(uint32_t frameCount) { m_benchmarkFrameCount = frameCount; }
     private:
         GLFWwindow* m_pGLFWwindow = nullptr;
+        std::string m_memoryTelemetryFilePath;
+        uint32_t m_benchmarkFrameCount = 0u;
     };
 }
\ No newline at end of file
@@ -1,13 +1,30 @@
 // VulkanGraphicsEngineDemo.cpp : This file contains the 'main' function. Program execution begins and ends there.
 //
 
+#include "VulkanGraphicsDefragmenter.h"
+#include "VulkanGraphicsDescriptorAllocator.h"
+#include "VulkanGraphicsDescriptorBatcher.h"
 #include "VulkanGraphicsGLFWApplication.h"
+#include "VulkanGraphicsHostAllocator.h"
+#include "VulkanGraphicsImageDescriptorUpdaters.h"
+#include "VulkanGraphicsImageDownsampler.h"
+#include "VulkanGraphicsObjLoader.h"
+#include "VulkanGraphicsOneTimeCommands.h"
 #include "VulkanGraphicsSceneLoader.h"
+#include "VulkanGraphicsUploadManager.h"
+#include "VulkanGraphicsVertexBuffer.h"
 
 #include <vulkan/vulkan.h>
 
 #include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
+#include <random>
 #include <sstream>
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -21,8 +38,16 @@ static void ShowHelpAndExit(const char* pBadOption = nullptr)
         oss << "Error parsing \"" << pBadOption << "\"" << std::endl;
     }
     oss << "Options:" << std::endl
+        << "-b           Benchmark mip generation by blitting and by the image downsampler, then exit." << std::endl
+        << "-d           Run an allocate/free churn workload, defragment it and verify the data, then exit." << std::endl
+        << "-e           Write descriptors to descriptor buffers instead of descriptor sets, if supported." << std::endl
+        << "-f           Render this many frames, print the CPU time of recording them, then exit." << std::endl
+        << "-m           GPU memory telemetry JSON output file, the memory is sampled every frame." << std::endl
+        << "-o           Benchmark OBJ loading by tinyobjloader and by the engine's loader, then exit." << std::endl
         << "-p           Data directory path." << std::endl
         << "-s           Input scene filename (relative to data directory path)." << std::endl
+        << "-t           Benchmark descriptor set updates by writes, update templates and batches, then exit." << std::endl
+        << "-u           Benchmark vertex buffer upload throughput by staging and by direct writes, then exit." << std::endl
         << "-v           Enable validation layers." << std::endl;
 
     if (throwError) {
@@ -37,12 +62,44 @@ static void ParseCommandLine(
     int argc, char* argv[],
     std::string* pDataDirPath,
     std::string* pSceneFilename,
-    bool* pEnableValidationLayers)
+    bool* pEnableValidationLayers,
+    bool* pBenchmarkMipGeneration,
+    bool* pBenchmarkUploads,
+    bool* pBenchmarkDescriptorUpdates,
+    bool* pBenchmarkObjLoading,
+    bool* pRunDefragmentationChurn,
+    bool* pUseDescriptorBuffers,
+    uint32_t* pBenchmarkFrameCount,
+    std::string* pMemoryTelemetryFilePath)
 {
     std::ostringstream oss;
     for (int i = 1; i < argc; ++i) {
         if (_stricmp(argv[i], "-h") == 0) {
             ShowHelpAndExit();
+        } else if (_stricmp(argv[i], "-b") == 0) {
+            *pBenchmarkMipGeneration = true;
+            continue;
+        } else if (_stricmp(argv[i], "-d") == 0) {
+            *pRunDefragmentationChurn = true;
+            continue;
+        } else if (_stricmp(argv[i], "-e") == 0) {
+            *pUseDescriptorBuffers = true;
+            continue;
+        } else if (_stricmp(argv[i], "-f") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-f");
+            }
+            *pBenchmarkFrameCount = static_cast<uint32_t>(std::stoul(argv[i]));
+            continue;
+        } else if (_stricmp(argv[i], "-m") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-m");
+            }
+            *pMemoryTelemetryFilePath = argv[i];
+            continue;
+        } else if (_stricmp(argv[i], "-o") == 0) {
+            *pBenchmarkObjLoading = true;
+            continue;
         } else if (_stricmp(argv[i], "-s") == 0) {
             if (++i == argc) {
                 ShowHelpAndExit("-s");
@@ -55,6 +112,12 @@ static void ParseCommandLine(
             }
             *pDataDirPath = argv[i];
             continue;
+        } else if (_stricmp(argv[i], "-t") == 0) {
+            *pBenchmarkDescriptorUpdates = true;
+            continue;
+        } else if (_stricmp(argv[i], "-u") == 0) {
+            *pBenchmarkUploads = true;
+            continue;
         } else if (_stricmp(argv[i], "-v") == 0) {
             *pEnableValidationLayers = true;
             continue;
@@ -63,21 +126,668 @@ static void ParseCommandLine(
     }
 }
 
+// Returns the GPU time of the recorded commands in milliseconds.
+static double MeasureGpuTimeMs(
+    vgfx::Context& context,
+    vgfx::OneTimeCommandsHelper& commandsHelper,
+    VkQueryPool queryPool,
+    float timestampPeriodNs,
+    const std::function<void(VkCommandBuffer)>& recordCommands)
+{
+    commandsHelper.execute([&](VkCommandBuffer commandBuffer) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0u, 2u);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0u);
+        recordCommands(commandBuffer);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1u);
+    });
+
+    uint64_t timestamps[2] = {};
+    vkGetQueryPoolResults(
+        context.getLogicalDevice(),
+        queryPool,
+        0u,
+        2u,
+        sizeof(timestamps),
+        timestamps,
+        sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    return static_cast<double>(timestamps[1] - timestamps[0]) * timestampPeriodNs / 1000000.0;
+}
+
+// Uploads batches of square R8G8B8A8_UNORM images and generates their mip levels, by blitting and by
+// the image downsampler (SPD). Prints the median GPU time of each, less the time of the upload alone.
+static void BenchmarkMipGeneration(vgfx::Context& context)
+{
+    VkPhysicalDeviceProperties deviceProperties = {};
+    vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &deviceProperties);
+    if (!deviceProperties.limits.timestampComputeAndGraphics) {
+        std::cerr << "Timestamp queries are not supported." << std::endl;
+        return;
+    }
+
+    vgfx::ImageDownsampler* pDownsampler =
+        context.isImageDownsamplerSupported() ? &context.getOrCreateImageDownsampler() : nullptr;
+    if (pDownsampler == nullptr) {
+        std::cout << "The image downsampler is not supported, only blitting is measured." << std::endl;
+    }
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = 2u;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (vkCreateQueryPool(context.getLogicalDevice(), &queryPoolInfo, nullptr, &queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timestamp query pool!");
+    }
+
+    const uint32_t maxImageSize = 4096u;
+    const uint32_t imagesPerBatch = 4u;
+    const uint32_t iterationCount = 10u;
+
+    auto& memoryAllocator = context.getMemoryAllocator();
+    VkDeviceSize stagingSizeBytes = VkDeviceSize(maxImageSize) * maxImageSize * 4u;
+    auto stagingBuffer =
+        memoryAllocator.createBuffer(
+            stagingSizeBytes,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY,
+            "Mip generation benchmark staging");
+
+    void* pStagingData = nullptr;
+    memoryAllocator.mapBuffer(stagingBuffer, &pStagingData);
+    uint8_t* pTexels = static_cast<uint8_t*>(pStagingData);
+    for (VkDeviceSize i = 0u; i < stagingSizeBytes; ++i) {
+        pTexels[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+    }
+    memoryAllocator.unmapBuffer(stagingBuffer);
+
+    vgfx::OneTimeCommandsHelper commandsHelper(context, context.getOrCreateUtilCommandBufferFactory());
+
+    enum class Method
+    {
+        CopyOnly,
+        Blit,
+        Downsampler,
+    };
+
+    std::cout << "Mip generation of " << imagesPerBatch << " images per batch, median of "
+        << iterationCount << " batches (ms):" << std::endl
+        << std::setw(10) << "Size" << std::setw(12) << "Upload" << std::setw(12) << "Blit"
+        << std::setw(12) << "SPD" << std::setw(12) << "Speedup" << std::endl;
+
+    for (uint32_t imageSize = 64u; imageSize <= maxImageSize; imageSize *= 2u) {
+        auto measureMedianMs = [&](Method method) {
+            std::vector<double> timesMs;
+            for (uint32_t iteration = 0u; iteration < iterationCount; ++iteration) {
+                vgfx::Image::Config imageConfig(
+                    imageSize,
+                    imageSize,
+                    VK_FORMAT_R8G8B8A8_UNORM,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                    | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+                    | VK_IMAGE_USAGE_SAMPLED_BIT
+                    | VK_IMAGE_USAGE_STORAGE_BIT,
+                    vgfx::Image::ComputeMipLevels2D(imageSize, imageSize));
+
+                std::vector<std::unique_ptr<vgfx::Image>> images;
+                std::vector<const vgfx::Image*> pImages;
+                for (uint32_t i = 0u; i < imagesPerBatch; ++i) {
+                    images.push_back(std::make_unique<vgfx::Image>(context, imageConfig));
+                    pImages.push_back(images.back().get());
+                }
+
+                std::unique_ptr<vgfx::ImageDownsampler::Batch> spDownsamplerBatch;
+                timesMs.push_back(
+                    MeasureGpuTimeMs(
+                        context,
+                        commandsHelper,
+                        queryPool,
+                        deviceProperties.limits.timestampPeriod,
+                        [&](VkCommandBuffer commandBuffer) {
+                            for (const auto& spImage : images) {
+                                vgfx::OneTimeCommandsHelper::RecordCopyBufferToImageCommands(
+                                    commandBuffer,
+                                    stagingBuffer.handle,
+                                    0u, // src offset
+                                    *spImage.get(),
+                                    method == Method::Blit ?
+                                        vgfx::OneTimeCommandsHelper::GenerateMips::Yes :
+                                        vgfx::OneTimeCommandsHelper::GenerateMips::No);
+                            }
+                            if (method == Method::Downsampler) {
+                                spDownsamplerBatch = pDownsampler->recordCommands(commandBuffer, pImages);
+                            }
+                        }));
+            }
+
+            std::sort(timesMs.begin(), timesMs.end());
+            return timesMs[timesMs.size() / 2u];
+        };
+
+        double uploadMs = measureMedianMs(Method::CopyOnly);
+        double blitMs = std::max(measureMedianMs(Method::Blit) - uploadMs, 0.0);
+
+        std::cout << std::fixed << std::setprecision(3)
+            << std::setw(10) << (std::to_string(imageSize) + "x" + std::to_string(imageSize))
+            << std::setw(12) << uploadMs
+            << std::setw(12) << blitMs;
+
+        uint32_t mipLevels = vgfx::Image::ComputeMipLevels2D(imageSize, imageSize);
+        if (pDownsampler != nullptr && mipLevels - 1u >= VGFX_DOWNSAMPLER_MIN_MIP_LEVELS) {
+            double downsamplerMs = std::max(measureMedianMs(Method::Downsampler) - uploadMs, 0.0);
+            std::cout << std::setw(12) << downsamplerMs;
+            if (downsamplerMs > 0.0) {
+                std::cout << std::setw(11) << std::setprecision(2) << (blitMs / downsamplerMs) << "x";
+            }
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << std::endl;
+    }
+
+    memoryAllocator.destroyBuffer(stagingBuffer);
+    vkDestroyQueryPool(context.getLogicalDevice(), queryPool, nullptr);
+}
+
+// Creates batches of vertex buffers with each upload strategy, by staging and copying them and by
+// writing them directly to device local, host visible memory, and prints the median throughput
+// from the start of the batch until its data can be used by the GPU.
+static void BenchmarkUploads(vgfx::Context& context)
+{
+    auto& memoryAllocator = context.getMemoryAllocator();
+    if (memoryAllocator.getDeviceLocalHostVisibleHeapSizeBytes() == 0u) {
+        std::cout << "No device local memory is host visible, only staging is measured." << std::endl;
+    } else {
+        std::cout << "Device local, host visible heap: "
+            << (memoryAllocator.getDeviceLocalHostVisibleHeapSizeBytes() / (1024u * 1024u)) << " MB"
+            << (memoryAllocator.isUnifiedMemory() ? " (unified memory)" : "")
+            << ", auto strategy writes directly: "
+            << (memoryAllocator.shouldWriteDirectly() ? "yes" : "no") << std::endl;
+    }
+
+    const size_t maxBatchSizeBytes = 64u * 1024u * 1024u;
+    const uint32_t buffersPerBatch = 16u;
+    const uint32_t iterationCount = 10u;
+
+    std::vector<uint8_t> vertexData(maxBatchSizeBytes / buffersPerBatch);
+    for (size_t i = 0u; i < vertexData.size(); ++i) {
+        vertexData[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+    }
+
+    vgfx::CommandBufferFactory& commandBufferFactory = context.getOrCreateUtilCommandBufferFactory();
+
+    vgfx::VertexBuffer::Config vertexBufferConfig(
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        { vgfx::VertexBuffer::AttributeDescription(VK_FORMAT_R32G32B32A32_SFLOAT, 0u) });
+
+    std::cout << "Upload of " << buffersPerBatch << " vertex buffers per batch, median of "
+        << iterationCount << " batches (MB/s):" << std::endl
+        << std::setw(10) << "Batch" << std::setw(12) << "Staging" << std::setw(12) << "Direct"
+        << std::setw(12) << "Speedup" << std::endl;
+
+    vgfx::MemoryAllocator::UploadStrategy prevUploadStrategy = memoryAllocator.getUploadStrategy();
+
+    for (size_t batchSizeBytes = 256u * 1024u; batchSizeBytes <= maxBatchSizeBytes; batchSizeBytes *= 4u) {
+        size_t bufferSizeBytes = batchSizeBytes / buffersPerBatch;
+
+        auto measureMedianMBps = [&](vgfx::MemoryAllocator::UploadStrategy uploadStrategy) {
+            memoryAllocator.setUploadStrategy(uploadStrategy);
+
+            std::vector<double> throughputs;
+            for (uint32_t iteration = 0u; iteration < iterationCount; ++iteration) {
+                std::vector<std::unique_ptr<vgfx::VertexBuffer>> vertexBuffers;
+
+                auto startTime = std::chrono::high_resolution_clock::now();
+                for (uint32_t i = 0u; i < buffersPerBatch; ++i) {
+                    vertexBuffers.push_back(
+                        std::make_unique<vgfx::VertexBuffer>(
+                            context,
+                            commandBufferFactory,
+                            vertexBufferConfig,
+                            vertexData.data(),
+                            bufferSizeBytes));
+                }
+                // Staged uploads may be recorded into the UploadManager's open batch.
+                vgfx::UploadManager* pUploadManager = context.getUploadManager();
+                if (pUploadManager != nullptr) {
+                    pUploadManager->wait(pUploadManager->flush());
+                }
+                auto endTime = std::chrono::high_resolution_clock::now();
+
+                double seconds = std::chrono::duration<double>(endTime - startTime).count();
+                throughputs.push_back(static_cast<double>(batchSizeBytes) / (1024.0 * 1024.0) / seconds);
+
+                vertexBuffers.clear();
+                context.waitForDeviceToIdle();
+            }
+
+            std::sort(throughputs.begin(), throughputs.end());
+            return throughputs[throughputs.size() / 2u];
+        };
+
+        double stagingMBps = measureMedianMBps(vgfx::MemoryAllocator::UploadStrategy::Staging);
+
+        std::cout << std::fixed << std::setprecision(0)
+            << std::setw(10) << (std::to_string(batchSizeBytes / 1024u) + "KB")
+            << std::setw(12) << stagingMBps;
+
+        if (memoryAllocator.getDeviceLocalHostVisibleHeapSizeBytes() > 0u) {
+            double directMBps = measureMedianMBps(vgfx::MemoryAllocator::UploadStrategy::DirectWrite);
+            std::cout << std::setw(12) << directMBps
+                << std::setw(11) << std::setprecision(2) << (directMBps / stagingMBps) << "x";
+        } else {
+            std::cout << std::setw(12) << "-";
+        }
+        std::cout << std::endl;
+    }
+
+    memoryAllocator.setUploadStrategy(prevUploadStrategy);
+}
+
+// Writes batches of descriptor sets like the Renderer's material sets, a combined image sampler
+// and a uniform buffer, with VkWriteDescriptorSets built by DescriptorSetUpdater, with the
+// layout's update template and with a DescriptorBatcher, and prints the median number of sets
+// updated per second of each.
+static void BenchmarkDescriptorUpdates(vgfx::Context& context)
+{
+    if (!context.areDescriptorUpdateTemplatesSupported()) {
+        std::cout << "Descriptor update templates are not supported." << std::endl;
+        return;
+    }
+
+    const uint32_t setsPerBatch = 4096u;
+    const uint32_t iterationCount = 20u;
+
+    vgfx::DescriptorSetLayout::DescriptorBindings bindings = {
+        { 0u, vgfx::DescriptorSetLayout::DescriptorBinding(
+            VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT) },
+        { 1u, vgfx::DescriptorSetLayout::DescriptorBinding(
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT) },
+    };
+    vgfx::DescriptorSetLayout layout(context, bindings);
+
+    vgfx::Image::Config imageConfig(
+        4u,
+        4u,
+        VK_FORMAT_R8G8B8A8_UNORM,
+        VK_IMAGE_TILING_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT);
+    vgfx::Image image(context, imageConfig);
+    vgfx::ImageView imageView(
+        context,
+        vgfx::ImageView::Config(VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_VIEW_TYPE_2D),
+        image);
+    vgfx::Sampler sampler(context, vgfx::Sampler::Config());
+    vgfx::Buffer uniformBuffer(
+        context,
+        vgfx::Buffer::Type::UniformBuffer,
+        vgfx::Buffer::Config("Descriptor update benchmark", 256u));
+
+    vgfx::DescriptorAllocator::Config allocatorConfig;
+    allocatorConfig.initMaxSets = setsPerBatch;
+    allocatorConfig.initPoolSizes = {
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, setsPerBatch },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, setsPerBatch },
+    };
+    vgfx::DescriptorAllocator descriptorAllocator(context, allocatorConfig);
+    std::vector<VkDescriptorSet> descriptorSets(setsPerBatch);
+
+    auto measureMedianSetsPerSecond = [&](const std::function<void(VkDescriptorSet)>& updateSet) {
+        std::vector<double> setsPerSecond;
+        for (uint32_t iteration = 0u; iteration < iterationCount; ++iteration) {
+            descriptorAllocator.reset();
+            descriptorAllocator.allocateDescriptorSets(layout, setsPerBatch, descriptorSets.data());
+
+            auto startTime = std::chrono::high_resolution_clock::now();
+            for (VkDescriptorSet descriptorSet : descriptorSets) {
+                updateSet(descriptorSet);
+            }
+            auto endTime = std::chrono::high_resolution_clock::now();
+
+            double seconds = std::chrono::duration<double>(endTime - startTime).count();
+            setsPerSecond.push_back(static_cast<double>(setsPerBatch) / seconds);
+        }
+
+        std::sort(setsPerSecond.begin(), setsPerSecond.end());
+        return setsPerSecond[setsPerSecond.size() / 2u];
+    };
+
+    vgfx::DescriptorSetUpdater updater;
+    double writesPerSecond = measureMedianSetsPerSecond([&](VkDescriptorSet descriptorSet) {
+        vgfx::CombinedImageSamplerDescriptorUpdater imageSamplerUpdater(imageView, sampler);
+        updater.clear();
+        updater.bindDescriptor(0u, imageSamplerUpdater);
+        updater.bindDescriptor(1u, uniformBuffer);
+        updater.updateDescriptorSet(context, descriptorSet);
+    });
+
+    std::vector<vgfx::DescriptorInfo> descriptorInfos(layout.getDescriptorInfoCount());
+    double templatesPerSecond = measureMedianSetsPerSecond([&](VkDescriptorSet descriptorSet) {
+        vgfx::DescriptorInfo& imageSamplerInfo = descriptorInfos[layout.getDescriptorInfoIndex(0u)];
+        imageSamplerInfo.image.imageView = imageView.getHandle();
+        imageSamplerInfo.image.sampler = sampler.getHandle();
+        imageSamplerInfo.image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        descriptorInfos[layout.getDescriptorInfoIndex(1u)].buffer = uniformBuffer.getDescriptorBufferInfo();
+        layout.updateDescriptorSet(descriptorSet, descriptorInfos.data());
+    });
+
+    // Like the Renderer's frames, the sets are requested and written one at a time and then
+    // allocated and written at once, so the allocation is timed as well.
+    vgfx::DescriptorBatcher descriptorBatcher(context);
+    VkDescriptorImageInfo imageInfo = {};
+    imageInfo.imageView = imageView.getHandle();
+    imageInfo.sampler = sampler.getHandle();
+    imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    std::vector<double> batchedSetsPerSecond;
+    for (uint32_t iteration = 0u; iteration < iterationCount; ++iteration) {
+        descriptorAllocator.reset();
+        descriptorBatcher.reset();
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        for (uint32_t setIndex = 0u; setIndex < setsPerBatch; ++setIndex) {
+            uint32_t batchedSetIndex = descriptorBatcher.requestDescriptorSets(layout, 1u);
+            descriptorBatcher.writeImage(
+                batchedSetIndex, 0u, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo);
+            descriptorBatcher.writeBuffer(
+                batchedSetIndex, 1u, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, uniformBuffer.getDescriptorBufferInfo());
+        }
+        descriptorBatcher.flush(descriptorAllocator);
+        auto endTime = std::chrono::high_resolution_clock::now();
+
+        double seconds = std::chrono::duration<double>(endTime - startTime).count();
+        batchedSetsPerSecond.push_back(static_cast<double>(setsPerBatch) / seconds);
+    }
+    std::sort(batchedSetsPerSecond.begin(), batchedSetsPerSecond.end());
+    double batchedPerSecond = batchedSetsPerSecond[batchedSetsPerSecond.size() / 2u];
+
+    std::cout << "Update of " << setsPerBatch << " descriptor sets per batch, median of "
+        << iterationCount << " batches (sets/s, Batched includes allocating the sets):" << std::endl
+        << std::fixed << std::setprecision(0)
+        << std::setw(12) << "Writes" << std::setw(12) << "Template" << std::setw(12) << "Batched"
+        << std::setw(12) << "Speedup" << std::endl
+        << std::setw(12) << writesPerSecond << std::setw(12) << templatesPerSecond << std::setw(12) << batchedPerSecond
+        << std::setw(11) << std::setprecision(2) << (templatesPerSecond / writesPerSecond) << "x" << std::endl;
+}
+
+// Writes a grid of quads with positions, normals and texture coordinates, in several material
+// groups, until the file is at least sizeBytes.
+static void WriteSyntheticObj(const std::string& filePath, size_t sizeBytes)
+{
+    std::ofstream file(filePath, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Failed to create " + filePath);
+    }
+
+    const uint32_t quadsPerRow = 1024u;
+    const uint32_t rowsPerGroup = 256u;
+    std::string text;
+    size_t writtenBytes = 0u;
+    uint64_t rowCount = 0u;
+    while (writtenBytes < sizeBytes) {
+        text.clear();
+        if (rowCount % rowsPerGroup == 0u) {
+            text += "usemtl material" + std::to_string((rowCount / rowsPerGroup) % 8u) + "\n";
+        }
+
+        // Two rows of vertices per row of quads, so every row is independent of the others.
+        for (uint32_t vertexRow = 0u; vertexRow < 2u; ++vertexRow) {
+            for (uint32_t column = 0u; column <= quadsPerRow; ++column) {
+                float x = static_cast<float>(column) * 0.01f;
+                float y = static_cast<float>(rowCount + vertexRow) * 0.01f;
+                text += "v " + std::to_string(x) + " " + std::to_string(y) + " 0.5\n";
+                text += "vt " + std::to_string(x) + " " + std::to_string(y) + "\n";
+                text += "vn 0.0 0.0 1.0\n";
+            }
+        }
+        // Relative indices, so the rows don't depend on how many vertices precede them.
+        int32_t rowVertexCount = static_cast<int32_t>(quadsPerRow + 1u);
+        for (int32_t column = 0; column < static_cast<int32_t>(quadsPerRow); ++column) {
+            int32_t bottomLeft = -2 * rowVertexCount + column;
+            int32_t indices[4] = { bottomLeft, bottomLeft + 1, bottomLeft + 1 + rowVertexCount, bottomLeft + rowVertexCount };
+            text += "f";
+            for (int32_t index : indices) {
+                std::string indexText = std::to_string(index);
+                text += " " + indexText + "/" + indexText + "/" + indexText;
+            }
+            text += "\n";
+        }
+
+        file.write(text.data(), text.size());
+        writtenBytes += text.size();
+        ++rowCount;
+    }
+}
+
+// Generates OBJ files from 10 MB to 1 GB in the temp directory, loads each with tinyobj::LoadObj and
+// with ObjLoader::LoadObj, and prints the MB/s of each. The files are deleted afterwards.
+static void BenchmarkObjLoading()
+{
+    const size_t fileSizesMB[] = { 10u, 100u, 1024u };
+
+    std::cout << std::setw(12) << "Size (MB)" << std::setw(16) << "tinyobj MB/s"
+        << std::setw(16) << "ObjLoader MB/s" << std::setw(12) << "Speedup" << std::endl;
+    for (size_t fileSizeMB : fileSizesMB) {
+        std::filesystem::path filePath =
+            std::filesystem::temp_directory_path() / ("vgfx_benchmark_" + std::to_string(fileSizeMB) + "mb.obj");
+        WriteSyntheticObj(filePath.string(), fileSizeMB * 1024u * 1024u);
+        double actualSizeMB = static_cast<double>(std::filesystem::file_size(filePath)) / (1024.0 * 1024.0);
+
+        tinyobj::attrib_t attrib;
+        std::vector<tinyobj::shape_t> shapes;
+        std::vector<tinyobj::material_t> materials;
+        std::string warn, err;
+
+        auto startTime = std::chrono::high_resolution_clock::now();
+        bool tinyobjLoaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.string().c_str());
+        auto endTime = std::chrono::high_resolution_clock::now();
+        double tinyobjMBps = actualSizeMB / std::chrono::duration<double>(endTime - startTime).count();
+
+        // Freed before the second load, so the two don't compete for memory.
+        attrib = tinyobj::attrib_t();
+        shapes.clear();
+        shapes.shrink_to_fit();
+
+        startTime = std::chrono::high_resolution_clock::now();
+        bool objLoaderLoaded = vgfx::ObjLoader::LoadObj(&attrib, &shapes, &materials, &warn, &err, filePath.string());
+        endTime = std::chrono::high_resolution_clock::now();
+        double objLoaderMBps = actualSizeMB / std::chrono::duration<double>(endTime - startTime).count();
+
+        std::filesystem::remove(filePath);
+
+        if (!tinyobjLoaded || !objLoaderLoaded) {
+            std::cerr << "Failed to load the " << fileSizeMB << " MB OBJ: " << warn << err << std::endl;
+            continue;
+        }
+
+        std::cout << std::fixed << std::setprecision(0)
+            << std::setw(12) << actualSizeMB << std::setw(16) << tinyobjMBps << std::setw(16) << objLoaderMBps
+            << std::setw(11) << std::setprecision(2) << (objLoaderMBps / tinyobjMBps) << "x" << std::endl;
+    }
+}
+
+static void PrintMemoryStatistics(const char* pLabel, const vgfx::MemoryAllocator& memoryAllocator)
+{
+    vgfx::MemoryAllocator::Statistics statistics;
+    memoryAllocator.calculateStatistics(&statistics);
+    std::cout << std::setw(8) << pLabel
+        << std::setw(10) << statistics.blockCount
+        << std::setw(14) << (statistics.blockBytes / (1024u * 1024u))
+        << std::setw(14) << (statistics.allocatedBytes / (1024u * 1024u))
+        << std::setw(14) << (statistics.wastedBytes / (1024u * 1024u)) << std::endl;
+}
+
+// Allocates and frees vertex buffers of random sizes for a number of rounds, defragmenting a few
+// moves at a time between them like the Renderer does between frames, then defragments to
+// completion and checks that the remaining buffers still hold their data.
+static bool RunDefragmentationChurn(vgfx::Context& context)
+{
+    if (!context.isDefragmenterSupported()) {
+        std::cerr << "Defragmentation requires timeline semaphores." << std::endl;
+        return false;
+    }
+
+    auto& memoryAllocator = context.getMemoryAllocator();
+    // Staged so that the buffers are in the static pools of device local memory.
+    vgfx::MemoryAllocator::UploadStrategy prevUploadStrategy = memoryAllocator.getUploadStrategy();
+    memoryAllocator.setUploadStrategy(vgfx::MemoryAllocator::UploadStrategy::Staging);
+
+    vgfx::Defragmenter& defragmenter = context.getOrCreateDefragmenter();
+    vgfx::CommandBufferFactory& commandBufferFactory = context.getOrCreateUtilCommandBufferFactory();
+
+    vgfx::VertexBuffer::Config vertexBufferConfig(
+        VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        { vgfx::VertexBuffer::AttributeDescription(VK_FORMAT_R32G32B32A32_SFLOAT, 0u) });
+
+    const uint32_t roundCount = 8u;
+    const uint32_t buffersPerRound = 64u;
+    const uint32_t minVertexCount = 1024u;
+    const uint32_t maxVertexCount = 128u * 1024u;
+
+    struct ChurnBuffer
+    {
+        uint32_t seed = 0u;
+        size_t sizeBytes = 0u;
+        std::unique_ptr<vgfx::VertexBuffer> spVertexBuffer;
+    };
+    std::vector<ChurnBuffer> buffers;
+    std::mt19937 random(1234u);
+
+    auto fillData = [](uint32_t seed, size_t sizeBytes) {
+        std::vector<uint8_t> data(sizeBytes);
+        for (size_t i = 0u; i < sizeBytes; ++i) {
+            data[i] = static_cast<uint8_t>(((seed + i) * 2654435761u) >> 24);
+        }
+        return data;
+    };
+
+    std::cout << std::setw(8) << "" << std::setw(10) << "Blocks" << std::setw(14) << "Block MB"
+        << std::setw(14) << "Allocated MB" << std::setw(14) << "Wasted MB" << std::endl;
+
+    uint32_t nextSeed = 0u;
+    for (uint32_t round = 0u; round < roundCount; ++round) {
+        for (uint32_t i = 0u; i < buffersPerRound; ++i) {
+            ChurnBuffer buffer;
+            buffer.seed = nextSeed++;
+            buffer.sizeBytes = size_t(minVertexCount + random() % (maxVertexCount - minVertexCount)) * vertexBufferConfig.vertexStride;
+            std::vector<uint8_t> data = fillData(buffer.seed, buffer.sizeBytes);
+            buffer.spVertexBuffer =
+                std::make_unique<vgfx::VertexBuffer>(
+                    context,
+                    commandBufferFactory,
+                    vertexBufferConfig,
+                    data.data(),
+                    data.size());
+            buffers.push_back(std::move(buffer));
+        }
+
+        // Frees about half of them, leaving holes between the rest.
+        buffers.erase(
+            std::remove_if(buffers.begin(), buffers.end(), [&random](const ChurnBuffer&) { return (random() % 2u) == 0u; }),
+            buffers.end());
+
+        // A few passes in between, as if frames were rendered.
+        defragmenter.start();
+        for (uint32_t frame = 0u; frame < 4u; ++frame) {
+            defragmenter.update();
+            context.getRetirementQueue()->collect();
+        }
+    }
+
+    context.waitForDeviceToIdle();
+    PrintMemoryStatistics("Before", memoryAllocator);
+
+    defragmenter.start();
+    defragmenter.finish();
+    context.waitForDeviceToIdle();
+    PrintMemoryStatistics("After", memoryAllocator);
+
+    const vgfx::Defragmenter::Stats& stats = defragmenter.getStats();
+    std::cout << stats.passCount << " passes moved " << stats.movedAllocationCount << " allocations ("
+        << (stats.movedBytes / (1024u * 1024u)) << " MB), ignored " << stats.ignoredMoveCount
+        << " moves and freed " << stats.freedBlockCount << " blocks (" << (stats.freedBytes / (1024u * 1024u))
+        << " MB)." << std::endl;
+
+    // Reads each remaining buffer back through its current handle.
+    vgfx::OneTimeCommandsHelper commandsHelper(context, commandBufferFactory);
+    uint32_t corruptCount = 0u;
+    for (ChurnBuffer& buffer : buffers) {
+        auto readbackBuffer =
+            memoryAllocator.createBuffer(
+                buffer.sizeBytes,
+                VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_TO_CPU,
+                "Defragmentation churn readback");
+
+        commandsHelper.execute([&](VkCommandBuffer commandBuffer) {
+            VkBufferCopy copyRegion = {};
+            copyRegion.size = buffer.sizeBytes;
+            vkCmdCopyBuffer(commandBuffer, buffer.spVertexBuffer->getHandle(), readbackBuffer.handle, 1u, &copyRegion);
+        });
+
+        void* pData = nullptr;
+        memoryAllocator.mapBuffer(readbackBuffer, &pData);
+        if (memcmp(pData, fillData(buffer.seed, buffer.sizeBytes).data(), buffer.sizeBytes) != 0) {
+            ++corruptCount;
+        }
+        memoryAllocator.unmapBuffer(readbackBuffer);
+        memoryAllocator.destroyBuffer(readbackBuffer);
+    }
+
+    std::cout << buffers.size() << " buffers verified, " << corruptCount << " corrupt." << std::endl;
+
+    buffers.clear();
+    context.waitForDeviceToIdle();
+    memoryAllocator.setUploadStrategy(prevUploadStrategy);
+
+    return corruptCount == 0u;
+}
+
 int main(int argc, char** argv)
 {
     std::string dataDirPath = ".";
     std::string sceneFilename = "default.vgfx";
     bool enableValidationLayers = false;
+    bool benchmarkMipGeneration = false;
+    bool benchmarkUploads = false;
+    bool benchmarkDescriptorUpdates = false;
+    bool benchmarkObjLoading = false;
+    bool runDefragmentationChurn = false;
+    bool useDescriptorBuffers = false;
+    uint32_t benchmarkFrameCount = 0u;
+    std::string memoryTelemetryFilePath;
 
     ParseCommandLine(
         argc, argv,
         &dataDirPath,
         &sceneFilename,
-        &enableValidationLayers);
+        &enableValidationLayers,
+        &benchmarkMipGeneration,
+        &benchmarkUploads,
+        &benchmarkDescriptorUpdates,
+        &benchmarkObjLoading,
+        &runDefragmentationChurn,
+        &useDescriptorBuffers,
+        &benchmarkFrameCount,
+        &memoryTelemetryFilePath);
+
+    // Doesn't need a device.
+    if (benchmarkObjLoading) {
+        BenchmarkObjLoading();
+        return EXIT_SUCCESS;
+    }
 
     vgfx::Context::AppConfig appConfig("Demo");
     appConfig.enableValidationLayers = enableValidationLayers;
     appConfig.dataDirectoryPath = dataDirPath;
+    appConfig.useDescriptorBuffers = useDescriptorBuffers;
+
+    // Outlives the app, so the driver's host memory is counted in the telemetry.
+    vgfx::HostAllocator hostAllocator;
+    if (!memoryTelemetryFilePath.empty()) {
+        appConfig.pHostAllocator = &hostAllocator;
+    }
 
     vgfx::Context::InstanceConfig instanceConfig;
     vgfx::Context::DeviceConfig deviceConfig;
@@ -85,12 +795,38 @@ int main(int argc, char** argv)
 
     demo::GLFWApplication app(appConfig, instanceConfig, deviceConfig, swapChainConfig);
 
+    if (benchmarkMipGeneration) {
+        BenchmarkMipGeneration(app.getContext());
+        return EXIT_SUCCESS;
+    }
+
+    if (runDefragmentationChurn) {
+        return RunDefragmentationChurn(app.getContext()) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (benchmarkUploads) {
+        BenchmarkUploads(app.getContext());
+        return EXIT_SUCCESS;
+    }
+
+    if (benchmarkDescriptorUpdates) {
+        BenchmarkDescriptorUpdates(app.getContext());
+        return EXIT_SUCCESS;
+    }
+
     vgfx::SceneLoader& sceneLoader = app.getSceneLoader();
 
     std::unique_ptr<vgfx::SceneNode> spScene = sceneLoader.loadScene(sceneFilename);
 
     app.setScene(std::move(spScene));
 
+    app.setMemoryTelemetryFilePath(memoryTelemetryFilePath);
+
+    if (useDescriptorBuffers && !app.getContext().areDescriptorBuffersEnabled()) {
+        std::cout << "Descriptor buffers are not supported, descriptor pools are used." << std::endl;
+    }
+    app.setBenchmarkFrameCount(benchmarkFrameCount);
+
     app.run();
 
     return EXIT_SUCCESS;
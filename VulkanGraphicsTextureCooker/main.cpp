@@ -0,0 +1,543 @@
+// VulkanGraphicsTextureCooker.cpp : Converts images to block compressed KTX2 files with complete
+// mip chains, which TextureFile::Load picks up in place of the images. Runs entirely on the CPU.
+//
+
+#include "VulkanGraphicsImageKernels.h"
+#include "VulkanGraphicsTextureCodec.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct CookerOptions
+{
+    bool useBc7 = true;
+    vgfx::TextureCodec::MipFilter mipFilter = vgfx::TextureCodec::MipFilter::Kaiser;
+    bool isSrgb = false;
+    bool premultiplyAlpha = false;
+    bool benchmarkKernels = false;
+    uint32_t threadCount = 0u;
+    std::string outputDirPath;
+    std::vector<std::string> inputPaths;
+};
+
+static void ShowHelpAndExit(const char* pBadOption = nullptr)
+{
+    std::ostringstream oss;
+    bool throwError = false;
+    if (pBadOption) {
+        throwError = true;
+        oss << "Error parsing \"" << pBadOption << "\"" << std::endl;
+    }
+    oss << "Usage: VulkanGraphicsTextureCooker [options] <image paths, e.g. data/*.png>" << std::endl
+        << "Options:" << std::endl
+        << "-f           Block format, bc1 or bc7 (default)." << std::endl
+        << "-m           Mip filter, box or kaiser (default)." << std::endl
+        << "-s           Images are sRGB, filter in linear space and write an sRGB format." << std::endl
+        << "-p           Premultiply the color channels by alpha." << std::endl
+        << "-b           Benchmark the CPU image kernels of each instruction set, then exit." << std::endl
+        << "-t           Encoder thread count (default is one per core)." << std::endl
+        << "-o           Output directory (default is next to each image)." << std::endl;
+
+    if (throwError) {
+        throw std::invalid_argument(oss.str());
+    } else {
+        std::cerr << oss.str();
+        exit(0);
+    }
+}
+
+static void ParseCommandLine(int argc, char* argv[], CookerOptions* pOptions)
+{
+    for (int i = 1; i < argc; ++i) {
+        if (_stricmp(argv[i], "-h") == 0) {
+            ShowHelpAndExit();
+        } else if (_stricmp(argv[i], "-f") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-f");
+            }
+            if (_stricmp(argv[i], "bc1") == 0) {
+                pOptions->useBc7 = false;
+            } else if (_stricmp(argv[i], "bc7") == 0) {
+                pOptions->useBc7 = true;
+            } else {
+                ShowHelpAndExit(argv[i]);
+            }
+            continue;
+        } else if (_stricmp(argv[i], "-m") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-m");
+            }
+            if (_stricmp(argv[i], "box") == 0) {
+                pOptions->mipFilter = vgfx::TextureCodec::MipFilter::Box;
+            } else if (_stricmp(argv[i], "kaiser") == 0) {
+                pOptions->mipFilter = vgfx::TextureCodec::MipFilter::Kaiser;
+            } else {
+                ShowHelpAndExit(argv[i]);
+            }
+            continue;
+        } else if (_stricmp(argv[i], "-s") == 0) {
+            pOptions->isSrgb = true;
+            continue;
+        } else if (_stricmp(argv[i], "-p") == 0) {
+            pOptions->premultiplyAlpha = true;
+            continue;
+        } else if (_stricmp(argv[i], "-b") == 0) {
+            pOptions->benchmarkKernels = true;
+            continue;
+        } else if (_stricmp(argv[i], "-t") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-t");
+            }
+            pOptions->threadCount = static_cast<uint32_t>(std::stoul(argv[i]));
+            continue;
+        } else if (_stricmp(argv[i], "-o") == 0) {
+            if (++i == argc) {
+                ShowHelpAndExit("-o");
+            }
+            pOptions->outputDirPath = argv[i];
+            continue;
+        } else if (argv[i][0] == '-') {
+            ShowHelpAndExit(argv[i]);
+        }
+        pOptions->inputPaths.push_back(argv[i]);
+    }
+
+    if (pOptions->inputPaths.empty() && !pOptions->benchmarkKernels) {
+        ShowHelpAndExit();
+    }
+}
+
+// Matches '*' and '?' wildcards, the Windows command prompt doesn't expand them.
+static bool MatchesWildcard(const char* pPattern, const char* pName)
+{
+    if (*pPattern == '\0') {
+        return *pName == '\0';
+    }
+    if (*pPattern == '*') {
+        return MatchesWildcard(pPattern + 1, pName) || (*pName != '\0' && MatchesWildcard(pPattern, pName + 1));
+    }
+    if (*pName != '\0' && (*pPattern == '?' || tolower(*pPattern) == tolower(*pName))) {
+        return MatchesWildcard(pPattern + 1, pName + 1);
+    }
+    return false;
+}
+
+static std::vector<std::filesystem::path> ExpandInputPaths(const std::vector<std::string>& inputPaths)
+{
+    std::vector<std::filesystem::path> paths;
+    for (const auto& inputPath : inputPaths) {
+        std::filesystem::path path(inputPath);
+        std::string pattern = path.filename().string();
+        if (pattern.find_first_of("*?") == std::string::npos) {
+            paths.push_back(path);
+            continue;
+        }
+
+        std::filesystem::path dirPath = path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+        std::vector<std::filesystem::path> matches;
+        for (const auto& entry : std::filesystem::directory_iterator(dirPath)) {
+            if (entry.is_regular_file() && MatchesWildcard(pattern.c_str(), entry.path().filename().string().c_str())) {
+                matches.push_back(entry.path());
+            }
+        }
+        std::sort(matches.begin(), matches.end());
+        paths.insert(paths.end(), matches.begin(), matches.end());
+    }
+    return paths;
+}
+
+static void WriteUint32(std::vector<uint8_t>* pData, size_t offset, uint32_t value)
+{
+    memcpy(pData->data() + offset, &value, sizeof(value));
+}
+
+static void WriteUint64(std::vector<uint8_t>* pData, size_t offset, uint64_t value)
+{
+    memcpy(pData->data() + offset, &value, sizeof(value));
+}
+
+// Basic data format descriptor for a BC1 or BC7 format, KTX2 requires one.
+static std::vector<uint8_t> CreateDataFormatDescriptor(VkFormat format)
+{
+    const uint32_t KHR_DF_MODEL_BC1A = 128u;
+    const uint32_t KHR_DF_MODEL_BC7 = 135u;
+    const uint32_t KHR_DF_PRIMARIES_BT709 = 1u;
+    const uint32_t KHR_DF_TRANSFER_LINEAR = 1u;
+    const uint32_t KHR_DF_TRANSFER_SRGB = 2u;
+    const uint32_t KHR_DF_CHANNEL_BC1A_ALPHAPRESENT = 1u;
+
+    bool isBc7 = format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+    bool isSrgb =
+        format == VK_FORMAT_BC7_SRGB_BLOCK
+        || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK
+        || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    bool hasAlpha = format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+    uint32_t blockSizeBytes = isBc7 ? 16u : 8u;
+
+    // Total size, then a descriptor block with one sample.
+    const uint32_t descriptorBlockSize = 24u + 16u;
+    std::vector<uint8_t> dfd(4u + descriptorBlockSize, 0u);
+    WriteUint32(&dfd, 0u, static_cast<uint32_t>(dfd.size()));
+    // Vendor id and descriptor type are zero.
+    WriteUint32(&dfd, 4u, 0u);
+    // Version 1.3 of the data format specification.
+    WriteUint32(&dfd, 8u, 2u | (descriptorBlockSize << 16u));
+    WriteUint32(
+        &dfd,
+        12u,
+        (isBc7 ? KHR_DF_MODEL_BC7 : KHR_DF_MODEL_BC1A)
+        | (KHR_DF_PRIMARIES_BT709 << 8u)
+        | ((isSrgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16u));
+    // 4x4x1x1 texel blocks, the dimensions are stored minus one.
+    WriteUint32(&dfd, 16u, 3u | (3u << 8u));
+    WriteUint32(&dfd, 20u, blockSizeBytes);
+    // The sample covers the whole block.
+    uint32_t channelType = hasAlpha ? KHR_DF_CHANNEL_BC1A_ALPHAPRESENT : 0u;
+    WriteUint32(&dfd, 28u, ((blockSizeBytes * 8u - 1u) << 16u) | (channelType << 24u));
+    WriteUint32(&dfd, 32u, 0u);
+    WriteUint32(&dfd, 36u, 0u);
+    WriteUint32(&dfd, 40u, 0xFFFFFFFFu);
+    return dfd;
+}
+
+// Writes the blocks of each mip level, largest first, to a KTX2 file.
+static bool WriteKtx2(
+    const std::filesystem::path& path,
+    VkFormat format,
+    uint32_t width,
+    uint32_t height,
+    const std::vector<std::vector<uint8_t>>& levels)
+{
+    static const uint8_t Ktx2Identifier[12] = {
+        0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+    };
+
+    const size_t headerSizeBytes = sizeof(Ktx2Identifier) + 9u * 4u + 4u * 4u + 2u * 8u;
+    size_t levelIndexSizeBytes = levels.size() * 3u * 8u;
+    std::vector<uint8_t> dfd = CreateDataFormatDescriptor(format);
+
+    std::vector<uint8_t> fileData(headerSizeBytes + levelIndexSizeBytes + dfd.size(), 0u);
+    memcpy(fileData.data(), Ktx2Identifier, sizeof(Ktx2Identifier));
+    size_t offset = sizeof(Ktx2Identifier);
+    WriteUint32(&fileData, offset, static_cast<uint32_t>(format));
+    WriteUint32(&fileData, offset + 4u, 1u); // type size
+    WriteUint32(&fileData, offset + 8u, width);
+    WriteUint32(&fileData, offset + 12u, height);
+    WriteUint32(&fileData, offset + 16u, 0u); // depth
+    WriteUint32(&fileData, offset + 20u, 0u); // layer count
+    WriteUint32(&fileData, offset + 24u, 1u); // face count
+    WriteUint32(&fileData, offset + 28u, static_cast<uint32_t>(levels.size()));
+    WriteUint32(&fileData, offset + 32u, 0u); // no supercompression
+    offset += 9u * 4u;
+
+    size_t dfdOffset = headerSizeBytes + levelIndexSizeBytes;
+    WriteUint32(&fileData, offset, static_cast<uint32_t>(dfdOffset));
+    WriteUint32(&fileData, offset + 4u, static_cast<uint32_t>(dfd.size()));
+    // No key/value data or supercompression global data.
+    memcpy(fileData.data() + dfdOffset, dfd.data(), dfd.size());
+
+    // The level data is stored smallest first, each level is aligned to the block size.
+    size_t blockSizeBytes = (format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK) ? 16u : 8u;
+    for (size_t level = levels.size(); level-- > 0u;) {
+        size_t levelOffset = (fileData.size() + blockSizeBytes - 1u) / blockSizeBytes * blockSizeBytes;
+        fileData.resize(levelOffset);
+        fileData.insert(fileData.end(), levels[level].begin(), levels[level].end());
+
+        size_t levelIndexOffset = headerSizeBytes + level * 3u * 8u;
+        WriteUint64(&fileData, levelIndexOffset, levelOffset);
+        WriteUint64(&fileData, levelIndexOffset + 8u, levels[level].size());
+        WriteUint64(&fileData, levelIndexOffset + 16u, levels[level].size());
+    }
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(fileData.data()), fileData.size());
+    return file.good();
+}
+
+static double ToMilliseconds(std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Loads an image as RGBA8, RGB images are expanded by the ImageKernels rather than stb_image.
+static bool LoadRgba8(const std::filesystem::path& path, int32_t* pWidth, int32_t* pHeight, std::vector<uint8_t>* pRgba)
+{
+    int32_t channels = 0;
+    if (!stbi_info(path.string().c_str(), pWidth, pHeight, &channels)) {
+        return false;
+    }
+
+    int32_t loadChannels = channels == STBI_rgb ? STBI_rgb : STBI_rgb_alpha;
+    stbi_uc* pPixels = stbi_load(path.string().c_str(), pWidth, pHeight, &channels, loadChannels);
+    if (pPixels == nullptr) {
+        return false;
+    }
+
+    size_t texelCount = static_cast<size_t>(*pWidth) * static_cast<size_t>(*pHeight);
+    pRgba->resize(texelCount * 4u);
+    if (loadChannels == STBI_rgb) {
+        vgfx::ImageKernels::ExpandRgbToRgba(pPixels, texelCount, pRgba->data());
+    } else {
+        memcpy(pRgba->data(), pPixels, pRgba->size());
+    }
+    stbi_image_free(pPixels);
+
+    return true;
+}
+
+// Times each of the ImageKernels with every instruction set that the CPU supports, in GB/s of
+// source data, and checks that their output matches the scalar kernels byte for byte.
+static bool BenchmarkImageKernels()
+{
+    using vgfx::ImageKernels::InstructionSet;
+
+    const uint32_t width = 2048u;
+    const uint32_t height = 2048u;
+    const size_t texelCount = static_cast<size_t>(width) * height;
+
+    std::mt19937 random(1u);
+    std::vector<uint8_t> rgb(texelCount * 3u);
+    std::vector<uint8_t> rgba(texelCount * 4u);
+    std::vector<float> floats(texelCount * 4u);
+    for (auto& value : rgb) {
+        value = static_cast<uint8_t>(random());
+    }
+    for (auto& value : rgba) {
+        value = static_cast<uint8_t>(random());
+    }
+    // Includes values outside of [0, 1] to check the clamping.
+    std::uniform_real_distribution<float> distribution(-0.1f, 1.1f);
+    for (auto& value : floats) {
+        value = distribution(random);
+    }
+
+    std::vector<uint8_t> output(texelCount * 4u);
+    std::vector<float> floatOutput(texelCount * 4u);
+    struct Kernel
+    {
+        const char* pName;
+        size_t sourceBytes;
+        std::function<void()> run;
+        const void* pOutput;
+        size_t outputBytes;
+    };
+    // PremultiplyAlpha works in place, so its time includes copying the source to the output.
+    const Kernel kernels[] = {
+        { "ExpandRgbToRgba", rgb.size(), [&]() {
+            vgfx::ImageKernels::ExpandRgbToRgba(rgb.data(), texelCount, output.data()); },
+            output.data(), texelCount * 4u },
+        { "PremultiplyAlpha", rgba.size(), [&]() {
+            memcpy(output.data(), rgba.data(), rgba.size());
+            vgfx::ImageKernels::PremultiplyAlpha(output.data(), texelCount); },
+            output.data(), texelCount * 4u },
+        { "Rgba8ToFloat", rgba.size(), [&]() {
+            vgfx::ImageKernels::ConvertRgba8ToFloat(rgba.data(), texelCount, false, floatOutput.data()); },
+            floatOutput.data(), floatOutput.size() * sizeof(float) },
+        { "SrgbToFloat", rgba.size(), [&]() {
+            vgfx::ImageKernels::ConvertRgba8ToFloat(rgba.data(), texelCount, true, floatOutput.data()); },
+            floatOutput.data(), floatOutput.size() * sizeof(float) },
+        { "FloatToRgba8", floats.size() * sizeof(float), [&]() {
+            vgfx::ImageKernels::ConvertFloatToRgba8(floats.data(), texelCount, false, output.data()); },
+            output.data(), texelCount * 4u },
+        { "FloatToSrgb", floats.size() * sizeof(float), [&]() {
+            vgfx::ImageKernels::ConvertFloatToRgba8(floats.data(), texelCount, true, output.data()); },
+            output.data(), texelCount * 4u },
+        { "Reduce2x2", rgba.size(), [&]() {
+            vgfx::ImageKernels::Reduce2x2(rgba.data(), width, height, output.data()); },
+            output.data(), texelCount },
+    };
+
+    const InstructionSet instructionSets[] = {
+        InstructionSet::Scalar, InstructionSet::Sse2, InstructionSet::Avx2, InstructionSet::Neon
+    };
+
+    std::cout << std::left << std::setw(20) << "Kernel"
+        << std::setw(10) << "ISA"
+        << std::right << std::setw(10) << "GB/s"
+        << std::setw(10) << "Speedup" << std::endl;
+
+    InstructionSet defaultInstructionSet = vgfx::ImageKernels::GetInstructionSet();
+    bool allMatch = true;
+    for (const auto& kernel : kernels) {
+        std::vector<uint8_t> scalarOutput;
+        double scalarGBps = 0.0;
+        for (InstructionSet instructionSet : instructionSets) {
+            if (!vgfx::ImageKernels::SetInstructionSet(instructionSet)) {
+                continue;
+            }
+
+            // Repeats the kernel for at least 200 ms.
+            uint32_t runCount = 0u;
+            auto startTime = std::chrono::steady_clock::now();
+            double elapsedMs = 0.0;
+            do {
+                kernel.run();
+                ++runCount;
+                elapsedMs = ToMilliseconds(std::chrono::steady_clock::now() - startTime);
+            } while (elapsedMs < 200.0);
+            double gbps = static_cast<double>(kernel.sourceBytes) * runCount / (elapsedMs * 1.0e6);
+
+            const uint8_t* pOutput = reinterpret_cast<const uint8_t*>(kernel.pOutput);
+            bool matches = true;
+            if (instructionSet == InstructionSet::Scalar) {
+                scalarOutput.assign(pOutput, pOutput + kernel.outputBytes);
+                scalarGBps = gbps;
+            } else {
+                matches = memcmp(pOutput, scalarOutput.data(), kernel.outputBytes) == 0;
+                allMatch = allMatch && matches;
+            }
+
+            std::cout << std::left << std::setw(20) << kernel.pName
+                << std::setw(10) << vgfx::ImageKernels::GetInstructionSetName(instructionSet)
+                << std::right << std::fixed << std::setprecision(2)
+                << std::setw(10) << gbps
+                << std::setw(9) << gbps / scalarGBps << "x"
+                << (matches ? "" : "  MISMATCH") << std::endl;
+        }
+    }
+    vgfx::ImageKernels::SetInstructionSet(defaultInstructionSet);
+
+    return allMatch;
+}
+
+int main(int argc, char** argv)
+{
+    CookerOptions options;
+    ParseCommandLine(argc, argv, &options);
+
+    if (options.benchmarkKernels) {
+        return BenchmarkImageKernels() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::vector<std::filesystem::path> inputPaths = ExpandInputPaths(options.inputPaths);
+    if (inputPaths.empty()) {
+        std::cerr << "No images matched." << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout << std::left << std::setw(28) << "Texture"
+        << std::right << std::setw(12) << "Size"
+        << std::setw(8) << "Mips"
+        << std::setw(12) << "Mips ms"
+        << std::setw(12) << "Encode ms"
+        << std::setw(10) << "MPix/s"
+        << std::setw(12) << "PSNR dB" << std::endl;
+
+    uint32_t failedCount = 0u;
+    uint64_t totalPixelCount = 0u;
+    double totalEncodeMs = 0.0;
+    for (const auto& inputPath : inputPaths) {
+        int32_t width = 0;
+        int32_t height = 0;
+        std::vector<uint8_t> pixels;
+        if (!LoadRgba8(inputPath, &width, &height, &pixels)) {
+            std::cerr << "Failed to load " << inputPath.string() << ": " << stbi_failure_reason() << std::endl;
+            ++failedCount;
+            continue;
+        }
+
+        auto mipStartTime = std::chrono::steady_clock::now();
+        if (options.premultiplyAlpha) {
+            vgfx::ImageKernels::PremultiplyAlpha(pixels.data(), pixels.size() / 4u);
+        }
+        std::vector<vgfx::TextureCodec::MipLevel> mipLevels =
+            vgfx::TextureCodec::GenerateMipChain(
+                pixels.data(),
+                static_cast<uint32_t>(width),
+                static_cast<uint32_t>(height),
+                options.mipFilter,
+                options.isSrgb);
+        double mipMs = ToMilliseconds(std::chrono::steady_clock::now() - mipStartTime);
+
+        // BC1 only keeps 1 bit alpha, so use its RGBA format only if the image needs it.
+        bool hasAlpha = false;
+        for (const auto& mipLevel : mipLevels) {
+            for (size_t i = 3u; i < mipLevel.pixels.size() && !hasAlpha; i += 4u) {
+                hasAlpha = mipLevel.pixels[i] < 128u;
+            }
+        }
+
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        if (options.useBc7) {
+            format = options.isSrgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        } else if (hasAlpha) {
+            format = options.isSrgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+        } else {
+            format = options.isSrgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        }
+
+        auto encodeStartTime = std::chrono::steady_clock::now();
+        std::vector<std::vector<uint8_t>> encodedLevels(mipLevels.size());
+        uint64_t pixelCount = 0u;
+        for (size_t level = 0u; level < mipLevels.size(); ++level) {
+            const auto& mipLevel = mipLevels[level];
+            vgfx::TextureCodec::EncodeImage(
+                format,
+                mipLevel.pixels.data(),
+                mipLevel.width,
+                mipLevel.height,
+                options.threadCount,
+                &encodedLevels[level]);
+            pixelCount += static_cast<uint64_t>(mipLevel.width) * mipLevel.height;
+        }
+        double encodeMs = ToMilliseconds(std::chrono::steady_clock::now() - encodeStartTime);
+
+        // Quality of the largest level, alpha is included unless the format is opaque.
+        const auto& baseLevel = mipLevels[0];
+        size_t basePixelCount = static_cast<size_t>(baseLevel.width) * baseLevel.height;
+        std::vector<uint8_t> decoded(baseLevel.pixels.size());
+        vgfx::TextureCodec::DecodeImage(format, encodedLevels[0].data(), baseLevel.width, baseLevel.height, decoded.data());
+        bool includeAlpha = options.useBc7 || hasAlpha;
+        double psnr = vgfx::TextureCodec::ComputePsnr(decoded.data(), baseLevel.pixels.data(), basePixelCount, includeAlpha);
+
+        std::filesystem::path outputPath = inputPath;
+        outputPath.replace_extension(".ktx2");
+        if (!options.outputDirPath.empty()) {
+            outputPath = std::filesystem::path(options.outputDirPath) / outputPath.filename();
+        }
+
+        if (!WriteKtx2(outputPath, format, baseLevel.width, baseLevel.height, encodedLevels)) {
+            std::cerr << "Failed to write " << outputPath.string() << std::endl;
+            ++failedCount;
+            continue;
+        }
+
+        totalPixelCount += pixelCount;
+        totalEncodeMs += encodeMs;
+
+        std::ostringstream size;
+        size << width << "x" << height;
+        std::cout << std::left << std::setw(28) << inputPath.filename().string()
+            << std::right << std::setw(12) << size.str()
+            << std::setw(8) << mipLevels.size()
+            << std::fixed << std::setprecision(1)
+            << std::setw(12) << mipMs
+            << std::setw(12) << encodeMs
+            << std::setw(10) << (encodeMs > 0.0 ? pixelCount / (encodeMs * 1000.0) : 0.0)
+            << std::setw(12) << psnr << std::endl;
+    }
+
+    std::cout << "Encoded " << totalPixelCount << " texels in " << std::fixed << std::setprecision(1)
+        << totalEncodeMs << " ms ("
+        << (totalEncodeMs > 0.0 ? totalPixelCount / (totalEncodeMs * 1000.0) : 0.0) << " MPix/s)" << std::endl;
+
+    return failedCount == 0u ? EXIT_SUCCESS : EXIT_FAILURE;
+}
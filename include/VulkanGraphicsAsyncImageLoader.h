@@ -0,0 +1,170 @@
+#pragma once
+
+#include "VulkanGraphicsCommandBufferFactory.h"
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsImage.h"
+#include "VulkanGraphicsImageDownsampler.h"
+#include "VulkanGraphicsTextureFile.h"
+#include "VulkanGraphicsUploadManager.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Loads images without stalling the render thread. Files are decoded by a pool of worker
+    // threads, and the decoded images are uploaded in batches by update(), which should be called
+    // once per frame on the render thread. Each batch is a single submission of the loader's
+    // UploadManager, whose staging ring holds maxBatchesInFlight batches, so update() never waits
+    // for the GPU. When a batch has completed the images are handed to their requests' callbacks.
+    class AsyncImageLoader
+    {
+    public:
+        struct Config
+        {
+            // Zero uses std::thread::hardware_concurrency() - 1.
+            uint32_t workerThreadCount = 0u;
+            // Decoded bytes that are uploaded per call to update(), a single image that is larger
+            // than this is uploaded by itself.
+            VkDeviceSize maxUploadBytesPerUpdate = 32u * 1024u * 1024u;
+            // Number of submitted batches that have not completed before update() stops submitting.
+            uint32_t maxBatchesInFlight = 3u;
+            // A frame is counted as a spike if it takes longer than this multiple of the median
+            // frame time recorded while images were loading.
+            float frameSpikeFactor = 2.0f;
+        };
+
+        // Called by update() on the render thread once the image is ready to be sampled, or with
+        // nullptr if the image could not be loaded.
+        using OnLoadedFunc = std::function<void(std::unique_ptr<Image>&& spImage)>;
+
+        AsyncImageLoader(
+            Context& context,
+            CommandBufferFactory& commandBufferFactory,
+            const Config& config = Config());
+
+        ~AsyncImageLoader();
+
+        // Queues the file for decoding, the callback is invoked by a later call to update().
+        void loadImage(const std::string& path, OnLoadedFunc onLoadedFunc);
+
+        // Called like OnLoadedFunc, along with the size of the file's largest mip level.
+        using OnLevelsLoadedFunc = std::function<void(std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent)>;
+
+        // Same as loadImage, but only loads the mip levels whose larger side is no larger than
+        // maxSize (see TextureFile::DropLevelsLargerThan), zero loads all of them.
+        void loadImageLevels(const std::string& path, uint32_t maxSize, OnLevelsLoadedFunc onLoadedFunc);
+
+        // Submits the next batch of decoded images, and invokes the callbacks of any completed
+        // batches. Also records the time since the previous call as a frame time if any loads
+        // were outstanding.
+        void update();
+
+        // True if any requests have not had their callback invoked yet.
+        bool isLoading() const { return m_outstandingRequestCount > 0u; }
+
+        // 1x1 opaque white image that is shared by everything waiting on a load.
+        const Image& getPlaceholderImage() const { return *m_spPlaceholderImage.get(); }
+
+        struct Stats
+        {
+            uint32_t requestedCount = 0u;
+            uint32_t loadedCount = 0u;
+            uint32_t failedCount = 0u;
+            uint32_t batchCount = 0u;
+            uint64_t uploadedBytes = 0u;
+
+            // Frame times recorded while loads were outstanding.
+            uint32_t frameCount = 0u;
+            float medianFrameTimeMs = 0.0f;
+            float p99FrameTimeMs = 0.0f;
+            float maxFrameTimeMs = 0.0f;
+            uint32_t frameSpikeCount = 0u;
+            // Longest time spent inside update(), i.e. the loader's own cost on the render thread.
+            float maxUpdateTimeMs = 0.0f;
+        };
+        Stats getStats() const;
+
+        // Clears the frame times so that the next streaming period is measured on its own.
+        void resetFrameTimes();
+
+    private:
+        struct DecodeRequest
+        {
+            uint64_t requestId = 0u;
+            std::string path;
+            uint32_t maxSize = 0u;
+        };
+
+        struct DecodedImage
+        {
+            uint64_t requestId = 0u;
+            std::string path;
+            // Empty if the file could not be loaded.
+            TextureFile::TextureData textureData;
+            VkExtent2D fileExtent = {};
+        };
+
+        struct LoadedImage
+        {
+            uint64_t requestId = 0u;
+            std::unique_ptr<Image> spImage;
+            VkExtent2D fileExtent = {};
+        };
+
+        struct UploadBatch
+        {
+            UploadManager::UploadId uploadId = 0u;
+            std::vector<LoadedImage> images;
+            // Resources used to generate the mip levels of the batch's images, if any.
+            std::unique_ptr<ImageDownsampler::Batch> spDownsamplerBatch;
+        };
+
+        void runWorker();
+
+        void submitBatch(std::vector<DecodedImage>& decodedImages);
+        void completeBatches(bool waitForCompletion);
+        void invokeCallback(uint64_t requestId, std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent);
+
+        void createPlaceholderImage();
+
+        Context& m_context;
+        CommandBufferFactory& m_commandBufferFactory;
+        Config m_config;
+
+        std::unique_ptr<UploadManager> m_spUploadManager;
+
+        std::unique_ptr<Image> m_spPlaceholderImage;
+
+        // Decode queue shared with the worker threads.
+        std::mutex m_decodeMutex;
+        std::condition_variable m_decodeCondition;
+        std::deque<DecodeRequest> m_decodeQueue;
+        std::vector<DecodedImage> m_decodedImages;
+        bool m_stopWorkers = false;
+        std::vector<std::thread> m_workers;
+
+        // Only accessed on the render thread.
+        uint64_t m_nextRequestId = 0u;
+        uint32_t m_outstandingRequestCount = 0u;
+        std::unordered_map<uint64_t, OnLevelsLoadedFunc> m_callbacks;
+        std::deque<UploadBatch> m_batchesInFlight;
+        std::vector<DecodedImage> m_pendingUploads;
+
+        Stats m_stats;
+        std::vector<float> m_frameTimesMs;
+        std::chrono::steady_clock::time_point m_lastUpdateTime;
+        bool m_hasLastUpdateTime = false;
+    };
+}
@@ -46,6 +46,15 @@ namespace vgfx
             Type type,
             const Config& config);
 
+        // Persistently mapped buffer from the frame's transient pool, see
+        // MemoryAllocator::createTransientBuffer. The pool frees it when it is reset, so it must
+        // only be used by the frame that created it. Config::memoryUsage and sharingMode are ignored.
+        Buffer(
+            Context& context,
+            Type type,
+            const Config& config,
+            uint32_t transientPoolIndex);
+
         ~Buffer() {
             destroy();
         }
@@ -62,6 +71,11 @@ namespace vgfx
             MemMap memMap = MemMap::UnMap)
         {
             assert(sizeOfDataBytes <= m_bufferSize);
+            if (m_isTransient) {
+                // Flushes the write if the memory isn't coherent.
+                m_context.getMemoryAllocator().writeMappedBuffer(m_buffer, pData, sizeOfDataBytes, writeOffsetBytes);
+                return true;
+            }
             if (m_pMappedPtr == nullptr) {
                 if (!m_context.getMemoryAllocator().mapBuffer(m_buffer, reinterpret_cast<void**>(&m_pMappedPtr))) {
                     return false;
@@ -80,6 +94,9 @@ namespace vgfx
         VkBuffer getHandle() { return m_buffer.handle;  }
         size_t getSize() const { return m_bufferSize; }
 
+        // Whole buffer, for DescriptorSetLayout::updateDescriptorSet.
+        const VkDescriptorBufferInfo& getDescriptorBufferInfo() const { return m_bufferInfo; }
+
         void update(VkWriteDescriptorSet* pWriteSet) const override
         {
             DescriptorUpdater::update(pWriteSet);
@@ -98,6 +115,7 @@ namespace vgfx
 
         MemoryAllocator::Buffer m_buffer;
         uint8_t* m_pMappedPtr = nullptr;
+        bool m_isTransient = false;
 
         VkDescriptorBufferInfo m_bufferInfo = {};
     };
@@ -13,14 +13,13 @@ namespace vgfx
     class Camera
     {
     public:
-        Camera(Context& context, const VkViewport& viewport, size_t frameBufferingCount);
+        Camera(Context& context, const VkViewport& viewport);
         Camera(
             Context& context,
-            size_t framesInFlightPlusOne,
             const glm::mat4& view,
             const glm::mat4& proj,
             const VkViewport& viewport)
-            : Camera(context, viewport, framesInFlightPlusOne)
+            : Camera(context, viewport)
         {
             m_view = view;
             m_proj = proj;
@@ -38,10 +37,10 @@ namespace vgfx
         void setProjection(const glm::mat4& proj)
         {
             m_proj = proj;
-            m_projBufferNeedsUpdateCount = m_cameraMatrixBuffers.size();
         }
 
-        Buffer& getProjectionBuffer() { return *m_cameraMatrixBuffers[m_currentBufferIndex].get(); }
+        // Uniform buffer of the projection matrix followed by the view matrix, as of the last update().
+        Buffer& getProjectionBuffer() { return *m_spCameraMatrixBuffer.get(); }
 
         Pipeline::RasterizerConfig getRasterizerConfig() const {
             return m_rasterizerConfig;
@@ -51,15 +50,16 @@ namespace vgfx
             return m_viewport;
         }
 
-        void update();
+        // Writes the matrices to a new buffer from the frame's transient pool, see
+        // DrawContext::transientPoolIndex.
+        void update(uint32_t transientPoolIndex);
 
     private:
-        std::vector<std::unique_ptr<Buffer>> m_cameraMatrixBuffers;
-        size_t m_currentBufferIndex = 0u;
+        Context& m_context;
+        std::unique_ptr<Buffer> m_spCameraMatrixBuffer;
 
         glm::mat4 m_view = glm::identity<glm::mat4>();
         glm::mat4 m_proj = glm::identity<glm::mat4>();
-        size_t m_projBufferNeedsUpdateCount = 0;
         VkViewport m_viewport = {};
         Pipeline::RasterizerConfig m_rasterizerConfig;
     };
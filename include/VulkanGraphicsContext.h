@@ -23,6 +23,11 @@ namespace vgfx
     class Renderer;
     class RenderTarget;
     class ImageDownsampler;
+    class UploadManager;
+    class GpuTimeline;
+    class RetirementQueue;
+    class Defragmenter;
+    class HostAllocator;
 
     class Context
     {
@@ -49,6 +54,16 @@ namespace vgfx
             bool enableValidationLayers = false;
             ValidationLayerFunc onValidationLayerFunc = nullptr;
             std::string dataDirectoryPath = ".";
+            // Counts the host memory allocated by the driver and VMA if set, must outlive the
+            // Context.
+            HostAllocator* pHostAllocator = nullptr;
+            // Write the descriptors of mesh effects to descriptor buffers instead of descriptor
+            // sets allocated from pools, if VK_EXT_descriptor_buffer is supported.
+            bool useDescriptorBuffers = false;
+            // The Renderer starts the Defragmenter when more than this fraction of the memory
+            // blocks is in holes between allocations, see MemoryAllocator::Statistics::
+            // fragmentedBytes, if it is supported. Zero disables it.
+            float defragmentWastedFraction = 0.25f;
 
             AppConfig(
                 const std::string& appName,
@@ -139,7 +154,7 @@ namespace vgfx
         uint32_t getDedicatedComputeQueueMaxCount() const;
 
         const bool hasDedicatedTransferQueueFamily(uint32_t index) const {
-            return m_queueFamilyIndices.transferFamily.value();
+            return m_queueFamilyIndices.transferFamily.has_value();
         }
         const uint32_t getDedicatedTransferQueueFamilyIndex(uint32_t index) const {
             return m_queueFamilyIndices.transferFamily.value();
@@ -156,10 +171,99 @@ namespace vgfx
 
         bool isDescriptorIndexingSupported() const { return m_descriptorIndexingIsSupported; }
 
+        // Timeline semaphores require Vulkan 1.2.
+        bool areTimelineSemaphoresSupported() const { return m_timelineSemaphoresAreSupported; }
+
+        // Descriptor update templates require Vulkan 1.1.
+        bool areDescriptorUpdateTemplatesSupported() const { return m_descriptorUpdateTemplatesAreSupported; }
+
+        // Push descriptors require VK_KHR_push_descriptor, which is enabled if it is available.
+        bool arePushDescriptorsSupported() const { return m_pushDescriptorsAreSupported; }
+
+        // vkCmdPushDescriptorSetKHR, the set's layout must have been created with
+        // VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR.
+        void pushDescriptorSet(
+            VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint pipelineBindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t setIndex,
+            uint32_t descriptorWriteCount,
+            const VkWriteDescriptorSet* pDescriptorWrites);
+
+        // Set if AppConfig::useDescriptorBuffers was set and VK_EXT_descriptor_buffer and buffer
+        // device addresses are supported, in which case they are both enabled.
+        bool areDescriptorBuffersEnabled() const { return m_descriptorBuffersAreEnabled; }
+
+        const VkPhysicalDeviceDescriptorBufferPropertiesEXT& getDescriptorBufferProperties() const
+        {
+            return m_descriptorBufferProperties;
+        }
+
+        // Wrappers of the VK_EXT_descriptor_buffer functions, which require areDescriptorBuffersEnabled().
+        VkDeviceSize getDescriptorSetLayoutSize(VkDescriptorSetLayout layout);
+        VkDeviceSize getDescriptorSetLayoutBindingOffset(VkDescriptorSetLayout layout, uint32_t binding);
+        void getDescriptor(const VkDescriptorGetInfoEXT& descriptorInfo, size_t dataSize, void* pDescriptor);
+        void bindDescriptorBuffers(
+            VkCommandBuffer commandBuffer,
+            uint32_t bufferCount,
+            const VkDescriptorBufferBindingInfoEXT* pBindingInfos);
+        void setDescriptorBufferOffsets(
+            VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint pipelineBindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t firstSet,
+            uint32_t setCount,
+            const uint32_t* pBufferIndices,
+            const VkDeviceSize* pOffsets);
+
+        bool isTextureCompressionBCSupported() const { return m_textureCompressionBCIsSupported; }
+
+        bool isTextureCompressionAstcLdrSupported() const { return m_textureCompressionAstcLdrIsSupported; }
+
+        // True if images of the format can be created with optimal tiling and used with all of the
+        // required features, e.g. VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT.
+        bool isImageFormatSupported(VkFormat format, VkFormatFeatureFlags requiredFeatures) const;
+
         CommandBufferFactory& getOrCreateUtilCommandBufferFactory();
 
+        // The ImageDownsampler requires shader subgroups and descriptor indexing.
+        bool isImageDownsamplerSupported() const
+        {
+            return m_shaderSubgroupsAreSupported && m_descriptorIndexingIsSupported;
+        }
+
         ImageDownsampler& getOrCreateImageDownsampler();
 
+        // Command buffer factory of the first transfer queue if its family is not the graphics
+        // queue's, e.g. a copy engine that runs alongside rendering, otherwise nullptr.
+        CommandBufferFactory* getOrCreateTransferCommandBufferFactory();
+
+        // Uploads to buffers and images that are used by the graphics queue, see
+        // OneTimeCommandsHelper::copyDataToBuffer. The copies are submitted to the transfer queue
+        // if there is one, otherwise to the graphics queue.
+        UploadManager& getOrCreateUploadManager();
+        // Null until getOrCreateUploadManager is called.
+        UploadManager* getUploadManager() { return m_spUploadManager.get(); }
+
+        // Timeline of the first graphics queue, which the Renderer and one-time commands submit
+        // to. Null if timeline semaphores are not supported.
+        GpuTimeline* getGpuTimeline() { return m_spGpuTimeline.get(); }
+
+        // Destroys Vulkan objects once the GPU has completed the work submitted to the GpuTimeline
+        // so far. Null if there is no timeline.
+        RetirementQueue* getRetirementQueue() { return m_spRetirementQueue.get(); }
+
+        // Destroys the object with the RetirementQueue, or immediately if there is none, in which
+        // case the caller must ensure that the GPU no longer uses it.
+        void retire(std::function<void()>&& destroyFunc);
+
+        // Defragments the memory on the graphics queue while rendering, see Defragmenter. Requires
+        // the GpuTimeline.
+        bool isDefragmenterSupported() const { return m_spGpuTimeline != nullptr; }
+        Defragmenter& getOrCreateDefragmenter();
+        // Null until getOrCreateDefragmenter is called.
+        Defragmenter* getDefragmenter() { return m_spDefragmenter.get(); }
+
         const AppConfig& getAppConfig() const { return m_appConfig; }
 
         void beginRendering(
@@ -244,17 +348,31 @@ namespace vgfx
         bool m_fp16IsSupported = false;
         bool m_shaderSubgroupsAreSupported = false;
         bool m_descriptorIndexingIsSupported = false;
+        bool m_timelineSemaphoresAreSupported = false;
+        bool m_descriptorUpdateTemplatesAreSupported = false;
+        bool m_pushDescriptorsAreSupported = false;
+        bool m_descriptorBuffersAreEnabled = false;
+        VkPhysicalDeviceDescriptorBufferPropertiesEXT m_descriptorBufferProperties = {};
+        bool m_textureCompressionBCIsSupported = false;
+        bool m_textureCompressionAstcLdrIsSupported = false;
 
         VkDebugReportCallbackEXT m_debugReportCallback = VK_NULL_HANDLE;
 
         PFN_vkCmdBeginRenderingKHR m_vkCmdBeginRendering = nullptr;
         PFN_vkCmdEndRenderingKHR m_vkCmdEndRendering = nullptr;
+        PFN_vkCmdPushDescriptorSetKHR m_vkCmdPushDescriptorSet = nullptr;
+        PFN_vkGetDescriptorSetLayoutSizeEXT m_vkGetDescriptorSetLayoutSize = nullptr;
+        PFN_vkGetDescriptorSetLayoutBindingOffsetEXT m_vkGetDescriptorSetLayoutBindingOffset = nullptr;
+        PFN_vkGetDescriptorEXT m_vkGetDescriptor = nullptr;
+        PFN_vkCmdBindDescriptorBuffersEXT m_vkCmdBindDescriptorBuffers = nullptr;
+        PFN_vkCmdSetDescriptorBufferOffsetsEXT m_vkCmdSetDescriptorBufferOffsets = nullptr;
 
         VkDevice m_device = VK_NULL_HANDLE;
 
         MemoryAllocator m_memoryAllocator;
 
         std::unique_ptr<CommandBufferFactory> m_spUtilCommandBufferFactory;
+        std::unique_ptr<CommandBufferFactory> m_spTransferCommandBufferFactory;
         // TODO this should probably be a component of some type of pluggable system.
         struct ImageDownsamplerDeleter
         {
@@ -262,5 +380,29 @@ namespace vgfx
             void operator()(ImageDownsampler*);
         };
         std::unique_ptr<ImageDownsampler, ImageDownsamplerDeleter> m_spImageDownsampler;
+        struct UploadManagerDeleter
+        {
+            UploadManagerDeleter() = default;
+            void operator()(UploadManager*);
+        };
+        std::unique_ptr<UploadManager, UploadManagerDeleter> m_spUploadManager;
+        struct GpuTimelineDeleter
+        {
+            GpuTimelineDeleter() = default;
+            void operator()(GpuTimeline*);
+        };
+        std::unique_ptr<GpuTimeline, GpuTimelineDeleter> m_spGpuTimeline;
+        struct RetirementQueueDeleter
+        {
+            RetirementQueueDeleter() = default;
+            void operator()(RetirementQueue*);
+        };
+        std::unique_ptr<RetirementQueue, RetirementQueueDeleter> m_spRetirementQueue;
+        struct DefragmenterDeleter
+        {
+            DefragmenterDeleter() = default;
+            void operator()(Defragmenter*);
+        };
+        std::unique_ptr<Defragmenter, DefragmenterDeleter> m_spDefragmenter;
     };
 }
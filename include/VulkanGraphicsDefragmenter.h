@@ -0,0 +1,106 @@
+#pragma once
+
+#include "VulkanGraphicsCommandBufferFactory.h"
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsGpuTimeline.h"
+#include "VulkanGraphicsMemoryAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+#include <vk_mem_alloc.h>
+
+namespace vgfx
+{
+    // Compacts the MemoryAllocator's blocks with VMA's defragmentation, a few moves at a time so
+    // that it can run alongside rendering. Each pass copies the buffers and images that VMA moves
+    // on the GPU timeline's queue and hands their owners the new handles right away, since
+    // anything submitted after the copies sees their data. The pass ends, freeing the old memory
+    // and handles, once the timeline has passed the copies and the frames that used the old
+    // handles. Only resources made movable with MemoryAllocator::setMovable are moved, descriptor
+    // sets must be written with the owners' current handles, e.g. the Renderer's are rewritten
+    // every frame. Requires the Context's GpuTimeline.
+    class Defragmenter
+    {
+    public:
+        struct Config
+        {
+            uint32_t maxMovesPerPass = 16u;
+            VkDeviceSize maxBytesPerPass = 32u * 1024u * 1024u;
+        };
+
+        Defragmenter(
+            Context& context,
+            CommandBufferFactory& commandBufferFactory,
+            const Config& config = Config());
+
+        // Waits for the current pass and ends the defragmentation.
+        ~Defragmenter();
+
+        // Defragments the static pools and then VMA's default blocks. Does nothing if it is
+        // already running.
+        void start();
+
+        bool isRunning() const { return !m_pools.empty(); }
+
+        // Ends the current pass if the GPU has finished with it and begins the next one. Call it
+        // once per frame, before any commands are recorded, e.g. the Renderer does.
+        void update();
+
+        // Runs the defragmentation to completion, waiting for each pass.
+        void finish();
+
+        struct Stats
+        {
+            uint32_t passCount = 0u;
+            // Moves of allocations that weren't movable.
+            uint32_t ignoredMoveCount = 0u;
+            // From VMA, counted when the defragmentation of a pool ends.
+            uint32_t movedAllocationCount = 0u;
+            VkDeviceSize movedBytes = 0u;
+            uint32_t freedBlockCount = 0u;
+            VkDeviceSize freedBytes = 0u;
+        };
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        struct Move
+        {
+            VmaAllocation allocation = VK_NULL_HANDLE;
+            VkBuffer oldBuffer = VK_NULL_HANDLE;
+            VkBuffer newBuffer = VK_NULL_HANDLE;
+            VkImage oldImage = VK_NULL_HANDLE;
+            VkImage newImage = VK_NULL_HANDLE;
+            MemoryAllocator::BufferMovedFunc bufferMovedFunc;
+            MemoryAllocator::ImageMovedFunc imageMovedFunc;
+        };
+
+        void beginPass();
+        void endPass(bool wait);
+        void endDefragmentation();
+        // Creates the moved resource and records its copy. Returns false if the allocation isn't
+        // movable or the resource couldn't be created.
+        bool recordMove(const VmaDefragmentationMove& vmaMove, Move* pMove);
+
+        Context& m_context;
+        CommandBufferFactory& m_commandBufferFactory;
+        GpuTimeline& m_gpuTimeline;
+        MemoryAllocator& m_memoryAllocator;
+        Config m_config;
+
+        // Pools left to defragment, VK_NULL_HANDLE for the default blocks.
+        std::deque<VmaPool> m_pools;
+        VmaDefragmentationContext m_defragmentationContext = VK_NULL_HANDLE;
+
+        VmaDefragmentationPassMoveInfo m_passInfo = {};
+        std::vector<Move> m_moves;
+        VkCommandBuffer m_commandBuffer = VK_NULL_HANDLE;
+        bool m_isPassInProgress = false;
+        // Timeline value of the pass's copies.
+        GpuTimeline::Value m_passValue = 0u;
+
+        Stats m_stats;
+    };
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsDescriptors.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Allocates descriptor sets that are released all at once by reset(), e.g. once per frame.
+    // When its pool runs out another pool, as large as everything allocated since the reset, is
+    // chained after it. Each reset counts the high-water marks of the sets and descriptors of each
+    // type since the previous one, and if more than one pool was needed they are replaced by a
+    // single pool that fits the high-water marks, so a frame like the previous one fits in one pool.
+    class DescriptorAllocator
+    {
+    public:
+        struct Config
+        {
+            // Size of the first pool.
+            uint32_t initMaxSets = 64u;
+            std::vector<VkDescriptorPoolSize> initPoolSizes;
+            // Multiplies the high-water marks when the pools are replaced, for some headroom.
+            float headroomFactor = 1.25f;
+            VkDescriptorPoolCreateFlags flags = 0u;
+        };
+
+        DescriptorAllocator(Context& context, const Config& config);
+
+        // Chains another pool if the sets don't fit in the current one.
+        void allocateDescriptorSets(
+            const DescriptorSetLayout& layout,
+            uint32_t count,
+            VkDescriptorSet* pDescriptorSetHandles);
+
+        // Allocates a set of each of the layouts with a single vkAllocateDescriptorSets.
+        void allocateDescriptorSets(
+            const DescriptorSetLayout* const* ppLayouts,
+            uint32_t count,
+            VkDescriptorSet* pDescriptorSetHandles);
+
+        // Releases all of the sets, which must no longer be in use by the GPU, and resizes the
+        // pools if more than one was needed since the last reset.
+        void reset();
+
+        struct Stats
+        {
+            uint32_t poolCount = 0u;
+            // Pools that were chained because the ones before them ran out.
+            uint32_t chainedPoolCount = 0u;
+            // Times that the pools were replaced by one that fits the high-water marks.
+            uint32_t resizeCount = 0u;
+            // Since the last reset.
+            uint32_t setCount = 0u;
+            uint32_t descriptorCount = 0u;
+            // Largest counts between two resets.
+            uint32_t peakSetCount = 0u;
+            uint32_t peakDescriptorCount = 0u;
+            // Sets that the pools can hold.
+            uint32_t maxSets = 0u;
+        };
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        struct Capacity
+        {
+            uint32_t maxSets = 0u;
+            std::map<VkDescriptorType, uint32_t> descriptorCounts;
+        };
+
+        // Allocates the sets of m_layoutHandles, which need m_requestedDescriptorCounts.
+        void allocate(uint32_t count, VkDescriptorSet* pDescriptorSetHandles);
+        void createPool(const Capacity& capacity);
+
+        Context& m_context;
+        Config m_config;
+
+        // Allocations are made from the last one.
+        std::vector<std::unique_ptr<DescriptorPool>> m_pools;
+        // Sets and descriptors allocated since the last reset.
+        Capacity m_used;
+
+        // Of the allocation in progress, kept so that allocations don't reallocate them.
+        std::vector<VkDescriptorSetLayout> m_layoutHandles;
+        std::map<VkDescriptorType, uint32_t> m_requestedDescriptorCounts;
+
+        Stats m_stats;
+    };
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsDescriptorAllocator.h"
+#include "VulkanGraphicsDescriptors.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Gathers the descriptor sets that are requested and written while the scene is traversed,
+    // then allocates them with one vkAllocateDescriptorSets and writes them with one
+    // vkUpdateDescriptorSets when it is flushed, before the draws that bind them are recorded.
+    // Its arrays keep their capacity between frames, so requests and writes don't allocate once
+    // they have grown to fit a frame.
+    class DescriptorBatcher
+    {
+    public:
+        DescriptorBatcher(Context& context);
+
+        // Returns the index of the first of the sets, the indices of the sets are consecutive.
+        // Their handles are valid once the batcher has been flushed.
+        uint32_t requestDescriptorSets(const DescriptorSetLayout& layout, uint32_t count);
+
+        // Writes one descriptor of the binding of a requested set when the batcher is flushed.
+        void writeImage(
+            uint32_t setIndex,
+            uint32_t bindingIndex,
+            VkDescriptorType descriptorType,
+            const VkDescriptorImageInfo& imageInfo);
+        void writeBuffer(
+            uint32_t setIndex,
+            uint32_t bindingIndex,
+            VkDescriptorType descriptorType,
+            const VkDescriptorBufferInfo& bufferInfo);
+
+        // Allocates all of the requested sets from the allocator and writes them.
+        void flush(DescriptorAllocator& descriptorAllocator);
+
+        const VkDescriptorSet* getDescriptorSets(uint32_t firstSetIndex) const
+        {
+            return &m_descriptorSets[firstSetIndex];
+        }
+
+        // Forgets the sets and writes, e.g. at the start of the frame.
+        void reset();
+
+    private:
+        // Info indices are into the image or buffer infos depending on the descriptor type.
+        struct Write
+        {
+            uint32_t setIndex = 0u;
+            uint32_t bindingIndex = 0u;
+            VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+            uint32_t infoIndex = 0u;
+        };
+
+        Context& m_context;
+
+        std::vector<const DescriptorSetLayout*> m_layouts;
+        std::vector<VkDescriptorSet> m_descriptorSets;
+
+        std::vector<Write> m_writes;
+        std::vector<VkDescriptorImageInfo> m_imageInfos;
+        std::vector<VkDescriptorBufferInfo> m_bufferInfos;
+        std::vector<VkWriteDescriptorSet> m_descriptorWrites;
+    };
+}
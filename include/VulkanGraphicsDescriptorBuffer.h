@@ -0,0 +1,79 @@
+#pragma once
+
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsDescriptors.h"
+#include "VulkanGraphicsMemoryAllocator.h"
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Persistently mapped buffer that the sets of descriptor buffer layouts are written to
+    // directly, see DescriptorSetUpdater::writeDescriptorBuffer. Sets are bump allocated and all
+    // released at once by reset(), e.g. once per frame like a DescriptorAllocator. Requires
+    // Context::areDescriptorBuffersEnabled().
+    class DescriptorBuffer
+    {
+    public:
+        struct Config
+        {
+            VkDeviceSize sizeBytes = 1024u * 1024u;
+        };
+
+        DescriptorBuffer(Context& context, const Config& config);
+        ~DescriptorBuffer();
+
+        // Returns the offsets of the sets from the start of the buffer, throws if it is full.
+        void allocateDescriptorSets(
+            const DescriptorSetLayout& layout,
+            uint32_t count,
+            VkDeviceSize* pOffsets);
+
+        void* getMappedData(VkDeviceSize offset)
+        {
+            return static_cast<uint8_t*>(m_buffer.pMappedData) + offset;
+        }
+
+        // Flushes the sets allocated since the last reset, in case the memory isn't coherent. Call
+        // it once they are written, before the command buffers that use them are submitted.
+        void flush();
+
+        // Releases all of the sets, which must no longer be in use by the GPU.
+        void reset();
+
+        // Binds the buffer as descriptor buffer index 0 of the command buffer.
+        void bind(VkCommandBuffer commandBuffer);
+
+        // Points consecutive sets of the pipeline layout, starting at firstSet, at sets in the buffer.
+        void setDescriptorSetOffsets(
+            VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint pipelineBindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t firstSet,
+            uint32_t setCount,
+            const VkDeviceSize* pOffsets);
+
+        struct Stats
+        {
+            // Since the last reset.
+            VkDeviceSize usedBytes = 0u;
+            uint32_t setCount = 0u;
+            // Largest counts between two resets.
+            VkDeviceSize peakUsedBytes = 0u;
+            uint32_t peakSetCount = 0u;
+        };
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        Context& m_context;
+        Config m_config;
+
+        MemoryAllocator::Buffer m_buffer;
+        VkDeviceAddress m_deviceAddress = 0u;
+        VkBufferUsageFlags m_usage = 0u;
+
+        Stats m_stats;
+    };
+}
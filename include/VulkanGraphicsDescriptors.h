@@ -10,6 +10,14 @@
 
 namespace vgfx
 {
+    // Info of one descriptor in the data of a DescriptorSetLayout's update template.
+    union DescriptorInfo
+    {
+        VkDescriptorImageInfo image;
+        VkDescriptorBufferInfo buffer;
+        VkBufferView texelBufferView;
+    };
+
     class DescriptorSetLayout
     {
     public:
@@ -52,9 +60,15 @@ namespace vgfx
         using BindingIndex = uint32_t; // VkDescriptorSetLayoutBinding::binding
         using DescriptorBindings = std::map<BindingIndex, DescriptorBinding>;
 
+        // Sets of a layout created with VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR
+        // aren't allocated, they are pushed to the command buffer with
+        // DescriptorSetUpdater::pushDescriptorSet. Sets of a layout created with
+        // VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT are allocated from a
+        // DescriptorBuffer and written with DescriptorSetUpdater::writeDescriptorBuffer.
         DescriptorSetLayout(
             Context& context,
-            const DescriptorBindings& descriptorBindings);
+            const DescriptorBindings& descriptorBindings,
+            VkDescriptorSetLayoutCreateFlags flags = 0u);
 
         ~DescriptorSetLayout();
 
@@ -64,10 +78,56 @@ namespace vgfx
         {
             return m_descriptorBindings;
         }
+
+        bool isPushDescriptor() const
+        {
+            return (m_flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR) != 0u;
+        }
+
+        bool isDescriptorBuffer() const
+        {
+            return (m_flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT) != 0u;
+        }
+
+        // Bytes that a set of a descriptor buffer layout occupies in the DescriptorBuffer, and
+        // where each binding's descriptors start within them.
+        VkDeviceSize getDescriptorBufferSize() const { return m_descriptorBufferSizeBytes; }
+        VkDeviceSize getDescriptorBufferBindingOffset(BindingIndex bindingIndex) const
+        {
+            return m_descriptorBufferBindingOffsets.at(bindingIndex);
+        }
+
+        // Sets of the layout can be written all at once from an array of DescriptorInfo, one per
+        // descriptor of each binding in the order of the binding indices, instead of with
+        // VkWriteDescriptorSet. Requires descriptor update templates and bindings of image, buffer
+        // or texel buffer descriptors, and not a push descriptor or descriptor buffer layout.
+        bool hasUpdateTemplate() const { return m_updateTemplate != VK_NULL_HANDLE; }
+        VkDescriptorUpdateTemplate getUpdateTemplate() const { return m_updateTemplate; }
+
+        // Index of the binding's first DescriptorInfo in the update template's data.
+        uint32_t getDescriptorInfoIndex(BindingIndex bindingIndex) const
+        {
+            return m_descriptorInfoIndices.at(bindingIndex);
+        }
+        uint32_t getDescriptorInfoCount() const { return m_descriptorInfoCount; }
+
+        // Writes all of the set's descriptors with the update template.
+        void updateDescriptorSet(VkDescriptorSet descriptorSet, const DescriptorInfo* pDescriptorInfos) const;
+
     private:
+        void createUpdateTemplate();
+
         Context& m_context;
         DescriptorBindings m_descriptorBindings;
+        VkDescriptorSetLayoutCreateFlags m_flags = 0u;
         VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+
+        VkDescriptorUpdateTemplate m_updateTemplate = VK_NULL_HANDLE;
+        std::map<BindingIndex, uint32_t> m_descriptorInfoIndices;
+        uint32_t m_descriptorInfoCount = 0u;
+
+        VkDeviceSize m_descriptorBufferSizeBytes = 0u;
+        std::map<BindingIndex, VkDeviceSize> m_descriptorBufferBindingOffsets;
     };
 
     using DescriptorSetLayouts = std::vector<std::unique_ptr<DescriptorSetLayout>>;
@@ -103,7 +163,24 @@ namespace vgfx
         }
 
         void bindDescriptor(uint32_t bindingIndex, DescriptorUpdater& updater);
+        // Forgets the bound descriptors but keeps their capacity, so that an updater can be reused.
+        void clear() { m_descriptorWrites.clear(); }
         void updateDescriptorSet(Context& context, VkDescriptorSet descriptorSet);
+        // Pushes the bound descriptors as the pipeline layout's set, which must have a push
+        // descriptor layout, instead of writing them to an allocated set.
+        void pushDescriptorSet(
+            Context& context,
+            VkCommandBuffer commandBuffer,
+            VkPipelineBindPoint pipelineBindPoint,
+            VkPipelineLayout pipelineLayout,
+            uint32_t setIndex);
+        // Writes the bound descriptors to a set of a descriptor buffer layout, pSetData points to
+        // the set's bytes in the DescriptorBuffer. Only image, sampler and uniform or storage
+        // buffer descriptors can be written this way.
+        void writeDescriptorBuffer(
+            Context& context,
+            const DescriptorSetLayout& layout,
+            void* pSetData);
 
     private:
         std::vector<VkWriteDescriptorSet> m_descriptorWrites;
@@ -125,6 +202,19 @@ namespace vgfx
             uint32_t count,
             VkDescriptorSet* pDescriptorSetHandles);
 
+        // Returns VK_ERROR_OUT_OF_POOL_MEMORY or VK_ERROR_FRAGMENTED_POOL instead of throwing
+        // if the pool doesn't have room for the sets.
+        VkResult tryAllocateDescriptorSets(
+            const DescriptorSetLayout& layout,
+            uint32_t count,
+            VkDescriptorSet* pDescriptorSetHandles);
+
+        // A set of each layout, which can differ.
+        VkResult tryAllocateDescriptorSets(
+            const VkDescriptorSetLayout* pLayoutHandles,
+            uint32_t count,
+            VkDescriptorSet* pDescriptorSetHandles);
+
         void freeDescriptorSets(
             std::vector<VkDescriptorSet>& descriptorSetHandles);
 
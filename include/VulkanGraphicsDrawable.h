@@ -19,27 +19,79 @@
 
 namespace vgfx
 {
+    class TextureResidencyManager;
+
     enum class ImageType
     {
         Diffuse,
     };
     using ImageSampler = std::pair<const ImageView*, const Sampler*>;
     using ImageSamplers = std::map<ImageType, ImageSampler>;
+
+    // Where a material's texture is within its image, if it was packed into a texture array or an
+    // atlas (see TexturePacker).
+    struct TextureRegion
+    {
+        uint32_t layer = 0u;
+        // Maps the texture coordinates to the image's: uv * uvScale + uvOffset.
+        glm::vec2 uvScale = glm::vec2(1.0f);
+        glm::vec2 uvOffset = glm::vec2(0.0f);
+
+        bool operator==(const TextureRegion& rhs) const
+        {
+            return layer == rhs.layer && uvScale == rhs.uvScale && uvOffset == rhs.uvOffset;
+        }
+        bool operator!=(const TextureRegion& rhs) const { return !(*this == rhs); }
+    };
+
+    // Range of the drawable's index buffer that is drawn with a single material. The vertex
+    // offset is added to each index, so submeshes can use indices local to their own vertices.
+    struct SubMesh
+    {
+        uint32_t firstIndex = 0u;
+        uint32_t indexCount = 0u;
+        int32_t vertexOffset = 0;
+        uint32_t materialIndex = 0u;
+        // Relative to the drawable's world transform, e.g. a glTF node transform.
+        glm::mat4 transform = glm::identity<glm::mat4>();
+    };
+    using SubMeshes = std::vector<SubMesh>;
+
     // Geometry of an single drawable object (vertices and indices).
     class Drawable
     {
     public:
+        // Creates a drawable with a single submesh that covers the entire index buffer.
         Drawable(
             VertexBuffer& vertexBuffer,
             IndexBuffer& indexBuffer,
             ImageSamplers& imageSamplers)
             : m_vertexBuffer(vertexBuffer)
             , m_indexBuffer(indexBuffer)
-            , m_imageSamplers(imageSamplers)
+            , m_subMeshes({ SubMesh{ 0u, indexBuffer.getCount(), 0, 0u } })
+            , m_materials({ imageSamplers })
         {
         }
 
-        void draw(DrawContext& recorder);
+        // Creates a drawable whose submeshes share the vertex and index buffer, each submesh
+        // references one of the materials by index.
+        Drawable(
+            VertexBuffer& vertexBuffer,
+            IndexBuffer& indexBuffer,
+            const SubMeshes& subMeshes,
+            const std::vector<ImageSamplers>& materials)
+            : m_vertexBuffer(vertexBuffer)
+            , m_indexBuffer(indexBuffer)
+            , m_subMeshes(subMeshes)
+            , m_materials(materials)
+        {
+        }
+
+        // Requests the drawable's descriptor sets while the scene is traversed and adds it to the
+        // DrawContext's draw queue.
+        void draw(DrawContext& drawContext);
+        // Records the drawable's draws once the DrawContext's DescriptorBatcher has been flushed.
+        void recordDraw(DrawContext& drawContext);
 
         const VertexBuffer& getVertexBuffer() const { return m_vertexBuffer; }
         VertexBuffer& getVertexBuffer() { return m_vertexBuffer; }
@@ -47,37 +99,86 @@ namespace vgfx
         const IndexBuffer& getIndexBuffer() const { return m_indexBuffer; }
         IndexBuffer& getIndexBuffer() { return m_indexBuffer; }
 
+        const SubMeshes& getSubMeshes() const { return m_subMeshes; }
+
         void setMeshEffect(MeshEffect* pMeshEffect) { m_pMeshEffect = pMeshEffect; }
         const MeshEffect* getMeshEffect() const { return m_pMeshEffect; }
 
         const glm::mat4& getWorldTransform() const { return m_worldTransform; }
         void setWorldTransform(const glm::mat4& worldTransform) { m_worldTransform = worldTransform; }
 
-        void setImageSampler(ImageType type, const ImageSampler& imageSampler)
+        // Sphere that bounds the submeshes (xyz is the center, w the radius) relative to the world
+        // transform. A radius of zero means the bounds are unknown.
+        const glm::vec4& getBoundingSphere() const { return m_boundingSphere; }
+        void setBoundingSphere(const glm::vec4& boundingSphere) { m_boundingSphere = boundingSphere; }
+
+        // If set then draw() reports the drawable's size on screen to the manager, which streams
+        // the drawable's textures to match.
+        void setTextureResidencyManager(TextureResidencyManager* pManager) { m_pTextureResidencyManager = pManager; }
+
+        size_t getMaterialCount() const { return m_materials.size(); }
+
+        void setImageSampler(ImageType type, const ImageSampler& imageSampler, size_t materialIndex = 0u)
         {
-            m_imageSamplers[type] = imageSampler;
+            m_materials.at(materialIndex)[type] = imageSampler;
         }
 
-        ImageSampler& getImageSampler(ImageType imageType)
+        ImageSampler& getImageSampler(ImageType imageType, size_t materialIndex = 0u)
         {
-            const auto& findIt = m_imageSamplers.find(imageType);
-            if (findIt == m_imageSamplers.end()) {
-                return (m_imageSamplers[imageType] = std::make_pair<const ImageView*, const Sampler*>(nullptr, nullptr));
+            ImageSamplers& imageSamplers = m_materials.at(materialIndex);
+            const auto& findIt = imageSamplers.find(imageType);
+            if (findIt == imageSamplers.end()) {
+                return (imageSamplers[imageType] = std::make_pair<const ImageView*, const Sampler*>(nullptr, nullptr));
             }
             return findIt->second;
         }
 
+        void setTextureRegion(ImageType imageType, const TextureRegion& textureRegion, size_t materialIndex = 0u)
+        {
+            if (m_textureRegions.size() < m_materials.size()) {
+                m_textureRegions.resize(m_materials.size());
+            }
+            m_textureRegions.at(materialIndex)[imageType] = textureRegion;
+        }
+
+        // The whole of layer 0 unless the texture was packed.
+        TextureRegion getTextureRegion(ImageType imageType, size_t materialIndex = 0u) const
+        {
+            if (materialIndex < m_textureRegions.size()) {
+                const auto& findIt = m_textureRegions[materialIndex].find(imageType);
+                if (findIt != m_textureRegions[materialIndex].end()) {
+                    return findIt->second;
+                }
+            }
+            return TextureRegion();
+        }
+
     protected:
-        void configureDescriptorSets(DrawContext& drawContext, std::vector<VkDescriptorSet>* pDescriptorSets);
+        void configureDescriptorSets(DrawContext& drawContext);
 
     private:
 
         VertexBuffer& m_vertexBuffer;
         IndexBuffer& m_indexBuffer;
+        SubMeshes m_subMeshes;
         const MeshEffect* m_pMeshEffect = nullptr;
         glm::mat4 m_worldTransform = glm::identity<glm::mat4>();
-        std::vector<VkDescriptorSet> m_descriptorSets;
-        ImageSamplers m_imageSamplers;
+        glm::vec4 m_boundingSphere = glm::vec4(0.0f);
+        TextureResidencyManager* m_pTextureResidencyManager = nullptr;
+        // First set is shared by all submeshes, followed by one set per unique material image
+        // sampler, i.e. materials whose textures were packed into the same image share a set.
+        // The sets are requested from the DescriptorBatcher starting at m_firstBatchedSetIndex,
+        // only the first if the material sets are pushed, and none if they are in a
+        // DescriptorBuffer, in which case their offsets are in m_descriptorBufferOffsets.
+        uint32_t m_firstBatchedSetIndex = 0u;
+        std::vector<VkDeviceSize> m_descriptorBufferOffsets;
+        std::vector<uint32_t> m_materialDescriptorSetIndices;
+        // Image sampler of each material set, the first is set index 1.
+        std::vector<const ImageSampler*> m_materialSetImageSamplers;
+        // Pushes and descriptor buffer writes reuse it, so that its writes don't allocate every draw.
+        DescriptorSetUpdater m_descriptorSetUpdater;
+        std::vector<ImageSamplers> m_materials;
+        std::vector<std::map<ImageType, TextureRegion>> m_textureRegions;
     };
 }
 
@@ -8,7 +8,11 @@
 
 #include <vulkan/vulkan.h>
 
+#include <glm/glm.hpp>
+#include <glm/ext/matrix_transform.hpp>
+
 #include <cassert>
+#include <cstdint>
 #include <stdexcept>
 #include <vector>
 
@@ -16,6 +20,17 @@ namespace vgfx
 {
     class Pipeline; // Forward declaration
 
+    // Push constants of the MeshEffects, matches the push_constant block of their vertex shaders.
+    // The view matrix is in the camera's uniform buffer.
+    struct MeshEffectPushConstants
+    {
+        glm::mat4 world = glm::identity<glm::mat4>();
+        // Texture region of the submesh's material (see TextureRegion), xy is the scale and zw the
+        // offset of its texture coordinates.
+        glm::vec4 uvScaleOffset = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+        uint32_t textureLayer = 0u;
+    };
+
     using MeshEffectId = std::pair<const Program*, const Program*>;
     class Effect
     {
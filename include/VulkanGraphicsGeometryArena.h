@@ -0,0 +1,156 @@
+#pragma once
+
+#include "VulkanGraphicsContext.h"
+
+#include "VulkanGraphicsCommandBufferFactory.h"
+#include "VulkanGraphicsMemoryAllocator.h"
+#include "VulkanGraphicsVertexBuffer.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    class GeometryArena;
+    struct GeometryArenaBlock;
+    struct GeometryArenaPool;
+
+    // Range of elements (vertices or indices) suballocated from one of a GeometryArena's buffers.
+    // The range is owned by the arena so that it can be moved when the arena is defragmented, so
+    // the buffer and first element should be queried each time they are used.
+    class GeometryRange
+    {
+    public:
+        VkBuffer getBuffer() const { return m_buffer; }
+        uint32_t getFirstElement() const { return m_firstElement; }
+        uint32_t getElementCount() const { return m_elementCount; }
+
+    private:
+        friend class GeometryArena;
+
+        GeometryArenaPool* m_pPool = nullptr;
+        GeometryArenaBlock* m_pBlock = nullptr;
+        VkBuffer m_buffer = VK_NULL_HANDLE;
+        uint32_t m_firstElement = 0u;
+        uint32_t m_elementCount = 0u;
+    };
+
+    // Suballocates the vertices of all meshes that have the same vertex layout (and the indices of
+    // all meshes with the same index type) out of a few large device local buffers, so that many
+    // drawables can be drawn with a single vertex and index buffer bind. Each pool of buffers uses a
+    // best fit free list allocator in units of elements, so vertex offsets are always a whole number
+    // of vertices.
+    class GeometryArena
+    {
+    public:
+        struct Config
+        {
+            // Size of each buffer allocated for a pool, a single range that is larger than this
+            // gets its own buffer of the required size.
+            uint32_t verticesPerBlock = 1024u * 1024u;
+            uint32_t indicesPerBlock = 4u * 1024u * 1024u;
+            // update() defragments a fragmented pool once this fraction of its capacity is free.
+            float defragmentFreeFraction = 0.25f;
+        };
+
+        GeometryArena(
+            Context& context,
+            CommandBufferFactory& commandBufferFactory,
+            const Config& config = Config());
+
+        ~GeometryArena();
+
+        // Allocates a range from the pool for the vertex layout and copies the vertices into it,
+        // if there are any.
+        GeometryRange& allocateVertices(
+            const VertexBuffer::Config& vertexConfig,
+            const void* pVertexData,
+            uint32_t vertexCount);
+
+        // Allocates a range from the pool for the index type and copies the indices into it.
+        GeometryRange& allocateIndices(
+            VkIndexType indexType,
+            const void* pIndexData,
+            uint32_t indexCount);
+
+        // Copies elements into the range, e.g. one that was allocated without data, starting at
+        // its firstElement'th element.
+        void write(
+            GeometryRange& range,
+            const void* pData,
+            uint32_t firstElement,
+            uint32_t elementCount);
+
+        // The range's elements are reused once the frames in flight that could read them have
+        // completed.
+        void free(GeometryRange& range);
+
+        // Moves the ranges of fragmented pools into tightly packed buffers and retires the old
+        // buffers, so frames in flight can still read them. Must not be called while a command
+        // buffer that binds the arena's buffers is being recorded. Returns the number of bytes
+        // that were copied.
+        VkDeviceSize defragment();
+
+        // Defragments the fragmented pools with at least Config::defragmentFreeFraction of their
+        // capacity free. Call once per frame before rendering, e.g. ModelLibrary::update does.
+        void update();
+
+        struct Stats
+        {
+            uint32_t poolCount = 0u;
+            uint32_t blockCount = 0u;
+            uint32_t rangeCount = 0u;
+            uint32_t freeRangeCount = 0u;
+            VkDeviceSize capacityBytes = 0u;
+            VkDeviceSize usedBytes = 0u;
+            uint32_t defragmentedPoolCount = 0u;
+            VkDeviceSize movedBytes = 0u;
+        };
+        Stats getStats() const;
+
+    private:
+        // Pools are keyed by the element kind and layout, see the allocate functions.
+        using PoolKey = std::vector<uint32_t>;
+
+        GeometryRange& allocate(
+            const PoolKey& poolKey,
+            uint32_t elementSizeBytes,
+            uint32_t elementsPerBlock,
+            VkBufferUsageFlags usage,
+            const void* pData,
+            uint32_t elementCount);
+
+        GeometryArenaBlock& createBlock(GeometryArenaPool& pool, uint32_t capacity);
+        void destroyBlock(GeometryArenaBlock& block);
+
+        VkDeviceSize defragmentPool(GeometryArenaPool& pool);
+
+        // Returns a freed range to its block's free ranges, see free().
+        void releaseRange(uint64_t pendingFreeId);
+
+        Context& m_context;
+        CommandBufferFactory& m_commandBufferFactory;
+        Config m_config;
+
+        std::map<PoolKey, std::unique_ptr<GeometryArenaPool>> m_pools;
+
+        // Freed ranges that frames in flight may still read, keyed by the id their retirement
+        // releases them with.
+        struct PendingFree
+        {
+            GeometryArenaPool* pPool = nullptr;
+            GeometryArenaBlock* pBlock = nullptr;
+            uint32_t firstElement = 0u;
+            uint32_t elementCount = 0u;
+        };
+        std::map<uint64_t, PendingFree> m_pendingFrees;
+        uint64_t m_nextPendingFreeId = 0u;
+
+        uint32_t m_defragmentedPoolCount = 0u;
+        VkDeviceSize m_movedBytes = 0u;
+    };
+}
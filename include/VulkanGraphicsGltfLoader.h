@@ -0,0 +1,110 @@
+#pragma once
+
+#include "VulkanGraphicsVertexBuffer.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Loader for glTF 2.0 (.gltf with external or data URI buffers, and binary .glb) files. The
+    // loader only parses the JSON and reads the buffers into memory, the accessors reference the
+    // buffer data directly so that interleaved vertex data can be uploaded without repacking.
+    namespace GltfLoader
+    {
+        // Strided view of an accessor's data.
+        struct AccessorView
+        {
+            const uint8_t* pData = nullptr;
+            // End of the buffer view that contains the accessor.
+            const uint8_t* pViewEnd = nullptr;
+            uint32_t count = 0u;
+            uint32_t stride = 0u;
+            uint32_t componentType = 0u; // glTF/GL component type, e.g. 5126 (FLOAT)
+            uint32_t componentCount = 0u;
+            bool normalized = false;
+
+            bool isValid() const { return pData != nullptr; }
+            uint32_t getElementSize() const;
+            VkFormat getVertexFormat() const;
+        };
+
+        struct Primitive
+        {
+            // Attributes in the order of the engine's vertex shader inputs.
+            AccessorView positions;
+            AccessorView colors;
+            AccessorView texCoords;
+            AccessorView normals;
+            // Invalid if the primitive is not indexed.
+            AccessorView indices;
+            int materialIndex = -1;
+        };
+
+        struct Mesh
+        {
+            std::string name;
+            std::vector<Primitive> primitives;
+        };
+
+        // A node that references a mesh, with the node's transform concatenated with its parents.
+        struct MeshInstance
+        {
+            uint32_t meshIndex = 0u;
+            glm::mat4 transform = glm::mat4(1.0f);
+        };
+
+        struct Image
+        {
+            // Either a path relative to the glTF file, or the encoded image is embedded in a buffer.
+            std::string uri;
+            const uint8_t* pEncodedData = nullptr;
+            size_t encodedSizeBytes = 0u;
+        };
+
+        struct Material
+        {
+            std::string name;
+            int baseColorImageIndex = -1;
+        };
+
+        struct Model
+        {
+            std::vector<std::vector<uint8_t>> buffers;
+            std::vector<Mesh> meshes;
+            std::vector<MeshInstance> meshInstances;
+            std::vector<Image> images;
+            std::vector<Material> materials;
+        };
+
+        bool IsGltfFile(const std::string& filePath);
+
+        // Only triangle list primitives are loaded, other primitive modes are skipped with a warning.
+        bool LoadModel(
+            const std::string& filePath,
+            Model* pModel,
+            std::string* pWarn,
+            std::string* pErr);
+
+        // Returns true if the primitive's attributes are interleaved in a single buffer view in the
+        // order the vertex shader expects, in which case the vertex data can be uploaded as is using
+        // the returned config.
+        bool GetInterleavedVertexLayout(
+            const Primitive& primitive,
+            VertexBuffer::Config* pConfig,
+            const uint8_t** ppVertexData,
+            size_t* pVertexDataSizeBytes);
+
+        // Converts the primitive's vertices to VertexXyzRgbUvN, missing colors are white and missing
+        // texture coordinates and normals are zero.
+        void AppendVerticesXyzRgbUvN(const Primitive& primitive, std::vector<uint8_t>* pVerticesOut);
+
+        // Appends the primitive's indices as 32 bit indices, or generates them if not indexed.
+        // Throws if an index is out of range of the primitive's vertices.
+        void AppendIndices(const Primitive& primitive, std::vector<uint32_t>* pIndicesOut);
+    }
+}
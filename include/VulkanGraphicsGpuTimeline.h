@@ -0,0 +1,55 @@
+#pragma once
+
+#include "VulkanGraphicsCommandQueue.h"
+#include "VulkanGraphicsContext.h"
+
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Tracks the GPU's progress through the submissions to a queue with a Vulkan 1.2 timeline
+    // semaphore. Each submission made through submit() signals the next value, so a value
+    // completes when its submission and everything submitted to the queue before it has. The CPU
+    // can poll or wait for a value instead of waiting for the queue to go idle. A timeline is
+    // tied to one queue because submissions to other queues could signal their values out of
+    // order.
+    class GpuTimeline
+    {
+    public:
+        GpuTimeline(Context& context, const CommandQueue& commandQueue);
+        ~GpuTimeline();
+
+        using Value = uint64_t;
+
+        // Submits to the queue, with the timeline semaphore added to the submit info's signal
+        // semaphores. Returns the value that it signals. The submit info must not chain its own
+        // VkTimelineSemaphoreSubmitInfo.
+        Value submit(const VkSubmitInfo& submitInfo, VkFence fence = VK_NULL_HANDLE);
+
+        // Value of the last submission, zero if there is none.
+        Value getLastSubmittedValue() const { return m_lastSubmittedValue; }
+
+        // Largest value that the GPU has signaled.
+        Value getCompletedValue();
+
+        bool isComplete(Value value);
+
+        // Returns false if the timeout, in nanoseconds, expired first.
+        bool wait(Value value, uint64_t timeout = UINT64_MAX);
+
+        const CommandQueue& getCommandQueue() const { return m_commandQueue; }
+
+        // Other queues can wait for a value with a VkTimelineSemaphoreSubmitInfo.
+        VkSemaphore getHandle() { return m_semaphore; }
+
+    private:
+        Context& m_context;
+        CommandQueue m_commandQueue;
+        VkSemaphore m_semaphore = VK_NULL_HANDLE;
+        Value m_lastSubmittedValue = 0u;
+        // Cached so that completed values don't query the device.
+        Value m_completedValue = 0u;
+    };
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // VkAllocationCallbacks that count the host memory that the driver and VMA allocate, by
+    // allocation scope and by the type of the object being created, with the peak of each. Vulkan
+    // doesn't pass the object type to the callbacks, so allocations are attributed to the type of
+    // the innermost ObjectTypeScope on the calling thread, e.g. the engine's pipelines, descriptor
+    // pools and command pools open one around their creation. Small allocations are served from
+    // free lists of fixed size slots. Install it with Context::AppConfig::pHostAllocator, it must
+    // outlive the Context.
+    class HostAllocator
+    {
+    public:
+        HostAllocator();
+        ~HostAllocator();
+
+        VkAllocationCallbacks* getCallbacks() { return &m_callbacks; }
+
+        // Attributes the host allocations made by this thread while it exists to the object type.
+        class ObjectTypeScope
+        {
+        public:
+            ObjectTypeScope(VkObjectType objectType);
+            ~ObjectTypeScope();
+
+        private:
+            VkObjectType m_prevObjectType = VK_OBJECT_TYPE_UNKNOWN;
+        };
+
+        struct Usage
+        {
+            uint64_t bytes = 0u;
+            uint64_t peakBytes = 0u;
+            uint32_t allocationCount = 0u;
+            // Including the ones that were freed.
+            uint64_t totalAllocationCount = 0u;
+        };
+
+        static constexpr size_t k_scopeCount = VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1u;
+
+        struct Stats
+        {
+            std::array<Usage, k_scopeCount> scopes = {};
+            // VK_OBJECT_TYPE_UNKNOWN for allocations made outside of an ObjectTypeScope.
+            std::map<VkObjectType, Usage> objectTypes;
+            Usage total;
+            // Reported by the driver through the internal allocation notifications, e.g.
+            // executable memory for shaders.
+            Usage internal;
+            // Allocations served from the small object free lists and the bytes reserved for them.
+            uint64_t pooledAllocationCount = 0u;
+            uint64_t pooledReservedBytes = 0u;
+        };
+        Stats getStats() const;
+
+        static const char* GetScopeName(VkSystemAllocationScope scope);
+        // Null for the types that the engine doesn't open an ObjectTypeScope for.
+        static const char* GetObjectTypeName(VkObjectType objectType);
+
+    private:
+        // Precedes every allocation, so frees are counted against the scope and type that the
+        // memory was allocated with.
+        struct Header
+        {
+            uint32_t sizeBytes = 0u;
+            uint32_t objectType = 0u;
+            // From the start of the block that was allocated, zero for pooled slots.
+            uint32_t baseOffset = 0u;
+            uint8_t scope = 0u;
+            uint8_t sizeClass = 0u;
+            uint16_t reserved = 0u;
+        };
+
+        static VKAPI_ATTR void* VKAPI_CALL Allocate(
+            void* pUserData,
+            size_t size,
+            size_t alignment,
+            VkSystemAllocationScope scope);
+        static VKAPI_ATTR void* VKAPI_CALL Reallocate(
+            void* pUserData,
+            void* pOriginal,
+            size_t size,
+            size_t alignment,
+            VkSystemAllocationScope scope);
+        static VKAPI_ATTR void VKAPI_CALL Free(void* pUserData, void* pMemory);
+        static VKAPI_ATTR void VKAPI_CALL InternalAllocate(
+            void* pUserData,
+            size_t size,
+            VkInternalAllocationType allocationType,
+            VkSystemAllocationScope scope);
+        static VKAPI_ATTR void VKAPI_CALL InternalFree(
+            void* pUserData,
+            size_t size,
+            VkInternalAllocationType allocationType,
+            VkSystemAllocationScope scope);
+
+        void* allocate(size_t size, size_t alignment, VkSystemAllocationScope scope);
+        void free(void* pMemory);
+        void* allocateSlot(uint8_t sizeClass);
+
+        static void AddUsage(Usage& usage, uint64_t sizeBytes);
+        static void RemoveUsage(Usage& usage, uint64_t sizeBytes);
+
+        VkAllocationCallbacks m_callbacks = {};
+
+        // Callbacks can be called from any thread.
+        mutable std::mutex m_mutex;
+        Stats m_stats;
+
+        // Free slots of each size class, linked through their first bytes.
+        std::vector<void*> m_freeSlots;
+        std::vector<void*> m_chunks;
+    };
+}
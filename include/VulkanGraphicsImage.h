@@ -7,6 +7,7 @@
 #include <cassert>
 #include <cstdint>
 #include <map>
+#include <vector>
 
 #include <vulkan/vulkan.h>
 
@@ -44,11 +45,17 @@ namespace vgfx
             }
 
             VkImageCreateInfo imageInfo = {};
+            // Offset of each mip level within the image data. If set then every level is copied
+            // from the data, e.g. for block compressed textures, and no levels are generated. Each
+            // level holds all of the array layers, one after the other.
+            std::vector<VkDeviceSize> mipLevelOffsets;
         };
         Image(Context& context, const Config& config);
 
-        // Creates an image and, if it is configured to have more than one mip map level,
-        // then generates the mip map levels (REQUIRES VK_IMAGE_USAGE_TRANSFER_SRC_BIT).
+        // Creates an image and, if it is configured to have more than one mip map level and no
+        // mip level offsets, then generates the mip map levels. They are generated by the
+        // ImageDownsampler if it can downsample the image (see ImageDownsampler::canDownsample),
+        // otherwise by blitting (REQUIRES VK_IMAGE_USAGE_TRANSFER_SRC_BIT).
         Image(
             Context& context,
             CommandBufferFactory& commandBufferFactory,
@@ -67,7 +74,9 @@ namespace vgfx
             , m_extent(config.imageInfo.extent)
             , m_format(config.imageInfo.format)
             , m_mipLevels(config.imageInfo.mipLevels)
+            , m_arrayLayers(config.imageInfo.arrayLayers)
             , m_sampleCount(config.imageInfo.samples)
+            , m_usage(config.imageInfo.usage)
             , m_handle(imageHandle)
         {
         }
@@ -78,7 +87,9 @@ namespace vgfx
             , m_extent(copy.m_extent)
             , m_format(copy.m_format)
             , m_mipLevels(copy.m_mipLevels)
+            , m_arrayLayers(copy.m_arrayLayers)
             , m_sampleCount(copy.m_sampleCount)
+            , m_usage(copy.m_usage)
             , m_handle(copy.getHandle())
         {
         }
@@ -90,7 +101,9 @@ namespace vgfx
         uint32_t getDepth() const { return m_extent.depth; }
         VkFormat getFormat() const { return m_format; }
         uint32_t getMipLevels() const { return m_mipLevels; }
+        uint32_t getArrayLayers() const { return m_arrayLayers; }
         VkSampleCountFlagBits getSampleCount() const { return m_sampleCount; }
+        VkImageUsageFlags getUsage() const { return m_usage; }
 
         VkImage getHandle() const { return m_handle != VK_NULL_HANDLE ? m_handle : m_image.handle; }
 
@@ -99,11 +112,16 @@ namespace vgfx
         ImageView* getDefaultImageView() const;
 
     private:
+        // Called by the Defragmenter once the image's data has been copied to the new handle.
+        void onMoved(VkImage newHandle);
+
         Context& m_context;
         VkExtent3D m_extent = {};
         VkFormat m_format = VK_FORMAT_UNDEFINED;
         uint32_t m_mipLevels = 0u;
+        uint32_t m_arrayLayers = 1u;
         VkSampleCountFlagBits m_sampleCount = VK_SAMPLE_COUNT_1_BIT;
+        VkImageUsageFlags m_usage = 0u;
 
         MemoryAllocator::Image m_image;
         VkImage m_handle = VK_NULL_HANDLE;
@@ -7,14 +7,18 @@
 #include "VulkanGraphicsImageView.h"
 #include "VulkanGraphicsOneTimeCommands.h"
 #include "VulkanGraphicsSampler.h"
-#include "VulkanGraphicsBuffer.h"
 
 #include <memory>
+#include <vector>
 
 namespace vgfx
 {
 #define VGFX_DOWNSAMPLER_MAX_MIP_LEVELS 12
+// Level 6 is bound separately, and images with fewer levels are generated as fast by blitting.
+#define VGFX_DOWNSAMPLER_MIN_MIP_LEVELS 6
 
+    // Generates the mip levels of images with AMD's Single Pass Downsampler (SPD), which writes
+    // all of an image's levels in one dispatch rather than a blit and a barrier per level.
     class ImageDownsampler
     {
     public:
@@ -29,6 +33,30 @@ namespace vgfx
             Precision precision);
         ~ImageDownsampler() = default;
 
+        // Returns true if the image is R8G8B8A8_UNORM with VK_IMAGE_USAGE_STORAGE_BIT, and has
+        // between VGFX_DOWNSAMPLER_MIN_MIP_LEVELS and VGFX_DOWNSAMPLER_MAX_MIP_LEVELS levels to
+        // generate. Otherwise its mip levels need to be generated by blitting.
+        bool canDownsample(const Image& image) const;
+
+        // The image views, descriptor sets and atomic counters used by recorded commands, which
+        // must be kept until the commands have completed.
+        struct Batch
+        {
+            std::unique_ptr<DescriptorPool> spDescriptorPool;
+            std::unique_ptr<Buffer> spAtomicCounters;
+            std::vector<std::unique_ptr<ImageView>> imageViews;
+        };
+
+        // Records the generation of the mip levels of each image. Mip level 0 of each image must be
+        // in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, e.g. as left by
+        // OneTimeCommandsHelper::RecordCopyBufferToImageCommands with GenerateMips::No, and all of
+        // the levels are left in that layout. Each image has its own atomic counter, so the
+        // dispatches of the batch don't need to wait on each other.
+        std::unique_ptr<Batch> recordCommands(
+            VkCommandBuffer commandBuffer,
+            const std::vector<const Image*>& images);
+
+        // Records, submits and waits for the commands to generate the mip levels of the image.
         void execute(const Image& image, OneTimeCommandsHelper& commandsHelper);
 
     private:
@@ -46,13 +74,9 @@ namespace vgfx
         std::unique_ptr<ComputeShader> m_spComputeShader;
         std::unique_ptr<Program> m_spComputeProgram;
         std::unique_ptr<ComputePipeline> m_spComputePipeline;
-        std::unique_ptr<DescriptorPool> m_spDescriptorPool;
-        VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
 
         std::unique_ptr<Sampler> m_spSampler;
-        std::unique_ptr<Buffer> m_spGlobalCounterUBO;
-        std::vector<std::unique_ptr<ImageView>> m_spUAVs;
-        std::unique_ptr<ImageView> m_spSourceSRV;
+        // Size of each image's atomic counters, aligned to minStorageBufferOffsetAlignment.
+        VkDeviceSize m_atomicCounterStrideBytes = 0u;
     };
 }
-
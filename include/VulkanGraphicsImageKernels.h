@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vgfx
+{
+    // CPU conversions of RGBA8 texels that run when images are loaded or cooked. Each kernel has a
+    // scalar implementation, and SSE2, AVX2 or NEON implementations that produce the same bytes. The
+    // best instruction set that the CPU supports is detected the first time a kernel runs. None of
+    // it uses the device.
+    namespace ImageKernels
+    {
+        enum class InstructionSet
+        {
+            Scalar,
+            Sse2,
+            Avx2,
+            Neon
+        };
+
+        bool IsSupported(InstructionSet instructionSet);
+
+        // Instruction set that the kernels use, the best supported one unless it has been set.
+        InstructionSet GetInstructionSet();
+
+        // Selects the instruction set of the kernels, e.g. to compare it against the scalar kernels.
+        // Returns false, leaving it unchanged, if the CPU doesn't support it.
+        bool SetInstructionSet(InstructionSet instructionSet);
+
+        const char* GetInstructionSetName(InstructionSet instructionSet);
+
+        // Appends an opaque alpha channel to tightly packed RGB8 texels.
+        void ExpandRgbToRgba(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut);
+
+        // Multiplies the color channels by alpha, rounded to nearest.
+        void PremultiplyAlpha(uint8_t* pRgba, size_t texelCount);
+
+        // Converts RGBA8 texels to floats in [0, 1]. If they are sRGB then the color channels are
+        // converted to linear, alpha is always linear.
+        void ConvertRgba8ToFloat(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut);
+
+        // Converts floats to RGBA8 texels, clamped to [0, 1] and rounded to nearest. If isSrgb then
+        // the color channels are converted from linear to sRGB.
+        void ConvertFloatToRgba8(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut);
+
+        // Halves an RGBA8 image, each texel of pRgbaOut is the average of a 2x2 block, rounded to
+        // nearest. A side of 1 is kept as is, the other sides must be even.
+        void Reduce2x2(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut);
+    }
+}
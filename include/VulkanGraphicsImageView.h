@@ -2,6 +2,8 @@
 
 #include "VulkanGraphicsContext.h"
 
+#include <tuple>
+
 #include <vulkan/vulkan.h>
 
 namespace vgfx
@@ -19,7 +21,8 @@ namespace vgfx
                 VkFormat format, // renderTargetFormat must be compatible with image's renderTargetFormat.
                 VkImageViewType viewType,
                 uint32_t baseMipLevel = 0u,
-                uint32_t mipMapLevels = 1u)
+                uint32_t mipMapLevels = 1u,
+                uint32_t layerCount = 1u) // VK_REMAINING_ARRAY_LAYERS for all of an array's layers.
             { 
                 imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
                 imageViewInfo.image = VK_NULL_HANDLE;
@@ -40,12 +43,15 @@ namespace vgfx
                 imageViewInfo.subresourceRange.baseMipLevel = baseMipLevel;
                 imageViewInfo.subresourceRange.levelCount = mipMapLevels;
                 imageViewInfo.subresourceRange.baseArrayLayer = 0u;
-                imageViewInfo.subresourceRange.layerCount = 1u;
+                imageViewInfo.subresourceRange.layerCount = layerCount;
             }
 
             bool operator<(const ImageView::Config& rhs) const
             {
-                return this->imageViewInfo.format < rhs.imageViewInfo.format;
+                const VkImageSubresourceRange& range = imageViewInfo.subresourceRange;
+                const VkImageSubresourceRange& rhsRange = rhs.imageViewInfo.subresourceRange;
+                return std::tie(imageViewInfo.format, imageViewInfo.viewType, range.baseMipLevel, range.levelCount, range.layerCount)
+                    < std::tie(rhs.imageViewInfo.format, rhs.imageViewInfo.viewType, rhsRange.baseMipLevel, rhsRange.levelCount, rhsRange.layerCount);
             }
 
             VkImageViewCreateInfo imageViewInfo = {};
@@ -65,9 +71,20 @@ namespace vgfx
         VkImageView getHandle() const { return m_imageView;  }
 
     private:
+        friend class Image;
+
+        void create();
         void destroy();
 
+        // Replaces the view with one of the image's current handle, after it has been moved.
+        void recreate()
+        {
+            destroy();
+            create();
+        }
+
         Context& m_context;
+        Config m_config;
         const Image& m_image;
         VkFormat m_format = VK_FORMAT_UNDEFINED; // ImageView format may differ from Image's format.
         VkImageView m_imageView = VK_NULL_HANDLE;
@@ -11,6 +11,11 @@
 
 namespace vgfx
 {
+    class GeometryArena;
+    class GeometryRange;
+
+    VkDeviceSize IndexTypeSizeBytes(VkIndexType indexType);
+
     class IndexBuffer
     {
     public:
@@ -40,22 +45,34 @@ namespace vgfx
             const void* pIndices,
             uint32_t numIndices);
 
+        // Suballocates the indices from the GeometryArena's buffer for the index type, the arena
+        // must outlive the IndexBuffer.
+        IndexBuffer(
+            GeometryArena& geometryArena,
+            const Config& config,
+            const void* pIndices,
+            uint32_t numIndices);
+
         ~IndexBuffer() {
             destroy();
         }
 
         VkIndexType getType() const { return m_indexType; }
 
-        VkBuffer getHandle() { return m_buffer.handle; }
+        VkBuffer getHandle();
 
         uint32_t getCount() const { return m_numIndices; }
 
+        // Offset of this buffer's first index within the buffer returned by getHandle(), which is
+        // non-zero if the indices are suballocated from a GeometryArena.
+        uint32_t getFirstIndex() const;
+
         bool getHasPrimitiveRestartValues() const { return m_hasPrimitiveRestartValues; }
 
     private:
         void destroy();
 
-        Context& m_context;
+        Context* m_pContext = nullptr;
 
         VkIndexType m_indexType = VK_INDEX_TYPE_MAX_ENUM;
         uint32_t m_numIndices = 0u;
@@ -63,6 +80,9 @@ namespace vgfx
         bool m_hasPrimitiveRestartValues = false;
 
         MemoryAllocator::Buffer m_buffer;
+
+        GeometryArena* m_pGeometryArena = nullptr;
+        GeometryRange* m_pGeometryRange = nullptr;
     };
 }
 
@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include <vulkan/vulkan.h>
@@ -9,6 +14,7 @@
 namespace vgfx
 {
     class Context;
+    class Defragmenter;
 
     class MemoryAllocator
     {
@@ -24,10 +30,27 @@ namespace vgfx
 
         void shutdown();
 
+        // Where an allocation is placed, so that allocations with different lifetimes don't
+        // interleave in the same blocks.
+        enum class AllocationClass
+        {
+            // VMA's default blocks.
+            Default,
+            // Geometry and textures that live as long as the content. Suballocated from pools of
+            // large blocks, one per memory type, or from the default blocks if it doesn't fit.
+            Static,
+            // Device memory of its own, so that recreating render targets doesn't leave holes.
+            RenderTarget,
+        };
+
         struct Buffer
         {
             VkBuffer handle = VK_NULL_HANDLE;
             VmaAllocation allocation = VK_NULL_HANDLE;
+            // Concurrent buffers can only be used by the queue families they were created with.
+            VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            // Set if the buffer is persistently mapped, e.g. transient buffers.
+            void* pMappedData = nullptr;
             bool isValid() const {
                 return handle != VK_NULL_HANDLE && allocation != VK_NULL_HANDLE;
             }
@@ -36,22 +59,73 @@ namespace vgfx
             VkDeviceSize sizeBytes,
             VkBufferUsageFlags usage,
             VmaMemoryUsage bufferMemoryUsage,
-            const char* pBufferName = nullptr);
+            const char* pBufferName = nullptr,
+            AllocationClass allocationClass = AllocationClass::Default);
 
         Buffer createSharedBuffer(
             VkDeviceSize sizeBytes,
             VkBufferUsageFlags usage,
             const std::vector<uint32_t>& queueFamilyIndices,
             VmaMemoryUsage bufferMemoryUsage,
-            const char* pBufferName = nullptr);
+            const char* pBufferName = nullptr,
+            AllocationClass allocationClass = AllocationClass::Default);
 
         Buffer createBuffer(
             const VkBufferCreateInfo& bufferCreateInfo,
             VmaMemoryUsage bufferMemoryUsage,
-            const char* pBufferName = nullptr);
+            const char* pBufferName = nullptr,
+            AllocationClass allocationClass = AllocationClass::Default);
 
         void destroyBuffer(Buffer& bufferAllocation);
 
+        // How static data, e.g. vertices and indices, gets into device local memory. Auto writes
+        // it directly if shouldWriteDirectly() decides that it is faster than staging it.
+        enum class UploadStrategy
+        {
+            Auto,
+            Staging,
+            DirectWrite,
+        };
+        void setUploadStrategy(UploadStrategy uploadStrategy) { m_uploadStrategy = uploadStrategy; }
+        UploadStrategy getUploadStrategy() const { return m_uploadStrategy; }
+
+        // Size of the largest heap with device local, host visible memory, zero if there is none.
+        VkDeviceSize getDeviceLocalHostVisibleHeapSizeBytes() const { return m_deviceLocalHostVisibleHeapSizeBytes; }
+
+        // True for integrated and CPU devices, e.g. lavapipe, whose device memory is system memory.
+        bool isUnifiedMemory() const { return m_isUnifiedMemory; }
+
+        // Returns true if static data should be written directly to device local, host visible
+        // memory instead of being staged and copied, which Auto does on unified memory and with
+        // resizable BAR. Without it only 256 MB of device memory is host visible, which is left
+        // to the per-frame data.
+        bool shouldWriteDirectly() const;
+
+        // Creates a persistently mapped buffer in device local, host visible memory, so the data
+        // can be written with writeMappedBuffer instead of being staged. Returns an invalid buffer
+        // if there is no such memory or it is full.
+        Buffer createDirectWriteBuffer(
+            const VkBufferCreateInfo& bufferCreateInfo,
+            const char* pBufferName = nullptr,
+            AllocationClass allocationClass = AllocationClass::Default);
+
+        // Copies the data to a persistently mapped buffer and flushes it if it isn't coherent.
+        // The GPU must not be using that range of the buffer.
+        void writeMappedBuffer(
+            const Buffer& buffer,
+            const void* pData,
+            VkDeviceSize dataSizeBytes,
+            VkDeviceSize dstOffsetBytes = 0u);
+
+        // Creates a persistently mapped buffer in host visible memory for data that the CPU writes
+        // every frame, device local if shouldWriteDirectly(). Writes to it must be flushed with
+        // flushMappedBuffer. Returns an invalid buffer if it fails.
+        Buffer createMappedBuffer(const VkBufferCreateInfo& bufferCreateInfo, const char* pBufferName = nullptr);
+
+        // Makes the CPU's writes to the range visible to the GPU, does nothing if the memory is
+        // coherent.
+        void flushMappedBuffer(const Buffer& buffer, VkDeviceSize offsetBytes, VkDeviceSize sizeBytes);
+
         bool mapBuffer(Buffer& handle, void** ppData);
         void unmapBuffer(Buffer& handle);
 
@@ -66,12 +140,181 @@ namespace vgfx
 
         Image createImage(
             const VkImageCreateInfo& imageCreateInfo,
-            VmaMemoryUsage imageMemoryUsage);
+            VmaMemoryUsage imageMemoryUsage,
+            const char* pImageName = nullptr,
+            AllocationClass allocationClass = AllocationClass::Default);
 
         void destroyImage(Image& image);
 
+        // Lets the Defragmenter move the buffer, which must be exclusive and a transfer src. Once the copy of its data
+        // has been submitted, movedFunc is called with the new handle, which the owner must use
+        // from then on, and the old handle is destroyed once the GPU no longer uses it. The owner
+        // must call clearMovable before it retires the buffer.
+        using BufferMovedFunc = std::function<void(VkBuffer newHandle)>;
+        void setMovable(const Buffer& buffer, const VkBufferCreateInfo& bufferCreateInfo, BufferMovedFunc&& movedFunc);
+
+        // Like the buffer version, for a single sample color image that is in the layout whenever
+        // it isn't being uploaded, and can be a transfer src and dst.
+        using ImageMovedFunc = std::function<void(VkImage newHandle)>;
+        void setMovable(
+            const Image& image,
+            const VkImageCreateInfo& imageCreateInfo,
+            VkImageLayout layout,
+            ImageMovedFunc&& movedFunc);
+
+        void clearMovable(VmaAllocation allocation);
+
+        // Creates linear pools of host visible memory, one per frame in flight, for data that is
+        // only used by one frame, e.g. uniforms and staging. Their buffers are bump allocated and
+        // all freed at once by resetTransientPool. They are device local if shouldWriteDirectly().
+        // Pools are only added, so it can be called again with a larger count.
+        void createTransientPools(uint32_t poolCount, VkDeviceSize poolSizeBytes);
+
+        uint32_t getTransientPoolCount() const { return static_cast<uint32_t>(m_transientPools.size()); }
+
+        // Creates a persistently mapped buffer in the pool, throws if the pool is full. Don't
+        // destroy it, it is destroyed when the pool is reset.
+        Buffer createTransientBuffer(
+            uint32_t poolIndex,
+            VkDeviceSize sizeBytes,
+            VkBufferUsageFlags usage,
+            const char* pBufferName = nullptr);
+
+        // Destroys all of the pool's buffers, the GPU must no longer use them, e.g. the pool's
+        // frame has completed.
+        void resetTransientPool(uint32_t poolIndex);
+
+        // Sums VMA's budget and usage of the device local memory heaps. The budget is an estimate of
+        // how much memory the process can use, including what it already uses.
+        void getDeviceLocalBudget(VkDeviceSize* pBudgetBytes, VkDeviceSize* pUsageBytes) const;
+
+        // Kind of resource that an allocation backs, determined from its usage flags.
+        enum class Category
+        {
+            VertexBuffer,
+            IndexBuffer,
+            UniformBuffer,
+            StorageBuffer,
+            StagingBuffer,
+            OtherBuffer,
+            Texture,
+            RenderTarget,
+            DepthStencil,
+            OtherImage,
+            Count
+        };
+        static const char* GetCategoryName(Category category);
+
+        struct Usage
+        {
+            VkDeviceSize bytes = 0u;
+            uint32_t allocationCount = 0u;
+        };
+
+        struct HeapBudget
+        {
+            VkDeviceSize budgetBytes = 0u;
+            VkDeviceSize usageBytes = 0u;
+            bool isDeviceLocal = false;
+        };
+
+        // Cheap enough to take every frame: VMA's heap budgets and the usage that the allocator
+        // counts as it creates and destroys resources.
+        struct Sample
+        {
+            uint32_t heapCount = 0u;
+            std::array<HeapBudget, VK_MAX_MEMORY_HEAPS> heaps = {};
+            std::array<Usage, static_cast<size_t>(Category::Count)> categories = {};
+            Usage total;
+        };
+        void sample(Sample* pSample) const;
+
+        // From vmaCalculateStatistics, which walks all of the memory blocks, so it is too slow to
+        // call every frame. Wasted bytes are the unused bytes of the blocks.
+        struct Statistics
+        {
+            VkDeviceSize blockBytes = 0u;
+            VkDeviceSize allocatedBytes = 0u;
+            VkDeviceSize wastedBytes = 0u;
+            // Wasted bytes other than the largest free range of each memory type, which is usually
+            // the untouched end of its last block, so roughly the bytes in holes between
+            // allocations.
+            VkDeviceSize fragmentedBytes = 0u;
+            uint32_t blockCount = 0u;
+            uint32_t allocationCount = 0u;
+        };
+        void calculateStatistics(Statistics* pStatistics) const;
+
+        // Usage of each buffer and image name, unnamed resources are counted under an empty name.
+        std::unordered_map<std::string, Usage> getUsageByName() const;
+
+        // JSON of VMA's statistics, with the allocations of every block if detailedMap is true.
+        std::string buildVmaStatsJson(bool detailedMap) const;
+
     private:
+        friend class Defragmenter;
+
+        struct Tracked
+        {
+            std::string name;
+            Category category = Category::OtherBuffer;
+            VkDeviceSize bytes = 0u;
+        };
+        void track(VmaAllocation allocation, const char* pName, Category category);
+        void untrack(VmaAllocation allocation);
+
+        VkResult createBuffer(
+            const VkBufferCreateInfo& bufferCreateInfo,
+            const VmaAllocationCreateInfo& allocationCreateInfo,
+            Category category,
+            const char* pBufferName,
+            Buffer* pBuffer);
+
+        VmaPool getOrCreateStaticPool(uint32_t memoryTypeIndex);
+
+        // Returns false if the allocation is being moved, in which case only its resource is
+        // destroyed and the Defragmenter has VMA free it.
+        bool releaseMovable(VmaAllocation allocation);
+
         VmaAllocator m_allocator = VK_NULL_HANDLE;
+        VkDevice m_device = VK_NULL_HANDLE;
+        const VkAllocationCallbacks* m_pAllocationCallbacks = nullptr;
+
+        UploadStrategy m_uploadStrategy = UploadStrategy::Auto;
+        VkDeviceSize m_deviceLocalHostVisibleHeapSizeBytes = 0u;
+        bool m_isUnifiedMemory = false;
+
+        using MemoryTypeIndex = uint32_t;
+        std::unordered_map<MemoryTypeIndex, VmaPool> m_staticPools;
+
+        struct TransientPool
+        {
+            VmaPool pool = VK_NULL_HANDLE;
+            std::vector<Buffer> buffers;
+        };
+        std::vector<TransientPool> m_transientPools;
+        VkDeviceSize m_transientPoolSizeBytes = 0u;
+
+        // VMA is thread safe, so the tracking is too.
+        mutable std::mutex m_trackedMutex;
+        std::unordered_map<VmaAllocation, Tracked> m_tracked;
+        std::array<Usage, static_cast<size_t>(Category::Count)> m_categoryUsage = {};
+
+        struct Movable
+        {
+            VkBuffer buffer = VK_NULL_HANDLE;
+            VkBufferCreateInfo bufferCreateInfo = {};
+            BufferMovedFunc bufferMovedFunc;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageCreateInfo imageCreateInfo = {};
+            VkImageLayout imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            ImageMovedFunc imageMovedFunc;
+        };
+        std::unordered_map<VmaAllocation, Movable> m_movables;
+
+        // Allocations of the Defragmenter's current pass, which VMA must free if they are destroyed
+        // before the pass ends. Set to true if they were.
+        std::unordered_map<VmaAllocation, bool> m_movingAllocations;
     };
 }
 
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "VulkanGraphicsHostAllocator.h"
+#include "VulkanGraphicsMemoryAllocator.h"
+
+#include <cstdint>
+#include <deque>
+#include <ostream>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Keeps a rolling history of the MemoryAllocator's samples, e.g. one per frame, to track down
+    // memory growth, and writes it to JSON along with the per-name usage, VMA's statistics and
+    // optionally VMA's detailed map of every allocation and the HostAllocator's usage.
+    class MemoryTelemetry
+    {
+    public:
+        struct Config
+        {
+            // About 10 seconds at 60 frames per second.
+            uint32_t historyLength = 600u;
+        };
+
+        MemoryTelemetry(
+            const MemoryAllocator& memoryAllocator,
+            const Config& config = Config(),
+            const HostAllocator* pHostAllocator = nullptr);
+
+        // Adds a sample to the history, dropping the oldest once it is full.
+        void sample();
+
+        // Oldest first.
+        const std::deque<MemoryAllocator::Sample>& getHistory() const { return m_history; }
+
+        // Number of samples taken, including the ones dropped from the history.
+        uint64_t getSampleCount() const { return m_sampleCount; }
+
+        // Largest usage of the device local heaps of all of the samples.
+        VkDeviceSize getPeakDeviceLocalUsageBytes() const { return m_peakDeviceLocalUsageBytes; }
+
+        void writeJson(std::ostream& out, bool includeVmaDetailedMap) const;
+
+    private:
+        const MemoryAllocator& m_memoryAllocator;
+        const HostAllocator* m_pHostAllocator = nullptr;
+        Config m_config;
+        std::deque<MemoryAllocator::Sample> m_history;
+        uint64_t m_sampleCount = 0u;
+        VkDeviceSize m_peakDeviceLocalUsageBytes = 0u;
+    };
+}
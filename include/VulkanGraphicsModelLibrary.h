@@ -1,5 +1,6 @@
 #pragma once
 
+#include "VulkanGraphicsAsyncImageLoader.h"
 #include "VulkanGraphicsCommandBufferFactory.h"
 #include "VulkanGraphicsContext.h"
 #include "VulkanGraphicsDescriptors.h"
@@ -8,15 +9,24 @@
 #include "VulkanGraphicsImageView.h"
 #include "VulkanGraphicsIndexBuffer.h"
 #include "VulkanGraphicsEffects.h"
+#include "VulkanGraphicsGeometryArena.h"
 #include "VulkanGraphicsSampler.h"
+#include "VulkanGraphicsTexturePacker.h"
+#include "VulkanGraphicsTextureResidencyManager.h"
 #include "VulkanGraphicsVertexBuffer.h"
 
 #include <memory>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace vgfx
 {
+    namespace GltfLoader
+    {
+        struct Model;
+    }
+
     class ModelLibrary
     {
     public:
@@ -29,6 +39,13 @@ namespace vgfx
             using Images = std::unordered_map<ImageType, std::string>;
             // Use imagesOverrides to override the imagesOverrides specified by the model, or provide them for a shape.
             Images imagesOverrides;
+            // If true then images that are not already loaded are streamed in by the
+            // TextureResidencyManager, and the drawable samples a placeholder image until their
+            // first levels are ready.
+            bool loadImagesAsync = false;
+            // If true then the images that are not already loaded are packed into texture arrays and
+            // atlases (see packImages) before the drawable is created.
+            bool packImages = false;
         };
 
         Drawable& getOrCreateDrawable(
@@ -44,11 +61,54 @@ namespace vgfx
             Context& context,
             CommandBufferFactory& commandBufferFactory);
 
+        // Decodes an image that is embedded in another file (e.g. a GLB), path is only used as the
+        // key for the image library.
+        Image& getOrLoadImage(
+            const std::string& path,
+            const uint8_t* pEncodedData,
+            size_t encodedSizeBytes,
+            Context& context,
+            CommandBufferFactory& commandBufferFactory);
+
+        // Loads the images, except those that are already loaded or packed, and packs them into
+        // texture arrays and atlases (see TexturePacker). Drawables that are created afterwards
+        // sample the packed images, so that their materials can share descriptor sets. Images that
+        // can't be packed are loaded on their own.
+        void packImages(
+            const std::vector<std::string>& paths,
+            Context& context,
+            CommandBufferFactory& commandBufferFactory);
+
+        void setTexturePackerConfig(const TexturePacker::Config& config) { m_texturePackerConfig = config; }
+
         ImageView& getOrCreateImageView(
             const ImageView::Config& config,
             Context& context,
             const Image& image);
 
+        // Arena that all of the models' vertices and indices are suballocated from, nullptr until
+        // the first model is loaded.
+        GeometryArena* getGeometryArena() { return m_spGeometryArena.get(); }
+
+        // Swaps the images that finished loading asynchronously into the drawables that are waiting
+        // on them, streams textures in or out of the memory budget and defragments the geometry
+        // arena. Call once per frame before rendering.
+        void update();
+
+        // nullptr until the first drawable that loads its images asynchronously is created.
+        AsyncImageLoader* getAsyncImageLoader() { return m_spAsyncImageLoader.get(); }
+        TextureResidencyManager* getTextureResidencyManager() { return m_spTextureResidencyManager.get(); }
+
+        // Config of the TextureResidencyManager, only used if set before it is created.
+        void setTextureResidencyConfig(const TextureResidencyManager::Config& config);
+
+        // Vertices that are uploaded as they are, e.g. the buffer views of a glTF model.
+        struct VertexDataView
+        {
+            const uint8_t* pData = nullptr;
+            size_t sizeBytes = 0u;
+        };
+
     private:
         static VertexBuffer::Config DefaultVertexBufferConfig;
         static IndexBuffer::Config DefaultIndexBufferConfig;
@@ -57,12 +117,35 @@ namespace vgfx
             const std::string& modelPathOrShapeName,
             VertexBuffer** ppVertexBuffer,
             IndexBuffer** ppIndexBuffer,
-            ModelDesc::Images* pModelImages) const;
+            SubMeshes* pSubMeshes,
+            std::vector<ModelDesc::Images>* pMaterialImages,
+            glm::vec4* pBoundingSphere) const;
 
         Drawable* findDrawable(const std::string& modelPath);
 
+        TextureResidencyManager& getOrCreateTextureResidencyManager(
+            Context& context,
+            CommandBufferFactory& commandBufferFactory);
+
+        // If the model's vertices are interleaved in the vertex shader's order then views of its
+        // buffers are returned instead of converted vertices, which are valid while pGltfModel is.
+        void loadGltfModel(
+            const std::string& modelName,
+            Context& context,
+            CommandBufferFactory& commandBufferFactory,
+            GltfLoader::Model* pGltfModel,
+            std::vector<uint8_t>* pVerticesOut,
+            std::vector<VertexDataView>* pVertexViewsOut,
+            std::vector<uint32_t>* pIndicesOut,
+            VertexBuffer::Config* pVertexBufferCfgOut,
+            SubMeshes* pSubMeshesOut,
+            std::vector<ModelDesc::Images>* pMaterialImagesOut);
+
         using FilePath = std::string;
 
+        // Declared before the libraries so that it is destroyed after the buffers suballocated from it.
+        std::unique_ptr<GeometryArena> m_spGeometryArena;
+
         using DrawableLibrary = std::unordered_map<FilePath, std::unique_ptr<Drawable>>;
         DrawableLibrary m_drawableLibrary;
 
@@ -72,11 +155,29 @@ namespace vgfx
         using ImageViewLibrary = std::map<ImageView::Config, std::unique_ptr<ImageView>>;
         ImageViewLibrary m_imageViewLibrary;
 
+        // Texture arrays and atlases, and where each packed image's texture is within them.
+        std::vector<std::unique_ptr<Image>> m_packedImages;
+        struct PackedImageRegion
+        {
+            const Image* pImage = nullptr;
+            TextureRegion region;
+        };
+        std::unordered_map<FilePath, PackedImageRegion> m_packedImageRegions;
+        TexturePacker::Config m_texturePackerConfig;
+
+        std::unique_ptr<AsyncImageLoader> m_spAsyncImageLoader;
+        TextureResidencyManager::Config m_textureResidencyConfig;
+        // Declared after the loader since it references the loader's placeholder image.
+        std::unique_ptr<TextureResidencyManager> m_spTextureResidencyManager;
+
         struct ModelData
         {
             std::unique_ptr<VertexBuffer> spVertexBuffer;
             std::unique_ptr<IndexBuffer> spIndexBuffer;
-            ModelDesc::Images modelImages;
+            SubMeshes subMeshes;
+            // Images of each material referenced by the submeshes.
+            std::vector<ModelDesc::Images> materialImages;
+            glm::vec4 boundingSphere = glm::vec4(0.0f);
         };
         using ModelDataLibrary = std::unordered_map<std::string, ModelData>;
         ModelDataLibrary m_modelDataLibrary;
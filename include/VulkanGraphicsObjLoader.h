@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+namespace vgfx
+{
+    // Multithreaded replacement for tinyobj::LoadObj. The file is memory mapped and split into
+    // line aligned chunks which are parsed in parallel and then merged, the output is the same
+    // tinyobj attrib/shape/material representation that tinyobj::LoadObj produces (faces are
+    // always triangulated).
+    namespace ObjLoader
+    {
+        struct LoadStats
+        {
+            size_t fileSizeBytes = 0u;
+            uint32_t chunkCount = 0u;
+            uint32_t threadCount = 0u;
+            double parseSeconds = 0.0;
+            double mergeSeconds = 0.0;
+
+            double getThroughputMBps() const
+            {
+                double totalSeconds = parseSeconds + mergeSeconds;
+                return totalSeconds > 0.0 ?
+                    (static_cast<double>(fileSizeBytes) / (1024.0 * 1024.0)) / totalSeconds : 0.0;
+            }
+        };
+
+        // If threadCount is zero then std::thread::hardware_concurrency() threads are used.
+        bool LoadObj(
+            tinyobj::attrib_t* pAttrib,
+            std::vector<tinyobj::shape_t>* pShapes,
+            std::vector<tinyobj::material_t>* pMaterials,
+            std::string* pWarn,
+            std::string* pErr,
+            const std::string& filePath,
+            uint32_t threadCount = 0u,
+            LoadStats* pStats = nullptr);
+    }
+}
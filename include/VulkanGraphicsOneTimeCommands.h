@@ -14,6 +14,8 @@
 namespace vgfx
 {
     class Context;
+    class GpuTimeline;
+    class UploadManager;
 
     class OneTimeCommandsRunner
     {
@@ -24,7 +26,9 @@ namespace vgfx
             const RecordCommandsFunc& drawFunc);
         ~OneTimeCommandsRunner();
 
-        void submit(CommandQueue queue);
+        // Waits for the commands to complete. If the timeline is of the queue then only its own
+        // submission is waited for, otherwise the queue is waited on until idle.
+        void submit(CommandQueue queue, GpuTimeline* pGpuTimeline = nullptr);
 
     private:
         CommandBufferFactory& m_commandBufferFactory;
@@ -39,15 +43,15 @@ namespace vgfx
             CommandBufferFactory& commandBufferFactory);
         ~OneTimeCommandsHelper();
 
-        void execute(const OneTimeCommandsRunner::RecordCommandsFunc& drawFunc) {
-            OneTimeCommandsRunner runner(
-                m_commandBufferFactory,
-                drawFunc);
-            runner.submit(m_commandQueue);
-        }
+        // Submits any pending uploads of the Context's UploadManager first, and acquires them if
+        // they were copied by a transfer queue, so that the commands see their data.
+        void execute(const OneTimeCommandsRunner::RecordCommandsFunc& drawFunc);
 
-        // Records and submits one-time-use command buffer that copies the
-        // provided data into the provided buffer.
+        // Copies the provided data into the provided buffer. If the helper uses the dst queue of
+        // the Context's UploadManager then the copy is recorded into its open batch and isn't
+        // waited on, it is submitted and acquired by execute() or the Renderer's next submit.
+        // Otherwise it records and submits a one-time-use command buffer. Persistently mapped
+        // buffers, e.g. direct write buffers, are written directly.
         void copyDataToBuffer(
             MemoryAllocator::Buffer& buffer,
             const std::vector<uint8_t>& data);
@@ -55,17 +59,48 @@ namespace vgfx
         void copyDataToBuffer(
             MemoryAllocator::Buffer& buffer,
             const void* pData,
-            VkDeviceSize dataSizeBytes);
+            VkDeviceSize dataSizeBytes,
+            VkDeviceSize dstOffsetBytes = 0u);
 
         enum class GenerateMips
         {
             No,
             Yes
         };
+        // If mip level offsets are provided then each level is copied from the data at its offset,
+        // otherwise only mip level 0 is copied. Uses the UploadManager like copyDataToBuffer.
         void copyDataToImage(
             Image& image,
             const void* pData,
             VkDeviceSize dataSizeBytes,
+            GenerateMips genMips,
+            const std::vector<VkDeviceSize>& mipLevelOffsets = {});
+
+        // Records the copy of the buffer to the image, the generation of the other mip levels, and
+        // the transition of the image to shader read only. Used by copyDataToImage, and by loaders
+        // that batch the upload of many images into a single command buffer. The mip level offsets
+        // are relative to srcOffsetBytes.
+        static void RecordCopyBufferToImageCommands(
+            VkCommandBuffer commandBuffer,
+            VkBuffer srcBuffer,
+            VkDeviceSize srcOffsetBytes,
+            const Image& image,
+            GenerateMips genMips,
+            const std::vector<VkDeviceSize>& mipLevelOffsets = {});
+
+        // The two halves of RecordCopyBufferToImageCommands, for uploads that copy on a transfer
+        // queue and then hand the image to a graphics queue, which blits the mip levels. The first
+        // leaves every mip level in transfer dst layout, and the second expects them to be in it.
+        static void RecordCopyBufferToTransferDstImageCommands(
+            VkCommandBuffer commandBuffer,
+            VkBuffer srcBuffer,
+            VkDeviceSize srcOffsetBytes,
+            const Image& image,
+            const std::vector<VkDeviceSize>& mipLevelOffsets = {});
+
+        static void RecordGenerateMipsAndShaderReadCommands(
+            VkCommandBuffer commandBuffer,
+            const Image& image,
             GenerateMips genMips);
 
         void recordImageMemBarrierCommand(
@@ -78,6 +113,8 @@ namespace vgfx
             uint32_t layerCount = VK_REMAINING_ARRAY_LAYERS);
 
     private:
+        UploadManager* getUploadManager();
+
         Context& m_context;
         CommandBufferFactory& m_commandBufferFactory;
         CommandQueue m_commandQueue;
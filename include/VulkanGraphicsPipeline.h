@@ -129,6 +129,7 @@ namespace vgfx
         std::vector<VkPushConstantRange> m_pushConstantRanges;
 
         std::vector<VkDescriptorSetLayout> m_descriptorSetLayouts;
+        VkPipelineCreateFlags m_pipelineCreateFlags = 0u;
 
         VkPipelineDepthStencilStateCreateInfo m_depthStencil = {};
         VkViewport m_viewport = {};
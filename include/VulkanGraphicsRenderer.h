@@ -5,7 +5,11 @@
 #include "VulkanGraphicsContext.h"
 #include "VulkanGraphicsCommandBufferFactory.h"
 #include "VulkanGraphicsDepthStencilBuffer.h"
+#include "VulkanGraphicsDescriptorAllocator.h"
+#include "VulkanGraphicsDescriptorBatcher.h"
+#include "VulkanGraphicsDescriptorBuffer.h"
 #include "VulkanGraphicsFence.h"
+#include "VulkanGraphicsGpuTimeline.h"
 #include "VulkanGraphicsObject.h"
 #include "VulkanGraphicsPipeline.h"
 #include "VulkanGraphicsRenderTarget.h"
@@ -26,6 +30,8 @@
 
 namespace vgfx
 {
+    class Drawable;
+
     struct ViewState
     {
         glm::mat4 cameraViewMatrix;
@@ -52,12 +58,29 @@ namespace vgfx
     struct DrawContext
     {
         Context& context;
-        DescriptorPool& descriptorPool;
+        // Reset at the start of the frame.
+        DescriptorAllocator& descriptorAllocator;
+        // Reset and bound at the start of the frame if the Context has descriptor buffers enabled,
+        // null otherwise.
+        DescriptorBuffer* pDescriptorBuffer = nullptr;
+        // Drawables request their descriptor sets from the batcher and add themselves to the draw
+        // queue while the scene is traversed. Once the traversal is done the batcher is flushed
+        // and the queued drawables are recorded, see Drawable::recordDraw.
+        DescriptorBatcher& descriptorBatcher;
+        std::vector<Drawable*>& drawQueue;
         size_t frameIndex;
         bool depthBufferEnabled;
         VkCommandBuffer commandBuffer;
         const RenderTarget& renderTarget;
+        // MemoryAllocator transient pool of the frame, for buffers that are only used by it, see
+        // MemoryAllocator::createTransientBuffer.
+        uint32_t transientPoolIndex = 0u;
         SceneState sceneState = {};
+        // Vertex and index buffers currently bound to the command buffer, drawables that are
+        // suballocated from the same GeometryArena buffers skip rebinding them.
+        VkBuffer boundVertexBuffer = VK_NULL_HANDLE;
+        VkBuffer boundIndexBuffer = VK_NULL_HANDLE;
+        VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
         void pushLight(
             const glm::vec4& position,
@@ -190,6 +213,8 @@ namespace vgfx
 
         VkResult acquireNextSwapChainImage(uint32_t* pSwapChainImageIndex);
 
+        void createRenderTargets(Renderer& renderer);
+
         SwapChain::Config m_swapChainConfig;
         VkSurfaceKHR m_surface = VK_NULL_HANDLE;
         void* m_pWindow = nullptr;
@@ -274,6 +299,22 @@ namespace vgfx
         QueueSubmitInfo& getSubmitInfo() { return m_queueSubmitInfo; }
         void submitGraphicsCommands();
 
+        // Value of the Context's GpuTimeline that the last submitted frame signals, zero if there
+        // is no timeline. Resources that the frame used can be released once it has completed.
+        GpuTimeline::Value getLastSubmittedFrameTimelineValue() const { return m_lastSubmittedFrameTimelineValue; }
+
+        // One per frame in flight plus one.
+        const std::vector<std::unique_ptr<DescriptorAllocator>>& getDescriptorAllocators() const
+        {
+            return m_descriptorAllocators;
+        }
+
+        // One per frame in flight plus one if the Context has descriptor buffers enabled.
+        const std::vector<std::unique_ptr<DescriptorBuffer>>& getDescriptorBuffers() const
+        {
+            return m_descriptorBuffers;
+        }
+
     protected:
         virtual const RenderTarget& prepareRenderTarget(VkCommandBuffer commandBuffer)
         {
@@ -295,17 +336,24 @@ namespace vgfx
         }
 
         void createResourcePools(uint32_t framesInFlightPlusOne);
-        void createCamera(uint32_t renderTargetWidth, uint32_t renderTargetHeight, uint32_t frameBufferingCount);
+        void createCamera(uint32_t renderTargetWidth, uint32_t renderTargetHeight);
+        // See AppConfig::defragmentWastedFraction.
+        void startDefragmenterIfFragmented();
 
     private:
         uint32_t m_frameBufferingCount = 1u;
 
         size_t m_frameIndex = 0u;
-        std::vector<std::unique_ptr<DescriptorPool>> m_descriptorPools;
+        GpuTimeline::Value m_lastSubmittedFrameTimelineValue = 0u;
+        std::vector<std::unique_ptr<DescriptorAllocator>> m_descriptorAllocators;
+        std::vector<std::unique_ptr<DescriptorBuffer>> m_descriptorBuffers;
+        std::unique_ptr<DescriptorBatcher> m_spDescriptorBatcher;
+        std::vector<Drawable*> m_drawQueue;
         std::unique_ptr<CommandBufferFactory> m_spCommandBufferFactory;
         std::vector<VkCommandBuffer> m_commandBuffers;
 
-        std::vector<std::unique_ptr<Buffer>> m_lightsBuffers;
+        // From the current frame's transient pool.
+        std::unique_ptr<Buffer> m_spLightsBuffer;
 
         QueueSubmitInfo m_queueSubmitInfo;
     };
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "VulkanGraphicsGpuTimeline.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+
+namespace vgfx
+{
+    // Defers the destruction of Vulkan objects until the GPU no longer uses them. Each object is
+    // retired with the GpuTimeline value of the last submission that could use it, and destroyed
+    // by collect() once the timeline has passed that value. This lets resources be released while
+    // frames are in flight instead of waiting for the device to idle.
+    class RetirementQueue
+    {
+    public:
+        using DestroyFunc = std::function<void()>;
+
+        RetirementQueue(GpuTimeline& gpuTimeline) : m_gpuTimeline(gpuTimeline) {}
+
+        // Waits for and destroys all of the retired objects.
+        ~RetirementQueue();
+
+        // Destroys the object once the timeline reaches lastUseValue, which must have been
+        // submitted.
+        void retire(GpuTimeline::Value lastUseValue, DestroyFunc&& destroyFunc);
+
+        // Destroys the object once everything submitted to the timeline so far has completed.
+        void retire(DestroyFunc&& destroyFunc)
+        {
+            retire(m_gpuTimeline.getLastSubmittedValue(), std::move(destroyFunc));
+        }
+
+        // Destroys the objects whose values have completed.
+        void collect();
+
+        // Waits for the last retired object's value and destroys all of them.
+        void flush();
+
+        size_t getPendingCount() const { return m_retired.size(); }
+
+    private:
+        struct Retired
+        {
+            GpuTimeline::Value lastUseValue = 0u;
+            DestroyFunc destroyFunc;
+        };
+
+        void destroyUpTo(GpuTimeline::Value completedValue);
+
+        GpuTimeline& m_gpuTimeline;
+        // Destroyed in order, so an object retired with a smaller value than the one before it
+        // waits for that one.
+        std::deque<Retired> m_retired;
+    };
+}
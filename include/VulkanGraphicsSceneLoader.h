@@ -16,6 +16,11 @@ namespace vgfx
         std::unique_ptr<SceneNode> loadScene(
             const std::string& filePath);
 
+        // Finishes any asynchronous loads that are ready, call once per frame before rendering.
+        void update();
+
+        ModelLibrary& getModelLibrary() { return *m_spModelLibrary.get(); }
+
     private:
         Context& m_graphicsContext;
         std::unique_ptr<ModelLibrary> m_spModelLibrary;
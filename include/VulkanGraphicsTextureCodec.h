@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // CPU encoding and decoding of block compressed textures, and generation of mip chains. None
+    // of it uses the device, so it can be used by offline tools, e.g. the texture cooker.
+    namespace TextureCodec
+    {
+        // Decodes a single BC1-BC5 or BC7 block to 4x4 RGBA8 texels, row by row.
+        bool DecodeBlock(VkFormat format, const uint8_t* pBlock, uint8_t texelsOut[16][4]);
+
+        // Decodes a level of BC1-BC5 or BC7 blocks to tightly packed RGBA8 texels.
+        bool DecodeImage(
+            VkFormat format,
+            const uint8_t* pBlocks,
+            uint32_t width,
+            uint32_t height,
+            uint8_t* pRgba8Out);
+
+        // Encodes 4x4 RGBA8 texels to a BC1 block. Texels with alpha below 128 are encoded as
+        // transparent black, which requires a BC1_RGBA format to be sampled as such.
+        void EncodeBc1Block(const uint8_t texels[16][4], uint8_t* pBlockOut);
+
+        // Encodes 4x4 RGBA8 texels to a mode 6 (single subset, RGBA) BC7 block.
+        void EncodeBc7Block(const uint8_t texels[16][4], uint8_t* pBlockOut);
+
+        // Encodes a level of tightly packed RGBA8 texels to BC1 or BC7. The rows of blocks are
+        // split across threads, zero uses std::thread::hardware_concurrency().
+        bool EncodeImage(
+            VkFormat format,
+            const uint8_t* pRgba8,
+            uint32_t width,
+            uint32_t height,
+            uint32_t threadCount,
+            std::vector<uint8_t>* pBlocksOut);
+
+        enum class MipFilter
+        {
+            // 2x2 average.
+            Box,
+            // Kaiser windowed sinc, sharper than box but can ring at hard edges.
+            Kaiser
+        };
+
+        struct MipLevel
+        {
+            uint32_t width = 0u;
+            uint32_t height = 0u;
+            // Tightly packed RGBA8 texels.
+            std::vector<uint8_t> pixels;
+        };
+
+        // Generates the full mip chain of an RGBA8 image, level 0 is a copy of the image. Each
+        // level is filtered from the previous one at float precision. If the image is sRGB then
+        // its color channels are filtered in linear space. Box filtered UNORM images whose sides
+        // are powers of two are instead averaged in 8 bits, with the ImageKernels.
+        std::vector<MipLevel> GenerateMipChain(
+            const uint8_t* pRgba8,
+            uint32_t width,
+            uint32_t height,
+            MipFilter filter,
+            bool isSrgb);
+
+        // Peak signal to noise ratio in dB of the RGB channels, and the alpha channel if requested.
+        // Returns infinity if the images are identical.
+        double ComputePsnr(
+            const uint8_t* pRgba8,
+            const uint8_t* pReferenceRgba8,
+            size_t pixelCount,
+            bool includeAlpha);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsImage.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Loading of 2D textures for sampling. KTX2 and DDS containers are uploaded as is, including
+    // their block compressed (BC1-BC5, BC7, ASTC) payloads and prebuilt mip chains. Any other
+    // file is decoded to RGBA8 with stb_image.
+    namespace TextureFile
+    {
+        struct TextureData
+        {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            uint32_t width = 0u;
+            uint32_t height = 0u;
+            // Layers of a texture array (see TexturePacker), files always have one.
+            uint32_t layerCount = 1u;
+            // All mip levels, starting with the largest. Each level is tightly packed and starts at
+            // a 16 byte aligned offset, and holds the level of each layer one after the other.
+            std::vector<uint8_t> data;
+            std::vector<VkDeviceSize> mipLevelOffsets;
+
+            uint32_t getMipLevelCount() const { return static_cast<uint32_t>(mipLevelOffsets.size()); }
+        };
+
+        // Returns false if the format is not one that TextureFile can load.
+        bool GetFormatBlockInfo(
+            VkFormat format,
+            uint32_t* pBlockWidth,
+            uint32_t* pBlockHeight,
+            uint32_t* pBlockSizeBytes);
+
+        bool IsBlockCompressedFormat(VkFormat format);
+
+        VkDeviceSize ComputeMipLevelSizeBytes(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevel);
+
+        // Path of the file that the texture cooker writes for the file, i.e. with a .ktx2 extension.
+        std::string GetCookedFilePath(const std::string& filePath);
+
+        // Loads the file and, if the device can't sample its format, decodes it to RGBA8. If the
+        // file has been cooked then the cooked file is loaded instead, unless the file was
+        // modified after it was cooked, in which case a warning is printed.
+        bool Load(
+            Context& context,
+            const std::string& filePath,
+            TextureData* pTextureData,
+            std::string* pErr);
+
+        // Same as Load, for a file that has already been read into memory (e.g. embedded in a GLB).
+        bool LoadFromMemory(
+            Context& context,
+            const uint8_t* pFileData,
+            size_t fileSizeBytes,
+            TextureData* pTextureData,
+            std::string* pErr);
+
+        // Software decode of BC1-BC5 and BC7 to R8G8B8A8 (SRGB, UNORM or SNORM to match the source
+        // format), keeping all of the mip levels. Returns false for formats without a decoder.
+        bool DecodeToRgba8(const TextureData& compressed, TextureData* pDecoded);
+
+        // Drops the mip levels whose larger side is larger than maxSize, e.g. to stream in a lower
+        // resolution of the texture. A single level RGBA8 texture has its mip chain generated first
+        // (box filtered on the CPU). Returns false, leaving the texture unchanged, if it has no
+        // level that small, e.g. a block compressed texture without mip levels.
+        bool DropLevelsLargerThan(TextureData* pTextureData, uint32_t maxSize);
+
+        // Config for an image that the texture data can be copied into. If the texture is not block
+        // compressed and only has one level and layer then the rest of the mip chain is generated,
+        // otherwise the config's mip level offsets reference the texture's levels.
+        Image::Config CreateImageConfig(const TextureData& textureData);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "VulkanGraphicsTextureFile.h"
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vgfx
+{
+    // Packing of many small textures into fewer images, so that draws that only differ by their
+    // textures can share a descriptor set. Textures of the same format and size become the layers
+    // of a texture array, and small RGBA8 textures of any size are packed into the layers of an
+    // atlas. None of it uses the device.
+    namespace TexturePacker
+    {
+        struct Config
+        {
+            // Textures of the same format, size and mip level count are packed into an array when
+            // there are at least this many of them.
+            uint32_t minArrayLayerCount = 2u;
+            // No more than VkPhysicalDeviceLimits::maxImageArrayLayers.
+            uint32_t maxArrayLayerCount = 256u;
+            // RGBA8 textures that aren't packed into an array are packed into an atlas if neither
+            // side is larger than this.
+            uint32_t maxAtlasTextureSize = 256u;
+            // Width and height of each atlas layer.
+            uint32_t atlasSize = 1024u;
+            // Texels around each texture in an atlas that repeat its edges, a power of two. Atlases
+            // have log2(borderTexels) + 1 mip levels so that every level has a border, each level
+            // is filled from the texture's own level so that neighbors never bleed into it.
+            uint32_t borderTexels = 8u;
+        };
+
+        static constexpr uint32_t NotPacked = UINT32_MAX;
+
+        struct Placement
+        {
+            // Index of the packed texture, or NotPacked.
+            uint32_t packedTextureIndex = NotPacked;
+            uint32_t layer = 0u;
+            // Maps the texture's coordinates to the packed texture's: uv * uvScale + uvOffset.
+            glm::vec2 uvScale = glm::vec2(1.0f);
+            glm::vec2 uvOffset = glm::vec2(0.0f);
+        };
+
+        // Packs the textures into arrays and atlases, which have all of their mip levels. Each
+        // texture gets a placement, textures that weren't packed are left to be loaded on their own.
+        void Pack(
+            const std::vector<const TextureFile::TextureData*>& textures,
+            const Config& config,
+            std::vector<TextureFile::TextureData>* pPackedTexturesOut,
+            std::vector<Placement>* pPlacementsOut);
+    }
+}
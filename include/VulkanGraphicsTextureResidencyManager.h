@@ -0,0 +1,139 @@
+#pragma once
+
+#include "VulkanGraphicsAsyncImageLoader.h"
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsDrawable.h"
+#include "VulkanGraphicsImage.h"
+#include "VulkanGraphicsImageView.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Keeps the textures that are loaded by the AsyncImageLoader within a device memory budget.
+    // A texture's smallest mip levels are loaded first so that its drawables can be drawn right
+    // away. Then the larger levels are streamed in, up to the resolution that the drawables cover
+    // on screen. If the budget would be exceeded then the least recently drawn textures are evicted.
+    // If that isn't enough, the least recently drawn of the remaining textures are reduced to
+    // lower resolutions.
+    class TextureResidencyManager
+    {
+    public:
+        struct Config
+        {
+            // Device memory that the textures can use. Zero uses budgetFraction of VMA's budget
+            // for the device local heaps.
+            VkDeviceSize budgetBytes = 0u;
+            float budgetFraction = 0.5f;
+            // Largest side of the mip levels that are loaded first, textures are never reduced
+            // below this while they are drawn.
+            uint32_t initialMaxSize = 64u;
+            // Texels per pixel that a drawable covers on screen, e.g. 2 to oversample for
+            // textures that are tiled or only cover part of the drawable.
+            float texelsPerPixel = 1.0f;
+            // Loads that are requested per update, to spread the decoding over several frames.
+            uint32_t maxLoadsPerUpdate = 4u;
+        };
+
+        TextureResidencyManager(
+            Context& context,
+            AsyncImageLoader& imageLoader,
+            const Config& config = Config());
+
+        ~TextureResidencyManager() = default;
+
+        using TextureId = uint32_t;
+
+        // Returns the texture of the file, the first call for a file requests its initial levels.
+        TextureId getOrAddTexture(const std::string& path);
+
+        // View of the texture's resident levels, or of the loader's placeholder image if none are.
+        const ImageView& getImageView(TextureId textureId) const;
+
+        // The image sampler of the drawable's material is pointed at the texture's view whenever
+        // the texture's resident levels change. Drawables rewrite their descriptor sets each frame,
+        // so the new view is used starting with the next frame that is recorded.
+        void bindTexture(TextureId textureId, Drawable& drawable, ImageType imageType, size_t materialIndex);
+
+        // Called by Drawable::draw, marks the drawable's textures as used by the current frame.
+        void onDrawn(const Drawable& drawable, float screenSizePixels);
+
+        // Frees the images that are no longer in use, evicts or reduces textures if over budget,
+        // and requests the levels that drawn textures are missing. Call once per frame.
+        void update();
+
+        struct Stats
+        {
+            VkDeviceSize budgetBytes = 0u;
+            VkDeviceSize residentBytes = 0u;
+            uint32_t textureCount = 0u;
+            uint32_t residentTextureCount = 0u;
+            uint32_t evictedCount = 0u;
+            uint32_t reducedCount = 0u;
+            uint32_t streamedInCount = 0u;
+        };
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        struct Binding
+        {
+            Drawable* pDrawable = nullptr;
+            ImageType imageType = ImageType::Diffuse;
+            size_t materialIndex = 0u;
+        };
+
+        struct Texture
+        {
+            std::string path;
+            std::unique_ptr<Image> spImage;
+            const ImageView* pImageView = nullptr;
+            // Max size of the load that the resident image came from, zero if not resident. The
+            // image's level 0 may be smaller, since the file's levels need not be powers of two.
+            uint32_t residentMaxSize = 0u;
+            VkDeviceSize residentBytes = 0u;
+            // Size of the file's level 0, zero until the first load completes.
+            VkExtent2D fileExtent = {};
+            // Bytes of the resident image per texel of its level 0, i.e. including the smaller
+            // levels, to estimate the size of other loads.
+            double bytesPerTexel = 0.0;
+            bool isLoading = false;
+            uint32_t requestedMaxSize = 0u;
+            bool loadFailed = false;
+            uint64_t lastDrawnFrame = 0u;
+            // Largest size that the texture was drawn at during lastDrawnFrame, in texels.
+            uint32_t drawnSize = 0u;
+            std::vector<Binding> bindings;
+        };
+
+        const ImageView& getPlaceholderImageView() const;
+        VkDeviceSize computeBudgetBytes() const;
+        VkDeviceSize estimateBytes(const Texture& texture, uint32_t maxSize) const;
+        uint32_t computeTargetMaxSize(const Texture& texture) const;
+
+        void requestLoad(TextureId textureId, uint32_t maxSize);
+        void onLoaded(TextureId textureId, std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent);
+        void setImage(Texture& texture, std::unique_ptr<Image>&& spImage, uint32_t maxSize);
+        void retireImage(Texture& texture);
+        void updateBindings(const Texture& texture);
+
+        Context& m_context;
+        AsyncImageLoader& m_imageLoader;
+        Config m_config;
+
+        std::vector<Texture> m_textures;
+        std::unordered_map<std::string, TextureId> m_textureIds;
+        std::unordered_map<const Drawable*, std::vector<TextureId>> m_drawableTextures;
+
+        // Incremented at the end of each update(), so draws are counted against the frame that the
+        // following update() processes.
+        uint64_t m_frame = 1u;
+
+        Stats m_stats;
+    };
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include "VulkanGraphicsCommandBufferFactory.h"
+#include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsFence.h"
+#include "VulkanGraphicsGpuTimeline.h"
+#include "VulkanGraphicsImage.h"
+#include "VulkanGraphicsMemoryAllocator.h"
+#include "VulkanGraphicsOneTimeCommands.h"
+#include "VulkanGraphicsSemaphore.h"
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <vulkan/vulkan.h>
+
+namespace vgfx
+{
+    // Uploads data to buffers and images without waiting for the GPU. The data is copied to a
+    // persistently mapped staging ring, and the copies are recorded into the open batch, a single
+    // command buffer that flush() submits, tracked by the Context's GpuTimeline if it submits to
+    // the same queue, otherwise by a fence. A batch's staging space is reclaimed once it has
+    // completed. If the ring is full then the oldest batch is waited on, an upload
+    // that is larger than the whole ring is staged in a buffer of its own. Only use it from one
+    // thread, i.e. the render thread.
+    //
+    // If a dst command buffer factory of another queue family is provided, e.g. the copies are
+    // submitted to a dedicated transfer queue and the resources are used by the graphics queue,
+    // then each batch releases its resources to the dst family and signals a semaphore. acquire()
+    // submits the matching acquire barriers to the dst queue, waiting on the semaphores only at
+    // the stages that use the resources, so the copies overlap the rendering submitted before it.
+    class UploadManager
+    {
+    public:
+        struct Config
+        {
+            VkDeviceSize stagingRingSizeBytes = 64u * 1024u * 1024u;
+        };
+
+        UploadManager(
+            Context& context,
+            CommandBufferFactory& commandBufferFactory,
+            const Config& config = Config(),
+            CommandBufferFactory* pDstCommandBufferFactory = nullptr);
+
+        // Submits the open batch and waits for all of the batches to complete.
+        ~UploadManager();
+
+        // Identifies the batch that an upload was recorded into. Batches are numbered from 1 and
+        // complete in order, so an id also covers all of the uploads recorded before it.
+        using UploadId = uint64_t;
+
+        // Stages the data and records its copy to the buffer. The buffer must not be destroyed
+        // until the upload has completed.
+        UploadId uploadToBuffer(
+            const MemoryAllocator::Buffer& buffer,
+            const void* pData,
+            VkDeviceSize dataSizeBytes,
+            VkDeviceSize dstOffsetBytes = 0u);
+
+        // Stages the data and records its copy to the image, see
+        // OneTimeCommandsHelper::RecordCopyBufferToImageCommands. If the resources are released
+        // to another family then the mip levels are blitted by the dst queue when it acquires it.
+        UploadId uploadToImage(
+            const Image& image,
+            const void* pData,
+            VkDeviceSize dataSizeBytes,
+            OneTimeCommandsHelper::GenerateMips genMips,
+            const std::vector<VkDeviceSize>& mipLevelOffsets = {});
+
+        // Records commands that use the batch's resources, e.g. to generate mip levels. They are
+        // recorded into the open batch after its copies, or if the resources are released to
+        // another family, when the dst queue acquires them, so anything that they reference must
+        // remain valid until then.
+        UploadId recordCommands(const OneTimeCommandsRunner::RecordCommandsFunc& recordFunc);
+
+        // Submits the open batch if anything was recorded into it, after reclaiming the resources
+        // of the batches and acquisitions that have completed, without waiting. Returns the id of
+        // the last batch that was submitted, zero if there is none.
+        UploadId flush();
+
+        // Submits the acquisition of the resources of the submitted batches up to the id to the
+        // dst queue, so that work submitted to it afterwards can use them. Does nothing unless the
+        // resources are released to another family.
+        void acquire(UploadId uploadId);
+
+        // Returns true if the batch has completed and its resources can be used by the dst queue,
+        // and reclaims the staging space of any completed batches. Batches whose copies have
+        // completed are acquired.
+        bool isComplete(UploadId uploadId);
+
+        // Submits the batch if it is still open, and waits for it to complete.
+        void wait(UploadId uploadId);
+
+        const CommandQueue& getCommandQueue() const { return m_commandQueue; }
+
+        // Queue that uses the uploaded resources, the same as getCommandQueue() unless a dst
+        // command buffer factory was provided.
+        const CommandQueue& getDstCommandQueue() const { return m_dstCommandQueue; }
+
+        bool releasesToDstQueueFamily() const { return m_pDstCommandBufferFactory != nullptr; }
+
+        struct Stats
+        {
+            uint32_t batchCount = 0u;
+            uint32_t uploadCount = 0u;
+            uint64_t uploadedBytes = 0u;
+            // Uploads that waited for a batch to complete to free ring space.
+            uint32_t stagingStallCount = 0u;
+            // Uploads too large for the ring.
+            uint32_t dedicatedStagingCount = 0u;
+            // Submissions of acquire barriers to the dst queue.
+            uint32_t acquireCount = 0u;
+        };
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        // Tracks a submission with the Context's GpuTimeline if it is of the submission's queue,
+        // otherwise with a fence.
+        struct Submission
+        {
+            std::unique_ptr<Fence> spFence;
+            GpuTimeline::Value timelineValue = 0u;
+        };
+
+        // Ownership transfer of a batch's resources, recorded as release barriers by the batch
+        // and as acquire barriers by the dst queue.
+        struct OwnershipTransfer
+        {
+            UploadId id = 0u;
+            std::unique_ptr<Semaphore> spSemaphore;
+            std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            std::vector<VkImageMemoryBarrier> imageBarriers;
+            std::vector<OneTimeCommandsRunner::RecordCommandsFunc> recordFuncs;
+        };
+
+        struct Batch
+        {
+            UploadId id = 0u;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            Submission submission;
+            // Ring head when the batch was submitted, and the ring bytes that it used, including
+            // any skipped at the end of the ring when it wrapped.
+            VkDeviceSize ringEnd = 0u;
+            VkDeviceSize ringBytes = 0u;
+            std::vector<MemoryAllocator::Buffer> dedicatedStagingBuffers;
+            OwnershipTransfer ownershipTransfer;
+        };
+
+        // Acquisition of the ownership transfers of one or more batches, up to id.
+        struct AcquireBatch
+        {
+            UploadId id = 0u;
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            Submission submission;
+            std::vector<std::unique_ptr<Semaphore>> semaphores;
+        };
+
+        VkCommandBuffer getOpenCommandBuffer();
+        void stage(const void* pData, VkDeviceSize dataSizeBytes, VkBuffer* pStagingBuffer, VkDeviceSize* pStagingOffset);
+        bool allocateFromRing(VkDeviceSize sizeBytes, VkDeviceSize* pOffset);
+        void submit(const CommandQueue& commandQueue, const VkSubmitInfo& submitInfo, Submission* pSubmission);
+        bool isSubmissionComplete(Submission& submission, bool wait);
+        void retireBatches(bool waitForOldest);
+        void retireAcquireBatches(bool waitForOldest);
+
+        Context& m_context;
+        CommandBufferFactory& m_commandBufferFactory;
+        CommandQueue m_commandQueue;
+        CommandBufferFactory* m_pDstCommandBufferFactory = nullptr;
+        CommandQueue m_dstCommandQueue;
+        Config m_config;
+        VkDeviceSize m_stagingAlignment = 16u;
+
+        // Created by the first upload.
+        MemoryAllocator::Buffer m_stagingRing;
+        uint8_t* m_pStagingRingData = nullptr;
+        VkDeviceSize m_ringHead = 0u;
+        VkDeviceSize m_ringTail = 0u;
+        VkDeviceSize m_ringUsedBytes = 0u;
+
+        Batch m_openBatch;
+        std::deque<Batch> m_submittedBatches;
+        // Last batch whose copies have completed.
+        UploadId m_copiedId = 0u;
+
+        std::deque<OwnershipTransfer> m_pendingOwnershipTransfers;
+        std::deque<AcquireBatch> m_submittedAcquireBatches;
+
+        std::vector<std::unique_ptr<Fence>> m_freeFences;
+        std::vector<std::unique_ptr<Semaphore>> m_freeSemaphores;
+        // Last batch that can be used by the dst queue.
+        UploadId m_completedId = 0u;
+
+        Stats m_stats;
+    };
+}
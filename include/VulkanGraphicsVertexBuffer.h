@@ -14,6 +14,9 @@
 
 namespace vgfx
 {
+    class GeometryArena;
+    class GeometryRange;
+
     class VertexBuffer
     {
     public:
@@ -65,22 +68,44 @@ namespace vgfx
             const VertexData* pVertexData,
             size_t vertexDataSizeBytes);
 
+        // Suballocates the vertices from the GeometryArena's buffer for the vertex layout, the
+        // arena must outlive the VertexBuffer. If pVertexData is null then the vertices are
+        // written afterwards with writeVertices.
+        VertexBuffer(
+            GeometryArena& geometryArena,
+            const Config& config,
+            const VertexData* pVertexData,
+            size_t vertexDataSizeBytes);
+
         ~VertexBuffer() {
             destroy();
         }
 
         const Config& getConfig() const { return m_config; }
 
-        VkBuffer getHandle() { return m_buffer.handle; }
+        // Copies vertices into a VertexBuffer that was suballocated from a GeometryArena.
+        void writeVertices(
+            const VertexData* pVertexData,
+            uint32_t firstVertex,
+            uint32_t vertexCount);
+
+        VkBuffer getHandle();
+
+        // Offset of this buffer's first vertex within the buffer returned by getHandle(), which is
+        // non-zero if the vertices are suballocated from a GeometryArena.
+        int32_t getFirstVertex() const;
 
     private:
         void destroy();
 
-        Context& m_context;
+        Context* m_pContext = nullptr;
 
         Config m_config;
 
         MemoryAllocator::Buffer m_buffer;
+
+        GeometryArena* m_pGeometryArena = nullptr;
+        GeometryRange* m_pGeometryRange = nullptr;
     };
 
     struct VertexXyzRgbUv
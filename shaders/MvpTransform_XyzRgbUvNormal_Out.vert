@@ -1,13 +1,16 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+// Matches vgfx::MeshEffectPushConstants.
 layout(push_constant) uniform PushParams {
     mat4 world;
-    mat4 view;
+    vec4 uvScaleOffset;
+    uint textureLayer;
 } push;
 
 layout(set = 0, binding = 0) uniform UniformParams {
     mat4 proj;
+    mat4 view;
 } ubo;
 
 layout(location = 0) in vec3 inPosition;
@@ -19,16 +22,20 @@ layout(location = 0) out vec3 fragPos;
 layout(location = 1) out vec3 fragColor;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out vec3 fragNormal;
+layout(location = 4) flat out vec4 fragUvScaleOffset;
+layout(location = 5) flat out uint fragTextureLayer;
 
 void main()
 {
     fragColor = inColor;
 
     fragTexCoord = inTexCoord;
+    fragUvScaleOffset = push.uvScaleOffset;
+    fragTextureLayer = push.textureLayer;
 
     mat4 normalTransform = transpose(inverse(push.world));
     fragNormal = (normalTransform * vec4(inNormal, 0.0)).xyz;
 
     fragPos = (push.world * vec4(inPosition, 1.0)).xyz;
-    gl_Position = ubo.proj * push.view * vec4(fragPos, 1.0);
+    gl_Position = ubo.proj * ubo.view * vec4(fragPos, 1.0);
 }
@@ -1,7 +1,8 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-layout(set = 1, binding = 0) uniform sampler2D texSampler;
+// Every texture is viewed as an array, packed textures are a layer or a region of a layer.
+layout(set = 1, binding = 0) uniform sampler2DArray texSampler;
 
 struct Light
 {
@@ -22,12 +23,23 @@ layout(location = 0) in vec3 fragPos;
 layout(location = 1) in vec3 fragColor;
 layout(location = 2) in vec2 fragTexCoord;
 layout(location = 3) in vec3 fragNormal;
+layout(location = 4) flat in vec4 fragUvScaleOffset;
+layout(location = 5) flat in uint fragTextureLayer;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-    vec3 inColor  = texture(texSampler, fragTexCoord).rgb;
+    // Atlas regions repeat within themselves rather than sampling their neighbors. The gradients
+    // of the unwrapped coordinates select the mip level, so it doesn't jump where they wrap.
+    vec2 texCoord = fragTexCoord;
+    if (fragUvScaleOffset != vec4(1.0, 1.0, 0.0, 0.0)) {
+        texCoord = fract(texCoord);
+    }
+    texCoord = texCoord * fragUvScaleOffset.xy + fragUvScaleOffset.zw;
+    vec2 texCoordDx = dFdx(fragTexCoord) * fragUvScaleOffset.xy;
+    vec2 texCoordDy = dFdy(fragTexCoord) * fragUvScaleOffset.xy;
+    vec3 inColor  = textureGrad(texSampler, vec3(texCoord, float(fragTextureLayer)), texCoordDx, texCoordDy).rgb;
 
     inColor *= fragColor;
     
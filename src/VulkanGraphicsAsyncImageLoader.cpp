@@ -0,0 +1,343 @@
+#include "VulkanGraphicsAsyncImageLoader.h"
+
+#include "VulkanGraphicsOneTimeCommands.h"
+
+#include <algorithm>
+
+namespace vgfx
+{
+    static float ToMilliseconds(std::chrono::steady_clock::duration duration)
+    {
+        return std::chrono::duration<float, std::milli>(duration).count();
+    }
+
+    AsyncImageLoader::AsyncImageLoader(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        const Config& config)
+        : m_context(context)
+        , m_commandBufferFactory(commandBufferFactory)
+        , m_config(config)
+    {
+        // Room for the batches in flight, plus one for the space skipped when the ring wraps.
+        UploadManager::Config uploadConfig;
+        uploadConfig.stagingRingSizeBytes =
+            m_config.maxUploadBytesPerUpdate * (static_cast<VkDeviceSize>(m_config.maxBatchesInFlight) + 1u);
+        // The copies run on the transfer queue if there is one, and are acquired by the queue of
+        // the command buffer factory once they have completed.
+        CommandBufferFactory* pTransferCommandBufferFactory = m_context.getOrCreateTransferCommandBufferFactory();
+        if (pTransferCommandBufferFactory != nullptr) {
+            m_spUploadManager =
+                std::make_unique<UploadManager>(
+                    m_context,
+                    *pTransferCommandBufferFactory,
+                    uploadConfig,
+                    &m_commandBufferFactory);
+        } else {
+            m_spUploadManager = std::make_unique<UploadManager>(m_context, m_commandBufferFactory, uploadConfig);
+        }
+
+        createPlaceholderImage();
+
+        uint32_t workerThreadCount = m_config.workerThreadCount;
+        if (workerThreadCount == 0u) {
+            // Leave a core for the render thread.
+            uint32_t coreCount = std::thread::hardware_concurrency();
+            workerThreadCount = coreCount > 1u ? coreCount - 1u : 1u;
+        }
+
+        m_workers.reserve(workerThreadCount);
+        for (uint32_t i = 0u; i < workerThreadCount; ++i) {
+            m_workers.emplace_back([this]() { runWorker(); });
+        }
+    }
+
+    AsyncImageLoader::~AsyncImageLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            m_stopWorkers = true;
+        }
+        m_decodeCondition.notify_all();
+
+        for (auto& worker : m_workers) {
+            worker.join();
+        }
+
+        // The images of submitted batches must outlive the GPU's use of them.
+        completeBatches(true);
+    }
+
+    void AsyncImageLoader::createPlaceholderImage()
+    {
+        const uint32_t whitePixel = 0xFFFFFFFFu;
+
+        Image::Config imageConfig(
+            1u,
+            1u,
+            VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_TILING_OPTIMAL,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+        m_spPlaceholderImage =
+            std::make_unique<Image>(
+                m_context,
+                m_commandBufferFactory,
+                imageConfig,
+                &whitePixel,
+                sizeof(whitePixel));
+    }
+
+    void AsyncImageLoader::loadImage(const std::string& path, OnLoadedFunc onLoadedFunc)
+    {
+        loadImageLevels(
+            path,
+            0u, // all levels
+            [onLoadedFunc](std::unique_ptr<Image>&& spImage, VkExtent2D) {
+                if (onLoadedFunc != nullptr) {
+                    onLoadedFunc(std::move(spImage));
+                }
+            });
+    }
+
+    void AsyncImageLoader::loadImageLevels(const std::string& path, uint32_t maxSize, OnLevelsLoadedFunc onLoadedFunc)
+    {
+        uint64_t requestId = m_nextRequestId++;
+        m_callbacks[requestId] = onLoadedFunc;
+        ++m_outstandingRequestCount;
+        ++m_stats.requestedCount;
+
+        {
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            DecodeRequest request;
+            request.requestId = requestId;
+            request.path = path;
+            request.maxSize = maxSize;
+            m_decodeQueue.emplace_back(std::move(request));
+        }
+        m_decodeCondition.notify_one();
+    }
+
+    void AsyncImageLoader::runWorker()
+    {
+        while (true) {
+            DecodeRequest request;
+            {
+                std::unique_lock<std::mutex> lock(m_decodeMutex);
+                m_decodeCondition.wait(lock, [this]() { return m_stopWorkers || !m_decodeQueue.empty(); });
+                if (m_stopWorkers) {
+                    return;
+                }
+
+                request = std::move(m_decodeQueue.front());
+                m_decodeQueue.pop_front();
+            }
+
+            DecodedImage decodedImage;
+            decodedImage.requestId = request.requestId;
+            decodedImage.path = std::move(request.path);
+
+            std::string err;
+            if (!TextureFile::Load(m_context, decodedImage.path, &decodedImage.textureData, &err)) {
+                decodedImage.textureData.data.clear();
+            } else {
+                decodedImage.fileExtent = { decodedImage.textureData.width, decodedImage.textureData.height };
+                if (request.maxSize != 0u) {
+                    // Textures without a level that small are loaded as is.
+                    TextureFile::DropLevelsLargerThan(&decodedImage.textureData, request.maxSize);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            m_decodedImages.emplace_back(std::move(decodedImage));
+        }
+    }
+
+    void AsyncImageLoader::update()
+    {
+        auto updateStartTime = std::chrono::steady_clock::now();
+        if (m_hasLastUpdateTime && isLoading()) {
+            m_frameTimesMs.push_back(ToMilliseconds(updateStartTime - m_lastUpdateTime));
+        }
+        m_lastUpdateTime = updateStartTime;
+        m_hasLastUpdateTime = true;
+
+        completeBatches(false);
+
+        {
+            std::lock_guard<std::mutex> lock(m_decodeMutex);
+            for (auto& decodedImage : m_decodedImages) {
+                m_pendingUploads.emplace_back(std::move(decodedImage));
+            }
+            m_decodedImages.clear();
+        }
+
+        // Failed decodes don't need to wait for an upload.
+        auto failedIt =
+            std::stable_partition(
+                m_pendingUploads.begin(),
+                m_pendingUploads.end(),
+                [](const DecodedImage& decodedImage) { return !decodedImage.textureData.data.empty(); });
+        for (auto it = failedIt; it != m_pendingUploads.end(); ++it) {
+            ++m_stats.failedCount;
+            invokeCallback(it->requestId, nullptr, it->fileExtent);
+        }
+        m_pendingUploads.erase(failedIt, m_pendingUploads.end());
+
+        if (!m_pendingUploads.empty() && m_batchesInFlight.size() < m_config.maxBatchesInFlight) {
+            // Always take at least one image so that images larger than the budget still load.
+            VkDeviceSize batchSizeBytes = 0u;
+            size_t batchImageCount = 0u;
+            while (batchImageCount < m_pendingUploads.size()) {
+                const auto& decodedImage = m_pendingUploads[batchImageCount];
+                VkDeviceSize imageSizeBytes = decodedImage.textureData.data.size();
+                if (batchImageCount > 0u && batchSizeBytes + imageSizeBytes > m_config.maxUploadBytesPerUpdate) {
+                    break;
+                }
+                batchSizeBytes += imageSizeBytes;
+                ++batchImageCount;
+            }
+
+            std::vector<DecodedImage> batchImages;
+            batchImages.reserve(batchImageCount);
+            for (size_t i = 0u; i < batchImageCount; ++i) {
+                batchImages.emplace_back(std::move(m_pendingUploads[i]));
+            }
+            m_pendingUploads.erase(m_pendingUploads.begin(), m_pendingUploads.begin() + batchImageCount);
+
+            submitBatch(batchImages);
+        }
+
+        float updateTimeMs = ToMilliseconds(std::chrono::steady_clock::now() - updateStartTime);
+        m_stats.maxUpdateTimeMs = std::max(m_stats.maxUpdateTimeMs, updateTimeMs);
+    }
+
+    void AsyncImageLoader::submitBatch(std::vector<DecodedImage>& decodedImages)
+    {
+        // Emplaced first, the downsampler's commands may be recorded when the batch is acquired,
+        // and a deque doesn't move its elements when others are added or removed at its ends.
+        UploadBatch& batch = m_batchesInFlight.emplace_back();
+
+        ImageDownsampler* pDownsampler =
+            m_context.isImageDownsamplerSupported() ? &m_context.getOrCreateImageDownsampler() : nullptr;
+        std::vector<const Image*> imagesToDownsample;
+        for (auto& decodedImage : decodedImages) {
+            Image::Config imageConfig = TextureFile::CreateImageConfig(decodedImage.textureData);
+            auto spImage = std::make_unique<Image>(m_context, imageConfig);
+
+            // Textures that provide their own mip levels are copied level by level, the others
+            // have their mip levels generated, by the downsampler if it can.
+            OneTimeCommandsHelper::GenerateMips genMips = OneTimeCommandsHelper::GenerateMips::No;
+            if (imageConfig.mipLevelOffsets.empty()) {
+                if (pDownsampler != nullptr && pDownsampler->canDownsample(*spImage.get())) {
+                    imagesToDownsample.push_back(spImage.get());
+                } else {
+                    genMips = OneTimeCommandsHelper::GenerateMips::Yes;
+                }
+            }
+
+            // Staged at an offset aligned to at least 16 bytes, and the mip levels are 16 byte
+            // aligned within it, which satisfies the texel and block size alignment that
+            // vkCmdCopyBufferToImage requires.
+            m_spUploadManager->uploadToImage(
+                *spImage.get(),
+                decodedImage.textureData.data.data(),
+                decodedImage.textureData.data.size(),
+                genMips,
+                decodedImage.textureData.mipLevelOffsets);
+            m_stats.uploadedBytes += decodedImage.textureData.data.size();
+
+            // Release the decoded data now rather than when the batch completes.
+            decodedImage.textureData.data = std::vector<uint8_t>();
+
+            LoadedImage loadedImage;
+            loadedImage.requestId = decodedImage.requestId;
+            loadedImage.spImage = std::move(spImage);
+            loadedImage.fileExtent = decodedImage.fileExtent;
+            batch.images.emplace_back(std::move(loadedImage));
+        }
+
+        // All of the batch's images are downsampled together, without barriers between them.
+        if (!imagesToDownsample.empty()) {
+            m_spUploadManager->recordCommands(
+                [&batch, pDownsampler, imagesToDownsample](VkCommandBuffer commandBuffer) {
+                    batch.spDownsamplerBatch = pDownsampler->recordCommands(commandBuffer, imagesToDownsample);
+                });
+        }
+
+        batch.uploadId = m_spUploadManager->flush();
+        ++m_stats.batchCount;
+    }
+
+    void AsyncImageLoader::completeBatches(bool waitForCompletion)
+    {
+        // Batches are submitted to a single queue, so they complete in order.
+        while (!m_batchesInFlight.empty()) {
+            UploadBatch& batch = m_batchesInFlight.front();
+            if (waitForCompletion) {
+                m_spUploadManager->wait(batch.uploadId);
+            } else if (!m_spUploadManager->isComplete(batch.uploadId)) {
+                break;
+            }
+
+            if (!waitForCompletion) {
+                for (auto& loadedImage : batch.images) {
+                    ++m_stats.loadedCount;
+                    invokeCallback(loadedImage.requestId, std::move(loadedImage.spImage), loadedImage.fileExtent);
+                }
+            }
+
+            m_batchesInFlight.pop_front();
+        }
+    }
+
+    void AsyncImageLoader::invokeCallback(uint64_t requestId, std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent)
+    {
+        auto findIt = m_callbacks.find(requestId);
+        if (findIt == m_callbacks.end()) {
+            return;
+        }
+
+        OnLevelsLoadedFunc onLoadedFunc = std::move(findIt->second);
+        m_callbacks.erase(findIt);
+        --m_outstandingRequestCount;
+
+        if (onLoadedFunc != nullptr) {
+            onLoadedFunc(std::move(spImage), fileExtent);
+        }
+    }
+
+    AsyncImageLoader::Stats AsyncImageLoader::getStats() const
+    {
+        Stats stats = m_stats;
+        if (m_frameTimesMs.empty()) {
+            return stats;
+        }
+
+        std::vector<float> sortedFrameTimesMs = m_frameTimesMs;
+        std::sort(sortedFrameTimesMs.begin(), sortedFrameTimesMs.end());
+
+        size_t frameCount = sortedFrameTimesMs.size();
+        stats.frameCount = static_cast<uint32_t>(frameCount);
+        stats.medianFrameTimeMs = sortedFrameTimesMs[frameCount / 2u];
+        stats.p99FrameTimeMs = sortedFrameTimesMs[std::min(frameCount - 1u, (frameCount * 99u) / 100u)];
+        stats.maxFrameTimeMs = sortedFrameTimesMs.back();
+
+        float spikeThresholdMs = stats.medianFrameTimeMs * m_config.frameSpikeFactor;
+        stats.frameSpikeCount =
+            static_cast<uint32_t>(
+                std::count_if(
+                    sortedFrameTimesMs.begin(),
+                    sortedFrameTimesMs.end(),
+                    [spikeThresholdMs](float frameTimeMs) { return frameTimeMs > spikeThresholdMs; }));
+
+        return stats;
+    }
+
+    void AsyncImageLoader::resetFrameTimes()
+    {
+        m_frameTimesMs.clear();
+        m_stats.maxUpdateTimeMs = 0.0f;
+        m_hasLastUpdateTime = false;
+    }
+}
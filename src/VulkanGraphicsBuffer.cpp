@@ -19,6 +19,21 @@ namespace vgfx
         }
     }
 
+    static VkBufferUsageFlags GetBufferUsage(Context& context, Buffer::Type type)
+    {
+        VkBufferUsageFlags usage = TypeToUsage(type);
+        if (context.areDescriptorBuffersEnabled()) {
+            // Descriptors written to descriptor buffers refer to the buffer by its address.
+            usage |= VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+        }
+        return usage;
+    }
+
+    static const char* GetBufferName(const Buffer::Config& config)
+    {
+        return config.bufferName.empty() ? nullptr : config.bufferName.c_str();
+    }
+
     Buffer::Buffer(
         Context& context,
         Type type,
@@ -27,15 +42,13 @@ namespace vgfx
         , m_context(context)
         , m_bufferSize(config.bufferSize)
     {
-        const char* pBufferName = nullptr;
-        if (!config.bufferName.empty()) {
-            pBufferName = config.bufferName.c_str();
-        }
+        const char* pBufferName = GetBufferName(config);
+        VkBufferUsageFlags usage = GetBufferUsage(context, type);
         if (config.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
             m_buffer =
                 context.getMemoryAllocator().createBuffer(
                     config.bufferSize,
-                    TypeToUsage(type),
+                    usage,
                     config.memoryUsage,
                     pBufferName);
         } else {
@@ -43,7 +56,7 @@ namespace vgfx
             m_buffer =
                 context.getMemoryAllocator().createSharedBuffer(
                     config.bufferSize,
-                    TypeToUsage(type),
+                    usage,
                     config.queueFamilyIndices,
                     config.memoryUsage,
                     pBufferName);
@@ -54,14 +67,48 @@ namespace vgfx
         m_bufferInfo.range = getSize();
     }
 
+    Buffer::Buffer(
+        Context& context,
+        Type type,
+        const Config& config,
+        uint32_t transientPoolIndex)
+        : DescriptorUpdater(static_cast<VkDescriptorType>(type))
+        , m_context(context)
+        , m_bufferSize(config.bufferSize)
+        , m_isTransient(true)
+    {
+        m_buffer =
+            context.getMemoryAllocator().createTransientBuffer(
+                transientPoolIndex,
+                config.bufferSize,
+                GetBufferUsage(context, type),
+                GetBufferName(config));
+        m_pMappedPtr = static_cast<uint8_t*>(m_buffer.pMappedData);
+
+        m_bufferInfo.buffer = getHandle();
+        m_bufferInfo.offset = 0;
+        m_bufferInfo.range = getSize();
+    }
+
     void Buffer::destroy()
     {
+        if (m_isTransient) {
+            // Owned by the transient pool, which destroys it when it is reset.
+            m_buffer = MemoryAllocator::Buffer();
+            m_pMappedPtr = nullptr;
+            return;
+        }
         if (m_buffer.isValid()) {
             if (m_pMappedPtr != nullptr) {
                 m_context.getMemoryAllocator().unmapBuffer(m_buffer);
                 m_pMappedPtr = nullptr;
             }
-            m_context.getMemoryAllocator().destroyBuffer(m_buffer);
+            // Frames in flight may still read it.
+            MemoryAllocator& memoryAllocator = m_context.getMemoryAllocator();
+            m_context.retire([&memoryAllocator, buffer = m_buffer]() mutable {
+                memoryAllocator.destroyBuffer(buffer);
+            });
+            m_buffer = MemoryAllocator::Buffer();
         }
     }
 }
@@ -6,37 +6,28 @@ namespace vgfx
 {
     Camera::Camera(
         Context& context,
-        const VkViewport& viewport,
-        size_t framesInFlightPlusOne)
-        : m_currentBufferIndex(framesInFlightPlusOne - 1u)
-        , m_projBufferNeedsUpdateCount(framesInFlightPlusOne)
+        const VkViewport& viewport)
+        : m_context(context)
         , m_rasterizerConfig({
             VK_POLYGON_MODE_FILL,
             VK_CULL_MODE_BACK_BIT,
             VK_FRONT_FACE_COUNTER_CLOCKWISE })
         , m_viewport(viewport)
     {
-        Buffer::Config cameraMatrixBufferCfg(sizeof(glm::mat4));
-        // Need one buffer each for each frame in flight and one for the current frame
-        for (uint32_t index = 0; index < framesInFlightPlusOne; ++index) {
-            m_cameraMatrixBuffers.emplace_back(
-                std::make_unique<Buffer>(
-                    context,
-                    Buffer::Type::UniformBuffer,
-                    cameraMatrixBufferCfg));
-        }
     }
 
-    void Camera::update()
+    void Camera::update(uint32_t transientPoolIndex)
     {
-        ++m_currentBufferIndex;
-        if (m_currentBufferIndex == m_cameraMatrixBuffers.size()) {
-            m_currentBufferIndex = 0u;
-        }
-        if (m_projBufferNeedsUpdateCount > 0) {
-            --m_projBufferNeedsUpdateCount;
-            auto& currentBuffer = *m_cameraMatrixBuffers[m_currentBufferIndex];
-            currentBuffer.update(&m_proj, sizeof(glm::mat4), 0u, Buffer::MemMap::LeaveMapped);
-        }
+        // The projection matrix followed by the view matrix. The previous frame's buffer belongs to
+        // its own pool, which frees it once that frame's resources are reused.
+        Buffer::Config cameraMatrixBufferCfg(2u * sizeof(glm::mat4));
+        m_spCameraMatrixBuffer =
+            std::make_unique<Buffer>(
+                m_context,
+                Buffer::Type::UniformBuffer,
+                cameraMatrixBufferCfg,
+                transientPoolIndex);
+        m_spCameraMatrixBuffer->update(&m_proj, sizeof(glm::mat4), 0u);
+        m_spCameraMatrixBuffer->update(&m_view, sizeof(glm::mat4), sizeof(glm::mat4));
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,7 @@
 #include "VulkanGraphicsCommandBufferFactory.h"
 
 #include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsHostAllocator.h"
 
 #include <stdexcept>
 
@@ -17,6 +18,7 @@ namespace vgfx
         poolInfo.queueFamilyIndex = m_commandQueue.queueFamilyIndex;
         poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_COMMAND_POOL);
         VkResult result =
             vkCreateCommandPool(
                 context.getLogicalDevice(),
@@ -47,6 +49,7 @@ namespace vgfx
         allocInfo.commandBufferCount = 1;
 
         VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_COMMAND_POOL);
         VkResult result = vkAllocateCommandBuffers(m_context.getLogicalDevice(), &allocInfo, &commandBuffer);
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to allocated command buffer from CommandBufferFactory!");
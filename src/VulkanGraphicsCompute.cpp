@@ -1,5 +1,7 @@
 #include "VulkanGraphicsCompute.h"
 
+#include "VulkanGraphicsHostAllocator.h"
+
 #include <stdexcept>
 
 namespace vgfx
@@ -41,6 +43,7 @@ namespace vgfx
         }
         pipelineLayoutCreateInfo.pSetLayouts = descriptorSetLayouts.data();
 
+        HostAllocator::ObjectTypeScope layoutObjectTypeScope(VK_OBJECT_TYPE_PIPELINE_LAYOUT);
         VkResult result =
             vkCreatePipelineLayout(
                 context.getLogicalDevice(),
@@ -67,6 +70,7 @@ namespace vgfx
         pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
         pipelineCreateInfo.basePipelineIndex = 0;
 
+        HostAllocator::ObjectTypeScope pipelineObjectTypeScope(VK_OBJECT_TYPE_PIPELINE);
         result = vkCreateComputePipelines(
             context.getLogicalDevice(),
             VK_NULL_HANDLE,
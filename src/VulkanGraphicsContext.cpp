@@ -3,9 +3,14 @@
 //
 #include "VulkanGraphicsContext.h"
 
+#include "VulkanGraphicsDefragmenter.h"
+#include "VulkanGraphicsGpuTimeline.h"
+#include "VulkanGraphicsHostAllocator.h"
 #include "VulkanGraphicsImageDownsampler.h"
 #include "VulkanGraphicsRenderer.h"
 #include "VulkanGraphicsRenderTarget.h"
+#include "VulkanGraphicsRetirementQueue.h"
+#include "VulkanGraphicsUploadManager.h"
 
 #include <exception>
 #include <iostream>
@@ -24,6 +29,8 @@ namespace vgfx
         Renderer& renderer)
     {
         m_appConfig = appConfig;
+        m_pAllocationCallbacks =
+            appConfig.pHostAllocator != nullptr ? appConfig.pHostAllocator->getCallbacks() : nullptr;
 
         createInstance(
             appConfig,
@@ -39,6 +46,11 @@ namespace vgfx
 
         createLogicalDevice(deviceConfig);
 
+        if (m_timelineSemaphoresAreSupported && hasGraphicsQueueFamily()) {
+            m_spGpuTimeline.reset(new GpuTimeline(*this, getGraphicsQueue(0u)));
+            m_spRetirementQueue.reset(new RetirementQueue(*m_spGpuTimeline));
+        }
+
         m_memoryAllocator.init(
             VK_MAKE_VERSION(
                 appConfig.majorVersion,
@@ -53,6 +65,15 @@ namespace vgfx
     {
         waitForDeviceToIdle();
 
+        // Ends its pass, which needs the timeline and the allocator.
+        m_spDefragmenter.reset();
+        // Frees its staging buffers.
+        m_spUploadManager.reset();
+        m_spTransferCommandBufferFactory.reset();
+        // Objects that are destroyed after this are destroyed immediately.
+        m_spRetirementQueue.reset();
+        m_spGpuTimeline.reset();
+
         m_memoryAllocator.shutdown();
 
         disableDebugReportCallback();
@@ -66,12 +87,26 @@ namespace vgfx
             vkDestroyInstance(m_instance, m_pAllocationCallbacks);
             m_instance = VK_NULL_HANDLE;
         }
+
+        m_pAllocationCallbacks = nullptr;
     }
 
     void Context::waitForDeviceToIdle()
     {
         if (m_device != VK_NULL_HANDLE) {
             vkDeviceWaitIdle(m_device);
+            if (m_spRetirementQueue != nullptr) {
+                m_spRetirementQueue->collect();
+            }
+        }
+    }
+
+    void Context::retire(std::function<void()>&& destroyFunc)
+    {
+        if (m_spRetirementQueue != nullptr) {
+            m_spRetirementQueue->retire(std::move(destroyFunc));
+        } else {
+            destroyFunc();
         }
     }
 
@@ -95,7 +130,7 @@ namespace vgfx
 
     ImageDownsampler& Context::getOrCreateImageDownsampler()
     {
-        assert(m_shaderSubgroupsAreSupported && m_descriptorIndexingIsSupported);
+        assert(isImageDownsamplerSupported());
 
         if (m_spImageDownsampler == nullptr) {
             m_spImageDownsampler.reset(new ImageDownsampler(
@@ -107,6 +142,44 @@ namespace vgfx
         return *m_spImageDownsampler.get();
     }
 
+    CommandBufferFactory* Context::getOrCreateTransferCommandBufferFactory()
+    {
+        if (m_spTransferCommandBufferFactory == nullptr
+            && m_queueFamilyIndices.transferFamily.has_value()
+            && m_queueFamilyIndices.transferFamily != m_queueFamilyIndices.graphicsFamily) {
+            m_spTransferCommandBufferFactory.reset(new CommandBufferFactory(*this, getDedicatedTransferQueue(0u)));
+        }
+        return m_spTransferCommandBufferFactory.get();
+    }
+
+    UploadManager& Context::getOrCreateUploadManager()
+    {
+        if (m_spUploadManager == nullptr) {
+            CommandBufferFactory* pTransferCommandBufferFactory = getOrCreateTransferCommandBufferFactory();
+            if (pTransferCommandBufferFactory != nullptr) {
+                m_spUploadManager.reset(
+                    new UploadManager(
+                        *this,
+                        *pTransferCommandBufferFactory,
+                        UploadManager::Config(),
+                        &getOrCreateUtilCommandBufferFactory()));
+            } else {
+                m_spUploadManager.reset(new UploadManager(*this, getOrCreateUtilCommandBufferFactory()));
+            }
+        }
+        return *m_spUploadManager.get();
+    }
+
+    Defragmenter& Context::getOrCreateDefragmenter()
+    {
+        assert(isDefragmenterSupported());
+
+        if (m_spDefragmenter == nullptr) {
+            m_spDefragmenter.reset(new Defragmenter(*this, getOrCreateUtilCommandBufferFactory()));
+        }
+        return *m_spDefragmenter.get();
+    }
+
     void Context::beginRendering(VkCommandBuffer commandBuffer, const RenderTarget& renderTarget)
     {
         std::vector<VkRenderingAttachmentInfoKHR> colorAttachments(renderTarget.getAttachmentCount());
@@ -166,6 +239,69 @@ namespace vgfx
         m_vkCmdBeginRendering(commandBuffer, &renderingInfo);
     }
 
+    void Context::pushDescriptorSet(
+        VkCommandBuffer commandBuffer,
+        VkPipelineBindPoint pipelineBindPoint,
+        VkPipelineLayout pipelineLayout,
+        uint32_t setIndex,
+        uint32_t descriptorWriteCount,
+        const VkWriteDescriptorSet* pDescriptorWrites)
+    {
+        m_vkCmdPushDescriptorSet(
+            commandBuffer,
+            pipelineBindPoint,
+            pipelineLayout,
+            setIndex,
+            descriptorWriteCount,
+            pDescriptorWrites);
+    }
+
+    VkDeviceSize Context::getDescriptorSetLayoutSize(VkDescriptorSetLayout layout)
+    {
+        VkDeviceSize sizeBytes = 0u;
+        m_vkGetDescriptorSetLayoutSize(m_device, layout, &sizeBytes);
+        return sizeBytes;
+    }
+
+    VkDeviceSize Context::getDescriptorSetLayoutBindingOffset(VkDescriptorSetLayout layout, uint32_t binding)
+    {
+        VkDeviceSize offsetBytes = 0u;
+        m_vkGetDescriptorSetLayoutBindingOffset(m_device, layout, binding, &offsetBytes);
+        return offsetBytes;
+    }
+
+    void Context::getDescriptor(const VkDescriptorGetInfoEXT& descriptorInfo, size_t dataSize, void* pDescriptor)
+    {
+        m_vkGetDescriptor(m_device, &descriptorInfo, dataSize, pDescriptor);
+    }
+
+    void Context::bindDescriptorBuffers(
+        VkCommandBuffer commandBuffer,
+        uint32_t bufferCount,
+        const VkDescriptorBufferBindingInfoEXT* pBindingInfos)
+    {
+        m_vkCmdBindDescriptorBuffers(commandBuffer, bufferCount, pBindingInfos);
+    }
+
+    void Context::setDescriptorBufferOffsets(
+        VkCommandBuffer commandBuffer,
+        VkPipelineBindPoint pipelineBindPoint,
+        VkPipelineLayout pipelineLayout,
+        uint32_t firstSet,
+        uint32_t setCount,
+        const uint32_t* pBufferIndices,
+        const VkDeviceSize* pOffsets)
+    {
+        m_vkCmdSetDescriptorBufferOffsets(
+            commandBuffer,
+            pipelineBindPoint,
+            pipelineLayout,
+            firstSet,
+            setCount,
+            pBufferIndices,
+            pOffsets);
+    }
+
     static Context::InstanceVersion QueryInstanceVersion()
     {
         uint32_t versionBits = 0;
@@ -265,7 +401,8 @@ namespace vgfx
         createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayersAsCharPtrs.size());
         createInfo.ppEnabledLayerNames = validationLayersAsCharPtrs.data();
 
-        VkResult result = vkCreateInstance(&createInfo, nullptr, &m_instance);
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_INSTANCE);
+        VkResult result = vkCreateInstance(&createInfo, m_pAllocationCallbacks, &m_instance);
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to create instance!");
         }
@@ -289,7 +426,7 @@ namespace vgfx
     void Context::destroyInstance()
     {
         if (m_instance != VK_NULL_HANDLE) {
-            vkDestroyInstance(m_instance, nullptr);
+            vkDestroyInstance(m_instance, m_pAllocationCallbacks);
         }
     }
 
@@ -496,6 +633,18 @@ namespace vgfx
             }
 
             if (queueFamilyIndices.isComplete(deviceConfig, presentQueueIsRequired)) {
+                if (!deviceConfig.dedicatedTransferQueueRequired) {
+                    // Prefer a family that only transfers, i.e. a copy engine, which uploads use
+                    // to overlap rendering.
+                    for (auto j = 0u; j < queueFamilyProperties.size(); ++j) {
+                        VkQueueFlags queueFlags = queueFamilyProperties[j].queueFlags;
+                        if ((queueFlags & VK_QUEUE_TRANSFER_BIT)
+                            && !(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                            queueFamilyIndices.transferFamily = j;
+                            break;
+                        }
+                    }
+                }
                 *pQueueFamilyProperties = std::move(queueFamilyProperties);
                 return queueFamilyIndices;
             }
@@ -696,6 +845,99 @@ namespace vgfx
         return false;
     }
 
+    static bool TryAddPushDescriptorExtension(
+        VkPhysicalDevice device,
+        std::vector<const char*>* pExtOut)
+    {
+        static const char* extArray[] = {
+            VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
+        };
+
+        size_t extCount = sizeof(extArray) / sizeof(extArray[0]);
+
+        if (CheckExtensionSupport(device, extArray, extCount)) {
+            pExtOut->insert(pExtOut->end(), extArray, &extArray[extCount]);
+            return true;
+        }
+
+        return false;
+    }
+
+    static bool AreTimelineSemaphoresSupported(
+        VkPhysicalDevice device,
+        const Context::InstanceVersion& instanceVersion)
+    {
+        // They are core in Vulkan 1.2, which both the instance and the device must support.
+        if (instanceVersion.major < 1 || (instanceVersion.major == 1 && instanceVersion.minor < 2)) {
+            return false;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties = {};
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            return false;
+        }
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+        timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+        features.pNext = &timelineSemaphoreFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+
+        return timelineSemaphoreFeatures.timelineSemaphore == VK_TRUE;
+    }
+
+    static bool TryAddDescriptorBufferExtension(
+        VkPhysicalDevice device,
+        const Context::InstanceVersion& instanceVersion,
+        std::vector<const char*>* pExtOut)
+    {
+        // Descriptors refer to buffers by their device address, which is core in Vulkan 1.2.
+        if (instanceVersion.major < 1 || (instanceVersion.major == 1 && instanceVersion.minor < 2)) {
+            return false;
+        }
+
+        VkPhysicalDeviceProperties deviceProperties = {};
+        vkGetPhysicalDeviceProperties(device, &deviceProperties);
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            return false;
+        }
+
+        static const char* extArray[] = {
+            VK_EXT_DESCRIPTOR_BUFFER_EXTENSION_NAME,
+        };
+
+        size_t extCount = sizeof(extArray) / sizeof(extArray[0]);
+
+        if (!CheckExtensionSupport(device, extArray, extCount)) {
+            return false;
+        }
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+        VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {};
+        bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+
+        VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+        descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+
+        features.pNext = &bufferDeviceAddressFeatures;
+        bufferDeviceAddressFeatures.pNext = &descriptorBufferFeatures;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+
+        if (bufferDeviceAddressFeatures.bufferDeviceAddress != VK_TRUE
+            || descriptorBufferFeatures.descriptorBuffer != VK_TRUE) {
+            return false;
+        }
+
+        pExtOut->insert(pExtOut->end(), extArray, &extArray[extCount]);
+        return true;
+    }
+
     void Context::createLogicalDevice(
         const Context::DeviceConfig& deviceConfig)
     {
@@ -735,6 +977,18 @@ namespace vgfx
         // Used by ImageSharpener.
         physDevFeatures.features.shaderInt16 = VK_TRUE;
 
+        // Used by TextureFile to upload block compressed textures without decoding them.
+        VkPhysicalDeviceFeatures supportedFeatures = {};
+        vkGetPhysicalDeviceFeatures(m_physicalDevice, &supportedFeatures);
+        if (supportedFeatures.textureCompressionBC) {
+            physDevFeatures.features.textureCompressionBC = VK_TRUE;
+        }
+        m_textureCompressionBCIsSupported = physDevFeatures.features.textureCompressionBC == VK_TRUE;
+        if (supportedFeatures.textureCompressionASTC_LDR) {
+            physDevFeatures.features.textureCompressionASTC_LDR = VK_TRUE;
+        }
+        m_textureCompressionAstcLdrIsSupported = physDevFeatures.features.textureCompressionASTC_LDR == VK_TRUE;
+
         VkPhysicalDeviceDynamicRenderingFeaturesKHR dynRenderingFeatures = {};
         dynRenderingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR;
         dynRenderingFeatures.dynamicRendering = VK_TRUE;
@@ -758,7 +1012,6 @@ namespace vgfx
 
         std::vector<const char*> deviceExtensionsAsCharPtrs;
         if (!deviceConfig.requiredDeviceExtensions.empty()) {
-            createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceConfig.requiredDeviceExtensions.size());
             ContainerOfStringsToCharPtrs(deviceConfig.requiredDeviceExtensions, &deviceExtensionsAsCharPtrs);
         }
 
@@ -810,20 +1063,103 @@ namespace vgfx
             ppDevFeaturesNext = &descriptorIndexingFeatures.pNext;
         }
 
+        // Used by Drawables for their per-draw bindings.
+        m_pushDescriptorsAreSupported = TryAddPushDescriptorExtension(m_physicalDevice, &deviceExtensionsAsCharPtrs);
+
+        // Used by Drawables instead of descriptor pools if the app asks for them.
+        VkPhysicalDeviceBufferDeviceAddressFeatures bufferDeviceAddressFeatures = {};
+        VkPhysicalDeviceDescriptorBufferFeaturesEXT descriptorBufferFeatures = {};
+        m_descriptorBuffersAreEnabled =
+            m_appConfig.useDescriptorBuffers
+            && TryAddDescriptorBufferExtension(m_physicalDevice, m_instanceVersion, &deviceExtensionsAsCharPtrs);
+        if (m_descriptorBuffersAreEnabled) {
+            bufferDeviceAddressFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_BUFFER_DEVICE_ADDRESS_FEATURES;
+            bufferDeviceAddressFeatures.bufferDeviceAddress = VK_TRUE;
+
+            descriptorBufferFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_FEATURES_EXT;
+            descriptorBufferFeatures.descriptorBuffer = VK_TRUE;
+
+            *ppDevFeaturesNext = &bufferDeviceAddressFeatures;
+            bufferDeviceAddressFeatures.pNext = &descriptorBufferFeatures;
+            ppDevFeaturesNext = &descriptorBufferFeatures.pNext;
+        }
+
+        // Used by GpuTimeline.
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineSemaphoreFeatures = {};
+        if (AreTimelineSemaphoresSupported(m_physicalDevice, m_instanceVersion)) {
+            m_timelineSemaphoresAreSupported = true;
+            timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+            timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+            *ppDevFeaturesNext = &timelineSemaphoreFeatures;
+            ppDevFeaturesNext = &timelineSemaphoreFeatures.pNext;
+        }
+
+        // Descriptor update templates are core in Vulkan 1.1, which both the instance and the
+        // device must support.
+        VkPhysicalDeviceProperties deviceProperties = {};
+        vkGetPhysicalDeviceProperties(m_physicalDevice, &deviceProperties);
+        m_descriptorUpdateTemplatesAreSupported =
+            (m_instanceVersion.major > 1 || (m_instanceVersion.major == 1 && m_instanceVersion.minor >= 1))
+            && deviceProperties.apiVersion >= VK_API_VERSION_1_1;
+
+        // Includes the optional extensions that were added above.
+        createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensionsAsCharPtrs.size());
         createInfo.ppEnabledExtensionNames = deviceExtensionsAsCharPtrs.data();
 
         createInfo.enabledLayerCount = 0;
 
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_DEVICE);
         VkResult result =
             vkCreateDevice(
                 m_physicalDevice,
                 &createInfo,
-                nullptr,
+                m_pAllocationCallbacks,
                 &m_device);
 
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to create logical device!");
         }
+
+        if (m_pushDescriptorsAreSupported) {
+            m_vkCmdPushDescriptorSet =
+                reinterpret_cast<PFN_vkCmdPushDescriptorSetKHR>(
+                    vkGetDeviceProcAddr(m_device, "vkCmdPushDescriptorSetKHR"));
+            m_pushDescriptorsAreSupported = m_vkCmdPushDescriptorSet != nullptr;
+        }
+
+        if (m_descriptorBuffersAreEnabled) {
+            m_descriptorBufferProperties = {};
+            m_descriptorBufferProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_BUFFER_PROPERTIES_EXT;
+
+            VkPhysicalDeviceProperties2 deviceProperties2 = {};
+            deviceProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            deviceProperties2.pNext = &m_descriptorBufferProperties;
+            vkGetPhysicalDeviceProperties2(m_physicalDevice, &deviceProperties2);
+
+            m_vkGetDescriptorSetLayoutSize =
+                reinterpret_cast<PFN_vkGetDescriptorSetLayoutSizeEXT>(
+                    vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutSizeEXT"));
+            m_vkGetDescriptorSetLayoutBindingOffset =
+                reinterpret_cast<PFN_vkGetDescriptorSetLayoutBindingOffsetEXT>(
+                    vkGetDeviceProcAddr(m_device, "vkGetDescriptorSetLayoutBindingOffsetEXT"));
+            m_vkGetDescriptor =
+                reinterpret_cast<PFN_vkGetDescriptorEXT>(
+                    vkGetDeviceProcAddr(m_device, "vkGetDescriptorEXT"));
+            m_vkCmdBindDescriptorBuffers =
+                reinterpret_cast<PFN_vkCmdBindDescriptorBuffersEXT>(
+                    vkGetDeviceProcAddr(m_device, "vkCmdBindDescriptorBuffersEXT"));
+            m_vkCmdSetDescriptorBufferOffsets =
+                reinterpret_cast<PFN_vkCmdSetDescriptorBufferOffsetsEXT>(
+                    vkGetDeviceProcAddr(m_device, "vkCmdSetDescriptorBufferOffsetsEXT"));
+            if (m_vkGetDescriptorSetLayoutSize == nullptr
+                || m_vkGetDescriptorSetLayoutBindingOffset == nullptr
+                || m_vkGetDescriptor == nullptr
+                || m_vkCmdBindDescriptorBuffers == nullptr
+                || m_vkCmdSetDescriptorBufferOffsets == nullptr) {
+                throw std::runtime_error("Failed to load the VK_EXT_descriptor_buffer functions!");
+            }
+        }
     }
 
     static VkResult CreateDebugReportCallbackEXT(
@@ -841,6 +1177,23 @@ namespace vgfx
         }
     }
 
+    bool Context::isImageFormatSupported(VkFormat format, VkFormatFeatureFlags requiredFeatures) const
+    {
+        // The format properties can report support for formats whose feature was not enabled.
+        if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK
+            && !m_textureCompressionBCIsSupported) {
+            return false;
+        }
+        if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK
+            && !m_textureCompressionAstcLdrIsSupported) {
+            return false;
+        }
+
+        VkFormatProperties formatProperties = {};
+        vkGetPhysicalDeviceFormatProperties(m_physicalDevice, format, &formatProperties);
+        return (formatProperties.optimalTilingFeatures & requiredFeatures) == requiredFeatures;
+    }
+
     void Context::enableDebugReportCallback(
         PFN_vkDebugReportCallbackEXT pfnCallback,
         void* pUserData)
@@ -991,4 +1344,32 @@ namespace vgfx
             delete pImageDownsampler;
         }
     }
+
+    void Context::UploadManagerDeleter::operator()(UploadManager* pUploadManager)
+    {
+        if (pUploadManager != nullptr) {
+            delete pUploadManager;
+        }
+    }
+
+    void Context::GpuTimelineDeleter::operator()(GpuTimeline* pGpuTimeline)
+    {
+        if (pGpuTimeline != nullptr) {
+            delete pGpuTimeline;
+        }
+    }
+
+    void Context::RetirementQueueDeleter::operator()(RetirementQueue* pRetirementQueue)
+    {
+        if (pRetirementQueue != nullptr) {
+            delete pRetirementQueue;
+        }
+    }
+
+    void Context::DefragmenterDeleter::operator()(Defragmenter* pDefragmenter)
+    {
+        if (pDefragmenter != nullptr) {
+            delete pDefragmenter;
+        }
+    }
 }
@@ -0,0 +1,385 @@
+#include "VulkanGraphicsDefragmenter.h"
+
+#include "VulkanGraphicsUploadManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <mutex>
+#include <stdexcept>
+
+namespace vgfx
+{
+    Defragmenter::Defragmenter(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        const Config& config)
+        : m_context(context)
+        , m_commandBufferFactory(commandBufferFactory)
+        , m_gpuTimeline(*context.getGpuTimeline())
+        , m_memoryAllocator(context.getMemoryAllocator())
+        , m_config(config)
+    {
+        // The frames that use the new handles must be submitted after the copies to the same queue.
+        assert(commandBufferFactory.getCommandQueue().queue == m_gpuTimeline.getCommandQueue().queue);
+    }
+
+    Defragmenter::~Defragmenter()
+    {
+        if (m_isPassInProgress) {
+            endPass(true);
+        }
+        if (m_defragmentationContext != VK_NULL_HANDLE) {
+            endDefragmentation();
+        }
+        m_pools.clear();
+    }
+
+    void Defragmenter::start()
+    {
+        if (isRunning()) {
+            return;
+        }
+
+        for (const auto& poolIt : m_memoryAllocator.m_staticPools) {
+            m_pools.push_back(poolIt.second);
+        }
+        m_pools.push_back(VK_NULL_HANDLE);
+    }
+
+    void Defragmenter::update()
+    {
+        if (m_isPassInProgress) {
+            if (!m_gpuTimeline.isComplete(m_passValue)) {
+                return;
+            }
+            endPass(false);
+        }
+
+        if (!isRunning()) {
+            return;
+        }
+
+        // Pending uploads write to resources that could be moved.
+        UploadManager* pUploadManager = m_context.getUploadManager();
+        if (pUploadManager != nullptr && !pUploadManager->isComplete(pUploadManager->flush())) {
+            return;
+        }
+
+        beginPass();
+    }
+
+    void Defragmenter::finish()
+    {
+        UploadManager* pUploadManager = m_context.getUploadManager();
+        if (pUploadManager != nullptr) {
+            pUploadManager->wait(pUploadManager->flush());
+        }
+
+        while (isRunning() || m_isPassInProgress) {
+            if (m_isPassInProgress) {
+                endPass(true);
+            } else {
+                beginPass();
+            }
+        }
+    }
+
+    void Defragmenter::beginPass()
+    {
+        VmaAllocator allocator = m_memoryAllocator.m_allocator;
+
+        if (m_defragmentationContext == VK_NULL_HANDLE) {
+            VmaDefragmentationInfo defragmentationInfo = {};
+            defragmentationInfo.pool = m_pools.front();
+            defragmentationInfo.maxBytesPerPass = m_config.maxBytesPerPass;
+            defragmentationInfo.maxAllocationsPerPass = m_config.maxMovesPerPass;
+
+            VkResult result = vmaBeginDefragmentation(allocator, &defragmentationInfo, &m_defragmentationContext);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to begin defragmentation!");
+            }
+        }
+
+        VkResult result = vmaBeginDefragmentationPass(allocator, m_defragmentationContext, &m_passInfo);
+        if (result == VK_SUCCESS) {
+            // Nothing left to move in the pool.
+            endDefragmentation();
+            return;
+        }
+        if (result != VK_INCOMPLETE) {
+            throw std::runtime_error("Failed to begin defragmentation pass!");
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_memoryAllocator.m_trackedMutex);
+            for (uint32_t moveIndex = 0u; moveIndex < m_passInfo.moveCount; ++moveIndex) {
+                m_memoryAllocator.m_movingAllocations[m_passInfo.pMoves[moveIndex].srcAllocation] = false;
+            }
+        }
+
+        m_commandBuffer = m_commandBufferFactory.createCommandBuffer();
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(m_commandBuffer, &beginInfo);
+
+        // The destination memory may have been used by resources that were destroyed since.
+        VkMemoryBarrier memoryBarrier = {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            m_commandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0u,
+            1u, &memoryBarrier,
+            0u, nullptr,
+            0u, nullptr);
+
+        m_moves.assign(m_passInfo.moveCount, Move());
+        bool hasCopies = false;
+        for (uint32_t moveIndex = 0u; moveIndex < m_passInfo.moveCount; ++moveIndex) {
+            VmaDefragmentationMove& vmaMove = m_passInfo.pMoves[moveIndex];
+            if (recordMove(vmaMove, &m_moves[moveIndex])) {
+                hasCopies = true;
+            } else {
+                vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+                ++m_stats.ignoredMoveCount;
+            }
+        }
+
+        // Everything submitted after the copies sees the moved data.
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            m_commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0u,
+            1u, &memoryBarrier,
+            0u, nullptr,
+            0u, nullptr);
+
+        vkEndCommandBuffer(m_commandBuffer);
+
+        m_isPassInProgress = true;
+        ++m_stats.passCount;
+
+        if (!hasCopies) {
+            m_passValue = m_gpuTimeline.getLastSubmittedValue();
+            endPass(false);
+            return;
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1u;
+        submitInfo.pCommandBuffers = &m_commandBuffer;
+        m_passValue = m_gpuTimeline.submit(submitInfo);
+
+        {
+            std::lock_guard<std::mutex> lock(m_memoryAllocator.m_trackedMutex);
+            for (const Move& move : m_moves) {
+                auto findIt = m_memoryAllocator.m_movables.find(move.allocation);
+                if (findIt != m_memoryAllocator.m_movables.end()) {
+                    if (move.newBuffer != VK_NULL_HANDLE) {
+                        findIt->second.buffer = move.newBuffer;
+                    } else if (move.newImage != VK_NULL_HANDLE) {
+                        findIt->second.image = move.newImage;
+                    }
+                }
+            }
+        }
+
+        // Frames submitted from now on use the new resources, the old ones are destroyed once the
+        // frames before the copies have completed.
+        for (Move& move : m_moves) {
+            if (move.newBuffer != VK_NULL_HANDLE) {
+                move.bufferMovedFunc(move.newBuffer);
+            } else if (move.newImage != VK_NULL_HANDLE) {
+                move.imageMovedFunc(move.newImage);
+            }
+        }
+    }
+
+    bool Defragmenter::recordMove(const VmaDefragmentationMove& vmaMove, Move* pMove)
+    {
+        MemoryAllocator::Movable movable;
+        {
+            std::lock_guard<std::mutex> lock(m_memoryAllocator.m_trackedMutex);
+            auto findIt = m_memoryAllocator.m_movables.find(vmaMove.srcAllocation);
+            if (findIt == m_memoryAllocator.m_movables.end()) {
+                return false;
+            }
+            movable = findIt->second;
+        }
+
+        VkDevice device = m_context.getLogicalDevice();
+        VkAllocationCallbacks* pAllocationCallbacks = m_context.getAllocationCallbacks();
+        VmaAllocator allocator = m_memoryAllocator.m_allocator;
+
+        if (movable.buffer != VK_NULL_HANDLE) {
+            VkBuffer newBuffer = VK_NULL_HANDLE;
+            if (vkCreateBuffer(device, &movable.bufferCreateInfo, pAllocationCallbacks, &newBuffer) != VK_SUCCESS) {
+                return false;
+            }
+            if (vmaBindBufferMemory(allocator, vmaMove.dstTmpAllocation, newBuffer) != VK_SUCCESS) {
+                vkDestroyBuffer(device, newBuffer, pAllocationCallbacks);
+                return false;
+            }
+
+            VkBufferCopy copyRegion = {};
+            copyRegion.size = movable.bufferCreateInfo.size;
+            vkCmdCopyBuffer(m_commandBuffer, movable.buffer, newBuffer, 1u, &copyRegion);
+
+            pMove->allocation = vmaMove.srcAllocation;
+            pMove->oldBuffer = movable.buffer;
+            pMove->newBuffer = newBuffer;
+            pMove->bufferMovedFunc = std::move(movable.bufferMovedFunc);
+            return true;
+        }
+
+        const VkImageCreateInfo& imageInfo = movable.imageCreateInfo;
+        assert(imageInfo.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED);
+
+        VkImage newImage = VK_NULL_HANDLE;
+        if (vkCreateImage(device, &imageInfo, pAllocationCallbacks, &newImage) != VK_SUCCESS) {
+            return false;
+        }
+        if (vmaBindImageMemory(allocator, vmaMove.dstTmpAllocation, newImage) != VK_SUCCESS) {
+            vkDestroyImage(device, newImage, pAllocationCallbacks);
+            return false;
+        }
+
+        VkImageMemoryBarrier barriers[2] = {};
+        for (VkImageMemoryBarrier& barrier : barriers) {
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.levelCount = imageInfo.mipLevels;
+            barrier.subresourceRange.layerCount = imageInfo.arrayLayers;
+        }
+        barriers[0].image = movable.image;
+        barriers[0].oldLayout = movable.imageLayout;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[1].image = newImage;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            m_commandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0u,
+            0u, nullptr,
+            0u, nullptr,
+            2u, barriers);
+
+        std::vector<VkImageCopy> copyRegions(imageInfo.mipLevels);
+        for (uint32_t mipLevel = 0u; mipLevel < imageInfo.mipLevels; ++mipLevel) {
+            VkImageCopy& copyRegion = copyRegions[mipLevel];
+            copyRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.srcSubresource.mipLevel = mipLevel;
+            copyRegion.srcSubresource.layerCount = imageInfo.arrayLayers;
+            copyRegion.dstSubresource = copyRegion.srcSubresource;
+            copyRegion.extent.width = std::max(imageInfo.extent.width >> mipLevel, 1u);
+            copyRegion.extent.height = std::max(imageInfo.extent.height >> mipLevel, 1u);
+            copyRegion.extent.depth = std::max(imageInfo.extent.depth >> mipLevel, 1u);
+        }
+        vkCmdCopyImage(
+            m_commandBuffer,
+            movable.image,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            newImage,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(copyRegions.size()),
+            copyRegions.data());
+
+        VkImageMemoryBarrier& dstBarrier = barriers[1];
+        dstBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        dstBarrier.newLayout = movable.imageLayout;
+        dstBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        dstBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        vkCmdPipelineBarrier(
+            m_commandBuffer,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0u,
+            0u, nullptr,
+            0u, nullptr,
+            1u, &dstBarrier);
+
+        pMove->allocation = vmaMove.srcAllocation;
+        pMove->oldImage = movable.image;
+        pMove->newImage = newImage;
+        pMove->imageMovedFunc = std::move(movable.imageMovedFunc);
+        return true;
+    }
+
+    void Defragmenter::endPass(bool wait)
+    {
+        if (wait) {
+            m_gpuTimeline.wait(m_passValue);
+        }
+
+        VmaAllocator allocator = m_memoryAllocator.m_allocator;
+        VkResult result = VK_SUCCESS;
+        {
+            // Held until the pass ends so that the allocations aren't destroyed in the meantime.
+            std::lock_guard<std::mutex> lock(m_memoryAllocator.m_trackedMutex);
+            for (uint32_t moveIndex = 0u; moveIndex < m_passInfo.moveCount; ++moveIndex) {
+                VmaDefragmentationMove& vmaMove = m_passInfo.pMoves[moveIndex];
+                if (m_memoryAllocator.m_movingAllocations[vmaMove.srcAllocation]) {
+                    // Its owner destroyed the resource, VMA frees the memory.
+                    vmaMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+                }
+            }
+            m_memoryAllocator.m_movingAllocations.clear();
+
+            result = vmaEndDefragmentationPass(allocator, m_defragmentationContext, &m_passInfo);
+        }
+
+        // Moved resources are bound to the allocations' new memory, the old ones to the freed memory.
+        VkDevice device = m_context.getLogicalDevice();
+        VkAllocationCallbacks* pAllocationCallbacks = m_context.getAllocationCallbacks();
+        for (Move& move : m_moves) {
+            if (move.oldBuffer != VK_NULL_HANDLE) {
+                vkDestroyBuffer(device, move.oldBuffer, pAllocationCallbacks);
+            }
+            if (move.oldImage != VK_NULL_HANDLE) {
+                vkDestroyImage(device, move.oldImage, pAllocationCallbacks);
+            }
+        }
+        m_moves.clear();
+
+        m_commandBufferFactory.freeCommandBuffer(m_commandBuffer);
+        m_commandBuffer = VK_NULL_HANDLE;
+        m_isPassInProgress = false;
+
+        if (result == VK_SUCCESS) {
+            endDefragmentation();
+        } else if (result != VK_INCOMPLETE) {
+            throw std::runtime_error("Failed to end defragmentation pass!");
+        }
+    }
+
+    void Defragmenter::endDefragmentation()
+    {
+        VmaDefragmentationStats defragmentationStats = {};
+        vmaEndDefragmentation(m_memoryAllocator.m_allocator, m_defragmentationContext, &defragmentationStats);
+        m_defragmentationContext = VK_NULL_HANDLE;
+
+        m_stats.movedAllocationCount += defragmentationStats.allocationsMoved;
+        m_stats.movedBytes += defragmentationStats.bytesMoved;
+        m_stats.freedBlockCount += defragmentationStats.deviceMemoryBlocksFreed;
+        m_stats.freedBytes += defragmentationStats.bytesFreed;
+
+        if (!m_pools.empty()) {
+            m_pools.pop_front();
+        }
+    }
+}
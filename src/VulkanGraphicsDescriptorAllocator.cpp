@@ -0,0 +1,148 @@
+#include "VulkanGraphicsDescriptorAllocator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace vgfx
+{
+    DescriptorAllocator::DescriptorAllocator(Context& context, const Config& config)
+        : m_context(context)
+        , m_config(config)
+    {
+        Capacity capacity;
+        capacity.maxSets = m_config.initMaxSets;
+        for (const VkDescriptorPoolSize& poolSize : m_config.initPoolSizes) {
+            capacity.descriptorCounts[poolSize.type] += poolSize.descriptorCount;
+        }
+        createPool(capacity);
+    }
+
+    static void AddDescriptorSets(
+        const DescriptorSetLayout& layout,
+        uint32_t count,
+        std::map<VkDescriptorType, uint32_t>* pDescriptorCounts)
+    {
+        for (const auto& descBindingCfg : layout.getDescriptorBindings()) {
+            (*pDescriptorCounts)[descBindingCfg.second.descriptorType] += descBindingCfg.second.arrayElementCount * count;
+        }
+    }
+
+    static void ClearDescriptorCounts(std::map<VkDescriptorType, uint32_t>* pDescriptorCounts)
+    {
+        // Zeroed rather than cleared, so the map doesn't reallocate its nodes every frame.
+        for (auto& countIt : *pDescriptorCounts) {
+            countIt.second = 0u;
+        }
+    }
+
+    void DescriptorAllocator::allocateDescriptorSets(
+        const DescriptorSetLayout& layout,
+        uint32_t count,
+        VkDescriptorSet* pDescriptorSetHandles)
+    {
+        m_layoutHandles.assign(count, layout.getHandle());
+        ClearDescriptorCounts(&m_requestedDescriptorCounts);
+        AddDescriptorSets(layout, count, &m_requestedDescriptorCounts);
+
+        allocate(count, pDescriptorSetHandles);
+    }
+
+    void DescriptorAllocator::allocateDescriptorSets(
+        const DescriptorSetLayout* const* ppLayouts,
+        uint32_t count,
+        VkDescriptorSet* pDescriptorSetHandles)
+    {
+        m_layoutHandles.resize(count);
+        ClearDescriptorCounts(&m_requestedDescriptorCounts);
+        for (uint32_t setIndex = 0u; setIndex < count; ++setIndex) {
+            m_layoutHandles[setIndex] = ppLayouts[setIndex]->getHandle();
+            AddDescriptorSets(*ppLayouts[setIndex], 1u, &m_requestedDescriptorCounts);
+        }
+
+        allocate(count, pDescriptorSetHandles);
+    }
+
+    void DescriptorAllocator::allocate(uint32_t count, VkDescriptorSet* pDescriptorSetHandles)
+    {
+        VkResult result = m_pools.back()->tryAllocateDescriptorSets(m_layoutHandles.data(), count, pDescriptorSetHandles);
+        if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL) {
+            // As large as everything allocated since the reset, so the chain grows geometrically.
+            Capacity capacity = m_used;
+            capacity.maxSets = std::max(capacity.maxSets, m_config.initMaxSets) + count;
+            for (const auto& countIt : m_requestedDescriptorCounts) {
+                capacity.descriptorCounts[countIt.first] += countIt.second;
+            }
+            createPool(capacity);
+            ++m_stats.chainedPoolCount;
+
+            result = m_pools.back()->tryAllocateDescriptorSets(m_layoutHandles.data(), count, pDescriptorSetHandles);
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate descriptor sets!");
+        }
+
+        m_used.maxSets += count;
+        uint32_t descriptorCount = 0u;
+        for (const auto& countIt : m_requestedDescriptorCounts) {
+            m_used.descriptorCounts[countIt.first] += countIt.second;
+            descriptorCount += countIt.second;
+        }
+
+        m_stats.setCount += count;
+        m_stats.descriptorCount += descriptorCount;
+        m_stats.peakSetCount = std::max(m_stats.peakSetCount, m_stats.setCount);
+        m_stats.peakDescriptorCount = std::max(m_stats.peakDescriptorCount, m_stats.descriptorCount);
+    }
+
+    void DescriptorAllocator::reset()
+    {
+        if (m_pools.size() > 1u) {
+            Capacity capacity;
+            capacity.maxSets = std::max(
+                m_config.initMaxSets,
+                static_cast<uint32_t>(std::ceil(m_used.maxSets * m_config.headroomFactor)));
+            for (const auto& countIt : m_used.descriptorCounts) {
+                capacity.descriptorCounts[countIt.first] =
+                    static_cast<uint32_t>(std::ceil(countIt.second * m_config.headroomFactor));
+            }
+            // Types that weren't used keep their initial counts.
+            for (const VkDescriptorPoolSize& poolSize : m_config.initPoolSizes) {
+                uint32_t& descriptorCount = capacity.descriptorCounts[poolSize.type];
+                descriptorCount = std::max(descriptorCount, poolSize.descriptorCount);
+            }
+
+            m_pools.clear();
+            m_stats.maxSets = 0u;
+            createPool(capacity);
+            ++m_stats.resizeCount;
+        } else {
+            m_pools.back()->reset();
+        }
+
+        m_used.maxSets = 0u;
+        ClearDescriptorCounts(&m_used.descriptorCounts);
+        m_stats.setCount = 0u;
+        m_stats.descriptorCount = 0u;
+    }
+
+    void DescriptorAllocator::createPool(const Capacity& capacity)
+    {
+        std::vector<VkDescriptorPoolSize> descriptorPoolSizes;
+        for (const auto& countIt : capacity.descriptorCounts) {
+            if (countIt.second > 0u) {
+                descriptorPoolSizes.push_back({ countIt.first, countIt.second });
+            }
+        }
+
+        m_pools.emplace_back(
+            std::make_unique<DescriptorPool>(
+                m_context,
+                descriptorPoolSizes,
+                capacity.maxSets,
+                m_config.flags));
+
+        m_stats.poolCount = static_cast<uint32_t>(m_pools.size());
+        m_stats.maxSets += capacity.maxSets;
+    }
+}
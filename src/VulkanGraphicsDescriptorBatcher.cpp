@@ -0,0 +1,98 @@
+#include "VulkanGraphicsDescriptorBatcher.h"
+
+namespace vgfx
+{
+    DescriptorBatcher::DescriptorBatcher(Context& context)
+        : m_context(context)
+    {
+    }
+
+    uint32_t DescriptorBatcher::requestDescriptorSets(const DescriptorSetLayout& layout, uint32_t count)
+    {
+        uint32_t firstSetIndex = static_cast<uint32_t>(m_layouts.size());
+        m_layouts.insert(m_layouts.end(), count, &layout);
+        return firstSetIndex;
+    }
+
+    void DescriptorBatcher::writeImage(
+        uint32_t setIndex,
+        uint32_t bindingIndex,
+        VkDescriptorType descriptorType,
+        const VkDescriptorImageInfo& imageInfo)
+    {
+        m_writes.push_back({ setIndex, bindingIndex, descriptorType, static_cast<uint32_t>(m_imageInfos.size()) });
+        m_imageInfos.push_back(imageInfo);
+    }
+
+    void DescriptorBatcher::writeBuffer(
+        uint32_t setIndex,
+        uint32_t bindingIndex,
+        VkDescriptorType descriptorType,
+        const VkDescriptorBufferInfo& bufferInfo)
+    {
+        m_writes.push_back({ setIndex, bindingIndex, descriptorType, static_cast<uint32_t>(m_bufferInfos.size()) });
+        m_bufferInfos.push_back(bufferInfo);
+    }
+
+    static bool IsBufferDescriptorType(VkDescriptorType descriptorType)
+    {
+        switch (descriptorType) {
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    void DescriptorBatcher::flush(DescriptorAllocator& descriptorAllocator)
+    {
+        if (m_layouts.empty()) {
+            return;
+        }
+
+        m_descriptorSets.resize(m_layouts.size());
+        descriptorAllocator.allocateDescriptorSets(
+            m_layouts.data(),
+            static_cast<uint32_t>(m_layouts.size()),
+            m_descriptorSets.data());
+
+        // The infos no longer move, so the writes can point at them.
+        m_descriptorWrites.resize(m_writes.size());
+        for (size_t writeIndex = 0u; writeIndex < m_writes.size(); ++writeIndex) {
+            const Write& write = m_writes[writeIndex];
+
+            VkWriteDescriptorSet& descriptorWrite = m_descriptorWrites[writeIndex];
+            descriptorWrite = {};
+            descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrite.dstSet = m_descriptorSets[write.setIndex];
+            descriptorWrite.dstBinding = write.bindingIndex;
+            descriptorWrite.dstArrayElement = 0u;
+            descriptorWrite.descriptorCount = 1u;
+            descriptorWrite.descriptorType = write.descriptorType;
+            if (IsBufferDescriptorType(write.descriptorType)) {
+                descriptorWrite.pBufferInfo = &m_bufferInfos[write.infoIndex];
+            } else {
+                descriptorWrite.pImageInfo = &m_imageInfos[write.infoIndex];
+            }
+        }
+
+        vkUpdateDescriptorSets(
+            m_context.getLogicalDevice(),
+            static_cast<uint32_t>(m_descriptorWrites.size()),
+            m_descriptorWrites.data(), 0, nullptr);
+    }
+
+    void DescriptorBatcher::reset()
+    {
+        // Clearing keeps the capacity.
+        m_layouts.clear();
+        m_descriptorSets.clear();
+        m_writes.clear();
+        m_imageInfos.clear();
+        m_bufferInfos.clear();
+        m_descriptorWrites.clear();
+    }
+}
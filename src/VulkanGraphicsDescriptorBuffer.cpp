@@ -0,0 +1,116 @@
+#include "VulkanGraphicsDescriptorBuffer.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace vgfx
+{
+    DescriptorBuffer::DescriptorBuffer(Context& context, const Config& config)
+        : m_context(context)
+        , m_config(config)
+    {
+        assert(context.areDescriptorBuffersEnabled());
+
+        // Combined image samplers need both usages, so every type of set fits in the one buffer.
+        m_usage =
+            VK_BUFFER_USAGE_RESOURCE_DESCRIPTOR_BUFFER_BIT_EXT
+            | VK_BUFFER_USAGE_SAMPLER_DESCRIPTOR_BUFFER_BIT_EXT
+            | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = m_config.sizeBytes;
+        bufferCreateInfo.usage = m_usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        MemoryAllocator& memoryAllocator = context.getMemoryAllocator();
+        m_buffer = memoryAllocator.createMappedBuffer(bufferCreateInfo, "Descriptor buffer");
+        if (!m_buffer.isValid()) {
+            throw std::runtime_error("Failed to create descriptor buffer!");
+        }
+
+        VkBufferDeviceAddressInfo bufferAddressInfo = {};
+        bufferAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+        bufferAddressInfo.buffer = m_buffer.handle;
+        m_deviceAddress = vkGetBufferDeviceAddress(context.getLogicalDevice(), &bufferAddressInfo);
+    }
+
+    DescriptorBuffer::~DescriptorBuffer()
+    {
+        if (m_buffer.isValid()) {
+            MemoryAllocator& memoryAllocator = m_context.getMemoryAllocator();
+            // Command buffers in flight may still read its descriptors.
+            m_context.retire([&memoryAllocator, buffer = m_buffer]() mutable {
+                memoryAllocator.destroyBuffer(buffer);
+            });
+        }
+    }
+
+    void DescriptorBuffer::allocateDescriptorSets(
+        const DescriptorSetLayout& layout,
+        uint32_t count,
+        VkDeviceSize* pOffsets)
+    {
+        assert(layout.isDescriptorBuffer());
+        // Sizes of descriptor buffer layouts are multiples of the offset alignment.
+        VkDeviceSize setSizeBytes = layout.getDescriptorBufferSize();
+        if (m_stats.usedBytes + setSizeBytes * count > m_config.sizeBytes) {
+            throw std::runtime_error("Descriptor buffer is full!");
+        }
+
+        for (uint32_t setIndex = 0u; setIndex < count; ++setIndex) {
+            pOffsets[setIndex] = m_stats.usedBytes;
+            m_stats.usedBytes += setSizeBytes;
+        }
+
+        m_stats.setCount += count;
+        m_stats.peakUsedBytes = std::max(m_stats.peakUsedBytes, m_stats.usedBytes);
+        m_stats.peakSetCount = std::max(m_stats.peakSetCount, m_stats.setCount);
+    }
+
+    void DescriptorBuffer::flush()
+    {
+        if (m_stats.usedBytes > 0u) {
+            m_context.getMemoryAllocator().flushMappedBuffer(m_buffer, 0u, m_stats.usedBytes);
+        }
+    }
+
+    void DescriptorBuffer::reset()
+    {
+        m_stats.usedBytes = 0u;
+        m_stats.setCount = 0u;
+    }
+
+    void DescriptorBuffer::bind(VkCommandBuffer commandBuffer)
+    {
+        VkDescriptorBufferBindingInfoEXT bindingInfo = {};
+        bindingInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_BUFFER_BINDING_INFO_EXT;
+        bindingInfo.address = m_deviceAddress;
+        bindingInfo.usage = m_usage;
+
+        m_context.bindDescriptorBuffers(commandBuffer, 1u, &bindingInfo);
+    }
+
+    void DescriptorBuffer::setDescriptorSetOffsets(
+        VkCommandBuffer commandBuffer,
+        VkPipelineBindPoint pipelineBindPoint,
+        VkPipelineLayout pipelineLayout,
+        uint32_t firstSet,
+        uint32_t setCount,
+        const VkDeviceSize* pOffsets)
+    {
+        // All of the sets are in buffer index 0.
+        const uint32_t bufferIndices[] = { 0u, 0u, 0u, 0u };
+        assert(setCount <= sizeof(bufferIndices) / sizeof(bufferIndices[0]));
+
+        m_context.setDescriptorBufferOffsets(
+            commandBuffer,
+            pipelineBindPoint,
+            pipelineLayout,
+            firstSet,
+            setCount,
+            bufferIndices,
+            pOffsets);
+    }
+}
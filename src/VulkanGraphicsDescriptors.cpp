@@ -1,14 +1,19 @@
 #include "VulkanGraphicsDescriptors.h"
 
+#include "VulkanGraphicsHostAllocator.h"
+
+#include <cassert>
 #include <stdexcept>
 
 namespace vgfx
 {
     DescriptorSetLayout::DescriptorSetLayout(
         Context& context,
-        const DescriptorBindings& descriptorBindings)
+        const DescriptorBindings& descriptorBindings,
+        VkDescriptorSetLayoutCreateFlags flags)
         : m_context(context)
         , m_descriptorBindings(descriptorBindings)
+        , m_flags(flags)
     {
         std::vector<VkDescriptorSetLayoutBinding> descriptorLayoutBindings;
         descriptorLayoutBindings.reserve(m_descriptorBindings.size());
@@ -37,6 +42,7 @@ namespace vgfx
 
         VkDescriptorSetLayoutCreateInfo layoutInfo = {};
         layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.flags = m_flags;
         layoutInfo.bindingCount = static_cast<uint32_t>(descriptorBindings.size());
         layoutInfo.pBindings = descriptorLayoutBindings.data();
 
@@ -47,6 +53,7 @@ namespace vgfx
 
         layoutInfo.pNext = &bindingFlagsInfo;
 
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT);
         VkResult result =
             vkCreateDescriptorSetLayout(
                 context.getLogicalDevice(),
@@ -57,10 +64,108 @@ namespace vgfx
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to create descriptor set layout!");
         }
+
+        if (isDescriptorBuffer()) {
+            VkDeviceSize offsetAlignment = context.getDescriptorBufferProperties().descriptorBufferOffsetAlignment;
+            VkDeviceSize sizeBytes = context.getDescriptorSetLayoutSize(m_descriptorSetLayout);
+            // Rounded up so that consecutive sets in the buffer are at valid offsets.
+            m_descriptorBufferSizeBytes = (sizeBytes + offsetAlignment - 1u) / offsetAlignment * offsetAlignment;
+            for (const auto& descBindingCfg : m_descriptorBindings) {
+                m_descriptorBufferBindingOffsets[descBindingCfg.first] =
+                    context.getDescriptorSetLayoutBindingOffset(m_descriptorSetLayout, descBindingCfg.first);
+            }
+        } else if (context.areDescriptorUpdateTemplatesSupported() && !isPushDescriptor()) {
+            // Templates of push descriptor layouts depend on the pipeline layout.
+            createUpdateTemplate();
+        }
+    }
+
+    static bool IsUpdateTemplateDescriptorType(VkDescriptorType descriptorType)
+    {
+        switch (descriptorType) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+        case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+        case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+            return true;
+        default:
+            // E.g. inline uniform blocks, which are written as bytes rather than infos.
+            return false;
+        }
+    }
+
+    void DescriptorSetLayout::createUpdateTemplate()
+    {
+        std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+        templateEntries.reserve(m_descriptorBindings.size());
+
+        uint32_t descriptorInfoIndex = 0u;
+        for (const auto& descBindingCfg : m_descriptorBindings) {
+            if (!IsUpdateTemplateDescriptorType(descBindingCfg.second.descriptorType)) {
+                m_descriptorInfoIndices.clear();
+                return;
+            }
+
+            VkDescriptorUpdateTemplateEntry templateEntry = {};
+            templateEntry.dstBinding = descBindingCfg.first;
+            templateEntry.dstArrayElement = 0u;
+            templateEntry.descriptorCount = descBindingCfg.second.arrayElementCount;
+            templateEntry.descriptorType = descBindingCfg.second.descriptorType;
+            templateEntry.offset = descriptorInfoIndex * sizeof(DescriptorInfo);
+            templateEntry.stride = sizeof(DescriptorInfo);
+            templateEntries.push_back(templateEntry);
+
+            m_descriptorInfoIndices[descBindingCfg.first] = descriptorInfoIndex;
+            descriptorInfoIndex += descBindingCfg.second.arrayElementCount;
+        }
+
+        VkDescriptorUpdateTemplateCreateInfo templateInfo = {};
+        templateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+        templateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+        templateInfo.pDescriptorUpdateEntries = templateEntries.data();
+        templateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+        templateInfo.descriptorSetLayout = m_descriptorSetLayout;
+
+        VkResult result =
+            vkCreateDescriptorUpdateTemplate(
+                m_context.getLogicalDevice(),
+                &templateInfo,
+                m_context.getAllocationCallbacks(),
+                &m_updateTemplate);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create descriptor update template!");
+        }
+
+        m_descriptorInfoCount = descriptorInfoIndex;
+    }
+
+    void DescriptorSetLayout::updateDescriptorSet(
+        VkDescriptorSet descriptorSet,
+        const DescriptorInfo* pDescriptorInfos) const
+    {
+        vkUpdateDescriptorSetWithTemplate(
+            m_context.getLogicalDevice(),
+            descriptorSet,
+            m_updateTemplate,
+            pDescriptorInfos);
     }
 
     DescriptorSetLayout::~DescriptorSetLayout()
     {
+        if (m_updateTemplate != VK_NULL_HANDLE) {
+            vkDestroyDescriptorUpdateTemplate(
+                m_context.getLogicalDevice(),
+                m_updateTemplate,
+                m_context.getAllocationCallbacks());
+        }
         if (m_descriptorSetLayout) {
             vkDestroyDescriptorSetLayout(
                 m_context.getLogicalDevice(),
@@ -97,6 +202,115 @@ namespace vgfx
         m_descriptorWrites.clear();
     }
 
+    void DescriptorSetUpdater::pushDescriptorSet(
+        Context& context,
+        VkCommandBuffer commandBuffer,
+        VkPipelineBindPoint pipelineBindPoint,
+        VkPipelineLayout pipelineLayout,
+        uint32_t setIndex)
+    {
+        context.pushDescriptorSet(
+            commandBuffer,
+            pipelineBindPoint,
+            pipelineLayout,
+            setIndex,
+            static_cast<uint32_t>(m_descriptorWrites.size()),
+            m_descriptorWrites.data());
+
+        m_descriptorWrites.clear();
+    }
+
+    static size_t GetDescriptorSize(
+        const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties,
+        VkDescriptorType descriptorType)
+    {
+        switch (descriptorType) {
+        case VK_DESCRIPTOR_TYPE_SAMPLER:
+            return properties.samplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+            return properties.combinedImageSamplerDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+            return properties.sampledImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+            return properties.storageImageDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+            return properties.inputAttachmentDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+            return properties.uniformBufferDescriptorSize;
+        case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+            return properties.storageBufferDescriptorSize;
+        default:
+            // Texel buffer descriptors need the buffer's address rather than a view, and there
+            // are no dynamic buffers in descriptor buffers.
+            throw std::runtime_error("Descriptor type can't be written to a descriptor buffer!");
+        }
+    }
+
+    void DescriptorSetUpdater::writeDescriptorBuffer(
+        Context& context,
+        const DescriptorSetLayout& layout,
+        void* pSetData)
+    {
+        assert(layout.isDescriptorBuffer());
+        const VkPhysicalDeviceDescriptorBufferPropertiesEXT& properties = context.getDescriptorBufferProperties();
+
+        for (const VkWriteDescriptorSet& descriptorWrite : m_descriptorWrites) {
+            size_t descriptorSize = GetDescriptorSize(properties, descriptorWrite.descriptorType);
+            uint8_t* pBindingData =
+                static_cast<uint8_t*>(pSetData) + layout.getDescriptorBufferBindingOffset(descriptorWrite.dstBinding);
+
+            for (uint32_t index = 0u; index < descriptorWrite.descriptorCount; ++index) {
+                VkDescriptorGetInfoEXT descriptorInfo = {};
+                descriptorInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_GET_INFO_EXT;
+                descriptorInfo.type = descriptorWrite.descriptorType;
+
+                VkDescriptorAddressInfoEXT addressInfo = {};
+                switch (descriptorWrite.descriptorType) {
+                case VK_DESCRIPTOR_TYPE_SAMPLER:
+                    descriptorInfo.data.pSampler = &descriptorWrite.pImageInfo[index].sampler;
+                    break;
+                case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                    descriptorInfo.data.pCombinedImageSampler = &descriptorWrite.pImageInfo[index];
+                    break;
+                case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                    descriptorInfo.data.pSampledImage = &descriptorWrite.pImageInfo[index];
+                    break;
+                case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                    descriptorInfo.data.pStorageImage = &descriptorWrite.pImageInfo[index];
+                    break;
+                case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                    descriptorInfo.data.pInputAttachmentImage = &descriptorWrite.pImageInfo[index];
+                    break;
+                default: {
+                    const VkDescriptorBufferInfo& bufferInfo = descriptorWrite.pBufferInfo[index];
+                    VkBufferDeviceAddressInfo bufferAddressInfo = {};
+                    bufferAddressInfo.sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO;
+                    bufferAddressInfo.buffer = bufferInfo.buffer;
+
+                    addressInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_ADDRESS_INFO_EXT;
+                    addressInfo.address =
+                        vkGetBufferDeviceAddress(context.getLogicalDevice(), &bufferAddressInfo) + bufferInfo.offset;
+                    addressInfo.range = bufferInfo.range;
+                    addressInfo.format = VK_FORMAT_UNDEFINED;
+                    if (descriptorWrite.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER) {
+                        descriptorInfo.data.pUniformBuffer = &addressInfo;
+                    } else {
+                        descriptorInfo.data.pStorageBuffer = &addressInfo;
+                    }
+                    break;
+                }
+                }
+
+                context.getDescriptor(
+                    descriptorInfo,
+                    descriptorSize,
+                    pBindingData + (descriptorWrite.dstArrayElement + index) * descriptorSize);
+            }
+        }
+
+        m_descriptorWrites.clear();
+    }
+
     DescriptorPool::DescriptorPool(
         Context& context,
         const std::vector<VkDescriptorPoolSize>& descriptorPoolSizes,
@@ -111,6 +325,7 @@ namespace vgfx
         poolInfo.maxSets = maxSets;
         poolInfo.flags = flags;
 
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_DESCRIPTOR_POOL);
         VkResult result = vkCreateDescriptorPool(
             context.getLogicalDevice(),
             &poolInfo,
@@ -125,10 +340,13 @@ namespace vgfx
     DescriptorPool::~DescriptorPool()
     {
         if (m_descriptorPool != VK_NULL_HANDLE) {
-            vkDestroyDescriptorPool(
-                m_context.getLogicalDevice(),
-                m_descriptorPool,
-                m_context.getAllocationCallbacks());
+            // Its sets may still be bound by command buffers in flight.
+            m_context.retire(
+                [device = m_context.getLogicalDevice(),
+                 descriptorPool = m_descriptorPool,
+                 pAllocationCallbacks = m_context.getAllocationCallbacks()]() {
+                    vkDestroyDescriptorPool(device, descriptorPool, pAllocationCallbacks);
+                });
         }
     }
 
@@ -136,18 +354,42 @@ namespace vgfx
         const DescriptorSetLayout& layout,
         uint32_t count,
         VkDescriptorSet* pDescriptorSetHandles)
+    {
+        VkResult result = tryAllocateDescriptorSets(layout, count, pDescriptorSetHandles);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate descriptor sets!");
+        }
+    }
+
+    VkResult DescriptorPool::tryAllocateDescriptorSets(
+        const DescriptorSetLayout& layout,
+        uint32_t count,
+        VkDescriptorSet* pDescriptorSetHandles)
     {
         std::vector<VkDescriptorSetLayout> layouts(count, layout.getHandle());
+        return tryAllocateDescriptorSets(layouts.data(), count, pDescriptorSetHandles);
+    }
+
+    VkResult DescriptorPool::tryAllocateDescriptorSets(
+        const VkDescriptorSetLayout* pLayoutHandles,
+        uint32_t count,
+        VkDescriptorSet* pDescriptorSetHandles)
+    {
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = m_descriptorPool;
         allocInfo.descriptorSetCount = count;
-        allocInfo.pSetLayouts = layouts.data();
+        allocInfo.pSetLayouts = pLayoutHandles;
 
+        // Sets are allocated from the pool's memory.
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_DESCRIPTOR_POOL);
         VkResult result = vkAllocateDescriptorSets(m_context.getLogicalDevice(), &allocInfo, pDescriptorSetHandles);
-        if (result != VK_SUCCESS) {
+        if (result != VK_SUCCESS
+            && result != VK_ERROR_OUT_OF_POOL_MEMORY
+            && result != VK_ERROR_FRAGMENTED_POOL) {
             throw std::runtime_error("Failed to allocate descriptor sets!");
         }
+        return result;
     }
 
     void DescriptorPool::freeDescriptorSets(std::vector<VkDescriptorSet>& descriptorSetHandles)
@@ -6,39 +6,80 @@
 #include "VulkanGraphicsRenderer.h"
 #include "VulkanGraphicsSampler.h"
 #include "VulkanGraphicsSceneNode.h"
+#include "VulkanGraphicsTextureResidencyManager.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
 
 //void vgfx::Renderer::updateCameraDescriptorSet(DescriptorSet& cameraDescriptorSet)
 //{
     // TODO
 //}
 
-void vgfx::Drawable::configureDescriptorSets(
-    DrawContext& drawContext,
-    std::vector<VkDescriptorSet>* pDescriptorSets)
+void vgfx::Drawable::configureDescriptorSets(DrawContext& drawContext)
 {
-    pDescriptorSets->clear();
-    pDescriptorSets->resize(m_pMeshEffect->getDescriptorSetLayouts().size());
-    for (size_t index = 0; index < m_pMeshEffect->getDescriptorSetLayouts().size(); ++index) {
-        const auto& spDescSetLayout = m_pMeshEffect->getDescriptorSetLayouts()[index];
-        
-        VkDescriptorSet* pWritePtr = pDescriptorSets->data() + index;
-        drawContext.descriptorPool.allocateDescriptorSets(
-            *spDescSetLayout.get(), 1, pWritePtr);
+    const auto& descSetLayouts = m_pMeshEffect->getDescriptorSetLayouts();
+    uint32_t materialCount = static_cast<uint32_t>(m_materials.size());
+
+    // Materials that sample the same image, e.g. different layers of a texture array, share a set.
+    std::vector<const ImageSampler*>& uniqueImageSamplers = m_materialSetImageSamplers;
+    uniqueImageSamplers.clear();
+    m_materialDescriptorSetIndices.resize(materialCount);
+    for (uint32_t materialIndex = 0u; materialIndex < materialCount; ++materialIndex) {
+        const ImageSampler& imageSampler = getImageSampler(ImageType::Diffuse, materialIndex);
+        auto findIt =
+            std::find_if(
+                uniqueImageSamplers.begin(),
+                uniqueImageSamplers.end(),
+                [&imageSampler](const ImageSampler* pImageSampler) { return *pImageSampler == imageSampler; });
+        m_materialDescriptorSetIndices[materialIndex] = 1u + static_cast<uint32_t>(findIt - uniqueImageSamplers.begin());
+        if (findIt == uniqueImageSamplers.end()) {
+            uniqueImageSamplers.push_back(&imageSampler);
+        }
     }
+    uint32_t materialSetCount = static_cast<uint32_t>(uniqueImageSamplers.size());
 
-    auto& curViewState = drawContext.sceneState.views.back();
-    // First set is the projection matrix
-    DescriptorSetUpdater updater;
-    updater.bindDescriptor(0, *curViewState.pCameraProjectionBuffer);
-    updater.updateDescriptorSet(drawContext.context, pDescriptorSets->at(0));
+    const DescriptorSetLayout& cameraSetLayout = *descSetLayouts[0].get();
+    const DescriptorSetLayout& materialSetLayout = *descSetLayouts[1].get();
+    // Material sets are pushed by draw() if their layout is a push descriptor layout.
+    bool pushMaterialSets = materialSetLayout.isPushDescriptor();
+    // Sets of descriptor buffer layouts are written straight into the frame's DescriptorBuffer.
+    bool useDescriptorBuffer = cameraSetLayout.isDescriptorBuffer();
 
-    auto& imageSampler = getImageSampler(ImageType::Diffuse);
+    if (useDescriptorBuffer) {
+        // Same order as the sets, camera first and then the materials.
+        m_descriptorBufferOffsets.resize(1u + materialSetCount);
+        drawContext.pDescriptorBuffer->allocateDescriptorSets(
+            cameraSetLayout, 1, m_descriptorBufferOffsets.data());
+        drawContext.pDescriptorBuffer->allocateDescriptorSets(
+            materialSetLayout, materialSetCount, m_descriptorBufferOffsets.data() + 1);
+    } else {
+        // Allocated and written by the batcher once the scene has been traversed. First set is the
+        // camera matrices which are the same for all submeshes.
+        m_firstBatchedSetIndex = drawContext.descriptorBatcher.requestDescriptorSets(cameraSetLayout, 1u);
 
-    CombinedImageSamplerDescriptorUpdater imageSamplerUpdater(*imageSampler.first, *imageSampler.second);
+        // Second set is the material's texture sampler plus the lights, one per unique image sampler.
+        if (!pushMaterialSets) {
+            drawContext.descriptorBatcher.requestDescriptorSets(materialSetLayout, materialSetCount);
+        }
+    }
 
-    // Second set is the texture sampler
-    updater.bindDescriptor(0, imageSamplerUpdater);
-    updater.updateDescriptorSet(drawContext.context, pDescriptorSets->at(1));
+    auto& curViewState = drawContext.sceneState.views.back();
+    if (useDescriptorBuffer) {
+        m_descriptorSetUpdater.clear();
+        m_descriptorSetUpdater.bindDescriptor(0, *curViewState.pCameraProjectionBuffer);
+        m_descriptorSetUpdater.writeDescriptorBuffer(
+            drawContext.context,
+            cameraSetLayout,
+            drawContext.pDescriptorBuffer->getMappedData(m_descriptorBufferOffsets[0]));
+    } else {
+        drawContext.descriptorBatcher.writeBuffer(
+            m_firstBatchedSetIndex,
+            0,
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            curViewState.pCameraProjectionBuffer->getDescriptorBufferInfo());
+    }
 
     auto& translationColumn = curViewState.cameraViewMatrix[3];
     glm::vec3 viewPos(
@@ -68,11 +109,81 @@ void vgfx::Drawable::configureDescriptorSets(
     writeSize = sizeof(lightCount);
     drawContext.sceneState.pLightsBuffer->update(&lightCount, writeSize, writeOffset);
 
-    updater.bindDescriptor(1, *drawContext.sceneState.pLightsBuffer);
-    updater.updateDescriptorSet(drawContext.context, pDescriptorSets->at(1));
+    if (pushMaterialSets) {
+        return;
+    }
+
+    if (useDescriptorBuffer) {
+        for (uint32_t setIndex = 0u; setIndex < materialSetCount; ++setIndex) {
+            const ImageSampler& imageSampler = *uniqueImageSamplers[setIndex];
+
+            CombinedImageSamplerDescriptorUpdater imageSamplerUpdater(*imageSampler.first, *imageSampler.second);
+
+            m_descriptorSetUpdater.clear();
+            m_descriptorSetUpdater.bindDescriptor(0, imageSamplerUpdater);
+            m_descriptorSetUpdater.bindDescriptor(1, *drawContext.sceneState.pLightsBuffer);
+            m_descriptorSetUpdater.writeDescriptorBuffer(
+                drawContext.context,
+                materialSetLayout,
+                drawContext.pDescriptorBuffer->getMappedData(m_descriptorBufferOffsets[1u + setIndex]));
+        }
+    } else {
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        const VkDescriptorBufferInfo& lightsBufferInfo = drawContext.sceneState.pLightsBuffer->getDescriptorBufferInfo();
+
+        for (uint32_t setIndex = 0u; setIndex < materialSetCount; ++setIndex) {
+            const ImageSampler& imageSampler = *uniqueImageSamplers[setIndex];
+            imageInfo.imageView = imageSampler.first->getHandle();
+            imageInfo.sampler = imageSampler.second->getHandle();
+
+            uint32_t batchedSetIndex = m_firstBatchedSetIndex + 1u + setIndex;
+            drawContext.descriptorBatcher.writeImage(
+                batchedSetIndex, 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageInfo);
+            drawContext.descriptorBatcher.writeBuffer(
+                batchedSetIndex, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, lightsBufferInfo);
+        }
+    }
+}
+
+// Approximate height in pixels of the bounding sphere when it is projected by the view, infinite if
+// the bounds are unknown or contain the camera.
+static float ComputeScreenSizePixels(
+    const glm::mat4& worldTransform,
+    const glm::vec4& boundingSphere,
+    const vgfx::ViewState& viewState)
+{
+    float maxScale =
+        std::max(
+            glm::length(glm::vec3(worldTransform[0])),
+            std::max(glm::length(glm::vec3(worldTransform[1])), glm::length(glm::vec3(worldTransform[2]))));
+    float radius = boundingSphere.w * maxScale;
+
+    glm::vec4 viewCenter = viewState.cameraViewMatrix * worldTransform * glm::vec4(glm::vec3(boundingSphere), 1.0f);
+    float distance = glm::length(glm::vec3(viewCenter));
+    if (radius <= 0.0f || distance <= radius) {
+        return std::numeric_limits<float>::infinity();
+    }
+
+    // The projected diameter is 2 * radius / distance * proj[1][1] in NDC, which spans 2 units of
+    // the viewport's height.
+    return (radius / distance) * std::abs(viewState.cameraProjectionMatrix[1][1]) * std::abs(viewState.viewport.height);
 }
 
 void vgfx::Drawable::draw(DrawContext& drawContext)
+{
+    if (m_pTextureResidencyManager != nullptr) {
+        m_pTextureResidencyManager->onDrawn(
+            *this,
+            ComputeScreenSizePixels(m_worldTransform, m_boundingSphere, drawContext.sceneState.views.back()));
+    }
+
+    configureDescriptorSets(drawContext);
+
+    drawContext.drawQueue.push_back(this);
+}
+
+void vgfx::Drawable::recordDraw(DrawContext& drawContext)
 {
     // TODO sort Drawables by pipeline and only bind once for each unique
     VkCommandBuffer commandBuffer = drawContext.commandBuffer;
@@ -81,51 +192,147 @@ void vgfx::Drawable::draw(DrawContext& drawContext)
         VK_PIPELINE_BIND_POINT_GRAPHICS,
         m_pMeshEffect->getPipeline().getHandle());
 
-    configureDescriptorSets(drawContext, &m_descriptorSets);
+    const VkDescriptorSet* pDescriptorSets = nullptr;
+    bool useDescriptorBuffer = m_pMeshEffect->getDescriptorSetLayouts()[0]->isDescriptorBuffer();
+    if (useDescriptorBuffer) {
+        drawContext.pDescriptorBuffer->setDescriptorSetOffsets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_pMeshEffect->getPipeline().getLayout(),
+            0u, // first set
+            1u,
+            m_descriptorBufferOffsets.data());
+    } else {
+        pDescriptorSets = drawContext.descriptorBatcher.getDescriptorSets(m_firstBatchedSetIndex);
+        vkCmdBindDescriptorSets(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_GRAPHICS,
+            m_pMeshEffect->getPipeline().getLayout(),
+            0u, // Offset in descriptor array
+            1u,
+            pDescriptorSets,
+            0u, // dynamic sets count
+            nullptr); // dynamic sets ptr
+    }
 
-    vkCmdBindDescriptorSets(
-        commandBuffer,
-        VK_PIPELINE_BIND_POINT_GRAPHICS,
-        m_pMeshEffect->getPipeline().getLayout(),
-        0u, // Offset in descriptor array
-        static_cast<uint32_t>(m_descriptorSets.size()),
-        m_descriptorSets.data(),
-        0u, // dynamic sets count
-        nullptr); // dynamic sets ptr
-
-    glm::mat4 pushConstants[2] = {
-        m_worldTransform,
-        drawContext.sceneState.views.back().cameraViewMatrix
-    };
-
-    vkCmdPushConstants(
-        commandBuffer,
-        m_pMeshEffect->getPipeline().getLayout(),
-        VK_SHADER_STAGE_VERTEX_BIT,
-        0,
-        sizeof(pushConstants),
-        static_cast<void*>(pushConstants));
-
-    VkBuffer vertexBuffers[] = { m_vertexBuffer.getHandle() };
-    VkDeviceSize offsets[] = { 0 };
-    vkCmdBindVertexBuffers(
-        commandBuffer,
-        0, // first binding
-        1, // count
-        vertexBuffers,
-        offsets);
+    // All submeshes share the same vertex and index buffer, so bind them once. Drawables whose
+    // geometry is suballocated from the same arena buffers share the binding as well.
+    VkBuffer vertexBuffer = m_vertexBuffer.getHandle();
+    if (drawContext.boundVertexBuffer != vertexBuffer) {
+        VkBuffer vertexBuffers[] = { vertexBuffer };
+        VkDeviceSize offsets[] = { 0 };
+        vkCmdBindVertexBuffers(
+            commandBuffer,
+            0, // first binding
+            1, // count
+            vertexBuffers,
+            offsets);
+        drawContext.boundVertexBuffer = vertexBuffer;
+    }
 
-    vkCmdBindIndexBuffer(
-        commandBuffer,
-        m_indexBuffer.getHandle(),
-        0, // Offset
-        m_indexBuffer.getType());
+    VkBuffer indexBuffer = m_indexBuffer.getHandle();
+    if (drawContext.boundIndexBuffer != indexBuffer || drawContext.boundIndexType != m_indexBuffer.getType()) {
+        vkCmdBindIndexBuffer(
+            commandBuffer,
+            indexBuffer,
+            0, // Offset
+            m_indexBuffer.getType());
+        drawContext.boundIndexBuffer = indexBuffer;
+        drawContext.boundIndexType = m_indexBuffer.getType();
+    }
 
-    vkCmdDrawIndexed(
-        commandBuffer,
-        m_indexBuffer.getCount(),
-        1, // instance count
-        0, // first index
-        0, // vertex offset
-        0); // first instance
+    uint32_t firstIndex = m_indexBuffer.getFirstIndex();
+    int32_t firstVertex = m_vertexBuffer.getFirstVertex();
+
+    VkPipelineLayout pipelineLayout = m_pMeshEffect->getPipeline().getLayout();
+    MeshEffectPushConstants pushConstants;
+
+    bool pushMaterialSets = m_pMeshEffect->getDescriptorSetLayouts()[1]->isPushDescriptor();
+    uint32_t boundSetIndex = UINT32_MAX;
+    const glm::mat4* pPushedTransform = nullptr;
+    uint32_t pushedRegionMaterialIndex = UINT32_MAX;
+    for (const auto& subMesh : m_subMeshes) {
+        // Only push the world transform when it changes, most models have a single transform.
+        if (pPushedTransform == nullptr || *pPushedTransform != subMesh.transform) {
+            pushConstants.world = m_worldTransform * subMesh.transform;
+
+            vkCmdPushConstants(
+                commandBuffer,
+                pipelineLayout,
+                VK_SHADER_STAGE_VERTEX_BIT,
+                offsetof(MeshEffectPushConstants, world),
+                sizeof(pushConstants.world),
+                static_cast<void*>(&pushConstants.world));
+
+            pPushedTransform = &subMesh.transform;
+        }
+
+        // Materials that were packed into the same image only differ by their texture region.
+        if (subMesh.materialIndex != pushedRegionMaterialIndex) {
+            TextureRegion textureRegion = getTextureRegion(ImageType::Diffuse, subMesh.materialIndex);
+            glm::vec4 uvScaleOffset(textureRegion.uvScale, textureRegion.uvOffset);
+            if (pushedRegionMaterialIndex == UINT32_MAX
+                || pushConstants.uvScaleOffset != uvScaleOffset
+                || pushConstants.textureLayer != textureRegion.layer) {
+                pushConstants.uvScaleOffset = uvScaleOffset;
+                pushConstants.textureLayer = textureRegion.layer;
+
+                vkCmdPushConstants(
+                    commandBuffer,
+                    pipelineLayout,
+                    VK_SHADER_STAGE_VERTEX_BIT,
+                    offsetof(MeshEffectPushConstants, uvScaleOffset),
+                    sizeof(MeshEffectPushConstants) - offsetof(MeshEffectPushConstants, uvScaleOffset),
+                    static_cast<void*>(&pushConstants.uvScaleOffset));
+            }
+            pushedRegionMaterialIndex = subMesh.materialIndex;
+        }
+
+        uint32_t setIndex = m_materialDescriptorSetIndices[subMesh.materialIndex];
+        if (setIndex != boundSetIndex) {
+            if (pushMaterialSets) {
+                // Written straight into the command buffer, replacing the previous material's.
+                const ImageSampler& imageSampler = *m_materialSetImageSamplers[setIndex - 1u];
+                CombinedImageSamplerDescriptorUpdater imageSamplerUpdater(*imageSampler.first, *imageSampler.second);
+
+                m_descriptorSetUpdater.clear();
+                m_descriptorSetUpdater.bindDescriptor(0, imageSamplerUpdater);
+                m_descriptorSetUpdater.bindDescriptor(1, *drawContext.sceneState.pLightsBuffer);
+                m_descriptorSetUpdater.pushDescriptorSet(
+                    drawContext.context,
+                    commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout,
+                    1u);
+            } else if (useDescriptorBuffer) {
+                drawContext.pDescriptorBuffer->setDescriptorSetOffsets(
+                    commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout,
+                    1u, // first set
+                    1u,
+                    &m_descriptorBufferOffsets[setIndex]);
+            } else {
+                vkCmdBindDescriptorSets(
+                    commandBuffer,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    pipelineLayout,
+                    1u, // Offset in descriptor array
+                    1u,
+                    &pDescriptorSets[setIndex],
+                    0u, // dynamic sets count
+                    nullptr); // dynamic sets ptr
+            }
+
+            boundSetIndex = setIndex;
+        }
+
+        vkCmdDrawIndexed(
+            commandBuffer,
+            subMesh.indexCount,
+            1, // instance count
+            firstIndex + subMesh.firstIndex,
+            firstVertex + subMesh.vertexOffset,
+            0); // first instance
+    }
 }
@@ -133,17 +133,24 @@ namespace vgfx
 
         std::vector<std::unique_ptr<DescriptorSetLayout>> descriptorSetLayouts;
         descriptorSetLayouts.reserve(2);
-        descriptorSetLayouts.emplace_back(std::make_unique<DescriptorSetLayout>(context, vertShaderBindings));
-        descriptorSetLayouts.emplace_back(std::make_unique<DescriptorSetLayout>(context, fragShaderBindings));
-
-        struct ModelParams {
-            glm::mat4 world = glm::identity<glm::mat4>();
-            glm::mat4 view = glm::identity<glm::mat4>();
-        };
+        // The material's bindings change with each draw, so they are pushed rather than allocated
+        // when push descriptors are supported, unless all of the sets are in descriptor buffers.
+        VkDescriptorSetLayoutCreateFlags cameraSetFlags = 0u;
+        VkDescriptorSetLayoutCreateFlags materialSetFlags = 0u;
+        if (context.areDescriptorBuffersEnabled()) {
+            cameraSetFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+            materialSetFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+        } else if (context.arePushDescriptorsSupported()) {
+            materialSetFlags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+        }
+        descriptorSetLayouts.emplace_back(
+            std::make_unique<DescriptorSetLayout>(context, vertShaderBindings, cameraSetFlags));
+        descriptorSetLayouts.emplace_back(
+            std::make_unique<DescriptorSetLayout>(context, fragShaderBindings, materialSetFlags));
 
         VkPushConstantRange pushConstantRange = {};
         pushConstantRange.offset = 0;
-        pushConstantRange.size = sizeof(ModelParams);
+        pushConstantRange.size = sizeof(MeshEffectPushConstants);
         pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
         std::vector<VkPushConstantRange> pushConstantRanges = { pushConstantRange };
@@ -0,0 +1,488 @@
+#include "VulkanGraphicsGeometryArena.h"
+
+#include "VulkanGraphicsIndexBuffer.h"
+#include "VulkanGraphicsOneTimeCommands.h"
+#include "VulkanGraphicsRetirementQueue.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <set>
+#include <stdexcept>
+
+namespace vgfx
+{
+    struct GeometryArenaBlock
+    {
+        MemoryAllocator::Buffer buffer;
+        uint32_t capacity = 0u;
+        // First element of each free range to its element count, ordered by first element so
+        // that adjacent free ranges can be coalesced.
+        std::map<uint32_t, uint32_t> freeRanges;
+    };
+
+    struct GeometryArenaPool
+    {
+        uint32_t elementSizeBytes = 0u;
+        uint32_t elementsPerBlock = 0u;
+        VkBufferUsageFlags usage = 0u;
+        const char* pName = nullptr;
+        std::vector<std::unique_ptr<GeometryArenaBlock>> blocks;
+        std::set<GeometryRange*> ranges;
+    };
+
+    // Best fit search of the free list, returns false if no free range is large enough.
+    static bool AllocateFromFreeRanges(
+        std::map<uint32_t, uint32_t>& freeRanges,
+        uint32_t elementCount,
+        uint32_t* pFirstElement)
+    {
+        auto bestIt = freeRanges.end();
+        for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+            if (it->second >= elementCount
+                && (bestIt == freeRanges.end() || it->second < bestIt->second)) {
+                bestIt = it;
+                if (it->second == elementCount) {
+                    break;
+                }
+            }
+        }
+
+        if (bestIt == freeRanges.end()) {
+            return false;
+        }
+
+        *pFirstElement = bestIt->first;
+        uint32_t remainingCount = bestIt->second - elementCount;
+        freeRanges.erase(bestIt);
+        if (remainingCount > 0u) {
+            freeRanges[*pFirstElement + elementCount] = remainingCount;
+        }
+        return true;
+    }
+
+    static void ReturnToFreeRanges(
+        std::map<uint32_t, uint32_t>& freeRanges,
+        uint32_t firstElement,
+        uint32_t elementCount)
+    {
+        auto nextIt = freeRanges.lower_bound(firstElement);
+        if (nextIt != freeRanges.end() && firstElement + elementCount == nextIt->first) {
+            elementCount += nextIt->second;
+            nextIt = freeRanges.erase(nextIt);
+        }
+
+        if (nextIt != freeRanges.begin()) {
+            auto prevIt = std::prev(nextIt);
+            if (prevIt->first + prevIt->second == firstElement) {
+                prevIt->second += elementCount;
+                return;
+            }
+        }
+
+        freeRanges[firstElement] = elementCount;
+    }
+
+    static bool BlockIsEmpty(const GeometryArenaBlock& block)
+    {
+        return block.freeRanges.size() == 1u && block.freeRanges.begin()->second == block.capacity;
+    }
+
+    // A pool is fragmented if any of its blocks have free space that is not at the end of the
+    // block, or if its ranges would fit into fewer blocks.
+    static bool PoolIsFragmented(const GeometryArenaPool& pool)
+    {
+        uint64_t usedElements = 0u;
+        uint64_t capacity = 0u;
+        for (const auto& spBlock : pool.blocks) {
+            const auto& freeRanges = spBlock->freeRanges;
+            if (freeRanges.size() > 1u) {
+                return true;
+            }
+            if (freeRanges.size() == 1u) {
+                const auto& freeRange = *freeRanges.begin();
+                if (freeRange.first + freeRange.second != spBlock->capacity) {
+                    return true;
+                }
+                usedElements += freeRange.first;
+            } else {
+                usedElements += spBlock->capacity;
+            }
+            capacity += spBlock->capacity;
+        }
+
+        return pool.blocks.size() > 1u && capacity - usedElements >= pool.elementsPerBlock;
+    }
+
+    static bool PoolIsMostlyFree(const GeometryArenaPool& pool, float freeFraction)
+    {
+        uint64_t capacity = 0u;
+        for (const auto& spBlock : pool.blocks) {
+            capacity += spBlock->capacity;
+        }
+        uint64_t usedElements = 0u;
+        for (const GeometryRange* pRange : pool.ranges) {
+            usedElements += pRange->getElementCount();
+        }
+        return static_cast<double>(capacity - usedElements) >= static_cast<double>(capacity) * freeFraction;
+    }
+
+    GeometryArena::GeometryArena(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        const Config& config)
+        : m_context(context)
+        , m_commandBufferFactory(commandBufferFactory)
+        , m_config(config)
+    {
+    }
+
+    GeometryArena::~GeometryArena()
+    {
+        // Ranges that are waiting for frames in flight are released through the arena.
+        RetirementQueue* pRetirementQueue = m_context.getRetirementQueue();
+        if (pRetirementQueue != nullptr && !m_pendingFrees.empty()) {
+            pRetirementQueue->flush();
+        }
+
+        for (auto& poolIt : m_pools) {
+            // All ranges should have been freed by their owners.
+            assert(poolIt.second->ranges.empty());
+            for (auto& spBlock : poolIt.second->blocks) {
+                destroyBlock(*spBlock.get());
+            }
+        }
+    }
+
+    GeometryRange& GeometryArena::allocateVertices(
+        const VertexBuffer::Config& vertexConfig,
+        const void* pVertexData,
+        uint32_t vertexCount)
+    {
+        // Vertices are only shared between meshes with identical layouts, so that the same
+        // pipeline vertex input state can be used for everything in the pool.
+        PoolKey poolKey = { 0u, vertexConfig.vertexStride };
+        for (const auto& attr : vertexConfig.vertexAttrDescriptions) {
+            poolKey.push_back(static_cast<uint32_t>(attr.format));
+            poolKey.push_back(attr.offset);
+        }
+
+        return allocate(
+            poolKey,
+            vertexConfig.vertexStride,
+            m_config.verticesPerBlock,
+            VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+            pVertexData,
+            vertexCount);
+    }
+
+    GeometryRange& GeometryArena::allocateIndices(
+        VkIndexType indexType,
+        const void* pIndexData,
+        uint32_t indexCount)
+    {
+        PoolKey poolKey = { 1u, static_cast<uint32_t>(indexType) };
+
+        return allocate(
+            poolKey,
+            static_cast<uint32_t>(IndexTypeSizeBytes(indexType)),
+            m_config.indicesPerBlock,
+            VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            pIndexData,
+            indexCount);
+    }
+
+    GeometryRange& GeometryArena::allocate(
+        const PoolKey& poolKey,
+        uint32_t elementSizeBytes,
+        uint32_t elementsPerBlock,
+        VkBufferUsageFlags usage,
+        const void* pData,
+        uint32_t elementCount)
+    {
+        if (elementCount == 0u) {
+            throw std::runtime_error("GeometryArena allocation must not be empty!");
+        }
+
+        auto& spPool = m_pools[poolKey];
+        if (spPool == nullptr) {
+            spPool = std::make_unique<GeometryArenaPool>();
+            spPool->elementSizeBytes = elementSizeBytes;
+            spPool->elementsPerBlock = elementsPerBlock;
+            spPool->usage = usage;
+            spPool->pName = (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) != 0 ?
+                "GeometryArenaVertices" : "GeometryArenaIndices";
+        }
+        GeometryArenaPool& pool = *spPool.get();
+
+        GeometryArenaBlock* pBlock = nullptr;
+        uint32_t firstElement = 0u;
+        for (auto& spBlock : pool.blocks) {
+            if (AllocateFromFreeRanges(spBlock->freeRanges, elementCount, &firstElement)) {
+                pBlock = spBlock.get();
+                break;
+            }
+        }
+
+        if (pBlock == nullptr) {
+            pBlock = &createBlock(pool, std::max(elementCount, pool.elementsPerBlock));
+            AllocateFromFreeRanges(pBlock->freeRanges, elementCount, &firstElement);
+        }
+
+        auto spRange = std::make_unique<GeometryRange>();
+        spRange->m_pPool = &pool;
+        spRange->m_pBlock = pBlock;
+        spRange->m_buffer = pBlock->buffer.handle;
+        spRange->m_firstElement = firstElement;
+        spRange->m_elementCount = elementCount;
+
+        GeometryRange* pRange = spRange.release();
+        pool.ranges.insert(pRange);
+
+        if (pData != nullptr) {
+            write(*pRange, pData, 0u, elementCount);
+        }
+        return *pRange;
+    }
+
+    void GeometryArena::write(
+        GeometryRange& range,
+        const void* pData,
+        uint32_t firstElement,
+        uint32_t elementCount)
+    {
+        assert(firstElement + elementCount <= range.m_elementCount);
+        uint32_t elementSizeBytes = range.m_pPool->elementSizeBytes;
+
+        OneTimeCommandsHelper helper(m_context, m_commandBufferFactory);
+        helper.copyDataToBuffer(
+            range.m_pBlock->buffer,
+            pData,
+            static_cast<VkDeviceSize>(elementCount) * elementSizeBytes,
+            static_cast<VkDeviceSize>(range.m_firstElement + firstElement) * elementSizeBytes);
+    }
+
+    void GeometryArena::free(GeometryRange& range)
+    {
+        uint64_t pendingFreeId = m_nextPendingFreeId++;
+        m_pendingFrees[pendingFreeId] = { range.m_pPool, range.m_pBlock, range.m_firstElement, range.m_elementCount };
+
+        range.m_pPool->ranges.erase(&range);
+        delete &range;
+
+        // Frames in flight may still read the range, so it isn't reallocated until they complete.
+        m_context.retire([this, pendingFreeId]() {
+            releaseRange(pendingFreeId);
+        });
+    }
+
+    void GeometryArena::releaseRange(uint64_t pendingFreeId)
+    {
+        auto findIt = m_pendingFrees.find(pendingFreeId);
+        if (findIt == m_pendingFrees.end()) {
+            // Its block was replaced when the pool was defragmented.
+            return;
+        }
+        GeometryArenaPool& pool = *findIt->second.pPool;
+        GeometryArenaBlock& block = *findIt->second.pBlock;
+        ReturnToFreeRanges(block.freeRanges, findIt->second.firstElement, findIt->second.elementCount);
+        m_pendingFrees.erase(findIt);
+
+        // Release blocks that are completely free, but keep one around to avoid thrashing.
+        if (pool.blocks.size() > 1u && BlockIsEmpty(block)) {
+            destroyBlock(block);
+            pool.blocks.erase(
+                std::find_if(pool.blocks.begin(), pool.blocks.end(), [&block](const auto& spBlock) {
+                    return spBlock.get() == &block;
+                }));
+        }
+    }
+
+    GeometryArenaBlock& GeometryArena::createBlock(GeometryArenaPool& pool, uint32_t capacity)
+    {
+        auto spBlock = std::make_unique<GeometryArenaBlock>();
+        spBlock->capacity = capacity;
+        spBlock->freeRanges[0u] = capacity;
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = static_cast<VkDeviceSize>(capacity) * pool.elementSizeBytes;
+        bufferCreateInfo.usage = pool.usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        MemoryAllocator& memoryAllocator = m_context.getMemoryAllocator();
+        spBlock->buffer =
+            memoryAllocator.createBuffer(
+                bufferCreateInfo,
+                VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY,
+                pool.pName,
+                MemoryAllocator::AllocationClass::Static);
+
+        // The Defragmenter can move the block within the static pools, then its ranges must refer
+        // to the new buffer too.
+        GeometryArenaBlock* pBlock = spBlock.get();
+        memoryAllocator.setMovable(spBlock->buffer, bufferCreateInfo, [&pool, pBlock](VkBuffer newHandle) {
+            pBlock->buffer.handle = newHandle;
+            for (GeometryRange* pRange : pool.ranges) {
+                if (pRange->m_pBlock == pBlock) {
+                    pRange->m_buffer = newHandle;
+                }
+            }
+        });
+
+        pool.blocks.push_back(std::move(spBlock));
+        return *pool.blocks.back().get();
+    }
+
+    void GeometryArena::destroyBlock(GeometryArenaBlock& block)
+    {
+        if (block.buffer.isValid()) {
+            MemoryAllocator& memoryAllocator = m_context.getMemoryAllocator();
+            memoryAllocator.clearMovable(block.buffer.allocation);
+            // Frames in flight may still read it.
+            m_context.retire([&memoryAllocator, buffer = block.buffer]() mutable {
+                memoryAllocator.destroyBuffer(buffer);
+            });
+            block.buffer = MemoryAllocator::Buffer();
+        }
+    }
+
+    VkDeviceSize GeometryArena::defragment()
+    {
+        VkDeviceSize bytesMoved = 0u;
+        for (auto& poolIt : m_pools) {
+            GeometryArenaPool& pool = *poolIt.second.get();
+            if (PoolIsFragmented(pool)) {
+                bytesMoved += defragmentPool(pool);
+            }
+        }
+        return bytesMoved;
+    }
+
+    void GeometryArena::update()
+    {
+        for (auto& poolIt : m_pools) {
+            GeometryArenaPool& pool = *poolIt.second.get();
+            if (PoolIsFragmented(pool) && PoolIsMostlyFree(pool, m_config.defragmentFreeFraction)) {
+                defragmentPool(pool);
+            }
+        }
+    }
+
+    VkDeviceSize GeometryArena::defragmentPool(GeometryArenaPool& pool)
+    {
+        // Pack the ranges in their current order so that neighbouring meshes stay neighbours.
+        std::map<const GeometryArenaBlock*, size_t> blockOrder;
+        for (size_t i = 0; i < pool.blocks.size(); ++i) {
+            blockOrder[pool.blocks[i].get()] = i;
+        }
+
+        std::vector<GeometryRange*> ranges(pool.ranges.begin(), pool.ranges.end());
+        std::sort(ranges.begin(), ranges.end(), [&blockOrder](const GeometryRange* pLhs, const GeometryRange* pRhs) {
+            size_t lhsBlock = blockOrder.at(pLhs->m_pBlock);
+            size_t rhsBlock = blockOrder.at(pRhs->m_pBlock);
+            return lhsBlock != rhsBlock ? lhsBlock < rhsBlock : pLhs->m_firstElement < pRhs->m_firstElement;
+        });
+
+        std::vector<std::unique_ptr<GeometryArenaBlock>> oldBlocks;
+        oldBlocks.swap(pool.blocks);
+
+        // Ranges that are waiting for frames in flight were freed in the old blocks, which are
+        // retired instead.
+        for (auto pendingIt = m_pendingFrees.begin(); pendingIt != m_pendingFrees.end();) {
+            if (pendingIt->second.pPool == &pool) {
+                pendingIt = m_pendingFrees.erase(pendingIt);
+            } else {
+                ++pendingIt;
+            }
+        }
+
+        struct RangeMove
+        {
+            GeometryRange* pRange;
+            GeometryArenaBlock* pDstBlock;
+            uint32_t dstFirstElement;
+        };
+        std::vector<RangeMove> moves;
+        moves.reserve(ranges.size());
+
+        GeometryArenaBlock* pDstBlock = nullptr;
+        for (GeometryRange* pRange : ranges) {
+            uint32_t dstFirstElement = 0u;
+            if (pDstBlock == nullptr
+                || !AllocateFromFreeRanges(pDstBlock->freeRanges, pRange->m_elementCount, &dstFirstElement)) {
+                pDstBlock = &createBlock(pool, std::max(pRange->m_elementCount, pool.elementsPerBlock));
+                AllocateFromFreeRanges(pDstBlock->freeRanges, pRange->m_elementCount, &dstFirstElement);
+            }
+            moves.push_back({ pRange, pDstBlock, dstFirstElement });
+        }
+
+        if (pool.blocks.empty()) {
+            createBlock(pool, pool.elementsPerBlock);
+        }
+
+        // Merge the copies between each pair of buffers into one vkCmdCopyBuffer.
+        std::map<std::pair<VkBuffer, VkBuffer>, std::vector<VkBufferCopy>> copies;
+        VkDeviceSize bytesMoved = 0u;
+        for (const auto& move : moves) {
+            VkBufferCopy copyRegion = {};
+            copyRegion.srcOffset = static_cast<VkDeviceSize>(move.pRange->m_firstElement) * pool.elementSizeBytes;
+            copyRegion.dstOffset = static_cast<VkDeviceSize>(move.dstFirstElement) * pool.elementSizeBytes;
+            copyRegion.size = static_cast<VkDeviceSize>(move.pRange->m_elementCount) * pool.elementSizeBytes;
+            copies[std::make_pair(move.pRange->m_buffer, move.pDstBlock->buffer.handle)].push_back(copyRegion);
+            bytesMoved += copyRegion.size;
+        }
+
+        if (!copies.empty()) {
+            OneTimeCommandsHelper helper(m_context, m_commandBufferFactory);
+            helper.execute(
+                [&copies](VkCommandBuffer commandBuffer) {
+                    for (const auto& buffersAndRegions : copies) {
+                        vkCmdCopyBuffer(
+                            commandBuffer,
+                            buffersAndRegions.first.first,
+                            buffersAndRegions.first.second,
+                            static_cast<uint32_t>(buffersAndRegions.second.size()),
+                            buffersAndRegions.second.data());
+                    }
+                });
+        }
+
+        // Patch the ranges so that the drawables referencing them use the new locations.
+        for (const auto& move : moves) {
+            move.pRange->m_pBlock = move.pDstBlock;
+            move.pRange->m_buffer = move.pDstBlock->buffer.handle;
+            move.pRange->m_firstElement = move.dstFirstElement;
+        }
+
+        for (auto& spBlock : oldBlocks) {
+            destroyBlock(*spBlock.get());
+        }
+
+        ++m_defragmentedPoolCount;
+        m_movedBytes += bytesMoved;
+
+        return bytesMoved;
+    }
+
+    GeometryArena::Stats GeometryArena::getStats() const
+    {
+        Stats stats;
+        stats.poolCount = static_cast<uint32_t>(m_pools.size());
+        stats.defragmentedPoolCount = m_defragmentedPoolCount;
+        stats.movedBytes = m_movedBytes;
+        for (const auto& poolIt : m_pools) {
+            const GeometryArenaPool& pool = *poolIt.second.get();
+            stats.blockCount += static_cast<uint32_t>(pool.blocks.size());
+            stats.rangeCount += static_cast<uint32_t>(pool.ranges.size());
+            for (const auto& spBlock : pool.blocks) {
+                stats.freeRangeCount += static_cast<uint32_t>(spBlock->freeRanges.size());
+                stats.capacityBytes += static_cast<VkDeviceSize>(spBlock->capacity) * pool.elementSizeBytes;
+            }
+            for (const GeometryRange* pRange : pool.ranges) {
+                stats.usedBytes += static_cast<VkDeviceSize>(pRange->getElementCount()) * pool.elementSizeBytes;
+            }
+        }
+        return stats;
+    }
+}
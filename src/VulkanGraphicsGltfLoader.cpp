@@ -0,0 +1,949 @@
+#include "VulkanGraphicsGltfLoader.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace vgfx
+{
+    // glTF component types (same values as the GL enums).
+    constexpr static uint32_t k_gltfByte = 5120u;
+    constexpr static uint32_t k_gltfUnsignedByte = 5121u;
+    constexpr static uint32_t k_gltfShort = 5122u;
+    constexpr static uint32_t k_gltfUnsignedShort = 5123u;
+    constexpr static uint32_t k_gltfUnsignedInt = 5125u;
+    constexpr static uint32_t k_gltfFloat = 5126u;
+
+    constexpr static uint32_t k_gltfModeTriangles = 4u;
+
+    constexpr static uint32_t k_glbMagic = 0x46546C67u; // "glTF"
+    constexpr static uint32_t k_glbChunkJson = 0x4E4F534Au; // "JSON"
+    constexpr static uint32_t k_glbChunkBin = 0x004E4942u; // "BIN\0"
+
+    // Minimal DOM for the glTF JSON, only what is required to read the glTF schema.
+    struct GltfJson
+    {
+        enum class Type
+        {
+            Null,
+            Bool,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0.0;
+        std::string string;
+        // Array elements, or object member values.
+        std::vector<GltfJson> values;
+        // Object member names, same size as values.
+        std::vector<std::string> names;
+
+        const GltfJson* find(const char* pName) const
+        {
+            if (type != Type::Object) {
+                return nullptr;
+            }
+            for (size_t i = 0; i < names.size(); ++i) {
+                if (names[i] == pName) {
+                    return &values[i];
+                }
+            }
+            return nullptr;
+        }
+
+        size_t size() const { return type == Type::Array ? values.size() : 0u; }
+
+        double getNumber(const char* pName, double defaultValue) const
+        {
+            const GltfJson* pValue = find(pName);
+            return (pValue != nullptr && pValue->type == Type::Number) ? pValue->number : defaultValue;
+        }
+
+        int64_t getInt(const char* pName, int64_t defaultValue) const
+        {
+            return static_cast<int64_t>(getNumber(pName, static_cast<double>(defaultValue)));
+        }
+
+        bool getBool(const char* pName, bool defaultValue) const
+        {
+            const GltfJson* pValue = find(pName);
+            return (pValue != nullptr && pValue->type == Type::Bool) ? pValue->boolean : defaultValue;
+        }
+
+        std::string getString(const char* pName) const
+        {
+            const GltfJson* pValue = find(pName);
+            return (pValue != nullptr && pValue->type == Type::String) ? pValue->string : std::string();
+        }
+
+        const GltfJson& getArray(const char* pName) const
+        {
+            static const GltfJson s_emptyArray = { Type::Array };
+            const GltfJson* pValue = find(pName);
+            return (pValue != nullptr && pValue->type == Type::Array) ? *pValue : s_emptyArray;
+        }
+    };
+
+    class GltfJsonParser
+    {
+    public:
+        GltfJsonParser(const char* pBegin, const char* pEnd) : m_p(pBegin), m_pEnd(pEnd) {}
+
+        bool parse(GltfJson* pRoot)
+        {
+            if (!parseValue(pRoot, 0u)) {
+                return false;
+            }
+            skipSpaces();
+            return m_p == m_pEnd;
+        }
+
+    private:
+        constexpr static uint32_t k_maxDepth = 256u;
+
+        void skipSpaces()
+        {
+            while (m_p < m_pEnd && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) {
+                ++m_p;
+            }
+        }
+
+        bool consume(char c)
+        {
+            skipSpaces();
+            if (m_p < m_pEnd && *m_p == c) {
+                ++m_p;
+                return true;
+            }
+            return false;
+        }
+
+        bool consumeLiteral(const char* pLiteral)
+        {
+            size_t length = strlen(pLiteral);
+            if (static_cast<size_t>(m_pEnd - m_p) >= length && memcmp(m_p, pLiteral, length) == 0) {
+                m_p += length;
+                return true;
+            }
+            return false;
+        }
+
+        static void AppendUtf8(uint32_t codePoint, std::string* pOut)
+        {
+            if (codePoint < 0x80u) {
+                pOut->push_back(static_cast<char>(codePoint));
+            } else if (codePoint < 0x800u) {
+                pOut->push_back(static_cast<char>(0xC0u | (codePoint >> 6)));
+                pOut->push_back(static_cast<char>(0x80u | (codePoint & 0x3Fu)));
+            } else {
+                pOut->push_back(static_cast<char>(0xE0u | (codePoint >> 12)));
+                pOut->push_back(static_cast<char>(0x80u | ((codePoint >> 6) & 0x3Fu)));
+                pOut->push_back(static_cast<char>(0x80u | (codePoint & 0x3Fu)));
+            }
+        }
+
+        bool parseString(std::string* pOut)
+        {
+            if (!consume('"')) {
+                return false;
+            }
+            while (m_p < m_pEnd && *m_p != '"') {
+                if (*m_p != '\\') {
+                    pOut->push_back(*m_p++);
+                    continue;
+                }
+
+                ++m_p;
+                if (m_p == m_pEnd) {
+                    return false;
+                }
+                char escaped = *m_p++;
+                switch (escaped) {
+                case 'b': pOut->push_back('\b'); break;
+                case 'f': pOut->push_back('\f'); break;
+                case 'n': pOut->push_back('\n'); break;
+                case 'r': pOut->push_back('\r'); break;
+                case 't': pOut->push_back('\t'); break;
+                case 'u': {
+                    if (m_pEnd - m_p < 4) {
+                        return false;
+                    }
+                    char hex[5] = { m_p[0], m_p[1], m_p[2], m_p[3], '\0' };
+                    AppendUtf8(static_cast<uint32_t>(strtoul(hex, nullptr, 16)), pOut);
+                    m_p += 4;
+                    break;
+                }
+                default: pOut->push_back(escaped); break;
+                }
+            }
+            return consume('"');
+        }
+
+        bool parseValue(GltfJson* pValue, uint32_t depth)
+        {
+            if (depth > k_maxDepth) {
+                return false;
+            }
+
+            skipSpaces();
+            if (m_p == m_pEnd) {
+                return false;
+            }
+
+            if (*m_p == '{') {
+                ++m_p;
+                pValue->type = GltfJson::Type::Object;
+                if (consume('}')) {
+                    return true;
+                }
+                do {
+                    pValue->names.emplace_back();
+                    pValue->values.emplace_back();
+                    if (!parseString(&pValue->names.back())
+                        || !consume(':')
+                        || !parseValue(&pValue->values.back(), depth + 1u)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume('}');
+            } else if (*m_p == '[') {
+                ++m_p;
+                pValue->type = GltfJson::Type::Array;
+                if (consume(']')) {
+                    return true;
+                }
+                do {
+                    pValue->values.emplace_back();
+                    if (!parseValue(&pValue->values.back(), depth + 1u)) {
+                        return false;
+                    }
+                } while (consume(','));
+                return consume(']');
+            } else if (*m_p == '"') {
+                pValue->type = GltfJson::Type::String;
+                return parseString(&pValue->string);
+            } else if (consumeLiteral("true")) {
+                pValue->type = GltfJson::Type::Bool;
+                pValue->boolean = true;
+                return true;
+            } else if (consumeLiteral("false")) {
+                pValue->type = GltfJson::Type::Bool;
+                return true;
+            } else if (consumeLiteral("null")) {
+                return true;
+            }
+
+            // The JSON chunk is not null terminated, so copy the number's characters before strtod.
+            const char* pNumberEnd = m_p;
+            while (pNumberEnd < m_pEnd && strchr("+-0123456789.eE", *pNumberEnd) != nullptr) {
+                ++pNumberEnd;
+            }
+            if (pNumberEnd == m_p) {
+                return false;
+            }
+            std::string number(m_p, pNumberEnd);
+            pValue->type = GltfJson::Type::Number;
+            pValue->number = strtod(number.c_str(), nullptr);
+            m_p = pNumberEnd;
+            return true;
+        }
+
+        const char* m_p;
+        const char* m_pEnd;
+    };
+
+    static bool ReadGltfFile(const std::string& filePath, std::vector<uint8_t>* pDataOut)
+    {
+        std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+        if (!file) {
+            return false;
+        }
+        std::streamsize fileSize = file.tellg();
+        file.seekg(0, std::ios::beg);
+        pDataOut->resize(static_cast<size_t>(fileSize));
+        return fileSize == 0 || file.read(reinterpret_cast<char*>(pDataOut->data()), fileSize).good();
+    }
+
+    static bool DecodeBase64(const char* pBegin, const char* pEnd, std::vector<uint8_t>* pDataOut)
+    {
+        static int8_t s_decodeTable[256] = {};
+        static bool s_tableInitialized = false;
+        if (!s_tableInitialized) {
+            const char* pAlphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            std::fill(std::begin(s_decodeTable), std::end(s_decodeTable), static_cast<int8_t>(-1));
+            for (int8_t i = 0; i < 64; ++i) {
+                s_decodeTable[static_cast<uint8_t>(pAlphabet[i])] = i;
+            }
+            s_tableInitialized = true;
+        }
+
+        pDataOut->reserve(((pEnd - pBegin) / 4) * 3);
+        uint32_t accumulator = 0u;
+        int32_t bitCount = 0;
+        for (const char* p = pBegin; p < pEnd && *p != '='; ++p) {
+            int8_t value = s_decodeTable[static_cast<uint8_t>(*p)];
+            if (value < 0) {
+                return false;
+            }
+            accumulator = (accumulator << 6) | static_cast<uint32_t>(value);
+            bitCount += 6;
+            if (bitCount >= 8) {
+                bitCount -= 8;
+                pDataOut->push_back(static_cast<uint8_t>((accumulator >> bitCount) & 0xFFu));
+            }
+        }
+        return true;
+    }
+
+    // Loads an external file or decodes a base64 data URI.
+    static bool LoadGltfUri(const std::string& baseDir, const std::string& uri, std::vector<uint8_t>* pDataOut)
+    {
+        if (uri.compare(0, 5, "data:") == 0) {
+            size_t dataStart = uri.find(";base64,");
+            if (dataStart == std::string::npos) {
+                return false;
+            }
+            dataStart += 8;
+            return DecodeBase64(uri.data() + dataStart, uri.data() + uri.size(), pDataOut);
+        }
+        return ReadGltfFile(baseDir + uri, pDataOut);
+    }
+
+    static uint32_t GltfComponentSize(uint32_t componentType)
+    {
+        switch (componentType) {
+        case k_gltfByte:
+        case k_gltfUnsignedByte:
+            return 1u;
+        case k_gltfShort:
+        case k_gltfUnsignedShort:
+            return 2u;
+        case k_gltfUnsignedInt:
+        case k_gltfFloat:
+            return 4u;
+        default:
+            return 0u;
+        }
+    }
+
+    static uint32_t GltfComponentCount(const std::string& type)
+    {
+        if (type == "SCALAR") return 1u;
+        if (type == "VEC2") return 2u;
+        if (type == "VEC3") return 3u;
+        if (type == "VEC4") return 4u;
+        if (type == "MAT4") return 16u;
+        return 0u;
+    }
+
+    uint32_t GltfLoader::AccessorView::getElementSize() const
+    {
+        return GltfComponentSize(componentType) * componentCount;
+    }
+
+    VkFormat GltfLoader::AccessorView::getVertexFormat() const
+    {
+        static const VkFormat k_floatFormats[] = {
+            VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT
+        };
+        // Three component 8 and 16 bit formats are rarely supported for vertex input, so are left out.
+        static const VkFormat k_unorm8Formats[] = {
+            VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8_UNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R8G8B8A8_UNORM
+        };
+        static const VkFormat k_snorm8Formats[] = {
+            VK_FORMAT_R8_SNORM, VK_FORMAT_R8G8_SNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R8G8B8A8_SNORM
+        };
+        static const VkFormat k_unorm16Formats[] = {
+            VK_FORMAT_R16_UNORM, VK_FORMAT_R16G16_UNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R16G16B16A16_UNORM
+        };
+        static const VkFormat k_snorm16Formats[] = {
+            VK_FORMAT_R16_SNORM, VK_FORMAT_R16G16_SNORM, VK_FORMAT_UNDEFINED, VK_FORMAT_R16G16B16A16_SNORM
+        };
+
+        if (componentCount < 1u || componentCount > 4u) {
+            return VK_FORMAT_UNDEFINED;
+        }
+
+        uint32_t index = componentCount - 1u;
+        if (componentType == k_gltfFloat) {
+            return k_floatFormats[index];
+        } else if (normalized) {
+            switch (componentType) {
+            case k_gltfUnsignedByte: return k_unorm8Formats[index];
+            case k_gltfByte: return k_snorm8Formats[index];
+            case k_gltfUnsignedShort: return k_unorm16Formats[index];
+            case k_gltfShort: return k_snorm16Formats[index];
+            }
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    static float ReadGltfComponent(const uint8_t* pComponent, uint32_t componentType, bool normalized)
+    {
+        switch (componentType) {
+        case k_gltfFloat: {
+            float value;
+            memcpy(&value, pComponent, sizeof(value));
+            return value;
+        }
+        case k_gltfUnsignedByte:
+            return normalized ? *pComponent / 255.0f : static_cast<float>(*pComponent);
+        case k_gltfByte: {
+            float value = static_cast<float>(static_cast<int8_t>(*pComponent));
+            return normalized ? std::max(value / 127.0f, -1.0f) : value;
+        }
+        case k_gltfUnsignedShort: {
+            uint16_t value;
+            memcpy(&value, pComponent, sizeof(value));
+            return normalized ? value / 65535.0f : static_cast<float>(value);
+        }
+        case k_gltfShort: {
+            int16_t value;
+            memcpy(&value, pComponent, sizeof(value));
+            return normalized ? std::max(value / 32767.0f, -1.0f) : static_cast<float>(value);
+        }
+        case k_gltfUnsignedInt: {
+            uint32_t value;
+            memcpy(&value, pComponent, sizeof(value));
+            return static_cast<float>(value);
+        }
+        default:
+            return 0.0f;
+        }
+    }
+
+    // Reads up to maxComponents of the accessor's element, returns the number read.
+    static uint32_t ReadGltfElement(const GltfLoader::AccessorView& view, uint32_t elementIndex, float* pOut, uint32_t maxComponents)
+    {
+        const uint8_t* pElement = view.pData + static_cast<size_t>(elementIndex) * view.stride;
+        uint32_t componentSize = GltfComponentSize(view.componentType);
+        uint32_t componentCount = std::min(view.componentCount, maxComponents);
+        for (uint32_t i = 0u; i < componentCount; ++i) {
+            pOut[i] = ReadGltfComponent(pElement + i * componentSize, view.componentType, view.normalized);
+        }
+        return componentCount;
+    }
+
+    struct GltfBufferView
+    {
+        uint32_t buffer = 0u;
+        size_t byteOffset = 0u;
+        size_t byteLength = 0u;
+        uint32_t byteStride = 0u;
+    };
+
+    static bool ResolveGltfAccessor(
+        const GltfJson& accessors,
+        int64_t accessorIndex,
+        const std::vector<GltfBufferView>& bufferViews,
+        const std::vector<std::vector<uint8_t>>& buffers,
+        GltfLoader::AccessorView* pView,
+        std::string* pWarn)
+    {
+        if (accessorIndex < 0 || static_cast<size_t>(accessorIndex) >= accessors.size()) {
+            *pWarn += "Invalid glTF accessor index.\n";
+            return false;
+        }
+
+        const GltfJson& accessor = accessors.values[accessorIndex];
+        if (accessor.find("sparse") != nullptr) {
+            *pWarn += "Sparse glTF accessors are not supported.\n";
+            return false;
+        }
+
+        int64_t bufferViewIndex = accessor.getInt("bufferView", -1);
+        if (bufferViewIndex < 0 || static_cast<size_t>(bufferViewIndex) >= bufferViews.size()) {
+            *pWarn += "glTF accessors without a buffer view are not supported.\n";
+            return false;
+        }
+
+        const GltfBufferView& bufferView = bufferViews[bufferViewIndex];
+
+        GltfLoader::AccessorView view;
+        view.count = static_cast<uint32_t>(accessor.getInt("count", 0));
+        view.componentType = static_cast<uint32_t>(accessor.getInt("componentType", 0));
+        view.componentCount = GltfComponentCount(accessor.getString("type"));
+        view.normalized = accessor.getBool("normalized", false);
+
+        uint32_t elementSize = view.getElementSize();
+        view.stride = bufferView.byteStride != 0u ? bufferView.byteStride : elementSize;
+
+        size_t byteOffset = static_cast<size_t>(accessor.getInt("byteOffset", 0));
+        if (elementSize == 0u
+            || view.count == 0u
+            || byteOffset + static_cast<size_t>(view.stride) * (view.count - 1u) + elementSize > bufferView.byteLength) {
+            *pWarn += "Invalid glTF accessor.\n";
+            return false;
+        }
+
+        const uint8_t* pViewBegin = buffers[bufferView.buffer].data() + bufferView.byteOffset;
+        view.pData = pViewBegin + byteOffset;
+        view.pViewEnd = pViewBegin + bufferView.byteLength;
+
+        *pView = view;
+        return true;
+    }
+
+    static glm::mat4 GetGltfNodeTransform(const GltfJson& node)
+    {
+        const GltfJson& matrix = node.getArray("matrix");
+        if (matrix.size() == 16u) {
+            // glTF matrices are column major, same as glm.
+            glm::mat4 transform;
+            for (int column = 0; column < 4; ++column) {
+                for (int row = 0; row < 4; ++row) {
+                    transform[column][row] = static_cast<float>(matrix.values[column * 4 + row].number);
+                }
+            }
+            return transform;
+        }
+
+        glm::mat4 transform(1.0f);
+        const GltfJson& translation = node.getArray("translation");
+        if (translation.size() == 3u) {
+            transform = glm::translate(
+                transform,
+                glm::vec3(
+                    static_cast<float>(translation.values[0].number),
+                    static_cast<float>(translation.values[1].number),
+                    static_cast<float>(translation.values[2].number)));
+        }
+
+        const GltfJson& rotation = node.getArray("rotation");
+        if (rotation.size() == 4u) {
+            // glTF quaternions are (x, y, z, w), the glm constructor takes w first.
+            glm::quat quaternion(
+                static_cast<float>(rotation.values[3].number),
+                static_cast<float>(rotation.values[0].number),
+                static_cast<float>(rotation.values[1].number),
+                static_cast<float>(rotation.values[2].number));
+            transform = transform * glm::mat4_cast(quaternion);
+        }
+
+        const GltfJson& scale = node.getArray("scale");
+        if (scale.size() == 3u) {
+            transform = glm::scale(
+                transform,
+                glm::vec3(
+                    static_cast<float>(scale.values[0].number),
+                    static_cast<float>(scale.values[1].number),
+                    static_cast<float>(scale.values[2].number)));
+        }
+
+        return transform;
+    }
+
+    bool GltfLoader::IsGltfFile(const std::string& filePath)
+    {
+        size_t dotPos = filePath.find_last_of('.');
+        if (dotPos == std::string::npos) {
+            return false;
+        }
+        std::string extension = filePath.substr(dotPos + 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) {
+            return static_cast<char>(tolower(c));
+        });
+        return extension == "gltf" || extension == "glb";
+    }
+
+    bool GltfLoader::LoadModel(
+        const std::string& filePath,
+        Model* pModel,
+        std::string* pWarn,
+        std::string* pErr)
+    {
+        std::vector<uint8_t> fileData;
+        if (!ReadGltfFile(filePath, &fileData)) {
+            *pErr += "Failed to open glTF file: " + filePath + "\n";
+            return false;
+        }
+
+        std::string baseDir;
+        size_t slashPos = filePath.find_last_of("/\\");
+        if (slashPos != std::string::npos) {
+            baseDir = filePath.substr(0, slashPos + 1);
+        }
+
+        Model& model = *pModel;
+        model = Model();
+
+        // A GLB is a 12 byte header followed by a JSON chunk and an optional binary chunk.
+        const char* pJsonBegin = reinterpret_cast<const char*>(fileData.data());
+        const char* pJsonEnd = pJsonBegin + fileData.size();
+        std::vector<uint8_t> glbBinChunk;
+        uint32_t magic = 0u;
+        if (fileData.size() >= 4u) {
+            memcpy(&magic, fileData.data(), sizeof(magic));
+        }
+        if (magic == k_glbMagic) {
+            size_t chunkOffset = 12u;
+            bool foundJson = false;
+            while (chunkOffset + 8u <= fileData.size()) {
+                uint32_t chunkHeader[2];
+                memcpy(chunkHeader, fileData.data() + chunkOffset, sizeof(chunkHeader));
+                size_t chunkStart = chunkOffset + 8u;
+                size_t chunkLength = chunkHeader[0];
+                if (chunkStart + chunkLength > fileData.size()) {
+                    break;
+                }
+                if (chunkHeader[1] == k_glbChunkJson && !foundJson) {
+                    pJsonBegin = reinterpret_cast<const char*>(fileData.data() + chunkStart);
+                    pJsonEnd = pJsonBegin + chunkLength;
+                    foundJson = true;
+                } else if (chunkHeader[1] == k_glbChunkBin && glbBinChunk.empty()) {
+                    glbBinChunk.assign(fileData.begin() + chunkStart, fileData.begin() + chunkStart + chunkLength);
+                }
+                chunkOffset = chunkStart + ((chunkLength + 3u) & ~size_t(3u));
+            }
+            if (!foundJson) {
+                *pErr += "Invalid GLB file: " + filePath + "\n";
+                return false;
+            }
+        }
+
+        GltfJson root;
+        GltfJsonParser parser(pJsonBegin, pJsonEnd);
+        if (!parser.parse(&root) || root.type != GltfJson::Type::Object) {
+            *pErr += "Failed to parse glTF JSON: " + filePath + "\n";
+            return false;
+        }
+
+        const GltfJson& buffers = root.getArray("buffers");
+        model.buffers.resize(buffers.size());
+        for (size_t i = 0; i < buffers.size(); ++i) {
+            const GltfJson& buffer = buffers.values[i];
+            std::string uri = buffer.getString("uri");
+            if (uri.empty()) {
+                // Only the first buffer may refer to the GLB binary chunk.
+                model.buffers[i] = (i == 0u) ? std::move(glbBinChunk) : std::vector<uint8_t>();
+            } else if (!LoadGltfUri(baseDir, uri, &model.buffers[i])) {
+                *pErr += "Failed to load glTF buffer: " + uri + "\n";
+                return false;
+            }
+
+            if (model.buffers[i].size() < static_cast<size_t>(buffer.getInt("byteLength", 0))) {
+                *pErr += "glTF buffer is smaller than its byteLength: " + filePath + "\n";
+                return false;
+            }
+        }
+
+        const GltfJson& bufferViewsJson = root.getArray("bufferViews");
+        std::vector<GltfBufferView> bufferViews(bufferViewsJson.size());
+        for (size_t i = 0; i < bufferViewsJson.size(); ++i) {
+            const GltfJson& bufferViewJson = bufferViewsJson.values[i];
+            GltfBufferView& bufferView = bufferViews[i];
+            int64_t bufferIndex = bufferViewJson.getInt("buffer", -1);
+            bufferView.byteOffset = static_cast<size_t>(bufferViewJson.getInt("byteOffset", 0));
+            bufferView.byteLength = static_cast<size_t>(bufferViewJson.getInt("byteLength", 0));
+            bufferView.byteStride = static_cast<uint32_t>(bufferViewJson.getInt("byteStride", 0));
+            if (bufferIndex < 0
+                || static_cast<size_t>(bufferIndex) >= model.buffers.size()
+                || bufferView.byteOffset + bufferView.byteLength > model.buffers[bufferIndex].size()) {
+                *pErr += "Invalid glTF buffer view: " + filePath + "\n";
+                return false;
+            }
+            bufferView.buffer = static_cast<uint32_t>(bufferIndex);
+        }
+
+        const GltfJson& images = root.getArray("images");
+        model.images.resize(images.size());
+        for (size_t i = 0; i < images.size(); ++i) {
+            const GltfJson& imageJson = images.values[i];
+            Image& image = model.images[i];
+            int64_t bufferViewIndex = imageJson.getInt("bufferView", -1);
+            if (bufferViewIndex >= 0 && static_cast<size_t>(bufferViewIndex) < bufferViews.size()) {
+                const GltfBufferView& bufferView = bufferViews[bufferViewIndex];
+                image.pEncodedData = model.buffers[bufferView.buffer].data() + bufferView.byteOffset;
+                image.encodedSizeBytes = bufferView.byteLength;
+            } else {
+                image.uri = imageJson.getString("uri");
+            }
+        }
+
+        const GltfJson& textures = root.getArray("textures");
+        const GltfJson& materials = root.getArray("materials");
+        model.materials.resize(materials.size());
+        for (size_t i = 0; i < materials.size(); ++i) {
+            const GltfJson& materialJson = materials.values[i];
+            Material& material = model.materials[i];
+            material.name = materialJson.getString("name");
+
+            const GltfJson* pPbr = materialJson.find("pbrMetallicRoughness");
+            const GltfJson* pBaseColorTexture = pPbr != nullptr ? pPbr->find("baseColorTexture") : nullptr;
+            if (pBaseColorTexture != nullptr) {
+                int64_t textureIndex = pBaseColorTexture->getInt("index", -1);
+                if (textureIndex >= 0 && static_cast<size_t>(textureIndex) < textures.size()) {
+                    int64_t imageIndex = textures.values[textureIndex].getInt("source", -1);
+                    if (imageIndex >= 0 && static_cast<size_t>(imageIndex) < model.images.size()) {
+                        material.baseColorImageIndex = static_cast<int>(imageIndex);
+                    }
+                }
+            }
+        }
+
+        const GltfJson& accessors = root.getArray("accessors");
+        const GltfJson& meshes = root.getArray("meshes");
+        model.meshes.resize(meshes.size());
+        for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex) {
+            const GltfJson& meshJson = meshes.values[meshIndex];
+            Mesh& mesh = model.meshes[meshIndex];
+            mesh.name = meshJson.getString("name");
+
+            const GltfJson& primitives = meshJson.getArray("primitives");
+            for (const GltfJson& primitiveJson : primitives.values) {
+                if (primitiveJson.getInt("mode", k_gltfModeTriangles) != k_gltfModeTriangles) {
+                    *pWarn += "Skipping glTF primitive that is not a triangle list in mesh: " + mesh.name + "\n";
+                    continue;
+                }
+
+                const GltfJson* pAttributes = primitiveJson.find("attributes");
+                if (pAttributes == nullptr) {
+                    continue;
+                }
+
+                Primitive primitive;
+                if (!ResolveGltfAccessor(accessors, pAttributes->getInt("POSITION", -1), bufferViews, model.buffers, &primitive.positions, pWarn)
+                    || primitive.positions.componentType != k_gltfFloat
+                    || primitive.positions.componentCount != 3u) {
+                    *pWarn += "Skipping glTF primitive without valid positions in mesh: " + mesh.name + "\n";
+                    continue;
+                }
+
+                struct OptionalAttribute
+                {
+                    const char* pName;
+                    AccessorView* pView;
+                };
+                OptionalAttribute optionalAttributes[] = {
+                    { "COLOR_0", &primitive.colors },
+                    { "TEXCOORD_0", &primitive.texCoords },
+                    { "NORMAL", &primitive.normals },
+                };
+                for (const auto& attribute : optionalAttributes) {
+                    int64_t accessorIndex = pAttributes->getInt(attribute.pName, -1);
+                    if (accessorIndex >= 0
+                        && ResolveGltfAccessor(accessors, accessorIndex, bufferViews, model.buffers, attribute.pView, pWarn)
+                        && attribute.pView->count != primitive.positions.count) {
+                        *pWarn += std::string("Ignoring glTF ") + attribute.pName + " with mismatched count.\n";
+                        *attribute.pView = AccessorView();
+                    }
+                }
+
+                int64_t indicesAccessor = primitiveJson.getInt("indices", -1);
+                if (indicesAccessor >= 0) {
+                    if (!ResolveGltfAccessor(accessors, indicesAccessor, bufferViews, model.buffers, &primitive.indices, pWarn)
+                        || primitive.indices.componentCount != 1u
+                        || (primitive.indices.componentType != k_gltfUnsignedByte
+                            && primitive.indices.componentType != k_gltfUnsignedShort
+                            && primitive.indices.componentType != k_gltfUnsignedInt)) {
+                        *pWarn += "Skipping glTF primitive with invalid indices in mesh: " + mesh.name + "\n";
+                        continue;
+                    }
+                }
+
+                int64_t materialIndex = primitiveJson.getInt("material", -1);
+                if (materialIndex >= 0 && static_cast<size_t>(materialIndex) < model.materials.size()) {
+                    primitive.materialIndex = static_cast<int>(materialIndex);
+                }
+
+                mesh.primitives.push_back(primitive);
+            }
+        }
+
+        // Flatten the node hierarchy of the default scene into mesh instances.
+        const GltfJson& nodes = root.getArray("nodes");
+        std::vector<int64_t> rootNodes;
+        const GltfJson& scenes = root.getArray("scenes");
+        int64_t sceneIndex = root.getInt("scene", 0);
+        if (sceneIndex >= 0 && static_cast<size_t>(sceneIndex) < scenes.size()) {
+            for (const GltfJson& node : scenes.values[sceneIndex].getArray("nodes").values) {
+                rootNodes.push_back(static_cast<int64_t>(node.number));
+            }
+        } else {
+            // No scene, so every node that is not a child is a root.
+            std::vector<bool> isChild(nodes.size(), false);
+            for (const GltfJson& node : nodes.values) {
+                for (const GltfJson& child : node.getArray("children").values) {
+                    size_t childIndex = static_cast<size_t>(child.number);
+                    if (childIndex < isChild.size()) {
+                        isChild[childIndex] = true;
+                    }
+                }
+            }
+            for (size_t i = 0; i < nodes.size(); ++i) {
+                if (!isChild[i]) {
+                    rootNodes.push_back(static_cast<int64_t>(i));
+                }
+            }
+        }
+
+        struct NodeToVisit
+        {
+            int64_t nodeIndex;
+            glm::mat4 parentTransform;
+            uint32_t depth;
+        };
+        std::vector<NodeToVisit> nodesToVisit;
+        for (auto rootNode : rootNodes) {
+            nodesToVisit.push_back({ rootNode, glm::mat4(1.0f), 0u });
+        }
+
+        while (!nodesToVisit.empty()) {
+            NodeToVisit nodeToVisit = nodesToVisit.back();
+            nodesToVisit.pop_back();
+
+            // The depth limit protects against malformed files with cycles.
+            if (nodeToVisit.nodeIndex < 0
+                || static_cast<size_t>(nodeToVisit.nodeIndex) >= nodes.size()
+                || nodeToVisit.depth > nodes.size()) {
+                continue;
+            }
+
+            const GltfJson& node = nodes.values[nodeToVisit.nodeIndex];
+            glm::mat4 transform = nodeToVisit.parentTransform * GetGltfNodeTransform(node);
+
+            int64_t meshIndex = node.getInt("mesh", -1);
+            if (meshIndex >= 0 && static_cast<size_t>(meshIndex) < model.meshes.size()) {
+                model.meshInstances.push_back({ static_cast<uint32_t>(meshIndex), transform });
+            }
+
+            for (const GltfJson& child : node.getArray("children").values) {
+                nodesToVisit.push_back({ static_cast<int64_t>(child.number), transform, nodeToVisit.depth + 1u });
+            }
+        }
+
+        if (nodes.size() == 0u) {
+            for (size_t meshIndex = 0; meshIndex < model.meshes.size(); ++meshIndex) {
+                model.meshInstances.push_back({ static_cast<uint32_t>(meshIndex), glm::mat4(1.0f) });
+            }
+        }
+
+        return true;
+    }
+
+    bool GltfLoader::GetInterleavedVertexLayout(
+        const Primitive& primitive,
+        VertexBuffer::Config* pConfig,
+        const uint8_t** ppVertexData,
+        size_t* pVertexDataSizeBytes)
+    {
+        const AccessorView* attributes[] = {
+            &primitive.positions,
+            &primitive.colors,
+            &primitive.texCoords,
+            &primitive.normals,
+        };
+
+        // Every attribute used by the vertex shader has to be in the same buffer view with the same
+        // stride, so that the buffer view can be bound as the vertex buffer as is.
+        const uint8_t* pVertexBase = primitive.positions.pData;
+        for (const AccessorView* pAttribute : attributes) {
+            if (!pAttribute->isValid()
+                || pAttribute->getVertexFormat() == VK_FORMAT_UNDEFINED
+                || pAttribute->stride != primitive.positions.stride
+                || pAttribute->pViewEnd != primitive.positions.pViewEnd) {
+                return false;
+            }
+            pVertexBase = std::min(pVertexBase, pAttribute->pData);
+        }
+
+        uint32_t stride = primitive.positions.stride;
+        size_t vertexDataSizeBytes = static_cast<size_t>(stride) * primitive.positions.count;
+        if (pVertexBase + vertexDataSizeBytes > primitive.positions.pViewEnd) {
+            return false;
+        }
+
+        VertexBuffer::Config config(stride, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+        for (const AccessorView* pAttribute : attributes) {
+            uint32_t offset = static_cast<uint32_t>(pAttribute->pData - pVertexBase);
+            if (offset + pAttribute->getElementSize() > stride) {
+                return false;
+            }
+            config.vertexAttrDescriptions.push_back(
+                VertexBuffer::AttributeDescription(pAttribute->getVertexFormat(), offset));
+        }
+
+        *pConfig = config;
+        *ppVertexData = pVertexBase;
+        *pVertexDataSizeBytes = vertexDataSizeBytes;
+        return true;
+    }
+
+    void GltfLoader::AppendVerticesXyzRgbUvN(const Primitive& primitive, std::vector<uint8_t>* pVerticesOut)
+    {
+        size_t writeOffset = pVerticesOut->size();
+        pVerticesOut->resize(writeOffset + sizeof(VertexXyzRgbUvN) * primitive.positions.count);
+
+        for (uint32_t i = 0u; i < primitive.positions.count; ++i) {
+            VertexXyzRgbUvN vertex = {
+                glm::vec3(0.0f),
+                glm::vec3(1.0f),
+                glm::vec2(0.0f),
+                glm::vec3(0.0f),
+            };
+
+            ReadGltfElement(primitive.positions, i, &vertex.pos.x, 3u);
+            if (primitive.colors.isValid()) {
+                ReadGltfElement(primitive.colors, i, &vertex.color.x, 3u);
+            }
+            if (primitive.texCoords.isValid()) {
+                ReadGltfElement(primitive.texCoords, i, &vertex.texCoord.x, 2u);
+            }
+            if (primitive.normals.isValid()) {
+                ReadGltfElement(primitive.normals, i, &vertex.normal.x, 3u);
+            }
+
+            memcpy(pVerticesOut->data() + writeOffset, &vertex, sizeof(vertex));
+            writeOffset += sizeof(vertex);
+        }
+    }
+
+    void GltfLoader::AppendIndices(const Primitive& primitive, std::vector<uint32_t>* pIndicesOut)
+    {
+        const AccessorView& indices = primitive.indices;
+        if (!indices.isValid()) {
+            for (uint32_t i = 0u; i < primitive.positions.count; ++i) {
+                pIndicesOut->push_back(i);
+            }
+            return;
+        }
+
+        size_t writeOffset = pIndicesOut->size();
+        pIndicesOut->resize(writeOffset + indices.count);
+        uint32_t* pIndexOut = pIndicesOut->data() + writeOffset;
+
+        if (indices.componentType == k_gltfUnsignedInt && indices.stride == sizeof(uint32_t)) {
+            memcpy(pIndexOut, indices.pData, sizeof(uint32_t) * indices.count);
+        } else {
+            for (uint32_t i = 0u; i < indices.count; ++i) {
+                const uint8_t* pIndex = indices.pData + static_cast<size_t>(i) * indices.stride;
+                if (indices.componentType == k_gltfUnsignedShort) {
+                    uint16_t index;
+                    memcpy(&index, pIndex, sizeof(index));
+                    pIndexOut[i] = index;
+                } else if (indices.componentType == k_gltfUnsignedByte) {
+                    pIndexOut[i] = *pIndex;
+                } else {
+                    memcpy(&pIndexOut[i], pIndex, sizeof(uint32_t));
+                }
+            }
+        }
+
+        // Out of range indices would make the GPU fetch vertices outside of the primitive's.
+        if (indices.count > 0u
+            && *std::max_element(pIndexOut, pIndexOut + indices.count) >= primitive.positions.count) {
+            pIndicesOut->resize(writeOffset);
+            throw std::runtime_error("glTF primitive has indices out of range of its vertices!");
+        }
+    }
+}
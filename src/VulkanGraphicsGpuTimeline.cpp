@@ -0,0 +1,112 @@
+#include "VulkanGraphicsGpuTimeline.h"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+#include <vector>
+
+namespace vgfx
+{
+    GpuTimeline::GpuTimeline(Context& context, const CommandQueue& commandQueue)
+        : m_context(context)
+        , m_commandQueue(commandQueue)
+    {
+        VkSemaphoreTypeCreateInfo semaphoreTypeInfo = {};
+        semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphoreTypeInfo.initialValue = 0u;
+
+        VkSemaphoreCreateInfo semaphoreInfo = {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &semaphoreTypeInfo;
+
+        VkResult result = vkCreateSemaphore(
+            m_context.getLogicalDevice(),
+            &semaphoreInfo,
+            m_context.getAllocationCallbacks(),
+            &m_semaphore);
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create timeline semaphore!");
+        }
+    }
+
+    GpuTimeline::~GpuTimeline()
+    {
+        if (m_semaphore != VK_NULL_HANDLE) {
+            // The semaphore must not be destroyed while submissions still signal it.
+            wait(m_lastSubmittedValue);
+            vkDestroySemaphore(m_context.getLogicalDevice(), m_semaphore, m_context.getAllocationCallbacks());
+        }
+    }
+
+    GpuTimeline::Value GpuTimeline::submit(const VkSubmitInfo& submitInfo, VkFence fence)
+    {
+        Value value = m_lastSubmittedValue + 1u;
+
+        // The values of binary semaphores are ignored, but the arrays must be the same length.
+        std::vector<VkSemaphore> signalSemaphores(
+            submitInfo.pSignalSemaphores,
+            submitInfo.pSignalSemaphores + submitInfo.signalSemaphoreCount);
+        signalSemaphores.push_back(m_semaphore);
+        std::vector<uint64_t> signalValues(signalSemaphores.size(), 0u);
+        signalValues.back() = value;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.pNext = submitInfo.pNext;
+        timelineInfo.signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size());
+        timelineInfo.pSignalSemaphoreValues = signalValues.data();
+
+        VkSubmitInfo timelineSubmitInfo = submitInfo;
+        timelineSubmitInfo.pNext = &timelineInfo;
+        timelineSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
+        timelineSubmitInfo.pSignalSemaphores = signalSemaphores.data();
+
+        VkResult result = vkQueueSubmit(m_commandQueue.queue, 1, &timelineSubmitInfo, fence);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit to GPU timeline!");
+        }
+
+        m_lastSubmittedValue = value;
+        return value;
+    }
+
+    GpuTimeline::Value GpuTimeline::getCompletedValue()
+    {
+        if (m_completedValue < m_lastSubmittedValue) {
+            vkGetSemaphoreCounterValue(m_context.getLogicalDevice(), m_semaphore, &m_completedValue);
+        }
+        return m_completedValue;
+    }
+
+    bool GpuTimeline::isComplete(Value value)
+    {
+        assert(value <= m_lastSubmittedValue);
+        return value <= m_completedValue || value <= getCompletedValue();
+    }
+
+    bool GpuTimeline::wait(Value value, uint64_t timeout)
+    {
+        if (isComplete(value)) {
+            return true;
+        }
+
+        VkSemaphoreWaitInfo waitInfo = {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &m_semaphore;
+        waitInfo.pValues = &value;
+
+        VkResult result = vkWaitSemaphores(m_context.getLogicalDevice(), &waitInfo, timeout);
+        if (result == VK_TIMEOUT) {
+            return false;
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to wait for GPU timeline!");
+        }
+
+        m_completedValue = std::max(m_completedValue, value);
+        return true;
+    }
+}
@@ -0,0 +1,281 @@
+#include "VulkanGraphicsHostAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace vgfx
+{
+    // Slots hold the header and up to this many bytes, and are aligned to the header's size.
+    constexpr static size_t k_slotPayloadSizes[] = { 16u, 48u, 112u, 240u, 496u };
+    // Of the slots and of the payloads that aren't pooled, malloc only guarantees 8 on some
+    // platforms, e.g. MSVC.
+    constexpr static size_t k_alignment = 16u;
+    constexpr static size_t k_sizeClassCount = sizeof(k_slotPayloadSizes) / sizeof(k_slotPayloadSizes[0]);
+    constexpr static uint8_t k_notPooled = 0xffu;
+    constexpr static size_t k_chunkSizeBytes = 64u * 1024u;
+
+    static thread_local VkObjectType t_objectType = VK_OBJECT_TYPE_UNKNOWN;
+
+    HostAllocator::ObjectTypeScope::ObjectTypeScope(VkObjectType objectType)
+        : m_prevObjectType(t_objectType)
+    {
+        t_objectType = objectType;
+    }
+
+    HostAllocator::ObjectTypeScope::~ObjectTypeScope()
+    {
+        t_objectType = m_prevObjectType;
+    }
+
+    HostAllocator::HostAllocator()
+        : m_freeSlots(k_sizeClassCount, nullptr)
+    {
+        static_assert(sizeof(Header) == k_alignment, "Slots are aligned to the header size.");
+
+        m_callbacks.pUserData = this;
+        m_callbacks.pfnAllocation = &HostAllocator::Allocate;
+        m_callbacks.pfnReallocation = &HostAllocator::Reallocate;
+        m_callbacks.pfnFree = &HostAllocator::Free;
+        m_callbacks.pfnInternalAllocation = &HostAllocator::InternalAllocate;
+        m_callbacks.pfnInternalFree = &HostAllocator::InternalFree;
+    }
+
+    HostAllocator::~HostAllocator()
+    {
+        // Everything allocated through the callbacks must have been freed by now.
+        assert(m_stats.total.allocationCount == 0u);
+        for (void* pChunk : m_chunks) {
+            ::operator delete(pChunk, std::align_val_t(k_alignment));
+        }
+    }
+
+    HostAllocator::Stats HostAllocator::getStats() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+    void* HostAllocator::Allocate(
+        void* pUserData,
+        size_t size,
+        size_t alignment,
+        VkSystemAllocationScope scope)
+    {
+        return static_cast<HostAllocator*>(pUserData)->allocate(size, alignment, scope);
+    }
+
+    void* HostAllocator::Reallocate(
+        void* pUserData,
+        void* pOriginal,
+        size_t size,
+        size_t alignment,
+        VkSystemAllocationScope scope)
+    {
+        HostAllocator* pHostAllocator = static_cast<HostAllocator*>(pUserData);
+        if (pOriginal == nullptr) {
+            return pHostAllocator->allocate(size, alignment, scope);
+        }
+        if (size == 0u) {
+            pHostAllocator->free(pOriginal);
+            return nullptr;
+        }
+
+        void* pMemory = pHostAllocator->allocate(size, alignment, scope);
+        if (pMemory != nullptr) {
+            const Header* pHeader = reinterpret_cast<const Header*>(pOriginal) - 1;
+            memcpy(pMemory, pOriginal, std::min<size_t>(size, pHeader->sizeBytes));
+            pHostAllocator->free(pOriginal);
+        }
+        // The original is left as it was if the allocation failed.
+        return pMemory;
+    }
+
+    void HostAllocator::Free(void* pUserData, void* pMemory)
+    {
+        if (pMemory != nullptr) {
+            static_cast<HostAllocator*>(pUserData)->free(pMemory);
+        }
+    }
+
+    void HostAllocator::InternalAllocate(
+        void* pUserData,
+        size_t size,
+        VkInternalAllocationType,
+        VkSystemAllocationScope)
+    {
+        HostAllocator* pHostAllocator = static_cast<HostAllocator*>(pUserData);
+        std::lock_guard<std::mutex> lock(pHostAllocator->m_mutex);
+        AddUsage(pHostAllocator->m_stats.internal, size);
+    }
+
+    void HostAllocator::InternalFree(
+        void* pUserData,
+        size_t size,
+        VkInternalAllocationType,
+        VkSystemAllocationScope)
+    {
+        HostAllocator* pHostAllocator = static_cast<HostAllocator*>(pUserData);
+        std::lock_guard<std::mutex> lock(pHostAllocator->m_mutex);
+        RemoveUsage(pHostAllocator->m_stats.internal, size);
+    }
+
+    void* HostAllocator::allocate(size_t size, size_t alignment, VkSystemAllocationScope scope)
+    {
+        assert(alignment > 0u && (alignment & (alignment - 1u)) == 0u);
+        if (size == 0u || size > UINT32_MAX) {
+            return nullptr;
+        }
+
+        uint8_t sizeClass = k_notPooled;
+        if (alignment <= sizeof(Header)) {
+            for (uint8_t classIndex = 0u; classIndex < k_sizeClassCount; ++classIndex) {
+                if (size <= k_slotPayloadSizes[classIndex]) {
+                    sizeClass = classIndex;
+                    break;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        Header* pHeader = nullptr;
+        uint32_t baseOffset = 0u;
+        if (sizeClass != k_notPooled) {
+            pHeader = static_cast<Header*>(allocateSlot(sizeClass));
+            if (pHeader != nullptr) {
+                ++m_stats.pooledAllocationCount;
+            }
+        } else {
+            // The header goes right before the aligned payload.
+            size_t payloadAlignment = std::max(alignment, k_alignment);
+            uint8_t* pBase = static_cast<uint8_t*>(std::malloc(size + sizeof(Header) + payloadAlignment));
+            if (pBase == nullptr) {
+                return nullptr;
+            }
+            uintptr_t payload = reinterpret_cast<uintptr_t>(pBase) + sizeof(Header);
+            payload = (payload + payloadAlignment - 1u) & ~(uintptr_t(payloadAlignment) - 1u);
+            pHeader = reinterpret_cast<Header*>(payload) - 1;
+            baseOffset = static_cast<uint32_t>(payload - reinterpret_cast<uintptr_t>(pBase));
+        }
+        if (pHeader == nullptr) {
+            return nullptr;
+        }
+
+        pHeader->sizeBytes = static_cast<uint32_t>(size);
+        pHeader->objectType = static_cast<uint32_t>(t_objectType);
+        pHeader->baseOffset = baseOffset;
+        pHeader->scope = static_cast<uint8_t>(scope);
+        pHeader->sizeClass = sizeClass;
+
+        AddUsage(m_stats.total, size);
+        AddUsage(m_stats.scopes[scope], size);
+        AddUsage(m_stats.objectTypes[t_objectType], size);
+
+        return pHeader + 1;
+    }
+
+    void HostAllocator::free(void* pMemory)
+    {
+        Header* pHeader = static_cast<Header*>(pMemory) - 1;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        RemoveUsage(m_stats.total, pHeader->sizeBytes);
+        RemoveUsage(m_stats.scopes[pHeader->scope], pHeader->sizeBytes);
+        RemoveUsage(m_stats.objectTypes[static_cast<VkObjectType>(pHeader->objectType)], pHeader->sizeBytes);
+
+        if (pHeader->sizeClass != k_notPooled) {
+            void*& pFreeSlot = m_freeSlots[pHeader->sizeClass];
+            *reinterpret_cast<void**>(pHeader) = pFreeSlot;
+            pFreeSlot = pHeader;
+        } else {
+            std::free(reinterpret_cast<uint8_t*>(pMemory) - pHeader->baseOffset);
+        }
+    }
+
+    void* HostAllocator::allocateSlot(uint8_t sizeClass)
+    {
+        void*& pFreeSlot = m_freeSlots[sizeClass];
+        if (pFreeSlot == nullptr) {
+            uint8_t* pChunk =
+                static_cast<uint8_t*>(::operator new(k_chunkSizeBytes, std::align_val_t(k_alignment), std::nothrow));
+            if (pChunk == nullptr) {
+                return nullptr;
+            }
+            m_chunks.push_back(pChunk);
+            m_stats.pooledReservedBytes += k_chunkSizeBytes;
+
+            size_t slotSizeBytes = sizeof(Header) + k_slotPayloadSizes[sizeClass];
+            for (size_t offset = 0u; offset + slotSizeBytes <= k_chunkSizeBytes; offset += slotSizeBytes) {
+                void* pSlot = pChunk + offset;
+                *reinterpret_cast<void**>(pSlot) = pFreeSlot;
+                pFreeSlot = pSlot;
+            }
+        }
+
+        void* pSlot = pFreeSlot;
+        pFreeSlot = *reinterpret_cast<void**>(pSlot);
+        return pSlot;
+    }
+
+    void HostAllocator::AddUsage(Usage& usage, uint64_t sizeBytes)
+    {
+        usage.bytes += sizeBytes;
+        usage.peakBytes = std::max(usage.peakBytes, usage.bytes);
+        ++usage.allocationCount;
+        ++usage.totalAllocationCount;
+    }
+
+    void HostAllocator::RemoveUsage(Usage& usage, uint64_t sizeBytes)
+    {
+        usage.bytes -= sizeBytes;
+        --usage.allocationCount;
+    }
+
+    const char* HostAllocator::GetScopeName(VkSystemAllocationScope scope)
+    {
+        switch (scope) {
+        case VK_SYSTEM_ALLOCATION_SCOPE_COMMAND:
+            return "command";
+        case VK_SYSTEM_ALLOCATION_SCOPE_OBJECT:
+            return "object";
+        case VK_SYSTEM_ALLOCATION_SCOPE_CACHE:
+            return "cache";
+        case VK_SYSTEM_ALLOCATION_SCOPE_DEVICE:
+            return "device";
+        case VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE:
+            return "instance";
+        default:
+            return "unknown";
+        }
+    }
+
+    const char* HostAllocator::GetObjectTypeName(VkObjectType objectType)
+    {
+        switch (objectType) {
+        case VK_OBJECT_TYPE_UNKNOWN:
+            return "unknown";
+        case VK_OBJECT_TYPE_INSTANCE:
+            return "instance";
+        case VK_OBJECT_TYPE_DEVICE:
+            return "device";
+        case VK_OBJECT_TYPE_COMMAND_POOL:
+            return "commandPool";
+        case VK_OBJECT_TYPE_DESCRIPTOR_POOL:
+            return "descriptorPool";
+        case VK_OBJECT_TYPE_DESCRIPTOR_SET_LAYOUT:
+            return "descriptorSetLayout";
+        case VK_OBJECT_TYPE_PIPELINE:
+            return "pipeline";
+        case VK_OBJECT_TYPE_PIPELINE_LAYOUT:
+            return "pipelineLayout";
+        case VK_OBJECT_TYPE_SHADER_MODULE:
+            return "shaderModule";
+        default:
+            return nullptr;
+        }
+    }
+}
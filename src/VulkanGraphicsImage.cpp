@@ -19,13 +19,23 @@ vgfx::Image::Image(
     , m_extent(config.imageInfo.extent)
     , m_format(config.imageInfo.format)
     , m_mipLevels(config.imageInfo.mipLevels)
+    , m_arrayLayers(config.imageInfo.arrayLayers)
     , m_sampleCount(config.imageInfo.samples)
+    , m_usage(config.imageInfo.usage)
 {
     auto& memoryAllocator = context.getMemoryAllocator();
 
     VmaMemoryUsage imageMemoryUsage = VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY;
 
-    m_image = memoryAllocator.createImage(config.imageInfo, imageMemoryUsage);
+    // Attachments are recreated when the window is resized, textures live as long as the content.
+    VkImageUsageFlags attachmentUsage =
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    vgfx::MemoryAllocator::AllocationClass allocationClass =
+        (config.imageInfo.usage & attachmentUsage) != 0 ?
+            vgfx::MemoryAllocator::AllocationClass::RenderTarget :
+            vgfx::MemoryAllocator::AllocationClass::Static;
+
+    m_image = memoryAllocator.createImage(config.imageInfo, imageMemoryUsage, nullptr, allocationClass);
 }
 
 vgfx::Image::Image(
@@ -36,23 +46,55 @@ vgfx::Image::Image(
     size_t imageDataSize)
     : Image(context, config)
 {
-
-    if (config.imageInfo.mipLevels > 1u) {
-        // make sure we can read from the image so that we can generate the mip levels.
-        assert(config.imageInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    // Textures are sampled once they have been uploaded, so the Defragmenter can move them if it
+    // can copy them.
+    VkImageUsageFlags copyUsage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    if ((config.imageInfo.usage & copyUsage) == copyUsage
+        && config.imageInfo.samples == VK_SAMPLE_COUNT_1_BIT
+        && config.imageInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
+        context.getMemoryAllocator().setMovable(
+            m_image,
+            config.imageInfo,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            [this](VkImage newHandle) { onMoved(newHandle); });
     }
 
     OneTimeCommandsHelper helper(context, commandBufferFactory);
 
-    OneTimeCommandsHelper::GenerateMips genMips =
-        context.areShaderSubgroupsSupported() && context.isDescriptorIndexingSupported() ?
-            OneTimeCommandsHelper::GenerateMips::No : OneTimeCommandsHelper::GenerateMips::Yes;
-    genMips = OneTimeCommandsHelper::GenerateMips::Yes;
-    helper.copyDataToImage(*this, pImageData, imageDataSize, genMips);
-    if (genMips == OneTimeCommandsHelper::GenerateMips::No) {
+    if (!config.mipLevelOffsets.empty()) {
+        // All of the mip levels are provided by the image data.
+        assert(config.mipLevelOffsets.size() == config.imageInfo.mipLevels);
+        helper.copyDataToImage(
+            *this,
+            pImageData,
+            imageDataSize,
+            OneTimeCommandsHelper::GenerateMips::No,
+            config.mipLevelOffsets);
+        return;
+    }
+
+    ImageDownsampler* pDownsampler = nullptr;
+    if (config.imageInfo.mipLevels > 1u && context.isImageDownsamplerSupported()) {
         ImageDownsampler& downsampler = context.getOrCreateImageDownsampler();
-        downsampler.execute(*this, helper);
+        if (downsampler.canDownsample(*this)) {
+            pDownsampler = &downsampler;
+        }
     }
+
+    if (pDownsampler != nullptr) {
+        helper.copyDataToImage(*this, pImageData, imageDataSize, OneTimeCommandsHelper::GenerateMips::No);
+        pDownsampler->execute(*this, helper);
+        return;
+    }
+
+    if (config.imageInfo.mipLevels > 1u) {
+        // make sure we can read from the image so that we can generate the mip levels.
+        assert(config.imageInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+        // Only the first layer's levels would be generated.
+        assert(config.imageInfo.arrayLayers == 1u);
+    }
+
+    helper.copyDataToImage(*this, pImageData, imageDataSize, OneTimeCommandsHelper::GenerateMips::Yes);
 }
 
 vgfx::Image::~Image()
@@ -60,7 +102,23 @@ vgfx::Image::~Image()
     m_imageViews.clear();
 
     if (m_image.isValid()) {
-        m_context.getMemoryAllocator().destroyImage(m_image);
+        // Frames in flight may still sample it.
+        vgfx::MemoryAllocator& memoryAllocator = m_context.getMemoryAllocator();
+        memoryAllocator.clearMovable(m_image.allocation);
+        m_context.retire([&memoryAllocator, image = m_image]() mutable {
+            memoryAllocator.destroyImage(image);
+        });
+        m_image = vgfx::MemoryAllocator::Image();
+    }
+}
+
+void vgfx::Image::onMoved(VkImage newHandle)
+{
+    m_image.handle = newHandle;
+
+    // Descriptor sets that are written afterwards use the new views.
+    for (auto& viewIt : m_imageViews) {
+        viewIt.second->recreate();
     }
 }
 
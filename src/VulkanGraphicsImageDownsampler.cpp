@@ -4,12 +4,44 @@
 #include "VulkanGraphicsDescriptorPoolBuilder.h"
 #include "VulkanGraphicsImageDescriptorUpdaters.h"
 
+#include <algorithm>
+#include <cassert>
+
 #define A_CPU
 #include "ffx_a.h"
 #include "ffx_spd.h"
 
 namespace vgfx
 {
+    // The shader's SpdGlobalAtomicBuffer, one counter per slice.
+    static const VkDeviceSize SpdAtomicCountersSizeBytes = 6u * sizeof(uint32_t);
+
+    // Binds a range of a storage buffer, so that each image in a batch has its own atomic counters.
+    class BufferRangeDescriptorUpdater : public DescriptorUpdater
+    {
+    public:
+        BufferRangeDescriptorUpdater(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+            : DescriptorUpdater(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER)
+        {
+            m_bufferInfo.buffer = buffer;
+            m_bufferInfo.offset = offset;
+            m_bufferInfo.range = range;
+        }
+
+        void update(VkWriteDescriptorSet* pWriteSet) const override
+        {
+            DescriptorUpdater::update(pWriteSet);
+
+            VkWriteDescriptorSet& writeSet = *pWriteSet;
+            writeSet.dstArrayElement = 0;
+
+            writeSet.pBufferInfo = &m_bufferInfo;
+        }
+
+    private:
+        VkDescriptorBufferInfo m_bufferInfo = {};
+    };
+
     ImageDownsampler::ImageDownsampler(
         Context& context,
         Precision precision)
@@ -77,16 +109,6 @@ namespace vgfx
 
         m_spComputePipeline = std::make_unique<ComputePipeline>(context, *m_spComputeShader.get());
 
-        DescriptorPoolBuilder descriptorPoolBuilder;
-        descriptorPoolBuilder.addDescriptorSets(m_spComputeShader->getDescriptorSetLayouts(), 1u);
-        m_spDescriptorPool = descriptorPoolBuilder.createPool(context);
-
-        m_spDescriptorPool->allocateDescriptorSets(
-            *m_spComputeShader->getDescriptorSetLayouts().front(),
-            1u, // Only one copy needed
-            &m_descriptorSet);
-
-
         Sampler::Config samplerConfig(
             VK_FILTER_LINEAR,
             VK_FILTER_LINEAR,
@@ -100,148 +122,187 @@ namespace vgfx
             1.0f); // max anisotropy
         m_spSampler = std::make_unique<Sampler>(context, samplerConfig);
 
-        // Create global atomic counter
-        size_t globalCounterBufSize = sizeof(int32_t);
-        Buffer::Config globalCounterBufferCfg("SpdGlobalAtomicCounter", globalCounterBufSize);
-
-        m_spGlobalCounterUBO =
-            std::make_unique<Buffer>(
-                context,Buffer::Type::StorageBuffer, globalCounterBufferCfg);
-
-        // initialize global atomic counter to 0
-        uint32_t zero = 0u;
-        m_spGlobalCounterUBO->update(&zero, sizeof(zero), 0u, Buffer::MemMap::UnMap);
+        VkPhysicalDeviceProperties deviceProperties = {};
+        vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &deviceProperties);
+        VkDeviceSize alignment = std::max(deviceProperties.limits.minStorageBufferOffsetAlignment, VkDeviceSize(1u));
+        m_atomicCounterStrideBytes = ((SpdAtomicCountersSizeBytes + alignment - 1u) / alignment) * alignment;
     }
 
-    void ImageDownsampler::execute(const Image& image, OneTimeCommandsHelper& commandsHelper)
+    bool ImageDownsampler::canDownsample(const Image& image) const
     {
-        // We need one UAV less because source texture will be bound as shader resource view (RSV)
-        // and not as UAV
-        uint32_t numUAVs = image.getMipLevels() - 1u;
-
-        // Anything smaller than 6 mips should just use standard method for downsampling.
-        assert(numUAVs >= 6);
+        // The shader declares its storage images as rgba8, and the last work group reduces a
+        // 64x64 level 6, so the image can't be larger than 4096x4096.
+        uint32_t levelsToGenerate = image.getMipLevels() - 1u;
+        return image.getFormat() == VK_FORMAT_R8G8B8A8_UNORM
+            && (image.getUsage() & VK_IMAGE_USAGE_STORAGE_BIT) != 0u
+            && image.getArrayLayers() == 1u
+            && image.getMipLevels() > 1u
+            && levelsToGenerate >= VGFX_DOWNSAMPLER_MIN_MIP_LEVELS
+            && levelsToGenerate <= VGFX_DOWNSAMPLER_MAX_MIP_LEVELS
+            && image.getWidth() <= (1u << VGFX_DOWNSAMPLER_MAX_MIP_LEVELS)
+            && image.getHeight() <= (1u << VGFX_DOWNSAMPLER_MAX_MIP_LEVELS);
+    }
 
-        m_spUAVs.resize(numUAVs);
-        for (uint32_t i = 0; i < numUAVs; ++i) {
-            ImageView::Config config(
-                image.getFormat(),
-                VK_IMAGE_VIEW_TYPE_2D,
-                i + 1u, // mip level
-                1u); // mip count
-            m_spUAVs[i] = std::make_unique<ImageView>(m_context, config, image);
+    std::unique_ptr<ImageDownsampler::Batch> ImageDownsampler::recordCommands(
+        VkCommandBuffer commandBuffer,
+        const std::vector<const Image*>& images)
+    {
+        auto spBatch = std::make_unique<Batch>();
+        if (images.empty()) {
+            return spBatch;
         }
 
-        // update descriptors
-        ImageArrayDescriptorUpdater mipImageViewUpdater(
-            m_spUAVs, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-
-        DescriptorSetUpdater descriptorSetUpdater;
-        descriptorSetUpdater.bindDescriptor(0, mipImageViewUpdater);
-
-        ImageDescriptorUpdater sixthImageUpdater(
-            *m_spUAVs[5].get(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+        uint32_t imageCount = static_cast<uint32_t>(images.size());
 
-        descriptorSetUpdater.bindDescriptor(1, sixthImageUpdater);
-
-        descriptorSetUpdater.bindDescriptor(2, *m_spGlobalCounterUBO.get());
+        const DescriptorSetLayouts& descriptorSetLayouts = m_spComputeShader->getDescriptorSetLayouts();
+        DescriptorPoolBuilder descriptorPoolBuilder;
+        descriptorPoolBuilder.addDescriptorSets(descriptorSetLayouts, imageCount);
+        descriptorPoolBuilder.addMaxSets(imageCount);
+        spBatch->spDescriptorPool = descriptorPoolBuilder.createPool(m_context);
 
-        ImageView::Config sourceCfg(
-            image.getFormat(),
-            VK_IMAGE_VIEW_TYPE_2D,
-            0u, // mip level
-            1u); // mip count
-        m_spSourceSRV = std::make_unique<ImageView>(m_context, sourceCfg, image);
+        std::vector<VkDescriptorSet> descriptorSets(imageCount, VK_NULL_HANDLE);
+        spBatch->spDescriptorPool->allocateDescriptorSets(
+            *descriptorSetLayouts.front(),
+            imageCount,
+            descriptorSets.data());
 
-        ImageDescriptorUpdater sourceSRVUpdater(
-            *m_spSourceSRV.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        // SPD expects its counters to start at zero, and resets them at the end of the dispatch.
+        size_t atomicCountersSizeBytes = static_cast<size_t>(m_atomicCounterStrideBytes * imageCount);
+        Buffer::Config atomicCountersConfig("SpdGlobalAtomicCounters", atomicCountersSizeBytes);
+        spBatch->spAtomicCounters =
+            std::make_unique<Buffer>(m_context, Buffer::Type::StorageBuffer, atomicCountersConfig);
 
-        descriptorSetUpdater.bindDescriptor(3, sourceSRVUpdater);
+        std::vector<uint8_t> zeros(atomicCountersSizeBytes, 0u);
+        spBatch->spAtomicCounters->update(zeros.data(), zeros.size(), 0u, Buffer::MemMap::UnMap);
 
         SamplerDescriptorUpdater samplerUpdater(*m_spSampler.get());
 
-        descriptorSetUpdater.bindDescriptor(4, samplerUpdater);
+        std::vector<VkImageMemoryBarrier> imageMemoryBarriers;
+        imageMemoryBarriers.reserve(images.size() * 2u);
+        for (uint32_t imageIndex = 0u; imageIndex < imageCount; ++imageIndex) {
+            const Image& image = *images[imageIndex];
+            assert(canDownsample(image));
 
-        descriptorSetUpdater.updateDescriptorSet(m_context, m_descriptorSet);
-
-        commandsHelper.execute([&](VkCommandBuffer commandBuffer) {
-            // downsample
-            varAU2 (dispatchThreadGroupCountXY);
-            varAU2 (workGroupOffset);
-            varAU2 (numWorkGroupsAndMips);
-            varAU4 (rectInfo) = initAU4(0, 0, image.getWidth(), image.getHeight());
-            SpdSetup(dispatchThreadGroupCountXY, workGroupOffset, numWorkGroupsAndMips, rectInfo);
-
-            constexpr const uint32_t numBarriers = 2u;
-            VkImageMemoryBarrier imageMemoryBarriers[numBarriers];
-
-            imageMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            imageMemoryBarriers[0].pNext = NULL;
-            imageMemoryBarriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_GENERAL;
-            imageMemoryBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageMemoryBarriers[0].subresourceRange.baseMipLevel = 1u;
-            imageMemoryBarriers[0].subresourceRange.levelCount = image.getMipLevels() - 1u;
-            imageMemoryBarriers[0].subresourceRange.baseArrayLayer = 0;
-            imageMemoryBarriers[0].subresourceRange.layerCount = 1u;
-            imageMemoryBarriers[0].image = image.getHandle();
-
-            imageMemoryBarriers[1].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            imageMemoryBarriers[1].pNext = NULL;
-            imageMemoryBarriers[1].srcAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
-            imageMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageMemoryBarriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageMemoryBarriers[1].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[1].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[1].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageMemoryBarriers[1].subresourceRange.baseMipLevel = 0u;
-            imageMemoryBarriers[1].subresourceRange.levelCount = 1u;
-            imageMemoryBarriers[1].subresourceRange.baseArrayLayer = 0u;
-            imageMemoryBarriers[1].subresourceRange.layerCount = 1u;
-            imageMemoryBarriers[1].image = image.getHandle();
-
-            // transition LOD 0 to shader read, transition rest of LODs to general layout.
-            vkCmdPipelineBarrier(
-                commandBuffer,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                0, // dependency flags
-                0, // mem barrier count
-                nullptr, // mem barriers
-                0, // buffer mem barrier count
-                nullptr, // buffer mem barriers
-                numBarriers,
-                imageMemoryBarriers);
-
-            vkCmdBindPipeline(
-                commandBuffer,
-                VK_PIPELINE_BIND_POINT_COMPUTE,
-                m_spComputePipeline->getHandle());
+            // Mip level 0 is sampled, the other levels are written as storage images.
+            ImageView::Config sourceConfig(
+                image.getFormat(),
+                VK_IMAGE_VIEW_TYPE_2D,
+                0u, // mip level
+                1u); // mip count
+            auto spSourceView = std::make_unique<ImageView>(m_context, sourceConfig, image);
+
+            uint32_t levelsToGenerate = image.getMipLevels() - 1u;
+            std::vector<std::unique_ptr<ImageView>> mipLevelViews(levelsToGenerate);
+            for (uint32_t i = 0u; i < levelsToGenerate; ++i) {
+                ImageView::Config config(
+                    image.getFormat(),
+                    VK_IMAGE_VIEW_TYPE_2D,
+                    i + 1u, // mip level
+                    1u); // mip count
+                mipLevelViews[i] = std::make_unique<ImageView>(m_context, config, image);
+            }
+
+            ImageArrayDescriptorUpdater mipLevelViewsUpdater(
+                mipLevelViews, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+
+            // Mip level 6 is also bound on its own, the last work group reads it back to generate
+            // the remaining levels.
+            ImageDescriptorUpdater sixthImageUpdater(
+                *mipLevelViews[5].get(), VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+
+            BufferRangeDescriptorUpdater atomicCountersUpdater(
+                spBatch->spAtomicCounters->getHandle(),
+                m_atomicCounterStrideBytes * imageIndex,
+                SpdAtomicCountersSizeBytes);
+
+            ImageDescriptorUpdater sourceUpdater(
+                *spSourceView.get(), VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+            DescriptorSetUpdater descriptorSetUpdater;
+            descriptorSetUpdater.bindDescriptor(0, mipLevelViewsUpdater);
+            descriptorSetUpdater.bindDescriptor(1, sixthImageUpdater);
+            descriptorSetUpdater.bindDescriptor(2, atomicCountersUpdater);
+            descriptorSetUpdater.bindDescriptor(3, sourceUpdater);
+            descriptorSetUpdater.bindDescriptor(4, samplerUpdater);
+            descriptorSetUpdater.updateDescriptorSet(m_context, descriptorSets[imageIndex]);
+
+            spBatch->imageViews.push_back(std::move(spSourceView));
+            for (auto& spMipLevelView : mipLevelViews) {
+                spBatch->imageViews.push_back(std::move(spMipLevelView));
+            }
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = image.getHandle();
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseArrayLayer = 0u;
+            barrier.subresourceRange.layerCount = 1u;
+
+            // Make the copy to mip level 0 visible to the compute shader.
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.subresourceRange.baseMipLevel = 0u;
+            barrier.subresourceRange.levelCount = 1u;
+            imageMemoryBarriers.push_back(barrier);
+
+            // The contents of the other levels are about to be overwritten.
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.subresourceRange.baseMipLevel = 1u;
+            barrier.subresourceRange.levelCount = levelsToGenerate;
+            imageMemoryBarriers.push_back(barrier);
+        }
 
-            // should be / 64
-            uint32_t dispatchX = dispatchThreadGroupCountXY[0];
-            uint32_t dispatchY = dispatchThreadGroupCountXY[1];
-            uint32_t dispatchZ = 1u;
+        // The first scope is the fragment shader stage so that this chains with the transition
+        // to shader read only that ends OneTimeCommandsHelper::RecordCopyBufferToImageCommands.
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            0, // dependency flags
+            0, // mem barrier count
+            nullptr, // mem barriers
+            0, // buffer mem barrier count
+            nullptr, // buffer mem barriers
+            static_cast<uint32_t>(imageMemoryBarriers.size()),
+            imageMemoryBarriers.data());
+
+        vkCmdBindPipeline(
+            commandBuffer,
+            VK_PIPELINE_BIND_POINT_COMPUTE,
+            m_spComputePipeline->getHandle());
+
+        // The images don't share any resources, so their dispatches can overlap.
+        for (uint32_t imageIndex = 0u; imageIndex < imageCount; ++imageIndex) {
+            const Image& image = *images[imageIndex];
+
+            varAU2(dispatchThreadGroupCountXY);
+            varAU2(workGroupOffset);
+            varAU2(numWorkGroupsAndMips);
+            varAU4(rectInfo) = initAU4(0, 0, image.getWidth(), image.getHeight());
+            SpdSetup(
+                dispatchThreadGroupCountXY,
+                workGroupOffset,
+                numWorkGroupsAndMips,
+                rectInfo,
+                static_cast<ASU1>(image.getMipLevels() - 1u));
 
-            VkDescriptorSet descriptorSets[] = {
-                m_descriptorSet,
-            };
             vkCmdBindDescriptorSets(
                 commandBuffer,
                 VK_PIPELINE_BIND_POINT_COMPUTE,
                 m_spComputePipeline->getLayout(),
                 0,
                 1,
-                descriptorSets,
+                &descriptorSets[imageIndex],
                 0,
                 nullptr);
 
-            LinearSamplerConstants data;
+            LinearSamplerConstants data = {};
             data.numWorkGroupsPerSlice = numWorkGroupsAndMips[0];
             data.mips = numWorkGroupsAndMips[1];
             data.workGroupOffset[0] = workGroupOffset[0];
@@ -256,36 +317,50 @@ namespace vgfx
                 sizeof(LinearSamplerConstants),
                 static_cast<void*>(&data));
 
-            vkCmdDispatch(commandBuffer, dispatchX, dispatchY, dispatchZ);
-
-            imageMemoryBarriers[0] = {};
-            imageMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-            imageMemoryBarriers[0].pNext = NULL;
-            imageMemoryBarriers[0].srcAccessMask = 0;
-            imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT;
-            imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
-            imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageMemoryBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-            imageMemoryBarriers[0].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            imageMemoryBarriers[0].subresourceRange.baseMipLevel = 1u;
-            imageMemoryBarriers[0].subresourceRange.levelCount = image.getMipLevels() - 1u;
-            imageMemoryBarriers[0].subresourceRange.baseArrayLayer = 0u;
-            imageMemoryBarriers[0].subresourceRange.layerCount = 1u;
-            imageMemoryBarriers[0].image = image.getHandle();
-
-            // transition general layout of destination image to shader read only for source image
-            vkCmdPipelineBarrier(
-                commandBuffer,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-                0,
-                0,
-                nullptr,
-                0,
-                nullptr,
-                1,
-                imageMemoryBarriers);
+            vkCmdDispatch(commandBuffer, dispatchThreadGroupCountXY[0], dispatchThreadGroupCountXY[1], 1u);
+        }
+
+        // Transition the generated levels to shader read only, like the rest of the image.
+        imageMemoryBarriers.clear();
+        for (const Image* pImage : images) {
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = pImage->getHandle();
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 1u;
+            barrier.subresourceRange.levelCount = pImage->getMipLevels() - 1u;
+            barrier.subresourceRange.baseArrayLayer = 0u;
+            barrier.subresourceRange.layerCount = 1u;
+            imageMemoryBarriers.push_back(barrier);
+        }
+
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+            0,
+            0,
+            nullptr,
+            0,
+            nullptr,
+            static_cast<uint32_t>(imageMemoryBarriers.size()),
+            imageMemoryBarriers.data());
+
+        return spBatch;
+    }
+
+    void ImageDownsampler::execute(const Image& image, OneTimeCommandsHelper& commandsHelper)
+    {
+        std::unique_ptr<Batch> spBatch;
+        commandsHelper.execute([&](VkCommandBuffer commandBuffer) {
+            spBatch = recordCommands(commandBuffer, { &image });
         });
+        // OneTimeCommandsHelper::execute waits for the commands to complete.
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,764 @@
+#include "VulkanGraphicsImageKernels.h"
+
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define VGFX_IMAGE_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define VGFX_IMAGE_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang only compile intrinsics in functions that target their instruction set, MSVC
+// compiles them anywhere.
+#if defined(VGFX_IMAGE_KERNELS_X86) && defined(__GNUC__)
+#define VGFX_TARGET_SSE2 __attribute__((target("sse2")))
+#define VGFX_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VGFX_TARGET_SSE2
+#define VGFX_TARGET_AVX2
+#endif
+
+namespace vgfx
+{
+    namespace ImageKernels
+    {
+        static InstructionSet DetectInstructionSet()
+        {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+#if defined(_MSC_VER)
+            int cpuInfo[4] = {};
+            __cpuid(cpuInfo, 0);
+            int maxLeaf = cpuInfo[0];
+            __cpuid(cpuInfo, 1);
+            bool hasSse2 = (cpuInfo[3] & (1 << 26)) != 0;
+            bool hasOsXsave = (cpuInfo[2] & (1 << 27)) != 0;
+            bool hasAvx = (cpuInfo[2] & (1 << 28)) != 0;
+            bool hasAvx2 = false;
+            // The OS must also save the YMM registers.
+            if (maxLeaf >= 7 && hasOsXsave && hasAvx && (_xgetbv(0) & 6u) == 6u) {
+                __cpuidex(cpuInfo, 7, 0);
+                hasAvx2 = (cpuInfo[1] & (1 << 5)) != 0;
+            }
+#else
+            __builtin_cpu_init();
+            bool hasSse2 = __builtin_cpu_supports("sse2");
+            bool hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+            if (hasAvx2) {
+                return InstructionSet::Avx2;
+            }
+            if (hasSse2) {
+                return InstructionSet::Sse2;
+            }
+            return InstructionSet::Scalar;
+#elif defined(VGFX_IMAGE_KERNELS_NEON)
+            // NEON is part of the ARMv8-A baseline.
+            return InstructionSet::Neon;
+#else
+            return InstructionSet::Scalar;
+#endif
+        }
+
+        static InstructionSet GetSupportedInstructionSet()
+        {
+            static const InstructionSet supported = DetectInstructionSet();
+            return supported;
+        }
+
+        static std::atomic<InstructionSet>& GetSelectedInstructionSet()
+        {
+            static std::atomic<InstructionSet> selected(GetSupportedInstructionSet());
+            return selected;
+        }
+
+        bool IsSupported(InstructionSet instructionSet)
+        {
+            InstructionSet supported = GetSupportedInstructionSet();
+            switch (instructionSet) {
+            case InstructionSet::Scalar:
+                return true;
+            case InstructionSet::Sse2:
+                return supported == InstructionSet::Sse2 || supported == InstructionSet::Avx2;
+            case InstructionSet::Avx2:
+                return supported == InstructionSet::Avx2;
+            case InstructionSet::Neon:
+                return supported == InstructionSet::Neon;
+            }
+            return false;
+        }
+
+        InstructionSet GetInstructionSet()
+        {
+            return GetSelectedInstructionSet().load(std::memory_order_relaxed);
+        }
+
+        bool SetInstructionSet(InstructionSet instructionSet)
+        {
+            if (!IsSupported(instructionSet)) {
+                return false;
+            }
+            GetSelectedInstructionSet().store(instructionSet, std::memory_order_relaxed);
+            return true;
+        }
+
+        const char* GetInstructionSetName(InstructionSet instructionSet)
+        {
+            switch (instructionSet) {
+            case InstructionSet::Scalar:
+                return "Scalar";
+            case InstructionSet::Sse2:
+                return "SSE2";
+            case InstructionSet::Avx2:
+                return "AVX2";
+            case InstructionSet::Neon:
+                return "NEON";
+            }
+            return "Unknown";
+        }
+
+        // sRGB conversion tables, shared by all of the instruction sets so that they agree exactly.
+        struct SrgbTables
+        {
+            float toLinear[256];
+            // Linear value halfway between each sRGB value and the next one, the last is never reached.
+            float thresholds[256];
+            // Number of thresholds that are <= i / LinearBuckets. A bucket is narrower than the
+            // smallest gap between thresholds, so it contains at most one of them.
+            static constexpr uint32_t LinearBuckets = 4096u;
+            int32_t bucketBase[LinearBuckets + 1u];
+
+            SrgbTables()
+            {
+                auto srgbToLinear = [](double value) {
+                    return value <= 0.04045 ? value / 12.92 : std::pow((value + 0.055) / 1.055, 2.4);
+                };
+                for (uint32_t value = 0u; value < 256u; ++value) {
+                    toLinear[value] = static_cast<float>(srgbToLinear(value / 255.0));
+                    thresholds[value] = value < 255u ? static_cast<float>(srgbToLinear((value + 0.5) / 255.0)) : 2.0f;
+                }
+
+                int32_t count = 0;
+                for (uint32_t bucket = 0u; bucket <= LinearBuckets; ++bucket) {
+                    float bucketStart = static_cast<float>(bucket) / LinearBuckets;
+                    while (thresholds[count] <= bucketStart) {
+                        ++count;
+                    }
+                    bucketBase[bucket] = count;
+                    assert(bucket == LinearBuckets || count >= 254
+                        || thresholds[count + 1] >= static_cast<float>(bucket + 1u) / LinearBuckets);
+                }
+            }
+        };
+
+        static const SrgbTables& GetSrgbTables()
+        {
+            static const SrgbTables tables;
+            return tables;
+        }
+
+        // Scalar kernels, the reference that the others must match.
+
+        static inline float ClampUnit(float value)
+        {
+            // NaN is clamped to 0, as by the SIMD min/max.
+            return value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        }
+
+        static inline uint8_t FloatToUnorm8(float value)
+        {
+            float scaled = value * 255.0f;
+            return static_cast<uint8_t>(static_cast<int32_t>(scaled + 0.5f));
+        }
+
+        static inline uint8_t LinearToSrgb8(const SrgbTables& tables, float value)
+        {
+            int32_t srgb = tables.bucketBase[static_cast<int32_t>(value * SrgbTables::LinearBuckets)];
+            return static_cast<uint8_t>(value >= tables.thresholds[srgb] ? srgb + 1 : srgb);
+        }
+
+        static inline uint8_t PremultiplyChannel(uint32_t channel, uint32_t alpha)
+        {
+            // Exact division by 255, rounded to nearest.
+            uint32_t product = channel * alpha + 128u;
+            return static_cast<uint8_t>((product + (product >> 8u)) >> 8u);
+        }
+
+        static void ExpandRgbToRgbaScalar(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut)
+        {
+            for (size_t i = 0u; i < texelCount; ++i) {
+                pRgbaOut[i * 4u + 0u] = pRgb[i * 3u + 0u];
+                pRgbaOut[i * 4u + 1u] = pRgb[i * 3u + 1u];
+                pRgbaOut[i * 4u + 2u] = pRgb[i * 3u + 2u];
+                pRgbaOut[i * 4u + 3u] = 255u;
+            }
+        }
+
+        static void PremultiplyAlphaScalar(uint8_t* pRgba, size_t texelCount)
+        {
+            for (size_t i = 0u; i < texelCount; ++i) {
+                uint8_t* pTexel = pRgba + i * 4u;
+                for (uint32_t channel = 0u; channel < 3u; ++channel) {
+                    pTexel[channel] = PremultiplyChannel(pTexel[channel], pTexel[3]);
+                }
+            }
+        }
+
+        static void ConvertRgba8ToFloatScalar(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut)
+        {
+            const SrgbTables& tables = GetSrgbTables();
+            for (size_t i = 0u; i < texelCount * 4u; ++i) {
+                pRgbaOut[i] = isSrgb && (i & 3u) != 3u ? tables.toLinear[pRgba[i]] : pRgba[i] / 255.0f;
+            }
+        }
+
+        static void ConvertFloatToRgba8Scalar(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut)
+        {
+            const SrgbTables& tables = GetSrgbTables();
+            for (size_t i = 0u; i < texelCount * 4u; ++i) {
+                float value = ClampUnit(pRgba[i]);
+                pRgbaOut[i] = isSrgb && (i & 3u) != 3u ? LinearToSrgb8(tables, value) : FloatToUnorm8(value);
+            }
+        }
+
+        // Averages the 2x2 blocks of two rows into dstCount texels.
+        static void ReduceRows2x2Scalar(const uint8_t* pRow0, const uint8_t* pRow1, size_t dstCount, uint8_t* pDst)
+        {
+            for (size_t i = 0u; i < dstCount * 4u; ++i) {
+                size_t src = (i / 4u) * 8u + (i & 3u);
+                uint32_t sum = pRow0[src] + pRow0[src + 4u] + pRow1[src] + pRow1[src + 4u];
+                pDst[i] = static_cast<uint8_t>((sum + 2u) >> 2u);
+            }
+        }
+
+        // Reduces an image that has a side of 1, each texel is the average of 2 texels.
+        static void ReduceLine(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            uint32_t srcCount = width * height;
+            if (srcCount == 1u) {
+                memcpy(pRgbaOut, pRgba, 4u);
+                return;
+            }
+            for (uint32_t i = 0u; i < srcCount * 2u; ++i) {
+                uint32_t src = (i / 4u) * 8u + (i & 3u);
+                pRgbaOut[i] = static_cast<uint8_t>((pRgba[src] + pRgba[src + 4u] + 1u) >> 1u);
+            }
+        }
+
+        static void Reduce2x2Scalar(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            size_t rowSize = static_cast<size_t>(width) * 4u;
+            uint32_t dstWidth = width / 2u;
+            for (uint32_t y = 0u; y < height / 2u; ++y) {
+                const uint8_t* pRow0 = pRgba + 2u * y * rowSize;
+                ReduceRows2x2Scalar(pRow0, pRow0 + rowSize, dstWidth, pRgbaOut + y * dstWidth * 4u);
+            }
+        }
+
+#if defined(VGFX_IMAGE_KERNELS_X86)
+        // SSE2 kernels.
+
+        VGFX_TARGET_SSE2
+        static void ExpandRgbToRgbaSse2(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut)
+        {
+            const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+            size_t i = 0u;
+            // Each load reads 16 bytes for 4 texels, so stop while a whole load is in bounds.
+            for (; i + 6u <= texelCount; i += 4u) {
+                __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRgb + i * 3u));
+                __m128i texels01 = _mm_unpacklo_epi32(rgb, _mm_srli_si128(rgb, 3));
+                __m128i texels23 = _mm_unpacklo_epi32(_mm_srli_si128(rgb, 6), _mm_srli_si128(rgb, 9));
+                __m128i rgba = _mm_or_si128(_mm_unpacklo_epi64(texels01, texels23), alpha);
+                // The fourth byte of each texel is the next texel's red, which the OR overwrites.
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pRgbaOut + i * 4u), rgba);
+            }
+            ExpandRgbToRgbaScalar(pRgb + i * 3u, texelCount - i, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_SSE2
+        static inline __m128i PremultiplyTexels16Sse2(__m128i texels, __m128i alphaMask)
+        {
+            __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m128i product = _mm_add_epi16(_mm_mullo_epi16(texels, alpha), _mm_set1_epi16(128));
+            __m128i premultiplied = _mm_srli_epi16(_mm_add_epi16(product, _mm_srli_epi16(product, 8)), 8);
+            return _mm_or_si128(_mm_andnot_si128(alphaMask, premultiplied), _mm_and_si128(alphaMask, texels));
+        }
+
+        VGFX_TARGET_SSE2
+        static void PremultiplyAlphaSse2(uint8_t* pRgba, size_t texelCount)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i alphaMask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+            size_t i = 0u;
+            for (; i + 4u <= texelCount; i += 4u) {
+                __m128i* pTexels = reinterpret_cast<__m128i*>(pRgba + i * 4u);
+                __m128i texels = _mm_loadu_si128(pTexels);
+                __m128i lo = PremultiplyTexels16Sse2(_mm_unpacklo_epi8(texels, zero), alphaMask);
+                __m128i hi = PremultiplyTexels16Sse2(_mm_unpackhi_epi8(texels, zero), alphaMask);
+                _mm_storeu_si128(pTexels, _mm_packus_epi16(lo, hi));
+            }
+            PremultiplyAlphaScalar(pRgba + i * 4u, texelCount - i);
+        }
+
+        VGFX_TARGET_SSE2
+        static void ConvertRgba8ToFloatSse2(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut)
+        {
+            // SSE2 has no gather, so the table lookups of sRGB texels stay scalar.
+            if (isSrgb) {
+                ConvertRgba8ToFloatScalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+            const __m128 scale = _mm_set1_ps(255.0f);
+            size_t i = 0u;
+            for (; i + 4u <= texelCount; i += 4u) {
+                __m128i texels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRgba + i * 4u));
+                __m128i lo = _mm_unpacklo_epi8(texels, zero);
+                __m128i hi = _mm_unpackhi_epi8(texels, zero);
+                float* pOut = pRgbaOut + i * 4u;
+                _mm_storeu_ps(pOut + 0u, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+                _mm_storeu_ps(pOut + 4u, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+                _mm_storeu_ps(pOut + 8u, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+                _mm_storeu_ps(pOut + 12u, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+            }
+            ConvertRgba8ToFloatScalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_SSE2
+        static inline __m128i FloatToUnorm8Sse2(__m128 value)
+        {
+            value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+            __m128 scaled = _mm_mul_ps(value, _mm_set1_ps(255.0f));
+            return _mm_cvttps_epi32(_mm_add_ps(scaled, _mm_set1_ps(0.5f)));
+        }
+
+        VGFX_TARGET_SSE2
+        static void ConvertFloatToRgba8Sse2(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut)
+        {
+            if (isSrgb) {
+                ConvertFloatToRgba8Scalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+
+            size_t i = 0u;
+            for (; i + 4u <= texelCount; i += 4u) {
+                const float* pIn = pRgba + i * 4u;
+                __m128i texel0 = FloatToUnorm8Sse2(_mm_loadu_ps(pIn + 0u));
+                __m128i texel1 = FloatToUnorm8Sse2(_mm_loadu_ps(pIn + 4u));
+                __m128i texel2 = FloatToUnorm8Sse2(_mm_loadu_ps(pIn + 8u));
+                __m128i texel3 = FloatToUnorm8Sse2(_mm_loadu_ps(pIn + 12u));
+                __m128i texels =
+                    _mm_packus_epi16(_mm_packs_epi32(texel0, texel1), _mm_packs_epi32(texel2, texel3));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(pRgbaOut + i * 4u), texels);
+            }
+            ConvertFloatToRgba8Scalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_SSE2
+        static void Reduce2x2Sse2(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i rounding = _mm_set1_epi16(2);
+            size_t rowSize = static_cast<size_t>(width) * 4u;
+            uint32_t dstWidth = width / 2u;
+            for (uint32_t y = 0u; y < height / 2u; ++y) {
+                const uint8_t* pRow0 = pRgba + 2u * y * rowSize;
+                const uint8_t* pRow1 = pRow0 + rowSize;
+                uint8_t* pDst = pRgbaOut + y * dstWidth * 4u;
+                uint32_t x = 0u;
+                // 4 texels of each row are reduced to 2 at a time.
+                for (; x + 2u <= dstWidth; x += 2u) {
+                    __m128i row0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0 + x * 8u));
+                    __m128i row1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1 + x * 8u));
+                    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(row0, zero), _mm_unpacklo_epi8(row1, zero));
+                    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(row0, zero), _mm_unpackhi_epi8(row1, zero));
+                    // Add the right texel of each pair to the left one.
+                    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+                    __m128i sums = _mm_unpacklo_epi64(lo, hi);
+                    __m128i averages = _mm_srli_epi16(_mm_add_epi16(sums, rounding), 2);
+                    _mm_storel_epi64(reinterpret_cast<__m128i*>(pDst + x * 4u), _mm_packus_epi16(averages, zero));
+                }
+                ReduceRows2x2Scalar(pRow0 + x * 8u, pRow1 + x * 8u, dstWidth - x, pDst + x * 4u);
+            }
+        }
+
+        // AVX2 kernels.
+
+        VGFX_TARGET_AVX2
+        static void ExpandRgbToRgbaAvx2(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut)
+        {
+            const __m256i shuffle = _mm256_setr_epi8(
+                0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+            size_t i = 0u;
+            // 8 texels at a time from two 16 byte loads, the second ending 28 bytes in.
+            for (; i + 10u <= texelCount; i += 8u) {
+                const uint8_t* pIn = pRgb + i * 3u;
+                __m256i rgb = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 12u)),
+                    1);
+                __m256i rgba = _mm256_or_si256(_mm256_shuffle_epi8(rgb, shuffle), alpha);
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(pRgbaOut + i * 4u), rgba);
+            }
+            ExpandRgbToRgbaScalar(pRgb + i * 3u, texelCount - i, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_AVX2
+        static inline __m256i PremultiplyTexels16Avx2(__m256i texels, __m256i alphaMask)
+        {
+            __m256i alpha =
+                _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(texels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+            __m256i product = _mm256_add_epi16(_mm256_mullo_epi16(texels, alpha), _mm256_set1_epi16(128));
+            __m256i premultiplied = _mm256_srli_epi16(_mm256_add_epi16(product, _mm256_srli_epi16(product, 8)), 8);
+            return _mm256_blendv_epi8(premultiplied, texels, alphaMask);
+        }
+
+        VGFX_TARGET_AVX2
+        static void PremultiplyAlphaAvx2(uint8_t* pRgba, size_t texelCount)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i alphaMask = _mm256_set1_epi64x(static_cast<long long>(0xFFFF000000000000ull));
+            size_t i = 0u;
+            for (; i + 8u <= texelCount; i += 8u) {
+                __m256i* pTexels = reinterpret_cast<__m256i*>(pRgba + i * 4u);
+                __m256i texels = _mm256_loadu_si256(pTexels);
+                // Unpacking and packing both work within each 128 bit lane, so the order is kept.
+                __m256i lo = PremultiplyTexels16Avx2(_mm256_unpacklo_epi8(texels, zero), alphaMask);
+                __m256i hi = PremultiplyTexels16Avx2(_mm256_unpackhi_epi8(texels, zero), alphaMask);
+                _mm256_storeu_si256(pTexels, _mm256_packus_epi16(lo, hi));
+            }
+            PremultiplyAlphaScalar(pRgba + i * 4u, texelCount - i);
+        }
+
+        VGFX_TARGET_AVX2
+        static void ConvertRgba8ToFloatAvx2(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut)
+        {
+            const float* pToLinear = GetSrgbTables().toLinear;
+            const __m256 scale = _mm256_set1_ps(255.0f);
+            size_t i = 0u;
+            for (; i + 2u <= texelCount; i += 2u) {
+                __m256i values =
+                    _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(pRgba + i * 4u)));
+                __m256 unorm = _mm256_div_ps(_mm256_cvtepi32_ps(values), scale);
+                if (isSrgb) {
+                    // Alpha, the fourth channel of each texel, stays linear.
+                    unorm = _mm256_blend_ps(_mm256_i32gather_ps(pToLinear, values, 4), unorm, 0x88);
+                }
+                _mm256_storeu_ps(pRgbaOut + i * 4u, unorm);
+            }
+            ConvertRgba8ToFloatScalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_AVX2
+        static inline __m256i FloatToRgba8Avx2(__m256 value, bool isSrgb, const SrgbTables& tables)
+        {
+            value = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+            __m256 scaled = _mm256_mul_ps(value, _mm256_set1_ps(255.0f));
+            __m256i unorm = _mm256_cvttps_epi32(_mm256_add_ps(scaled, _mm256_set1_ps(0.5f)));
+            if (!isSrgb) {
+                return unorm;
+            }
+
+            __m256i bucket =
+                _mm256_cvttps_epi32(_mm256_mul_ps(value, _mm256_set1_ps(static_cast<float>(SrgbTables::LinearBuckets))));
+            __m256i srgb = _mm256_i32gather_epi32(tables.bucketBase, bucket, 4);
+            __m256 threshold = _mm256_i32gather_ps(tables.thresholds, srgb, 4);
+            // The comparison's mask is -1, so subtracting it adds 1.
+            srgb = _mm256_sub_epi32(srgb, _mm256_castps_si256(_mm256_cmp_ps(value, threshold, _CMP_GE_OQ)));
+            return _mm256_blend_epi32(srgb, unorm, 0x88);
+        }
+
+        VGFX_TARGET_AVX2
+        static void ConvertFloatToRgba8Avx2(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut)
+        {
+            const SrgbTables& tables = GetSrgbTables();
+            const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+            size_t i = 0u;
+            for (; i + 8u <= texelCount; i += 8u) {
+                const float* pIn = pRgba + i * 4u;
+                __m256i texels01 = FloatToRgba8Avx2(_mm256_loadu_ps(pIn + 0u), isSrgb, tables);
+                __m256i texels23 = FloatToRgba8Avx2(_mm256_loadu_ps(pIn + 8u), isSrgb, tables);
+                __m256i texels45 = FloatToRgba8Avx2(_mm256_loadu_ps(pIn + 16u), isSrgb, tables);
+                __m256i texels67 = FloatToRgba8Avx2(_mm256_loadu_ps(pIn + 24u), isSrgb, tables);
+                // Packing interleaves the 128 bit lanes, the permute restores the texel order.
+                __m256i texels = _mm256_packus_epi16(
+                    _mm256_packs_epi32(texels01, texels23),
+                    _mm256_packs_epi32(texels45, texels67));
+                _mm256_storeu_si256(
+                    reinterpret_cast<__m256i*>(pRgbaOut + i * 4u),
+                    _mm256_permutevar8x32_epi32(texels, order));
+            }
+            ConvertFloatToRgba8Scalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        VGFX_TARGET_AVX2
+        static inline __m256i SumRows2x2Avx2(const uint8_t* pRow0, const uint8_t* pRow1)
+        {
+            // 4 texels of each row, then the right texel of each pair is added to the left one.
+            __m256i sums = _mm256_add_epi16(
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow0))),
+                _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pRow1))));
+            sums = _mm256_add_epi16(sums, _mm256_srli_si256(sums, 8));
+            // Moves the 2 sums to the low lane.
+            return _mm256_permute4x64_epi64(sums, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+
+        VGFX_TARGET_AVX2
+        static void Reduce2x2Avx2(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            const __m256i rounding = _mm256_set1_epi16(2);
+            size_t rowSize = static_cast<size_t>(width) * 4u;
+            uint32_t dstWidth = width / 2u;
+            for (uint32_t y = 0u; y < height / 2u; ++y) {
+                const uint8_t* pRow0 = pRgba + 2u * y * rowSize;
+                const uint8_t* pRow1 = pRow0 + rowSize;
+                uint8_t* pDst = pRgbaOut + y * dstWidth * 4u;
+                uint32_t x = 0u;
+                for (; x + 4u <= dstWidth; x += 4u) {
+                    __m256i sums01 = SumRows2x2Avx2(pRow0 + x * 8u, pRow1 + x * 8u);
+                    __m256i sums23 = SumRows2x2Avx2(pRow0 + x * 8u + 16u, pRow1 + x * 8u + 16u);
+                    __m256i sums = _mm256_inserti128_si256(sums01, _mm256_castsi256_si128(sums23), 1);
+                    __m256i averages = _mm256_srli_epi16(_mm256_add_epi16(sums, rounding), 2);
+                    __m256i packed = _mm256_permute4x64_epi64(
+                        _mm256_packus_epi16(averages, averages), _MM_SHUFFLE(3, 1, 2, 0));
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(pDst + x * 4u), _mm256_castsi256_si128(packed));
+                }
+                ReduceRows2x2Scalar(pRow0 + x * 8u, pRow1 + x * 8u, dstWidth - x, pDst + x * 4u);
+            }
+        }
+#endif
+
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+        // NEON kernels.
+
+        static void ExpandRgbToRgbaNeon(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut)
+        {
+            size_t i = 0u;
+            for (; i + 16u <= texelCount; i += 16u) {
+                uint8x16x3_t rgb = vld3q_u8(pRgb + i * 3u);
+                uint8x16x4_t rgba = { { rgb.val[0], rgb.val[1], rgb.val[2], vdupq_n_u8(255u) } };
+                vst4q_u8(pRgbaOut + i * 4u, rgba);
+            }
+            ExpandRgbToRgbaScalar(pRgb + i * 3u, texelCount - i, pRgbaOut + i * 4u);
+        }
+
+        static inline uint8x8_t PremultiplyChannelNeon(uint8x8_t channel, uint8x8_t alpha)
+        {
+            uint16x8_t product = vaddq_u16(vmull_u8(channel, alpha), vdupq_n_u16(128u));
+            return vshrn_n_u16(vsraq_n_u16(product, product, 8), 8);
+        }
+
+        static void PremultiplyAlphaNeon(uint8_t* pRgba, size_t texelCount)
+        {
+            size_t i = 0u;
+            for (; i + 8u <= texelCount; i += 8u) {
+                uint8x8x4_t texels = vld4_u8(pRgba + i * 4u);
+                for (uint32_t channel = 0u; channel < 3u; ++channel) {
+                    texels.val[channel] = PremultiplyChannelNeon(texels.val[channel], texels.val[3]);
+                }
+                vst4_u8(pRgba + i * 4u, texels);
+            }
+            PremultiplyAlphaScalar(pRgba + i * 4u, texelCount - i);
+        }
+
+        static void ConvertRgba8ToFloatNeon(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut)
+        {
+            // NEON has no gather, so the table lookups of sRGB texels stay scalar.
+            if (isSrgb) {
+                ConvertRgba8ToFloatScalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+
+            const float32x4_t scale = vdupq_n_f32(255.0f);
+            size_t i = 0u;
+            for (; i + 4u <= texelCount; i += 4u) {
+                uint8x16_t texels = vld1q_u8(pRgba + i * 4u);
+                uint16x8_t lo = vmovl_u8(vget_low_u8(texels));
+                uint16x8_t hi = vmovl_u8(vget_high_u8(texels));
+                float* pOut = pRgbaOut + i * 4u;
+                vst1q_f32(pOut + 0u, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(lo))), scale));
+                vst1q_f32(pOut + 4u, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(lo))), scale));
+                vst1q_f32(pOut + 8u, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(hi))), scale));
+                vst1q_f32(pOut + 12u, vdivq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(hi))), scale));
+            }
+            ConvertRgba8ToFloatScalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        static inline uint16x4_t FloatToUnorm8Neon(float32x4_t value)
+        {
+            // vmaxnm returns the number if one operand is NaN, which clamps NaN to 0.
+            value = vminq_f32(vmaxnmq_f32(value, vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+            float32x4_t scaled = vmulq_f32(value, vdupq_n_f32(255.0f));
+            return vmovn_u32(vcvtq_u32_f32(vaddq_f32(scaled, vdupq_n_f32(0.5f))));
+        }
+
+        static void ConvertFloatToRgba8Neon(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut)
+        {
+            if (isSrgb) {
+                ConvertFloatToRgba8Scalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+
+            size_t i = 0u;
+            for (; i + 4u <= texelCount; i += 4u) {
+                const float* pIn = pRgba + i * 4u;
+                uint16x8_t texels01 = vcombine_u16(FloatToUnorm8Neon(vld1q_f32(pIn + 0u)), FloatToUnorm8Neon(vld1q_f32(pIn + 4u)));
+                uint16x8_t texels23 = vcombine_u16(FloatToUnorm8Neon(vld1q_f32(pIn + 8u)), FloatToUnorm8Neon(vld1q_f32(pIn + 12u)));
+                vst1q_u8(pRgbaOut + i * 4u, vcombine_u8(vmovn_u16(texels01), vmovn_u16(texels23)));
+            }
+            ConvertFloatToRgba8Scalar(pRgba + i * 4u, texelCount - i, isSrgb, pRgbaOut + i * 4u);
+        }
+
+        static void Reduce2x2Neon(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            size_t rowSize = static_cast<size_t>(width) * 4u;
+            uint32_t dstWidth = width / 2u;
+            for (uint32_t y = 0u; y < height / 2u; ++y) {
+                const uint8_t* pRow0 = pRgba + 2u * y * rowSize;
+                const uint8_t* pRow1 = pRow0 + rowSize;
+                uint8_t* pDst = pRgbaOut + y * dstWidth * 4u;
+                uint32_t x = 0u;
+                // The loads deinterleave the channels, so adding pairwise adds neighboring texels.
+                for (; x + 8u <= dstWidth; x += 8u) {
+                    uint8x16x4_t row0 = vld4q_u8(pRow0 + x * 8u);
+                    uint8x16x4_t row1 = vld4q_u8(pRow1 + x * 8u);
+                    uint8x8x4_t averages;
+                    for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                        uint16x8_t sums = vpadalq_u8(vpaddlq_u8(row0.val[channel]), row1.val[channel]);
+                        averages.val[channel] = vrshrn_n_u16(sums, 2);
+                    }
+                    vst4_u8(pDst + x * 4u, averages);
+                }
+                ReduceRows2x2Scalar(pRow0 + x * 8u, pRow1 + x * 8u, dstWidth - x, pDst + x * 4u);
+            }
+        }
+#endif
+
+        void ExpandRgbToRgba(const uint8_t* pRgb, size_t texelCount, uint8_t* pRgbaOut)
+        {
+            switch (GetInstructionSet()) {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+            case InstructionSet::Avx2:
+                ExpandRgbToRgbaAvx2(pRgb, texelCount, pRgbaOut);
+                return;
+            case InstructionSet::Sse2:
+                ExpandRgbToRgbaSse2(pRgb, texelCount, pRgbaOut);
+                return;
+#endif
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+            case InstructionSet::Neon:
+                ExpandRgbToRgbaNeon(pRgb, texelCount, pRgbaOut);
+                return;
+#endif
+            default:
+                ExpandRgbToRgbaScalar(pRgb, texelCount, pRgbaOut);
+                return;
+            }
+        }
+
+        void PremultiplyAlpha(uint8_t* pRgba, size_t texelCount)
+        {
+            switch (GetInstructionSet()) {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+            case InstructionSet::Avx2:
+                PremultiplyAlphaAvx2(pRgba, texelCount);
+                return;
+            case InstructionSet::Sse2:
+                PremultiplyAlphaSse2(pRgba, texelCount);
+                return;
+#endif
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+            case InstructionSet::Neon:
+                PremultiplyAlphaNeon(pRgba, texelCount);
+                return;
+#endif
+            default:
+                PremultiplyAlphaScalar(pRgba, texelCount);
+                return;
+            }
+        }
+
+        void ConvertRgba8ToFloat(const uint8_t* pRgba, size_t texelCount, bool isSrgb, float* pRgbaOut)
+        {
+            switch (GetInstructionSet()) {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+            case InstructionSet::Avx2:
+                ConvertRgba8ToFloatAvx2(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            case InstructionSet::Sse2:
+                ConvertRgba8ToFloatSse2(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+#endif
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+            case InstructionSet::Neon:
+                ConvertRgba8ToFloatNeon(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+#endif
+            default:
+                ConvertRgba8ToFloatScalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+        }
+
+        void ConvertFloatToRgba8(const float* pRgba, size_t texelCount, bool isSrgb, uint8_t* pRgbaOut)
+        {
+            switch (GetInstructionSet()) {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+            case InstructionSet::Avx2:
+                ConvertFloatToRgba8Avx2(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            case InstructionSet::Sse2:
+                ConvertFloatToRgba8Sse2(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+#endif
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+            case InstructionSet::Neon:
+                ConvertFloatToRgba8Neon(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+#endif
+            default:
+                ConvertFloatToRgba8Scalar(pRgba, texelCount, isSrgb, pRgbaOut);
+                return;
+            }
+        }
+
+        void Reduce2x2(const uint8_t* pRgba, uint32_t width, uint32_t height, uint8_t* pRgbaOut)
+        {
+            assert((width == 1u || (width & 1u) == 0u) && (height == 1u || (height & 1u) == 0u));
+            if (width == 1u || height == 1u) {
+                ReduceLine(pRgba, width, height, pRgbaOut);
+                return;
+            }
+
+            switch (GetInstructionSet()) {
+#if defined(VGFX_IMAGE_KERNELS_X86)
+            case InstructionSet::Avx2:
+                Reduce2x2Avx2(pRgba, width, height, pRgbaOut);
+                return;
+            case InstructionSet::Sse2:
+                Reduce2x2Sse2(pRgba, width, height, pRgbaOut);
+                return;
+#endif
+#if defined(VGFX_IMAGE_KERNELS_NEON)
+            case InstructionSet::Neon:
+                Reduce2x2Neon(pRgba, width, height, pRgbaOut);
+                return;
+#endif
+            default:
+                Reduce2x2Scalar(pRgba, width, height, pRgbaOut);
+                return;
+            }
+        }
+    }
+}
@@ -12,15 +12,21 @@ namespace vgfx
         const Config& config,
         const Image& image)
         : m_context(context)
+        , m_config(config)
         , m_image(image)
     {
-        VkDevice device = context.getLogicalDevice();
+        create();
+    }
+
+    void ImageView::create()
+    {
+        VkDevice device = m_context.getLogicalDevice();
         assert(device != VK_NULL_HANDLE && "Invalid context!");
 
-        VkAllocationCallbacks* pAllocationCallbacks = context.getAllocationCallbacks();
+        VkAllocationCallbacks* pAllocationCallbacks = m_context.getAllocationCallbacks();
 
-        VkImageViewCreateInfo imageViewInfo = config.imageViewInfo;
-        imageViewInfo.image = image.getHandle();
+        VkImageViewCreateInfo imageViewInfo = m_config.imageViewInfo;
+        imageViewInfo.image = m_image.getHandle();
 
         if (vkCreateImageView(device, &imageViewInfo, pAllocationCallbacks, &m_imageView) != VK_SUCCESS) {
             throw std::runtime_error("Failed to create image view!");
@@ -37,7 +43,9 @@ namespace vgfx
 
             VkAllocationCallbacks* pAllocationCallbacks = m_context.getAllocationCallbacks();
 
-            vkDestroyImageView(device, m_imageView, pAllocationCallbacks);
+            m_context.retire([device, imageView = m_imageView, pAllocationCallbacks]() {
+                vkDestroyImageView(device, imageView, pAllocationCallbacks);
+            });
 
             m_imageView = VK_NULL_HANDLE;
         }
@@ -1,5 +1,6 @@
 #include "VulkanGraphicsIndexBuffer.h"
 
+#include "VulkanGraphicsGeometryArena.h"
 #include "VulkanGraphicsOneTimeCommands.h"
 
 #include <cassert>
@@ -28,26 +29,47 @@ namespace vgfx
         const Config& config,
         const void* pIndices,
         uint32_t numIndices)
-        : m_context(context)
+        : m_pContext(&context)
         , m_indexType(config.indexType)
         , m_numIndices(numIndices)
         , m_hasPrimitiveRestartValues(config.hasPrimitiveRestartValues)
     {
         VkDeviceSize dataSizeBytes = numIndices * IndexTypeSizeBytes(m_indexType);
-        if (config.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
-            m_buffer =
-                context.getMemoryAllocator().createBuffer(
-                    dataSizeBytes,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
-        } else {
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = dataSizeBytes;
+        // Transfer src so that the Defragmenter can copy it.
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+        bufferCreateInfo.sharingMode = config.sharingMode;
+        if (config.sharingMode == VK_SHARING_MODE_CONCURRENT) {
             assert(!config.queueFamilyIndices.empty());
+            bufferCreateInfo.pQueueFamilyIndices = config.queueFamilyIndices.data();
+            bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(config.queueFamilyIndices.size());
+        }
+
+        MemoryAllocator& memoryAllocator = context.getMemoryAllocator();
+        if (memoryAllocator.shouldWriteDirectly()) {
             m_buffer =
-                context.getMemoryAllocator().createSharedBuffer(
-                    dataSizeBytes,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                    config.queueFamilyIndices,
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
+                memoryAllocator.createDirectWriteBuffer(
+                    bufferCreateInfo,
+                    nullptr,
+                    MemoryAllocator::AllocationClass::Static);
+        }
+        if (!m_buffer.isValid()) {
+            m_buffer =
+                memoryAllocator.createBuffer(
+                    bufferCreateInfo,
+                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY,
+                    nullptr,
+                    MemoryAllocator::AllocationClass::Static);
+        }
+
+        if (config.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
+            memoryAllocator.setMovable(m_buffer, bufferCreateInfo, [this](VkBuffer newHandle) {
+                m_buffer.handle = newHandle;
+                // The mapping moves with the memory, direct writes are only made when it is created.
+                m_buffer.pMappedData = nullptr;
+            });
         }
 
         OneTimeCommandsHelper helper(context, commandBufferFactory);
@@ -55,10 +77,44 @@ namespace vgfx
         helper.copyDataToBuffer(m_buffer, pIndices, dataSizeBytes);
     }
 
+    IndexBuffer::IndexBuffer(
+        GeometryArena& geometryArena,
+        const Config& config,
+        const void* pIndices,
+        uint32_t numIndices)
+        : m_indexType(config.indexType)
+        , m_numIndices(numIndices)
+        , m_hasPrimitiveRestartValues(config.hasPrimitiveRestartValues)
+        , m_pGeometryArena(&geometryArena)
+    {
+        assert(config.sharingMode == VK_SHARING_MODE_EXCLUSIVE);
+
+        m_pGeometryRange = &geometryArena.allocateIndices(m_indexType, pIndices, numIndices);
+    }
+
+    VkBuffer IndexBuffer::getHandle()
+    {
+        return m_pGeometryRange != nullptr ? m_pGeometryRange->getBuffer() : m_buffer.handle;
+    }
+
+    uint32_t IndexBuffer::getFirstIndex() const
+    {
+        return m_pGeometryRange != nullptr ? m_pGeometryRange->getFirstElement() : 0u;
+    }
+
     void IndexBuffer::destroy()
     {
+        if (m_pGeometryRange != nullptr) {
+            m_pGeometryArena->free(*m_pGeometryRange);
+            m_pGeometryRange = nullptr;
+        }
         if (m_buffer.isValid()) {
-            m_context.getMemoryAllocator().destroyBuffer(m_buffer);
+            MemoryAllocator& memoryAllocator = m_pContext->getMemoryAllocator();
+            memoryAllocator.clearMovable(m_buffer.allocation);
+            m_pContext->retire([&memoryAllocator, buffer = m_buffer]() mutable {
+                memoryAllocator.destroyBuffer(buffer);
+            });
+            m_buffer = MemoryAllocator::Buffer();
         }
     }
 }
\ No newline at end of file
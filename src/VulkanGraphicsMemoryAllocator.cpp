@@ -6,12 +6,52 @@
 
 #include "VulkanGraphicsContext.h"
 
+#include <algorithm>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
+#include <stdexcept>
 
 #include <vulkan/vulkan.h>
 
 namespace vgfx
 {
+    // Blocks of the static pools. Larger resources are allocated from the default blocks.
+    constexpr static VkDeviceSize k_staticPoolBlockSizeBytes = 128u * 1024u * 1024u;
+
+    // Host visible device memory without resizable BAR.
+    constexpr static VkDeviceSize k_smallBarSizeBytes = 256u * 1024u * 1024u;
+
+    static MemoryAllocator::Category GetBufferCategory(
+        VkBufferUsageFlags usage,
+        VmaMemoryUsage memoryUsage)
+    {
+        if (usage & VK_BUFFER_USAGE_VERTEX_BUFFER_BIT) {
+            return MemoryAllocator::Category::VertexBuffer;
+        } else if (usage & VK_BUFFER_USAGE_INDEX_BUFFER_BIT) {
+            return MemoryAllocator::Category::IndexBuffer;
+        } else if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+            return MemoryAllocator::Category::UniformBuffer;
+        } else if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+            return MemoryAllocator::Category::StorageBuffer;
+        } else if ((usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT) && memoryUsage == VMA_MEMORY_USAGE_CPU_ONLY) {
+            return MemoryAllocator::Category::StagingBuffer;
+        }
+        return MemoryAllocator::Category::OtherBuffer;
+    }
+
+    static MemoryAllocator::Category GetImageCategory(VkImageUsageFlags usage)
+    {
+        if (usage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return MemoryAllocator::Category::DepthStencil;
+        } else if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT) {
+            return MemoryAllocator::Category::RenderTarget;
+        } else if (usage & VK_IMAGE_USAGE_SAMPLED_BIT) {
+            return MemoryAllocator::Category::Texture;
+        }
+        return MemoryAllocator::Category::OtherImage;
+    }
+
     void MemoryAllocator::init(
         uint32_t vulkanApiVersion,
         Context& context)
@@ -26,18 +66,63 @@ namespace vgfx
         allocatorInfo.physicalDevice = context.getPhysicalDevice();
         allocatorInfo.device = context.getLogicalDevice();
         allocatorInfo.pAllocationCallbacks = context.getAllocationCallbacks();
+        if (context.areDescriptorBuffersEnabled()) {
+            // Descriptor buffers, and the buffers that their descriptors refer to, are addressed
+            // by their device address.
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+        }
 
         VkResult result = vmaCreateAllocator(&allocatorInfo, &m_allocator);
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to create VMA, vmaCreateAllocator failed!");
         }
+        m_device = context.getLogicalDevice();
+        m_pAllocationCallbacks = context.getAllocationCallbacks();
+
+        const VkPhysicalDeviceProperties* pDeviceProperties = nullptr;
+        vmaGetPhysicalDeviceProperties(m_allocator, &pDeviceProperties);
+        m_isUnifiedMemory =
+            pDeviceProperties->deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU
+            || pDeviceProperties->deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+
+        const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+        vmaGetMemoryProperties(m_allocator, &pMemoryProperties);
+
+        const VkMemoryPropertyFlags directWriteFlags =
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        m_deviceLocalHostVisibleHeapSizeBytes = 0u;
+        for (uint32_t typeIndex = 0u; typeIndex < pMemoryProperties->memoryTypeCount; ++typeIndex) {
+            const VkMemoryType& memoryType = pMemoryProperties->memoryTypes[typeIndex];
+            if ((memoryType.propertyFlags & directWriteFlags) == directWriteFlags) {
+                m_deviceLocalHostVisibleHeapSizeBytes =
+                    std::max(
+                        m_deviceLocalHostVisibleHeapSizeBytes,
+                        pMemoryProperties->memoryHeaps[memoryType.heapIndex].size);
+            }
+        }
     }
 
     void MemoryAllocator::shutdown()
     {
         if (m_allocator != VK_NULL_HANDLE) {
+            for (uint32_t poolIndex = 0u; poolIndex < m_transientPools.size(); ++poolIndex) {
+                resetTransientPool(poolIndex);
+                vmaDestroyPool(m_allocator, m_transientPools[poolIndex].pool);
+            }
+            m_transientPools.clear();
+
+            // Their allocations must have been destroyed already.
+            for (auto& poolIt : m_staticPools) {
+                vmaDestroyPool(m_allocator, poolIt.second);
+            }
+            m_staticPools.clear();
+
             vmaDestroyAllocator(m_allocator);
             m_allocator = VK_NULL_HANDLE;
+
+            m_tracked.clear();
+            m_categoryUsage = {};
+            m_movables.clear();
         }
     }
 
@@ -45,14 +130,15 @@ namespace vgfx
         VkDeviceSize sizeBytes,
         VkBufferUsageFlags usage,
         VmaMemoryUsage bufferMemoryUsage,
-        const char* pBufferName)
+        const char* pBufferName,
+        AllocationClass allocationClass)
     {
         VkBufferCreateInfo bufferCreateInfo = {};
         bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
         bufferCreateInfo.size = sizeBytes;
         bufferCreateInfo.usage = usage;
         bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        return createBuffer(bufferCreateInfo, bufferMemoryUsage, pBufferName);
+        return createBuffer(bufferCreateInfo, bufferMemoryUsage, pBufferName, allocationClass);
     }
 
     MemoryAllocator::Buffer MemoryAllocator::createSharedBuffer(
@@ -60,7 +146,8 @@ namespace vgfx
         VkBufferUsageFlags usage,
         const std::vector<uint32_t>& queueFamilyIndices,
         VmaMemoryUsage bufferMemoryUsage,
-        const char* pBufferName)
+        const char* pBufferName,
+        AllocationClass allocationClass)
     {
         VkBufferCreateInfo bufferCreateInfo = {};
         bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -70,13 +157,14 @@ namespace vgfx
         bufferCreateInfo.pQueueFamilyIndices = queueFamilyIndices.data();
         bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilyIndices.size());
 
-        return createBuffer(bufferCreateInfo, bufferMemoryUsage, pBufferName);
+        return createBuffer(bufferCreateInfo, bufferMemoryUsage, pBufferName, allocationClass);
     }
 
     MemoryAllocator::Buffer MemoryAllocator::createBuffer(
         const VkBufferCreateInfo& bufferCreateInfo,
         VmaMemoryUsage bufferMemoryUsage,
-        const char* pBufferName)
+        const char* pBufferName,
+        AllocationClass allocationClass)
     {
         VmaAllocationCreateInfo allocInfo = {};
         allocInfo.usage = bufferMemoryUsage;
@@ -85,25 +173,283 @@ namespace vgfx
             allocInfo.pUserData = const_cast<char*>(pBufferName);
         }
 
+        Category category = GetBufferCategory(bufferCreateInfo.usage, bufferMemoryUsage);
+
         Buffer handle;
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        if (allocationClass == AllocationClass::Static) {
+            uint32_t memoryTypeIndex = 0u;
+            if (vmaFindMemoryTypeIndexForBufferInfo(m_allocator, &bufferCreateInfo, &allocInfo, &memoryTypeIndex) == VK_SUCCESS) {
+                VmaAllocationCreateInfo poolAllocInfo = allocInfo;
+                poolAllocInfo.pool = getOrCreateStaticPool(memoryTypeIndex);
+                // Fails if the buffer is larger than a block.
+                result = createBuffer(bufferCreateInfo, poolAllocInfo, category, pBufferName, &handle);
+            }
+        } else if (allocationClass == AllocationClass::RenderTarget) {
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        }
+
+        if (result != VK_SUCCESS) {
+            result = createBuffer(bufferCreateInfo, allocInfo, category, pBufferName, &handle);
+        }
+
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate buffer via vmaCreateBuffer!");
+        }
+
+        return handle;
+    }
+
+    VkResult MemoryAllocator::createBuffer(
+        const VkBufferCreateInfo& bufferCreateInfo,
+        const VmaAllocationCreateInfo& allocationCreateInfo,
+        Category category,
+        const char* pBufferName,
+        Buffer* pBuffer)
+    {
+        VmaAllocationInfo allocationInfo = {};
         VkResult result = vmaCreateBuffer(
             m_allocator,
             &bufferCreateInfo,
-            &allocInfo,
-            &handle.handle,
-            &handle.allocation,
-            nullptr);
+            &allocationCreateInfo,
+            &pBuffer->handle,
+            &pBuffer->allocation,
+            &allocationInfo);
+
+        if (result == VK_SUCCESS) {
+            pBuffer->sharingMode = bufferCreateInfo.sharingMode;
+            pBuffer->pMappedData = allocationInfo.pMappedData;
+
+            track(pBuffer->allocation, pBufferName, category);
+        }
+        return result;
+    }
+
+    bool MemoryAllocator::shouldWriteDirectly() const
+    {
+        if (m_deviceLocalHostVisibleHeapSizeBytes == 0u) {
+            return false;
+        }
+
+        switch (m_uploadStrategy) {
+        case UploadStrategy::Staging:
+            return false;
+        case UploadStrategy::DirectWrite:
+            return true;
+        default:
+            return m_isUnifiedMemory || m_deviceLocalHostVisibleHeapSizeBytes > k_smallBarSizeBytes;
+        }
+    }
+
+    MemoryAllocator::Buffer MemoryAllocator::createDirectWriteBuffer(
+        const VkBufferCreateInfo& bufferCreateInfo,
+        const char* pBufferName,
+        AllocationClass allocationClass)
+    {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        // Written once with memcpy, so write combined memory is fine.
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT;
+        if (pBufferName != nullptr) {
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+            allocInfo.pUserData = const_cast<char*>(pBufferName);
+        }
+        if (allocationClass == AllocationClass::RenderTarget) {
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        }
+
+        Category category = GetBufferCategory(bufferCreateInfo.usage, VMA_MEMORY_USAGE_GPU_ONLY);
+
+        Buffer handle;
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        uint32_t memoryTypeIndex = 0u;
+        if (vmaFindMemoryTypeIndexForBufferInfo(m_allocator, &bufferCreateInfo, &allocInfo, &memoryTypeIndex) != VK_SUCCESS) {
+            return handle;
+        }
+
+        if (allocationClass == AllocationClass::Static) {
+            VmaAllocationCreateInfo poolAllocInfo = allocInfo;
+            poolAllocInfo.pool = getOrCreateStaticPool(memoryTypeIndex);
+            result = createBuffer(bufferCreateInfo, poolAllocInfo, category, pBufferName, &handle);
+        }
 
         if (result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate buffer via vmaCreateBuffer!");
+            result = createBuffer(bufferCreateInfo, allocInfo, category, pBufferName, &handle);
+        }
+
+        if (result != VK_SUCCESS) {
+            return Buffer();
+        }
+
+        return handle;
+    }
+
+    void MemoryAllocator::writeMappedBuffer(
+        const Buffer& buffer,
+        const void* pData,
+        VkDeviceSize dataSizeBytes,
+        VkDeviceSize dstOffsetBytes)
+    {
+        assert(buffer.pMappedData != nullptr);
+        memcpy(static_cast<uint8_t*>(buffer.pMappedData) + dstOffsetBytes, pData, dataSizeBytes);
+        // Does nothing if the memory is coherent.
+        vmaFlushAllocation(m_allocator, buffer.allocation, dstOffsetBytes, dataSizeBytes);
+    }
+
+    MemoryAllocator::Buffer MemoryAllocator::createMappedBuffer(
+        const VkBufferCreateInfo& bufferCreateInfo,
+        const char* pBufferName)
+    {
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        if (shouldWriteDirectly()) {
+            allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+        if (pBufferName != nullptr) {
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+            allocInfo.pUserData = const_cast<char*>(pBufferName);
+        }
+
+        Buffer handle;
+        VkResult result =
+            createBuffer(bufferCreateInfo, allocInfo, GetBufferCategory(bufferCreateInfo.usage, VMA_MEMORY_USAGE_CPU_TO_GPU), pBufferName, &handle);
+        if (result != VK_SUCCESS) {
+            return Buffer();
+        }
+        return handle;
+    }
+
+    void MemoryAllocator::flushMappedBuffer(const Buffer& buffer, VkDeviceSize offsetBytes, VkDeviceSize sizeBytes)
+    {
+        assert(buffer.pMappedData != nullptr);
+        vmaFlushAllocation(m_allocator, buffer.allocation, offsetBytes, sizeBytes);
+    }
+
+    VmaPool MemoryAllocator::getOrCreateStaticPool(uint32_t memoryTypeIndex)
+    {
+        auto findIt = m_staticPools.find(memoryTypeIndex);
+        if (findIt != m_staticPools.end()) {
+            return findIt->second;
+        }
+
+        VmaPoolCreateInfo poolInfo = {};
+        poolInfo.memoryTypeIndex = memoryTypeIndex;
+        poolInfo.blockSize = k_staticPoolBlockSizeBytes;
+
+        VmaPool pool = VK_NULL_HANDLE;
+        VkResult result = vmaCreatePool(m_allocator, &poolInfo, &pool);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create static memory pool!");
+        }
+        m_staticPools[memoryTypeIndex] = pool;
+        return pool;
+    }
+
+    void MemoryAllocator::createTransientPools(uint32_t poolCount, VkDeviceSize poolSizeBytes)
+    {
+        assert(m_transientPools.empty() || poolSizeBytes == m_transientPoolSizeBytes);
+        m_transientPoolSizeBytes = poolSizeBytes;
+
+        // Any buffer usage that transient data could have, its memory type must support all of them.
+        VkBufferCreateInfo exampleBufferInfo = {};
+        exampleBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        exampleBufferInfo.size = 1024u;
+        exampleBufferInfo.usage =
+            VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT
+            | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+            | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        exampleBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo exampleAllocInfo = {};
+        exampleAllocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+        if (shouldWriteDirectly()) {
+            // Per-frame data is written directly to the memory that the GPU reads it from, like
+            // direct write vertex buffers.
+            exampleAllocInfo.requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        } else if (m_deviceLocalHostVisibleHeapSizeBytes > 0u) {
+            // Small BAR heaps are still large enough for a few MB per frame.
+            exampleAllocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        }
+
+        uint32_t memoryTypeIndex = 0u;
+        VkResult result = vmaFindMemoryTypeIndexForBufferInfo(m_allocator, &exampleBufferInfo, &exampleAllocInfo, &memoryTypeIndex);
+        if (result != VK_SUCCESS && exampleAllocInfo.requiredFlags != 0u) {
+            exampleAllocInfo.requiredFlags = 0u;
+            exampleAllocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+            result = vmaFindMemoryTypeIndexForBufferInfo(m_allocator, &exampleBufferInfo, &exampleAllocInfo, &memoryTypeIndex);
+        }
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to find memory type for transient pools!");
+        }
+
+        while (m_transientPools.size() < poolCount) {
+            VmaPoolCreateInfo poolInfo = {};
+            poolInfo.memoryTypeIndex = memoryTypeIndex;
+            poolInfo.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+            poolInfo.blockSize = poolSizeBytes;
+            poolInfo.maxBlockCount = 1u;
+
+            TransientPool transientPool;
+            result = vmaCreatePool(m_allocator, &poolInfo, &transientPool.pool);
+            if (result != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create transient memory pool!");
+            }
+            m_transientPools.push_back(std::move(transientPool));
+        }
+    }
+
+    MemoryAllocator::Buffer MemoryAllocator::createTransientBuffer(
+        uint32_t poolIndex,
+        VkDeviceSize sizeBytes,
+        VkBufferUsageFlags usage,
+        const char* pBufferName)
+    {
+        TransientPool& transientPool = m_transientPools[poolIndex];
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = sizeBytes;
+        bufferCreateInfo.usage = usage;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        VmaAllocationCreateInfo allocInfo = {};
+        allocInfo.pool = transientPool.pool;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+        if (pBufferName != nullptr) {
+            allocInfo.flags |= VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+            allocInfo.pUserData = const_cast<char*>(pBufferName);
         }
 
+        Buffer handle;
+        VkResult result =
+            createBuffer(bufferCreateInfo, allocInfo, GetBufferCategory(usage, VMA_MEMORY_USAGE_CPU_TO_GPU), pBufferName, &handle);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Transient memory pool is full!");
+        }
+
+        transientPool.buffers.push_back(handle);
         return handle;
     }
 
+    void MemoryAllocator::resetTransientPool(uint32_t poolIndex)
+    {
+        // VMA has no reset, but destroying the buffers of a linear pool only moves its offsets.
+        TransientPool& transientPool = m_transientPools[poolIndex];
+        for (Buffer& buffer : transientPool.buffers) {
+            destroyBuffer(buffer);
+        }
+        transientPool.buffers.clear();
+    }
+
     void MemoryAllocator::destroyBuffer(Buffer& bufferAllocation)
     {
-        vmaDestroyBuffer(m_allocator, bufferAllocation.handle, bufferAllocation.allocation);
+        untrack(bufferAllocation.allocation);
+        if (releaseMovable(bufferAllocation.allocation)) {
+            vmaDestroyBuffer(m_allocator, bufferAllocation.handle, bufferAllocation.allocation);
+        } else {
+            vkDestroyBuffer(m_device, bufferAllocation.handle, m_pAllocationCallbacks);
+        }
         bufferAllocation.handle = VK_NULL_HANDLE;
         bufferAllocation.allocation = VK_NULL_HANDLE;
     }
@@ -121,32 +467,251 @@ namespace vgfx
 
     MemoryAllocator::Image MemoryAllocator::createImage(
         const VkImageCreateInfo& imageCreateInfo,
-        VmaMemoryUsage imageMemoryUsage)
+        VmaMemoryUsage imageMemoryUsage,
+        const char* pImageName,
+        AllocationClass allocationClass)
     {
         VmaAllocationCreateInfo allocationCreateInfo = {};
         allocationCreateInfo.usage = imageMemoryUsage;
+        if (pImageName != nullptr) {
+            allocationCreateInfo.flags = VMA_ALLOCATION_CREATE_USER_DATA_COPY_STRING_BIT;
+            allocationCreateInfo.pUserData = const_cast<char*>(pImageName);
+        }
 
         Image image;
-        VkResult result =
-            vmaCreateImage(
-                m_allocator,
-                &imageCreateInfo,
-                &allocationCreateInfo,
-                &image.handle,
-                &image.allocation,
-                nullptr);
+        VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+        if (allocationClass == AllocationClass::Static) {
+            uint32_t memoryTypeIndex = 0u;
+            if (vmaFindMemoryTypeIndexForImageInfo(m_allocator, &imageCreateInfo, &allocationCreateInfo, &memoryTypeIndex) == VK_SUCCESS) {
+                VmaAllocationCreateInfo poolAllocationCreateInfo = allocationCreateInfo;
+                poolAllocationCreateInfo.pool = getOrCreateStaticPool(memoryTypeIndex);
+                // Fails if the image is larger than a block.
+                result = vmaCreateImage(
+                    m_allocator,
+                    &imageCreateInfo,
+                    &poolAllocationCreateInfo,
+                    &image.handle,
+                    &image.allocation,
+                    nullptr);
+            }
+        } else if (allocationClass == AllocationClass::RenderTarget) {
+            allocationCreateInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+        }
+
+        if (result != VK_SUCCESS) {
+            result =
+                vmaCreateImage(
+                    m_allocator,
+                    &imageCreateInfo,
+                    &allocationCreateInfo,
+                    &image.handle,
+                    &image.allocation,
+                    nullptr);
+        }
 
         if (result != VK_SUCCESS) {
             throw std::runtime_error("Failed to create image via vmaCreateImage.");
         }
 
+        track(image.allocation, pImageName, GetImageCategory(imageCreateInfo.usage));
+
         return image;
     }
 
     void MemoryAllocator::destroyImage(Image& image)
     {
-        vmaDestroyImage(m_allocator, image.handle, image.allocation);
+        untrack(image.allocation);
+        if (releaseMovable(image.allocation)) {
+            vmaDestroyImage(m_allocator, image.handle, image.allocation);
+        } else {
+            vkDestroyImage(m_device, image.handle, m_pAllocationCallbacks);
+        }
         image.handle = VK_NULL_HANDLE;
         image.allocation = VK_NULL_HANDLE;
     }
+
+    void MemoryAllocator::setMovable(
+        const Buffer& buffer,
+        const VkBufferCreateInfo& bufferCreateInfo,
+        BufferMovedFunc&& movedFunc)
+    {
+        assert(bufferCreateInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE);
+        assert(bufferCreateInfo.usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        Movable& movable = m_movables[buffer.allocation];
+        movable.buffer = buffer.handle;
+        movable.bufferCreateInfo = bufferCreateInfo;
+        movable.bufferCreateInfo.pNext = nullptr;
+        movable.bufferMovedFunc = std::move(movedFunc);
+    }
+
+    void MemoryAllocator::setMovable(
+        const Image& image,
+        const VkImageCreateInfo& imageCreateInfo,
+        VkImageLayout layout,
+        ImageMovedFunc&& movedFunc)
+    {
+        assert(imageCreateInfo.sharingMode == VK_SHARING_MODE_EXCLUSIVE);
+        assert(imageCreateInfo.samples == VK_SAMPLE_COUNT_1_BIT);
+        assert((imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) && (imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        Movable& movable = m_movables[image.allocation];
+        movable.image = image.handle;
+        movable.imageCreateInfo = imageCreateInfo;
+        movable.imageCreateInfo.pNext = nullptr;
+        movable.imageLayout = layout;
+        movable.imageMovedFunc = std::move(movedFunc);
+    }
+
+    void MemoryAllocator::clearMovable(VmaAllocation allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        m_movables.erase(allocation);
+    }
+
+    bool MemoryAllocator::releaseMovable(VmaAllocation allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        m_movables.erase(allocation);
+
+        auto findIt = m_movingAllocations.find(allocation);
+        if (findIt != m_movingAllocations.end()) {
+            // Freed by VMA when the pass ends.
+            findIt->second = true;
+            return false;
+        }
+        return true;
+    }
+
+    void MemoryAllocator::getDeviceLocalBudget(VkDeviceSize* pBudgetBytes, VkDeviceSize* pUsageBytes) const
+    {
+        const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+        vmaGetMemoryProperties(m_allocator, &pMemoryProperties);
+
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(m_allocator, budgets);
+
+        *pBudgetBytes = 0u;
+        *pUsageBytes = 0u;
+        for (uint32_t heapIndex = 0u; heapIndex < pMemoryProperties->memoryHeapCount; ++heapIndex) {
+            if (pMemoryProperties->memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                *pBudgetBytes += budgets[heapIndex].budget;
+                *pUsageBytes += budgets[heapIndex].usage;
+            }
+        }
+    }
+
+    const char* MemoryAllocator::GetCategoryName(Category category)
+    {
+        switch (category) {
+        case Category::VertexBuffer: return "VertexBuffer";
+        case Category::IndexBuffer: return "IndexBuffer";
+        case Category::UniformBuffer: return "UniformBuffer";
+        case Category::StorageBuffer: return "StorageBuffer";
+        case Category::StagingBuffer: return "StagingBuffer";
+        case Category::OtherBuffer: return "OtherBuffer";
+        case Category::Texture: return "Texture";
+        case Category::RenderTarget: return "RenderTarget";
+        case Category::DepthStencil: return "DepthStencil";
+        case Category::OtherImage: return "OtherImage";
+        default: return "Unknown";
+        }
+    }
+
+    void MemoryAllocator::track(VmaAllocation allocation, const char* pName, Category category)
+    {
+        VmaAllocationInfo allocationInfo = {};
+        vmaGetAllocationInfo(m_allocator, allocation, &allocationInfo);
+
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        Tracked& tracked = m_tracked[allocation];
+        tracked.name = pName != nullptr ? pName : "";
+        tracked.category = category;
+        tracked.bytes = allocationInfo.size;
+
+        Usage& usage = m_categoryUsage[static_cast<size_t>(category)];
+        usage.bytes += tracked.bytes;
+        ++usage.allocationCount;
+    }
+
+    void MemoryAllocator::untrack(VmaAllocation allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        auto findIt = m_tracked.find(allocation);
+        if (findIt == m_tracked.end()) {
+            return;
+        }
+
+        Usage& usage = m_categoryUsage[static_cast<size_t>(findIt->second.category)];
+        usage.bytes -= findIt->second.bytes;
+        --usage.allocationCount;
+        m_tracked.erase(findIt);
+    }
+
+    void MemoryAllocator::sample(Sample* pSample) const
+    {
+        const VkPhysicalDeviceMemoryProperties* pMemoryProperties = nullptr;
+        vmaGetMemoryProperties(m_allocator, &pMemoryProperties);
+
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS] = {};
+        vmaGetHeapBudgets(m_allocator, budgets);
+
+        pSample->heapCount = pMemoryProperties->memoryHeapCount;
+        for (uint32_t heapIndex = 0u; heapIndex < pMemoryProperties->memoryHeapCount; ++heapIndex) {
+            HeapBudget& heap = pSample->heaps[heapIndex];
+            heap.budgetBytes = budgets[heapIndex].budget;
+            heap.usageBytes = budgets[heapIndex].usage;
+            heap.isDeviceLocal = (pMemoryProperties->memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        }
+
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        pSample->categories = m_categoryUsage;
+        pSample->total = Usage();
+        for (const Usage& usage : m_categoryUsage) {
+            pSample->total.bytes += usage.bytes;
+            pSample->total.allocationCount += usage.allocationCount;
+        }
+    }
+
+    void MemoryAllocator::calculateStatistics(Statistics* pStatistics) const
+    {
+        VmaTotalStatistics totalStatistics = {};
+        vmaCalculateStatistics(m_allocator, &totalStatistics);
+
+        const VmaStatistics& statistics = totalStatistics.total.statistics;
+        pStatistics->blockBytes = statistics.blockBytes;
+        pStatistics->allocatedBytes = statistics.allocationBytes;
+        pStatistics->wastedBytes = statistics.blockBytes - statistics.allocationBytes;
+        pStatistics->fragmentedBytes = 0u;
+        for (const VmaDetailedStatistics& typeStatistics : totalStatistics.memoryType) {
+            VkDeviceSize typeWastedBytes = typeStatistics.statistics.blockBytes - typeStatistics.statistics.allocationBytes;
+            pStatistics->fragmentedBytes += typeWastedBytes - typeStatistics.unusedRangeSizeMax;
+        }
+        pStatistics->blockCount = statistics.blockCount;
+        pStatistics->allocationCount = statistics.allocationCount;
+    }
+
+    std::unordered_map<std::string, MemoryAllocator::Usage> MemoryAllocator::getUsageByName() const
+    {
+        std::unordered_map<std::string, Usage> usageByName;
+
+        std::lock_guard<std::mutex> lock(m_trackedMutex);
+        for (const auto& trackedIt : m_tracked) {
+            Usage& usage = usageByName[trackedIt.second.name];
+            usage.bytes += trackedIt.second.bytes;
+            ++usage.allocationCount;
+        }
+        return usageByName;
+    }
+
+    std::string MemoryAllocator::buildVmaStatsJson(bool detailedMap) const
+    {
+        char* pStatsString = nullptr;
+        vmaBuildStatsString(m_allocator, &pStatsString, detailedMap ? VK_TRUE : VK_FALSE);
+        std::string statsJson(pStatsString);
+        vmaFreeStatsString(m_allocator, pStatsString);
+        return statsJson;
+    }
 }
@@ -0,0 +1,175 @@
+#include "VulkanGraphicsMemoryTelemetry.h"
+
+#include <algorithm>
+#include <string>
+
+namespace vgfx
+{
+    static VkDeviceSize GetDeviceLocalUsageBytes(const MemoryAllocator::Sample& sample)
+    {
+        VkDeviceSize usageBytes = 0u;
+        for (uint32_t heapIndex = 0u; heapIndex < sample.heapCount; ++heapIndex) {
+            if (sample.heaps[heapIndex].isDeviceLocal) {
+                usageBytes += sample.heaps[heapIndex].usageBytes;
+            }
+        }
+        return usageBytes;
+    }
+
+    static void WriteJsonString(std::ostream& out, const std::string& str)
+    {
+        static const char* k_hexDigits = "0123456789abcdef";
+        out << '"';
+        for (char c : str) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20u) {
+                out << "\\u00" << k_hexDigits[(c >> 4) & 0xf] << k_hexDigits[c & 0xf];
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    static void WriteUsage(std::ostream& out, const MemoryAllocator::Usage& usage)
+    {
+        out << "{\"bytes\": " << usage.bytes << ", \"allocationCount\": " << usage.allocationCount << "}";
+    }
+
+    static void WriteHostUsage(std::ostream& out, const HostAllocator::Usage& usage)
+    {
+        out << "{\"bytes\": " << usage.bytes
+            << ", \"peakBytes\": " << usage.peakBytes
+            << ", \"allocationCount\": " << usage.allocationCount
+            << ", \"totalAllocationCount\": " << usage.totalAllocationCount << "}";
+    }
+
+    MemoryTelemetry::MemoryTelemetry(
+        const MemoryAllocator& memoryAllocator,
+        const Config& config,
+        const HostAllocator* pHostAllocator)
+        : m_memoryAllocator(memoryAllocator)
+        , m_pHostAllocator(pHostAllocator)
+        , m_config(config)
+    {
+    }
+
+    void MemoryTelemetry::sample()
+    {
+        if (m_config.historyLength == 0u) {
+            return;
+        }
+
+        if (m_history.size() == m_config.historyLength) {
+            m_history.pop_front();
+        }
+        m_history.emplace_back();
+        m_memoryAllocator.sample(&m_history.back());
+        ++m_sampleCount;
+
+        m_peakDeviceLocalUsageBytes =
+            std::max(m_peakDeviceLocalUsageBytes, GetDeviceLocalUsageBytes(m_history.back()));
+    }
+
+    void MemoryTelemetry::writeJson(std::ostream& out, bool includeVmaDetailedMap) const
+    {
+        MemoryAllocator::Sample latest;
+        m_memoryAllocator.sample(&latest);
+
+        MemoryAllocator::Statistics statistics;
+        m_memoryAllocator.calculateStatistics(&statistics);
+
+        out << "{\n";
+
+        out << "  \"heaps\": [";
+        for (uint32_t heapIndex = 0u; heapIndex < latest.heapCount; ++heapIndex) {
+            const MemoryAllocator::HeapBudget& heap = latest.heaps[heapIndex];
+            out << (heapIndex > 0u ? ", " : "")
+                << "{\"budgetBytes\": " << heap.budgetBytes
+                << ", \"usageBytes\": " << heap.usageBytes
+                << ", \"deviceLocal\": " << (heap.isDeviceLocal ? "true" : "false") << "}";
+        }
+        out << "],\n";
+
+        out << "  \"statistics\": {\"blockBytes\": " << statistics.blockBytes
+            << ", \"allocatedBytes\": " << statistics.allocatedBytes
+            << ", \"wastedBytes\": " << statistics.wastedBytes
+            << ", \"blockCount\": " << statistics.blockCount
+            << ", \"allocationCount\": " << statistics.allocationCount << "},\n";
+
+        out << "  \"total\": ";
+        WriteUsage(out, latest.total);
+        out << ",\n";
+
+        out << "  \"categories\": {";
+        for (size_t categoryIndex = 0u; categoryIndex < latest.categories.size(); ++categoryIndex) {
+            out << (categoryIndex > 0u ? ", " : "") << "\""
+                << MemoryAllocator::GetCategoryName(static_cast<MemoryAllocator::Category>(categoryIndex)) << "\": ";
+            WriteUsage(out, latest.categories[categoryIndex]);
+        }
+        out << "},\n";
+
+        out << "  \"names\": {";
+        bool firstName = true;
+        for (const auto& usageIt : m_memoryAllocator.getUsageByName()) {
+            out << (firstName ? "\n    " : ",\n    ");
+            WriteJsonString(out, usageIt.first);
+            out << ": ";
+            WriteUsage(out, usageIt.second);
+            firstName = false;
+        }
+        out << "\n  },\n";
+
+        // The device local usage and allocation count of each sample, oldest first.
+        out << "  \"history\": {\"sampleCount\": " << m_sampleCount
+            << ", \"peakDeviceLocalUsageBytes\": " << m_peakDeviceLocalUsageBytes
+            << ", \"deviceLocalUsageBytes\": [";
+        for (size_t sampleIndex = 0u; sampleIndex < m_history.size(); ++sampleIndex) {
+            out << (sampleIndex > 0u ? ", " : "") << GetDeviceLocalUsageBytes(m_history[sampleIndex]);
+        }
+        out << "], \"allocationCounts\": [";
+        for (size_t sampleIndex = 0u; sampleIndex < m_history.size(); ++sampleIndex) {
+            out << (sampleIndex > 0u ? ", " : "") << m_history[sampleIndex].total.allocationCount;
+        }
+        out << "]}";
+
+        if (m_pHostAllocator != nullptr) {
+            HostAllocator::Stats hostStats = m_pHostAllocator->getStats();
+            out << ",\n  \"host\": {\"total\": ";
+            WriteHostUsage(out, hostStats.total);
+            out << ", \"internal\": ";
+            WriteHostUsage(out, hostStats.internal);
+            out << ", \"pooledAllocationCount\": " << hostStats.pooledAllocationCount
+                << ", \"pooledReservedBytes\": " << hostStats.pooledReservedBytes;
+            out << ",\n    \"scopes\": {";
+            for (size_t scopeIndex = 0u; scopeIndex < hostStats.scopes.size(); ++scopeIndex) {
+                out << (scopeIndex > 0u ? ", " : "") << "\""
+                    << HostAllocator::GetScopeName(static_cast<VkSystemAllocationScope>(scopeIndex)) << "\": ";
+                WriteHostUsage(out, hostStats.scopes[scopeIndex]);
+            }
+            // Types without a name are listed by their VkObjectType value.
+            out << "},\n    \"objectTypes\": {";
+            bool firstObjectType = true;
+            for (const auto& usageIt : hostStats.objectTypes) {
+                out << (firstObjectType ? "\n      \"" : ",\n      \"");
+                const char* pObjectTypeName = HostAllocator::GetObjectTypeName(usageIt.first);
+                if (pObjectTypeName != nullptr) {
+                    out << pObjectTypeName;
+                } else {
+                    out << static_cast<uint32_t>(usageIt.first);
+                }
+                out << "\": ";
+                WriteHostUsage(out, usageIt.second);
+                firstObjectType = false;
+            }
+            out << "\n    }}";
+        }
+
+        if (includeVmaDetailedMap) {
+            // VMA's stats string is a JSON object.
+            out << ",\n  \"vma\": " << m_memoryAllocator.buildVmaStatsJson(true);
+        }
+        out << "\n}\n";
+    }
+}
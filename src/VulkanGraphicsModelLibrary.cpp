@@ -1,5 +1,9 @@
 #include "VulkanGraphicsModelLibrary.h"
 
+#include "VulkanGraphicsGltfLoader.h"
+#include "VulkanGraphicsObjLoader.h"
+#include "VulkanGraphicsTextureFile.h"
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 
@@ -9,6 +13,10 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
 #include <unordered_map>
 
 template<> struct std::hash<vgfx::VertexXyzRgbUv> {
@@ -34,18 +42,34 @@ namespace vgfx
 {
     IndexBuffer::Config ModelLibrary::DefaultIndexBufferConfig(VK_INDEX_TYPE_UINT32);
 
+    using VertexDataView = ModelLibrary::VertexDataView;
+
     static std::unique_ptr<VertexBuffer> CreateVertexBuffer(
-        Context& context,
-        CommandBufferFactory& commandBufferFactory,
+        GeometryArena& geometryArena,
         const VertexBuffer::Config& config,
-        const std::vector<uint8_t>& vertices)
+        const std::vector<VertexDataView>& vertexViews)
     {
-        return std::make_unique<VertexBuffer>(
-            context,
-            commandBufferFactory,
-            config,
-            vertices.data(),
-            vertices.size());
+        if (vertexViews.size() == 1u) {
+            return std::make_unique<VertexBuffer>(
+                geometryArena,
+                config,
+                vertexViews[0].pData,
+                vertexViews[0].sizeBytes);
+        }
+
+        // Each view is copied into its part of the buffer, rather than being gathered first.
+        size_t vertexDataSizeBytes = 0u;
+        for (const auto& vertexView : vertexViews) {
+            vertexDataSizeBytes += vertexView.sizeBytes;
+        }
+        auto spVertexBuffer = std::make_unique<VertexBuffer>(geometryArena, config, nullptr, vertexDataSizeBytes);
+        uint32_t firstVertex = 0u;
+        for (const auto& vertexView : vertexViews) {
+            uint32_t vertexCount = static_cast<uint32_t>(vertexView.sizeBytes / config.vertexStride);
+            spVertexBuffer->writeVertices(vertexView.pData, firstVertex, vertexCount);
+            firstVertex += vertexCount;
+        }
+        return spVertexBuffer;
     }
 
     static VertexXyzRgbUv CreateXyzRgbUv(const tinyobj::attrib_t& attrib, const tinyobj::index_t& index)
@@ -95,54 +119,113 @@ namespace vgfx
         return vertex;
     }
 
+    // Creates a submesh for each unique material used by each shape, the submeshes share the vertex
+    // and index buffers. The tinyobj material id of each drawable material is output to pMaterialIdsOut
+    // (-1 if the faces had no material).
     template<class VertexType>
     void CreateVertsFromShapes(
         const tinyobj::attrib_t& attrib,
         const std::vector<tinyobj::shape_t>& shapes,
         const std::function<VertexType(const tinyobj::attrib_t&, const tinyobj::index_t&)>& createVertexFunc,
         std::vector<uint8_t>* pVerticesOut,
-        std::vector<uint32_t>* pIndicesOut)
+        std::vector<uint32_t>* pIndicesOut,
+        SubMeshes* pSubMeshesOut,
+        std::vector<int>* pMaterialIdsOut)
     {
         std::vector<uint8_t>& vertices = *pVerticesOut;
         std::vector<uint32_t>& indices = *pIndicesOut;
-        std::unordered_map<VertexType, uint32_t> uniqueVertices;
+        std::vector<int>& materialIds = *pMaterialIdsOut;
 
+        std::map<int, std::vector<tinyobj::index_t>> materialFaceIndices;
         for (const auto& shape : shapes) {
-            for (const auto& index : shape.mesh.indices) {
-                VertexType vertex = createVertexFunc(attrib, index);
+            // Group the shape's faces by material so that each material is one contiguous range.
+            materialFaceIndices.clear();
+            size_t faceIndexOffset = 0u;
+            for (size_t face = 0u; face < shape.mesh.num_face_vertices.size(); ++face) {
+                size_t faceVertexCount = shape.mesh.num_face_vertices[face];
+                int materialId = face < shape.mesh.material_ids.size() ? shape.mesh.material_ids[face] : -1;
+                auto& faceIndices = materialFaceIndices[materialId];
+                faceIndices.insert(
+                    faceIndices.end(),
+                    shape.mesh.indices.begin() + faceIndexOffset,
+                    shape.mesh.indices.begin() + faceIndexOffset + faceVertexCount);
+                faceIndexOffset += faceVertexCount;
+            }
+
+            for (const auto& materialAndIndices : materialFaceIndices) {
+                auto findIt = std::find(materialIds.begin(), materialIds.end(), materialAndIndices.first);
+                uint32_t materialIndex = static_cast<uint32_t>(std::distance(materialIds.begin(), findIt));
+                if (findIt == materialIds.end()) {
+                    materialIds.push_back(materialAndIndices.first);
+                }
+
+                SubMesh subMesh;
+                subMesh.firstIndex = static_cast<uint32_t>(indices.size());
+                subMesh.indexCount = static_cast<uint32_t>(materialAndIndices.second.size());
+                subMesh.vertexOffset = static_cast<int32_t>(vertices.size() / sizeof(VertexType));
+                subMesh.materialIndex = materialIndex;
+                pSubMeshesOut->push_back(subMesh);
+
+                uint32_t localIndex = 0u;
+                for (const auto& index : materialAndIndices.second) {
+                    VertexType vertex = createVertexFunc(attrib, index);
 
-                if (uniqueVertices.count(vertex) == 0) {
-                    //uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
                     uint8_t* pVertex = reinterpret_cast<uint8_t*>(&vertex);
                     vertices.insert(vertices.end(), pVertex, pVertex + sizeof(VertexType));
+
+                    // Indices are relative to the submesh's vertex offset.
+                    indices.push_back(localIndex++);
                 }
+            }
+        }
+    }
 
-                //indices.push_back(uniqueVertices[vertex]);
-                indices.push_back(static_cast<uint32_t>(indices.size()));
+    // Returns the images of each drawable material, materials without a diffuse texture use the
+    // first diffuse texture found in the model.
+    static std::vector<ModelLibrary::ModelDesc::Images> CreateMaterialImages(
+        const std::vector<tinyobj::material_t>& materials,
+        const std::vector<int>& materialIds)
+    {
+        std::string defaultDiffuseTexture;
+        for (const auto& material : materials) {
+            if (!material.diffuse_texname.empty()) {
+                defaultDiffuseTexture = material.diffuse_texname;
+                break;
             }
         }
+
+        std::vector<ModelLibrary::ModelDesc::Images> materialImages(materialIds.size());
+        for (size_t materialIndex = 0; materialIndex < materialIds.size(); ++materialIndex) {
+            int materialId = materialIds[materialIndex];
+            std::string diffuseTexture = defaultDiffuseTexture;
+            if (materialId >= 0 && !materials[materialId].diffuse_texname.empty()) {
+                diffuseTexture = materials[materialId].diffuse_texname;
+            }
+
+            if (!diffuseTexture.empty()) {
+                materialImages[materialIndex][ImageType::Diffuse] = diffuseTexture;
+            }
+        }
+        return materialImages;
     }
 
     void CreateVertexBuffers(
-        const std::vector<uint8_t>& vertices,
+        const std::vector<VertexDataView>& vertexViews,
         const std::vector<uint32_t>& indices,
         const VertexBuffer::Config& vtxBufferCfg,
-        Context& context,
-        CommandBufferFactory& commandBufferFactory,
+        GeometryArena& geometryArena,
         std::unique_ptr<VertexBuffer>* pspVertexBuffer,
         std::unique_ptr<IndexBuffer>* pspIndexBuffer)
     {
         *pspVertexBuffer =
             CreateVertexBuffer(
-                context,
-                commandBufferFactory,
+                geometryArena,
                 vtxBufferCfg,
-                vertices);
+                vertexViews);
 
         *pspIndexBuffer =
             std::make_unique<IndexBuffer>(
-                context,
-                commandBufferFactory,
+                geometryArena,
                 // TODO eventually could have a way to use other index buffer configs
                 ModelLibrary::GetDefaultIndexBufferConfig(),
                 indices.data(),
@@ -253,6 +336,232 @@ namespace vgfx
         return false;
     }
 
+    static bool VertexLayoutsMatch(const VertexBuffer::Config& lhs, const VertexBuffer::Config& rhs)
+    {
+        if (lhs.vertexStride != rhs.vertexStride
+            || lhs.vertexAttrDescriptions.size() != rhs.vertexAttrDescriptions.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < lhs.vertexAttrDescriptions.size(); ++i) {
+            if (lhs.vertexAttrDescriptions[i].format != rhs.vertexAttrDescriptions[i].format
+                || lhs.vertexAttrDescriptions[i].offset != rhs.vertexAttrDescriptions[i].offset) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Sphere around the AABB of the submeshes' positions, which are expected to be the first
+    // attribute. Returns a radius of zero (unknown bounds) for any other layout.
+    static glm::vec4 ComputeBoundingSphere(
+        const std::vector<VertexDataView>& vertexViews,
+        const std::vector<uint32_t>& indices,
+        const VertexBuffer::Config& vertexBufferCfg,
+        const SubMeshes& subMeshes)
+    {
+        if (vertexBufferCfg.vertexAttrDescriptions.empty()
+            || vertexBufferCfg.vertexAttrDescriptions[0].format != VK_FORMAT_R32G32B32_SFLOAT
+            || vertexBufferCfg.vertexStride < sizeof(glm::vec3)) {
+            return glm::vec4(0.0f);
+        }
+
+        uint32_t positionOffset = vertexBufferCfg.vertexAttrDescriptions[0].offset;
+        // First vertex of each view, and the vertex count after the last one.
+        std::vector<size_t> viewFirstVertices;
+        size_t vertexCount = 0u;
+        for (const auto& vertexView : vertexViews) {
+            viewFirstVertices.push_back(vertexCount);
+            vertexCount += vertexView.sizeBytes / vertexBufferCfg.vertexStride;
+        }
+        std::vector<glm::vec3> positions;
+        for (const auto& subMesh : subMeshes) {
+            for (uint32_t i = subMesh.firstIndex; i < subMesh.firstIndex + subMesh.indexCount && i < indices.size(); ++i) {
+                int64_t vertexIndex = static_cast<int64_t>(indices[i]) + subMesh.vertexOffset;
+                if (vertexIndex < 0 || static_cast<size_t>(vertexIndex) >= vertexCount) {
+                    continue;
+                }
+                size_t viewIndex =
+                    std::distance(
+                        viewFirstVertices.begin(),
+                        std::upper_bound(viewFirstVertices.begin(), viewFirstVertices.end(), static_cast<size_t>(vertexIndex))) - 1u;
+                size_t viewVertexIndex = static_cast<size_t>(vertexIndex) - viewFirstVertices[viewIndex];
+                glm::vec3 position;
+                std::memcpy(
+                    &position,
+                    vertexViews[viewIndex].pData + viewVertexIndex * vertexBufferCfg.vertexStride + positionOffset,
+                    sizeof(position));
+                positions.push_back(glm::vec3(subMesh.transform * glm::vec4(position, 1.0f)));
+            }
+        }
+        if (positions.empty()) {
+            return glm::vec4(0.0f);
+        }
+
+        glm::vec3 minPosition = positions[0];
+        glm::vec3 maxPosition = positions[0];
+        for (const auto& position : positions) {
+            minPosition = glm::min(minPosition, position);
+            maxPosition = glm::max(maxPosition, position);
+        }
+        glm::vec3 center = (minPosition + maxPosition) * 0.5f;
+        float radius = 0.0f;
+        for (const auto& position : positions) {
+            radius = std::max(radius, glm::length(position - center));
+        }
+        return glm::vec4(center, radius);
+    }
+
+    void ModelLibrary::loadGltfModel(
+        const std::string& modelName,
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        GltfLoader::Model* pGltfModel,
+        std::vector<uint8_t>* pVerticesOut,
+        std::vector<VertexDataView>* pVertexViewsOut,
+        std::vector<uint32_t>* pIndicesOut,
+        VertexBuffer::Config* pVertexBufferCfgOut,
+        SubMeshes* pSubMeshesOut,
+        std::vector<ModelDesc::Images>* pMaterialImagesOut)
+    {
+        const std::string& dataDirectoryPath = context.getAppConfig().dataDirectoryPath;
+
+        GltfLoader::Model& gltfModel = *pGltfModel;
+        std::string warn, err;
+        if (!GltfLoader::LoadModel(dataDirectoryPath + "/" + modelName, &gltfModel, &warn, &err)) {
+            throw std::runtime_error(warn + err);
+        }
+
+        bool foundPrimitive = false;
+        for (const auto& mesh : gltfModel.meshes) {
+            if (!mesh.primitives.empty()) {
+                foundPrimitive = true;
+                break;
+            }
+        }
+
+        if (!foundPrimitive) {
+            throw std::runtime_error("No triangle primitives found in model: " + modelName);
+        }
+
+        // If every primitive's vertices are interleaved with the same layout then the buffer views
+        // are uploaded as is, otherwise everything is converted to VertexXyzRgbUvN. The views must
+        // hold every attribute of the vertex shader, including COLOR_0, which most assets lack.
+        bool useInterleavedLayout = true;
+        bool foundInterleavedPrimitive = false;
+        VertexBuffer::Config interleavedConfig;
+        for (const auto& mesh : gltfModel.meshes) {
+            for (const auto& primitive : mesh.primitives) {
+                VertexBuffer::Config primitiveConfig;
+                const uint8_t* pVertexData = nullptr;
+                size_t vertexDataSizeBytes = 0u;
+                if (!GltfLoader::GetInterleavedVertexLayout(primitive, &primitiveConfig, &pVertexData, &vertexDataSizeBytes)
+                    || (foundInterleavedPrimitive && !VertexLayoutsMatch(primitiveConfig, interleavedConfig))) {
+                    useInterleavedLayout = false;
+                    break;
+                }
+                interleavedConfig = primitiveConfig;
+                foundInterleavedPrimitive = true;
+            }
+            if (!useInterleavedLayout) {
+                break;
+            }
+        }
+
+        *pVertexBufferCfgOut = useInterleavedLayout ? interleavedConfig : VertexXyzRgbUvN::GetConfig();
+        uint32_t vertexStride = pVertexBufferCfgOut->vertexStride;
+
+        // Each primitive is stored once, and then referenced by a submesh for each node that uses its mesh.
+        std::vector<std::vector<SubMesh>> meshSubMeshes(gltfModel.meshes.size());
+        std::vector<int> materialIds;
+        size_t vertexCount = 0u;
+        for (size_t meshIndex = 0; meshIndex < gltfModel.meshes.size(); ++meshIndex) {
+            for (const auto& primitive : gltfModel.meshes[meshIndex].primitives) {
+                SubMesh subMesh;
+                subMesh.firstIndex = static_cast<uint32_t>(pIndicesOut->size());
+                subMesh.vertexOffset = static_cast<int32_t>(vertexCount);
+
+                if (useInterleavedLayout) {
+                    VertexBuffer::Config primitiveConfig;
+                    VertexDataView vertexView;
+                    GltfLoader::GetInterleavedVertexLayout(primitive, &primitiveConfig, &vertexView.pData, &vertexView.sizeBytes);
+                    pVertexViewsOut->push_back(vertexView);
+                } else {
+                    GltfLoader::AppendVerticesXyzRgbUvN(primitive, pVerticesOut);
+                }
+                vertexCount += primitive.positions.count;
+
+                GltfLoader::AppendIndices(primitive, pIndicesOut);
+                subMesh.indexCount = static_cast<uint32_t>(pIndicesOut->size()) - subMesh.firstIndex;
+
+                auto findIt = std::find(materialIds.begin(), materialIds.end(), primitive.materialIndex);
+                subMesh.materialIndex = static_cast<uint32_t>(std::distance(materialIds.begin(), findIt));
+                if (findIt == materialIds.end()) {
+                    materialIds.push_back(primitive.materialIndex);
+                }
+
+                meshSubMeshes[meshIndex].push_back(subMesh);
+            }
+        }
+
+        for (const auto& meshInstance : gltfModel.meshInstances) {
+            for (SubMesh subMesh : meshSubMeshes[meshInstance.meshIndex]) {
+                subMesh.transform = meshInstance.transform;
+                pSubMeshesOut->push_back(subMesh);
+            }
+        }
+
+        // Image paths are relative to the data directory, same as the model. Images embedded in the
+        // glTF buffers are loaded now and cached under a name derived from the model's name.
+        std::string modelDirectory;
+        size_t slashPos = modelName.find_last_of("/\\");
+        if (slashPos != std::string::npos) {
+            modelDirectory = modelName.substr(0, slashPos + 1);
+        }
+
+        std::vector<std::string> imagePaths(gltfModel.images.size());
+        for (size_t imageIndex = 0; imageIndex < gltfModel.images.size(); ++imageIndex) {
+            const auto& image = gltfModel.images[imageIndex];
+            if (image.pEncodedData != nullptr) {
+                imagePaths[imageIndex] = modelName + "#image" + std::to_string(imageIndex);
+            } else if (!image.uri.empty()) {
+                imagePaths[imageIndex] = modelDirectory + image.uri;
+            }
+        }
+
+        std::string defaultDiffuseImage;
+        for (const auto& material : gltfModel.materials) {
+            if (material.baseColorImageIndex >= 0 && !imagePaths[material.baseColorImageIndex].empty()) {
+                defaultDiffuseImage = imagePaths[material.baseColorImageIndex];
+                break;
+            }
+        }
+
+        pMaterialImagesOut->resize(materialIds.size());
+        for (size_t materialIndex = 0; materialIndex < materialIds.size(); ++materialIndex) {
+            int materialId = materialIds[materialIndex];
+            int imageIndex = materialId >= 0 ? gltfModel.materials[materialId].baseColorImageIndex : -1;
+
+            std::string diffuseImage = defaultDiffuseImage;
+            if (imageIndex >= 0 && !imagePaths[imageIndex].empty()) {
+                diffuseImage = imagePaths[imageIndex];
+
+                const auto& image = gltfModel.images[imageIndex];
+                if (image.pEncodedData != nullptr) {
+                    getOrLoadImage(
+                        dataDirectoryPath + "/" + diffuseImage,
+                        image.pEncodedData,
+                        image.encodedSizeBytes,
+                        context,
+                        commandBufferFactory);
+                }
+            }
+
+            if (!diffuseImage.empty()) {
+                (*pMaterialImagesOut)[materialIndex][ImageType::Diffuse] = diffuseImage;
+            }
+        }
+    }
+
     Drawable& ModelLibrary::getOrCreateDrawable(
         Context& context,
         const ModelDesc& model,
@@ -265,15 +574,23 @@ namespace vgfx
             return *pDrawable;
         }
 
-        // make a copy of the override paths (if any) so that we can add the model file's images if there are some.
-        ModelDesc::Images modelImages = model.imagesOverrides;
-
         VertexBuffer* pVertexBuffer;
         IndexBuffer* pIndexBuffer;
-        // TODO implement getModelData
-        if (!getModelData(model.modelPathOrShapeName, &pVertexBuffer, &pIndexBuffer, &modelImages)) {
+        SubMeshes subMeshes;
+        std::vector<ModelDesc::Images> materialImages;
+        glm::vec4 boundingSphere;
+        if (!getModelData(
+                model.modelPathOrShapeName,
+                &pVertexBuffer,
+                &pIndexBuffer,
+                &subMeshes,
+                &materialImages,
+                &boundingSphere)) {
 
             std::vector<uint8_t> vertices;
+            // Of vertices, or of gltfModel's buffers if they are uploaded as they are.
+            std::vector<VertexDataView> vertexViews;
+            GltfLoader::Model gltfModel;
             std::vector<uint32_t> indices;
             ShapeType shapeType = ShapeType::NONE;
             VertexBuffer::Config vertexBufferCfg;
@@ -282,69 +599,222 @@ namespace vgfx
                     std::string error = "Unknown shape type: " + model.modelPathOrShapeName;
                     throw std::runtime_error(error);
                 }
+                subMeshes.push_back({ 0u, static_cast<uint32_t>(indices.size()), 0, 0u });
+                materialImages.resize(1u);
+            } else if (GltfLoader::IsGltfFile(model.modelPathOrShapeName)) {
+                loadGltfModel(
+                    model.modelPathOrShapeName,
+                    context,
+                    commandBufferFactory,
+                    &gltfModel,
+                    &vertices,
+                    &vertexViews,
+                    &indices,
+                    &vertexBufferCfg,
+                    &subMeshes,
+                    &materialImages);
             } else {
                 tinyobj::attrib_t attrib;
                 std::vector<tinyobj::shape_t> shapes;
                 std::vector<tinyobj::material_t> materials;
                 std::string warn, err;
 
-                if (!tinyobj::LoadObj(
+                if (!ObjLoader::LoadObj(
                     &attrib, &shapes, &materials, &warn, &err,
-                    modelPath.c_str())) {
+                    modelPath)) {
                     throw std::runtime_error(warn + err);
                 }
 
+                std::vector<int> materialIds;
                 CreateVertsFromShapes<VertexXyzRgbUvN>(
                     attrib,
                     shapes,
                     CreateXyzRgbUvN,
                     &vertices,
-                    &indices);
+                    &indices,
+                    &subMeshes,
+                    &materialIds);
 
                 vertexBufferCfg = VertexXyzRgbUvN::GetConfig();
 
-                if (!materials.empty()) {
-                    if (model.imagesOverrides.find(ImageType::Diffuse) == model.imagesOverrides.end()) {
-                        modelImages[ImageType::Diffuse] = materials.front().diffuse_texname;
-                    }
-                }
+                materialImages = CreateMaterialImages(materials, materialIds);
+            }
+
+            if (m_spGeometryArena == nullptr) {
+                m_spGeometryArena = std::make_unique<GeometryArena>(context, commandBufferFactory);
+            }
+
+            if (vertexViews.empty()) {
+                vertexViews.push_back({ vertices.data(), vertices.size() });
             }
 
             auto& newModelData = m_modelDataLibrary[model.modelPathOrShapeName];
 
             CreateVertexBuffers(
-                vertices, indices, vertexBufferCfg,
-                context, commandBufferFactory,
+                vertexViews, indices, vertexBufferCfg,
+                *m_spGeometryArena.get(),
                 &newModelData.spVertexBuffer, &newModelData.spIndexBuffer);
 
-            newModelData.modelImages = modelImages;
+            newModelData.subMeshes = subMeshes;
+            newModelData.materialImages = materialImages;
+            newModelData.boundingSphere = boundingSphere =
+                ComputeBoundingSphere(vertexViews, indices, vertexBufferCfg, subMeshes);
 
             pVertexBuffer = newModelData.spVertexBuffer.get();
             pIndexBuffer = newModelData.spIndexBuffer.get();
         }
 
-        ImageSamplers imageSamplers;
-        for (auto imageTypeAndPath : modelImages) {
-            std::string texturePath = context.getAppConfig().dataDirectoryPath + "/" + imageTypeAndPath.second;
-            Image& image =
-                getOrLoadImage(
-                    texturePath,
-                    context,
-                    commandBufferFactory);
+        if (model.packImages) {
+            std::vector<std::string> texturePaths;
+            for (size_t materialIndex = 0; materialIndex < materialImages.size(); ++materialIndex) {
+                ModelDesc::Images images = materialImages[materialIndex];
+                for (const auto& imageTypeAndPath : model.imagesOverrides) {
+                    images[imageTypeAndPath.first] = imageTypeAndPath.second;
+                }
+                for (const auto& imageTypeAndPath : images) {
+                    texturePaths.push_back(context.getAppConfig().dataDirectoryPath + "/" + imageTypeAndPath.second);
+                }
+            }
+            packImages(texturePaths, context, commandBufferFactory);
+        }
+
+        std::vector<ImageSamplers> materials(materialImages.size());
+        struct PackedImage
+        {
+            ImageType imageType = ImageType::Diffuse;
+            size_t materialIndex = 0u;
+            TextureRegion region;
+        };
+        std::vector<PackedImage> packedImages;
+        struct StreamedImage
+        {
+            TextureResidencyManager::TextureId textureId = 0u;
+            ImageType imageType = ImageType::Diffuse;
+            size_t materialIndex = 0u;
+        };
+        std::vector<StreamedImage> streamedImages;
+        for (size_t materialIndex = 0; materialIndex < materialImages.size(); ++materialIndex) {
+            // The overrides replace the model's images for every material.
+            ModelDesc::Images images = materialImages[materialIndex];
+            for (const auto& imageTypeAndPath : model.imagesOverrides) {
+                images[imageTypeAndPath.first] = imageTypeAndPath.second;
+            }
+
+            for (const auto& imageTypeAndPath : images) {
+                std::string texturePath = context.getAppConfig().dataDirectoryPath + "/" + imageTypeAndPath.second;
+                auto packedIt = m_packedImageRegions.find(texturePath);
+                if (packedIt != m_packedImageRegions.end()) {
+                    const Image& packedImage = *packedIt->second.pImage;
+                    const ImageView& imageView =
+                        packedImage.getOrCreateView(
+                            ImageView::Config(
+                                packedImage.getFormat(),
+                                VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+                                0u, // base mip level
+                                packedImage.getMipLevels(),
+                                VK_REMAINING_ARRAY_LAYERS));
+                    materials[materialIndex][imageTypeAndPath.first] = ImageSampler(&imageView, nullptr);
+
+                    PackedImage packed;
+                    packed.imageType = imageTypeAndPath.first;
+                    packed.materialIndex = materialIndex;
+                    packed.region = packedIt->second.region;
+                    packedImages.push_back(packed);
+                    continue;
+                }
+
+                if (model.loadImagesAsync && m_imageLibrary.find(texturePath) == m_imageLibrary.end()) {
+                    TextureResidencyManager& textureResidencyManager =
+                        getOrCreateTextureResidencyManager(context, commandBufferFactory);
 
-            ImageView& imageView =
-                (image.getOrCreateView(
-                    ImageView::Config(
-                        image.getFormat(), VK_IMAGE_VIEW_TYPE_2D)));
+                    StreamedImage streamedImage;
+                    streamedImage.textureId = textureResidencyManager.getOrAddTexture(texturePath);
+                    streamedImage.imageType = imageTypeAndPath.first;
+                    streamedImage.materialIndex = materialIndex;
+                    streamedImages.push_back(streamedImage);
 
-            imageSamplers[imageTypeAndPath.first] = ImageSampler(&imageView, nullptr);
+                    materials[materialIndex][imageTypeAndPath.first] =
+                        ImageSampler(&textureResidencyManager.getImageView(streamedImage.textureId), nullptr);
+                    continue;
+                }
+
+                Image& image =
+                    getOrLoadImage(
+                        texturePath,
+                        context,
+                        commandBufferFactory);
+
+                // The effect samples every texture as an array.
+                ImageView& imageView =
+                    (image.getOrCreateView(
+                        ImageView::Config(
+                            image.getFormat(), VK_IMAGE_VIEW_TYPE_2D_ARRAY)));
+
+                materials[materialIndex][imageTypeAndPath.first] = ImageSampler(&imageView, nullptr);
+            }
+        }
+
+        Drawable& drawable =
+            *(m_drawableLibrary[modelPath] =
+                std::make_unique<Drawable>(
+                    *pVertexBuffer,
+                    *pIndexBuffer,
+                    subMeshes,
+                    materials)).get();
+
+        drawable.setBoundingSphere(boundingSphere);
+
+        for (const auto& packedImage : packedImages) {
+            drawable.setTextureRegion(packedImage.imageType, packedImage.region, packedImage.materialIndex);
+        }
+
+        if (!streamedImages.empty()) {
+            for (const auto& streamedImage : streamedImages) {
+                m_spTextureResidencyManager->bindTexture(
+                    streamedImage.textureId,
+                    drawable,
+                    streamedImage.imageType,
+                    streamedImage.materialIndex);
+            }
+            drawable.setTextureResidencyManager(m_spTextureResidencyManager.get());
         }
 
-        return *(m_drawableLibrary[modelPath] =
-            std::make_unique<Drawable>(
-                *pVertexBuffer,
-                *pIndexBuffer,
-                imageSamplers)).get();
+        return drawable;
+    }
+
+    void ModelLibrary::update()
+    {
+        if (m_spAsyncImageLoader != nullptr) {
+            m_spAsyncImageLoader->update();
+        }
+        if (m_spTextureResidencyManager != nullptr) {
+            m_spTextureResidencyManager->update();
+        }
+        if (m_spGeometryArena != nullptr) {
+            m_spGeometryArena->update();
+        }
+    }
+
+    void ModelLibrary::setTextureResidencyConfig(const TextureResidencyManager::Config& config)
+    {
+        m_textureResidencyConfig = config;
+    }
+
+    TextureResidencyManager& ModelLibrary::getOrCreateTextureResidencyManager(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory)
+    {
+        if (m_spAsyncImageLoader == nullptr) {
+            m_spAsyncImageLoader = std::make_unique<AsyncImageLoader>(context, commandBufferFactory);
+        }
+        if (m_spTextureResidencyManager == nullptr) {
+            m_spTextureResidencyManager =
+                std::make_unique<TextureResidencyManager>(
+                    context,
+                    *m_spAsyncImageLoader.get(),
+                    m_textureResidencyConfig);
+        }
+        return *m_spTextureResidencyManager.get();
     }
 
     IndexBuffer::Config& ModelLibrary::GetDefaultIndexBufferConfig()
@@ -356,15 +826,17 @@ namespace vgfx
         const std::string& modelPathOrShapeName,
         VertexBuffer** ppVertexBuffer,
         IndexBuffer** ppIndexBuffer,
-        ModelDesc::Images* pModelImages) const
+        SubMeshes* pSubMeshes,
+        std::vector<ModelDesc::Images>* pMaterialImages,
+        glm::vec4* pBoundingSphere) const
     {
         auto findIt = m_modelDataLibrary.find(modelPathOrShapeName);
         if (findIt != m_modelDataLibrary.end()) {
             *ppVertexBuffer = findIt->second.spVertexBuffer.get();
             *ppIndexBuffer = findIt->second.spIndexBuffer.get();
-            ModelDesc::Images copy = findIt->second.modelImages;
-            copy.insert(pModelImages->begin(), pModelImages->end());
-            pModelImages->swap(copy);
+            *pSubMeshes = findIt->second.subMeshes;
+            *pMaterialImages = findIt->second.materialImages;
+            *pBoundingSphere = findIt->second.boundingSphere;
             return true;
         }
         return false;
@@ -380,6 +852,19 @@ namespace vgfx
         return nullptr;
     }
 
+    static std::unique_ptr<Image> CreateImageFromTextureData(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        const TextureFile::TextureData& textureData)
+    {
+        return std::make_unique<Image>(
+            context,
+            commandBufferFactory,
+            TextureFile::CreateImageConfig(textureData),
+            textureData.data.data(),
+            textureData.data.size());
+    }
+
     Image& ModelLibrary::getOrLoadImage(
         const std::string& path,
         Context& context,
@@ -390,45 +875,101 @@ namespace vgfx
             return *spImage.get();
         }
 
-        int32_t texWidth = 0;
-        int32_t texHeight = 0;
-        int32_t texChannels = 0;
-        stbi_uc* pPixels = stbi_load(
-            path.c_str(),
-            &texWidth, &texHeight, &texChannels,
-            STBI_rgb_alpha);
-        if (pPixels == nullptr) {
-            std::string error = "Failed to load image: " + path;
+        TextureFile::TextureData textureData;
+        std::string err;
+        if (!TextureFile::Load(context, path, &textureData, &err)) {
+            std::string error = "Failed to load image: " + err;
             throw std::runtime_error(error);
         }
 
-        VkDeviceSize imageSize = static_cast<int64_t>(texWidth) * static_cast<int64_t>(texHeight) * 4;
+        spImage = CreateImageFromTextureData(context, commandBufferFactory, textureData);
+
+        return *spImage.get();
+    }
 
-        // TODO the image config should not be hard coded.
-        Image::Config imageConfig(
-            texWidth,
-            texHeight,
-            VK_FORMAT_R8G8B8A8_UNORM,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_TRANSFER_DST_BIT
-            | VK_IMAGE_USAGE_SAMPLED_BIT
-            | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
-            | VK_IMAGE_USAGE_STORAGE_BIT,
-            Image::ComputeMipLevels2D(texWidth, texHeight));
+    Image& ModelLibrary::getOrLoadImage(
+        const std::string& path,
+        const uint8_t* pEncodedData,
+        size_t encodedSizeBytes,
+        Context& context,
+        CommandBufferFactory& commandBufferFactory)
+    {
+        auto& spImage = m_imageLibrary[path];
+        if (spImage != nullptr) {
+            return *spImage.get();
+        }
 
-        spImage =
-            std::make_unique<Image>(
-                context,
-                commandBufferFactory,
-                imageConfig,
-                pPixels,
-                imageSize);
+        TextureFile::TextureData textureData;
+        std::string err;
+        if (!TextureFile::LoadFromMemory(context, pEncodedData, encodedSizeBytes, &textureData, &err)) {
+            std::string error = "Failed to decode image: " + path + ": " + err;
+            throw std::runtime_error(error);
+        }
 
-        stbi_image_free(pPixels);
+        spImage = CreateImageFromTextureData(context, commandBufferFactory, textureData);
 
         return *spImage.get();
     }
 
+    void ModelLibrary::packImages(
+        const std::vector<std::string>& paths,
+        Context& context,
+        CommandBufferFactory& commandBufferFactory)
+    {
+        std::vector<std::string> unloadedPaths;
+        for (const auto& path : paths) {
+            if (m_imageLibrary.find(path) == m_imageLibrary.end()
+                && m_packedImageRegions.find(path) == m_packedImageRegions.end()
+                && std::find(unloadedPaths.begin(), unloadedPaths.end(), path) == unloadedPaths.end()) {
+                unloadedPaths.push_back(path);
+            }
+        }
+        if (unloadedPaths.empty()) {
+            return;
+        }
+
+        std::vector<TextureFile::TextureData> textures(unloadedPaths.size());
+        std::vector<const TextureFile::TextureData*> pTextures(unloadedPaths.size());
+        for (size_t i = 0u; i < unloadedPaths.size(); ++i) {
+            std::string err;
+            if (!TextureFile::Load(context, unloadedPaths[i], &textures[i], &err)) {
+                std::string error = "Failed to load image: " + err;
+                throw std::runtime_error(error);
+            }
+            pTextures[i] = &textures[i];
+        }
+
+        VkPhysicalDeviceProperties deviceProperties = {};
+        vkGetPhysicalDeviceProperties(context.getPhysicalDevice(), &deviceProperties);
+        TexturePacker::Config packerConfig = m_texturePackerConfig;
+        packerConfig.maxArrayLayerCount =
+            std::min(packerConfig.maxArrayLayerCount, deviceProperties.limits.maxImageArrayLayers);
+        packerConfig.atlasSize = std::min(packerConfig.atlasSize, deviceProperties.limits.maxImageDimension2D);
+
+        std::vector<TextureFile::TextureData> packedTextures;
+        std::vector<TexturePacker::Placement> placements;
+        TexturePacker::Pack(pTextures, packerConfig, &packedTextures, &placements);
+
+        size_t firstPackedImage = m_packedImages.size();
+        for (const auto& packedTexture : packedTextures) {
+            m_packedImages.push_back(CreateImageFromTextureData(context, commandBufferFactory, packedTexture));
+        }
+
+        for (size_t i = 0u; i < unloadedPaths.size(); ++i) {
+            const TexturePacker::Placement& placement = placements[i];
+            if (placement.packedTextureIndex == TexturePacker::NotPacked) {
+                m_imageLibrary[unloadedPaths[i]] = CreateImageFromTextureData(context, commandBufferFactory, textures[i]);
+                continue;
+            }
+
+            PackedImageRegion& packedImageRegion = m_packedImageRegions[unloadedPaths[i]];
+            packedImageRegion.pImage = m_packedImages[firstPackedImage + placement.packedTextureIndex].get();
+            packedImageRegion.region.layer = placement.layer;
+            packedImageRegion.region.uvScale = placement.uvScale;
+            packedImageRegion.region.uvOffset = placement.uvOffset;
+        }
+    }
+
     ImageView& ModelLibrary::getOrCreateImageView(const ImageView::Config& config, Context& context, const vgfx::Image& image)
     {
         auto& spImageView = m_imageViewLibrary[config];
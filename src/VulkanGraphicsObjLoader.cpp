@@ -0,0 +1,721 @@
+#include "VulkanGraphicsObjLoader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vgfx
+{
+    // Read only memory mapping of the OBJ file, the chunks parse directly out of the mapped pages.
+    class MappedObjFile
+    {
+    public:
+        MappedObjFile(const std::string& filePath)
+        {
+#ifdef _WIN32
+            m_file = CreateFileA(
+                filePath.c_str(),
+                GENERIC_READ,
+                FILE_SHARE_READ,
+                nullptr,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) {
+                return;
+            }
+
+            LARGE_INTEGER fileSize = {};
+            if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart == 0) {
+                return;
+            }
+            m_size = static_cast<size_t>(fileSize.QuadPart);
+
+            m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (m_mapping == nullptr) {
+                return;
+            }
+
+            m_pData = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+            m_file = open(filePath.c_str(), O_RDONLY);
+            if (m_file < 0) {
+                return;
+            }
+
+            struct stat fileStat = {};
+            if (fstat(m_file, &fileStat) != 0 || fileStat.st_size == 0) {
+                return;
+            }
+            m_size = static_cast<size_t>(fileStat.st_size);
+
+            void* pMapped = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_file, 0);
+            if (pMapped == MAP_FAILED) {
+                return;
+            }
+            madvise(pMapped, m_size, MADV_SEQUENTIAL);
+            m_pData = static_cast<const char*>(pMapped);
+#endif
+        }
+
+        ~MappedObjFile()
+        {
+#ifdef _WIN32
+            if (m_pData != nullptr) {
+                UnmapViewOfFile(m_pData);
+            }
+            if (m_mapping != nullptr) {
+                CloseHandle(m_mapping);
+            }
+            if (m_file != INVALID_HANDLE_VALUE) {
+                CloseHandle(m_file);
+            }
+#else
+            if (m_pData != nullptr) {
+                munmap(const_cast<char*>(m_pData), m_size);
+            }
+            if (m_file >= 0) {
+                close(m_file);
+            }
+#endif
+        }
+
+        bool isValid() const { return m_pData != nullptr; }
+        const char* getData() const { return m_pData; }
+        size_t getSize() const { return m_size; }
+
+    private:
+#ifdef _WIN32
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_mapping = nullptr;
+#else
+        int m_file = -1;
+#endif
+        const char* m_pData = nullptr;
+        size_t m_size = 0u;
+    };
+
+    // Material id used for faces at the start of a chunk that precede any usemtl in that chunk, the
+    // actual id is whatever material was active at the end of the previous chunk.
+    constexpr static int k_inheritMaterialId = -2;
+
+    struct ObjChunkShape
+    {
+        std::string name;
+        // True if this shape was started by an o/g statement, false if it continues the
+        // shape that was active at the end of the previous chunk.
+        bool startsNewShape = false;
+        std::vector<tinyobj::index_t> indices;
+        // One per triangle, indexes into ObjChunk::materialNames.
+        std::vector<int> materialIds;
+    };
+
+    // Negative OBJ indices are relative to the number of attributes parsed so far, which is only
+    // known for the chunk's own attributes, so they are fixed up when the chunks are merged.
+    struct ObjRelativeIndex
+    {
+        uint32_t shapeIndex;
+        uint32_t indexOffset;
+        uint32_t component; // 0 = vertex, 1 = normal, 2 = texcoord
+    };
+
+    struct ObjChunk
+    {
+        const char* pBegin = nullptr;
+        const char* pEnd = nullptr;
+
+        std::vector<float> vertices;
+        std::vector<float> colors;
+        std::vector<float> normals;
+        std::vector<float> texcoords;
+
+        std::vector<ObjChunkShape> shapes;
+        std::vector<ObjRelativeIndex> relativeIndices;
+
+        std::vector<std::string> materialNames;
+        int lastMaterialId = k_inheritMaterialId;
+        std::vector<std::string> materialLibs;
+
+        std::string warn;
+        std::string err;
+    };
+
+    static inline bool IsObjSpace(char c)
+    {
+        return c == ' ' || c == '\t';
+    }
+
+    static inline bool IsObjDigit(char c)
+    {
+        return c >= '0' && c <= '9';
+    }
+
+    static inline const char* SkipObjSpaces(const char* p, const char* pEnd)
+    {
+        while (p < pEnd && IsObjSpace(*p)) {
+            ++p;
+        }
+        return p;
+    }
+
+    // Minimal float parser for the decimal notation used by OBJ exporters, avoids the locale
+    // handling and per call overhead of strtof. Returns nullptr if no number was found.
+    static const char* ParseObjFloat(const char* p, const char* pEnd, float* pValue)
+    {
+        static const double k_powersOf10[] = {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+            1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        p = SkipObjSpaces(p, pEnd);
+
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        uint64_t mantissa = 0u;
+        int32_t exponent = 0;
+        uint32_t significantDigits = 0u;
+        bool foundDigits = false;
+
+        while (p < pEnd && IsObjDigit(*p)) {
+            foundDigits = true;
+            uint32_t digit = static_cast<uint32_t>(*p - '0');
+            if (significantDigits < 19u) {
+                mantissa = mantissa * 10u + digit;
+                if (mantissa != 0u) {
+                    ++significantDigits;
+                }
+            } else {
+                ++exponent;
+            }
+            ++p;
+        }
+
+        if (p < pEnd && *p == '.') {
+            ++p;
+            while (p < pEnd && IsObjDigit(*p)) {
+                foundDigits = true;
+                uint32_t digit = static_cast<uint32_t>(*p - '0');
+                if (significantDigits < 19u) {
+                    mantissa = mantissa * 10u + digit;
+                    if (mantissa != 0u) {
+                        ++significantDigits;
+                    }
+                    --exponent;
+                }
+                ++p;
+            }
+        }
+
+        if (!foundDigits) {
+            return nullptr;
+        }
+
+        if (p < pEnd && (*p == 'e' || *p == 'E')) {
+            const char* pExp = p + 1;
+            bool negativeExp = false;
+            if (pExp < pEnd && (*pExp == '-' || *pExp == '+')) {
+                negativeExp = (*pExp == '-');
+                ++pExp;
+            }
+            if (pExp < pEnd && IsObjDigit(*pExp)) {
+                int32_t expValue = 0;
+                while (pExp < pEnd && IsObjDigit(*pExp)) {
+                    if (expValue < 10000) {
+                        expValue = expValue * 10 + (*pExp - '0');
+                    }
+                    ++pExp;
+                }
+                exponent += negativeExp ? -expValue : expValue;
+                p = pExp;
+            }
+        }
+
+        double value = static_cast<double>(mantissa);
+        if (exponent < 0) {
+            value = (-exponent <= 22) ? value / k_powersOf10[-exponent] : value * std::pow(10.0, exponent);
+        } else if (exponent > 0) {
+            value = (exponent <= 22) ? value * k_powersOf10[exponent] : value * std::pow(10.0, exponent);
+        }
+
+        *pValue = static_cast<float>(negative ? -value : value);
+        return p;
+    }
+
+    static const char* ParseObjInt(const char* p, const char* pEnd, int32_t* pValue)
+    {
+        bool negative = false;
+        if (p < pEnd && (*p == '-' || *p == '+')) {
+            negative = (*p == '-');
+            ++p;
+        }
+
+        if (p == pEnd || !IsObjDigit(*p)) {
+            return nullptr;
+        }
+
+        int32_t value = 0;
+        while (p < pEnd && IsObjDigit(*p)) {
+            value = value * 10 + (*p - '0');
+            ++p;
+        }
+
+        *pValue = negative ? -value : value;
+        return p;
+    }
+
+    static std::string ParseObjName(const char* p, const char* pEnd)
+    {
+        p = SkipObjSpaces(p, pEnd);
+        const char* pNameEnd = pEnd;
+        while (pNameEnd > p && (IsObjSpace(*(pNameEnd - 1)) || *(pNameEnd - 1) == '\r')) {
+            --pNameEnd;
+        }
+        return std::string(p, pNameEnd);
+    }
+
+    static inline bool ObjKeywordMatches(const char* p, const char* pEnd, const char* pKeyword, size_t keywordLength)
+    {
+        return static_cast<size_t>(pEnd - p) > keywordLength
+            && memcmp(p, pKeyword, keywordLength) == 0
+            && IsObjSpace(p[keywordLength]);
+    }
+
+    struct ObjFaceVertex
+    {
+        tinyobj::index_t index;
+        bool isRelative[3];
+    };
+
+    // Converts a 1 based (or negative relative) OBJ index to a 0 based index. Relative indices are
+    // converted relative to the chunk's own attribute count and flagged for fix up during the merge.
+    static inline bool ResolveObjIndex(int32_t objIndex, size_t localCount, int* pIndex, bool* pIsRelative)
+    {
+        if (objIndex > 0) {
+            *pIndex = objIndex - 1;
+            *pIsRelative = false;
+            return true;
+        } else if (objIndex < 0) {
+            *pIndex = static_cast<int>(localCount) + objIndex;
+            *pIsRelative = true;
+            return true;
+        }
+        return false;
+    }
+
+    static bool ParseObjFace(
+        const char* p,
+        const char* pEnd,
+        ObjChunk& chunk,
+        int currentMaterialId,
+        std::vector<ObjFaceVertex>& faceVertices)
+    {
+        faceVertices.clear();
+
+        const size_t vertexCount = chunk.vertices.size() / 3;
+        const size_t normalCount = chunk.normals.size() / 3;
+        const size_t texcoordCount = chunk.texcoords.size() / 2;
+
+        p = SkipObjSpaces(p, pEnd);
+        while (p < pEnd && *p != '\r') {
+            ObjFaceVertex faceVertex = {};
+            faceVertex.index.vertex_index = -1;
+            faceVertex.index.normal_index = -1;
+            faceVertex.index.texcoord_index = -1;
+
+            int32_t objIndex = 0;
+            p = ParseObjInt(p, pEnd, &objIndex);
+            if (p == nullptr
+                || !ResolveObjIndex(objIndex, vertexCount, &faceVertex.index.vertex_index, &faceVertex.isRelative[0])) {
+                return false;
+            }
+
+            if (p < pEnd && *p == '/') {
+                ++p;
+                if (p < pEnd && *p != '/') {
+                    p = ParseObjInt(p, pEnd, &objIndex);
+                    if (p == nullptr
+                        || !ResolveObjIndex(objIndex, texcoordCount, &faceVertex.index.texcoord_index, &faceVertex.isRelative[2])) {
+                        return false;
+                    }
+                }
+                if (p < pEnd && *p == '/') {
+                    ++p;
+                    p = ParseObjInt(p, pEnd, &objIndex);
+                    if (p == nullptr
+                        || !ResolveObjIndex(objIndex, normalCount, &faceVertex.index.normal_index, &faceVertex.isRelative[1])) {
+                        return false;
+                    }
+                }
+            }
+
+            faceVertices.push_back(faceVertex);
+            p = SkipObjSpaces(p, pEnd);
+        }
+
+        if (faceVertices.size() < 3) {
+            // Lines and points are not supported by the engine, skip them like tinyobj does for faces.
+            return true;
+        }
+
+        ObjChunkShape& shape = chunk.shapes.back();
+        const uint32_t shapeIndex = static_cast<uint32_t>(chunk.shapes.size() - 1);
+
+        auto emitFaceVertex = [&](const ObjFaceVertex& faceVertex) {
+            const uint32_t indexOffset = static_cast<uint32_t>(shape.indices.size());
+            for (uint32_t component = 0u; component < 3u; ++component) {
+                if (faceVertex.isRelative[component]) {
+                    chunk.relativeIndices.push_back({ shapeIndex, indexOffset, component });
+                }
+            }
+            shape.indices.push_back(faceVertex.index);
+        };
+
+        // Triangulate as a fan, which matches tinyobj's default triangulation for convex polygons.
+        for (size_t i = 1; i + 1 < faceVertices.size(); ++i) {
+            emitFaceVertex(faceVertices[0]);
+            emitFaceVertex(faceVertices[i]);
+            emitFaceVertex(faceVertices[i + 1]);
+            shape.materialIds.push_back(currentMaterialId);
+        }
+
+        return true;
+    }
+
+    static void ParseObjChunk(ObjChunk& chunk)
+    {
+        chunk.shapes.emplace_back();
+
+        int currentMaterialId = k_inheritMaterialId;
+        std::vector<ObjFaceVertex> faceVertices;
+        faceVertices.reserve(8);
+
+        size_t lineNumber = 0u;
+        const char* pLine = chunk.pBegin;
+        while (pLine < chunk.pEnd) {
+            const char* pLineEnd = static_cast<const char*>(memchr(pLine, '\n', chunk.pEnd - pLine));
+            if (pLineEnd == nullptr) {
+                pLineEnd = chunk.pEnd;
+            }
+            ++lineNumber;
+
+            const char* p = SkipObjSpaces(pLine, pLineEnd);
+            const char* pNextLine = pLineEnd + 1;
+            if (p == pLineEnd || *p == '#' || *p == '\r') {
+                pLine = pNextLine;
+                continue;
+            }
+
+            bool lineIsValid = true;
+            if (p[0] == 'v' && p + 1 < pLineEnd && IsObjSpace(p[1])) {
+                float values[6] = { 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+                const char* pCur = p + 1;
+                uint32_t valueCount = 0u;
+                while (valueCount < 6u) {
+                    const char* pNext = ParseObjFloat(pCur, pLineEnd, &values[valueCount]);
+                    if (pNext == nullptr) {
+                        break;
+                    }
+                    pCur = pNext;
+                    ++valueCount;
+                }
+
+                if (valueCount < 3u) {
+                    lineIsValid = false;
+                } else {
+                    chunk.vertices.insert(chunk.vertices.end(), values, values + 3);
+                    if (valueCount == 6u) {
+                        chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+                    } else {
+                        chunk.colors.insert(chunk.colors.end(), { 1.0f, 1.0f, 1.0f });
+                    }
+                }
+            } else if (p[0] == 'v' && p + 2 < pLineEnd && p[1] == 't' && IsObjSpace(p[2])) {
+                float u = 0.0f;
+                float v = 0.0f;
+                const char* pCur = ParseObjFloat(p + 2, pLineEnd, &u);
+                if (pCur == nullptr) {
+                    lineIsValid = false;
+                } else {
+                    ParseObjFloat(pCur, pLineEnd, &v);
+                    chunk.texcoords.push_back(u);
+                    chunk.texcoords.push_back(v);
+                }
+            } else if (p[0] == 'v' && p + 2 < pLineEnd && p[1] == 'n' && IsObjSpace(p[2])) {
+                float normal[3] = {};
+                const char* pCur = p + 2;
+                for (uint32_t i = 0u; i < 3u && pCur != nullptr; ++i) {
+                    pCur = ParseObjFloat(pCur, pLineEnd, &normal[i]);
+                }
+                if (pCur == nullptr) {
+                    lineIsValid = false;
+                } else {
+                    chunk.normals.insert(chunk.normals.end(), normal, normal + 3);
+                }
+            } else if (p[0] == 'f' && p + 1 < pLineEnd && IsObjSpace(p[1])) {
+                lineIsValid = ParseObjFace(p + 1, pLineEnd, chunk, currentMaterialId, faceVertices);
+            } else if ((p[0] == 'o' || p[0] == 'g') && (p + 1 == pLineEnd || IsObjSpace(p[1]) || p[1] == '\r')) {
+                ObjChunkShape newShape;
+                newShape.name = ParseObjName(p + 1, pLineEnd);
+                newShape.startsNewShape = true;
+                chunk.shapes.push_back(std::move(newShape));
+            } else if (ObjKeywordMatches(p, pLineEnd, "usemtl", 6)) {
+                std::string materialName = ParseObjName(p + 6, pLineEnd);
+                auto findIt = std::find(chunk.materialNames.begin(), chunk.materialNames.end(), materialName);
+                currentMaterialId = static_cast<int>(std::distance(chunk.materialNames.begin(), findIt));
+                if (findIt == chunk.materialNames.end()) {
+                    chunk.materialNames.push_back(materialName);
+                }
+                chunk.lastMaterialId = currentMaterialId;
+            } else if (ObjKeywordMatches(p, pLineEnd, "mtllib", 6)) {
+                chunk.materialLibs.push_back(ParseObjName(p + 6, pLineEnd));
+            }
+            // Anything else (smoothing groups, lines, points, etc.) is ignored.
+
+            if (!lineIsValid) {
+                chunk.warn += "Failed to parse OBJ line: " + std::string(p, pLineEnd) + "\n";
+            }
+
+            pLine = pNextLine;
+        }
+    }
+
+    // Splits the file into roughly equal, line aligned, ranges.
+    static std::vector<ObjChunk> SplitObjChunks(const char* pData, size_t dataSize, uint32_t chunkCount)
+    {
+        std::vector<ObjChunk> chunks;
+        chunks.reserve(chunkCount);
+
+        const char* pDataEnd = pData + dataSize;
+        const char* pChunkBegin = pData;
+        for (uint32_t i = 1u; i <= chunkCount && pChunkBegin < pDataEnd; ++i) {
+            const char* pChunkEnd = pDataEnd;
+            if (i < chunkCount) {
+                pChunkEnd = pData + (dataSize / chunkCount) * i;
+                if (pChunkEnd < pChunkBegin) {
+                    pChunkEnd = pChunkBegin;
+                }
+                const char* pNewLine = static_cast<const char*>(memchr(pChunkEnd, '\n', pDataEnd - pChunkEnd));
+                pChunkEnd = (pNewLine != nullptr) ? pNewLine + 1 : pDataEnd;
+            }
+
+            ObjChunk chunk;
+            chunk.pBegin = pChunkBegin;
+            chunk.pEnd = pChunkEnd;
+            chunks.push_back(std::move(chunk));
+
+            pChunkBegin = pChunkEnd;
+        }
+
+        return chunks;
+    }
+
+    static void LoadObjMaterials(
+        const std::string& objFilePath,
+        const std::vector<std::string>& materialLibs,
+        std::vector<tinyobj::material_t>* pMaterials,
+        std::map<std::string, int>* pMaterialMap,
+        std::string* pWarn)
+    {
+        std::string baseDir;
+        size_t slashPos = objFilePath.find_last_of("/\\");
+        if (slashPos != std::string::npos) {
+            baseDir = objFilePath.substr(0, slashPos + 1);
+        }
+
+        for (const auto& materialLib : materialLibs) {
+            std::ifstream materialStream(baseDir + materialLib);
+            if (!materialStream) {
+                *pWarn += "Material file not found: " + materialLib + "\n";
+                continue;
+            }
+
+            std::string warn;
+            std::string err;
+            tinyobj::LoadMtl(pMaterialMap, pMaterials, &materialStream, &warn, &err);
+            *pWarn += warn + err;
+            // Same as tinyobj, only the first material library that loads is used.
+            return;
+        }
+    }
+
+    bool ObjLoader::LoadObj(
+        tinyobj::attrib_t* pAttrib,
+        std::vector<tinyobj::shape_t>* pShapes,
+        std::vector<tinyobj::material_t>* pMaterials,
+        std::string* pWarn,
+        std::string* pErr,
+        const std::string& filePath,
+        uint32_t threadCount,
+        LoadStats* pStats)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+
+        MappedObjFile objFile(filePath);
+        if (!objFile.isValid()) {
+            *pErr += "Failed to open OBJ file: " + filePath + "\n";
+            return false;
+        }
+
+        if (threadCount == 0u) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Small chunks only add merge overhead, so make sure each one has a decent amount of work.
+        constexpr size_t k_minChunkSizeBytes = 1024u * 1024u;
+        const size_t maxChunkCount = std::max<size_t>(1u, objFile.getSize() / k_minChunkSizeBytes);
+        const uint32_t chunkCount = static_cast<uint32_t>(std::min<size_t>(threadCount * 4u, maxChunkCount));
+        threadCount = std::min(threadCount, chunkCount);
+
+        std::vector<ObjChunk> chunks = SplitObjChunks(objFile.getData(), objFile.getSize(), chunkCount);
+
+        std::atomic<size_t> nextChunk(0u);
+        auto parseChunks = [&chunks, &nextChunk]() {
+            for (size_t chunkIndex = nextChunk++; chunkIndex < chunks.size(); chunkIndex = nextChunk++) {
+                ParseObjChunk(chunks[chunkIndex]);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threadCount - 1u);
+        for (uint32_t i = 1u; i < threadCount; ++i) {
+            workers.emplace_back(parseChunks);
+        }
+        parseChunks();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        auto parseEndTime = std::chrono::steady_clock::now();
+
+        std::vector<std::string> materialLibs;
+        for (auto& chunk : chunks) {
+            materialLibs.insert(materialLibs.end(), chunk.materialLibs.begin(), chunk.materialLibs.end());
+            *pWarn += chunk.warn;
+        }
+
+        std::map<std::string, int> materialMap;
+        pMaterials->clear();
+        LoadObjMaterials(filePath, materialLibs, pMaterials, &materialMap, pWarn);
+
+        // Merge the chunks, offsetting the relative indices by the attribute counts of the previous chunks.
+        size_t totalVertexFloats = 0u;
+        size_t totalNormalFloats = 0u;
+        size_t totalTexcoordFloats = 0u;
+        for (const auto& chunk : chunks) {
+            totalVertexFloats += chunk.vertices.size();
+            totalNormalFloats += chunk.normals.size();
+            totalTexcoordFloats += chunk.texcoords.size();
+        }
+
+        tinyobj::attrib_t& attrib = *pAttrib;
+        attrib.vertices.clear();
+        attrib.colors.clear();
+        attrib.normals.clear();
+        attrib.texcoords.clear();
+        attrib.vertices.reserve(totalVertexFloats);
+        attrib.colors.reserve(totalVertexFloats);
+        attrib.normals.reserve(totalNormalFloats);
+        attrib.texcoords.reserve(totalTexcoordFloats);
+
+        std::vector<tinyobj::shape_t>& shapes = *pShapes;
+        shapes.clear();
+
+        int activeMaterialId = -1;
+        for (auto& chunk : chunks) {
+            const int baseCounts[3] = {
+                static_cast<int>(attrib.vertices.size() / 3),
+                static_cast<int>(attrib.normals.size() / 3),
+                static_cast<int>(attrib.texcoords.size() / 2)
+            };
+
+            for (const auto& relativeIndex : chunk.relativeIndices) {
+                tinyobj::index_t& index = chunk.shapes[relativeIndex.shapeIndex].indices[relativeIndex.indexOffset];
+                int* pIndex =
+                    relativeIndex.component == 0u ? &index.vertex_index :
+                    relativeIndex.component == 1u ? &index.normal_index : &index.texcoord_index;
+                *pIndex += baseCounts[relativeIndex.component];
+            }
+
+            std::vector<int> globalMaterialIds(chunk.materialNames.size(), -1);
+            for (size_t i = 0; i < chunk.materialNames.size(); ++i) {
+                auto findIt = materialMap.find(chunk.materialNames[i]);
+                if (findIt != materialMap.end()) {
+                    globalMaterialIds[i] = findIt->second;
+                } else {
+                    *pWarn += "Material not found: " + chunk.materialNames[i] + "\n";
+                }
+            }
+
+            for (auto& chunkShape : chunk.shapes) {
+                if (chunkShape.startsNewShape || shapes.empty()) {
+                    shapes.emplace_back();
+                    shapes.back().name = chunkShape.name;
+                }
+
+                tinyobj::mesh_t& mesh = shapes.back().mesh;
+                mesh.indices.insert(mesh.indices.end(), chunkShape.indices.begin(), chunkShape.indices.end());
+                for (int localMaterialId : chunkShape.materialIds) {
+                    mesh.num_face_vertices.push_back(3);
+                    mesh.material_ids.push_back(
+                        localMaterialId == k_inheritMaterialId ? activeMaterialId : globalMaterialIds[localMaterialId]);
+                    mesh.smoothing_group_ids.push_back(0);
+                }
+            }
+
+            if (chunk.lastMaterialId != k_inheritMaterialId) {
+                activeMaterialId = globalMaterialIds[chunk.lastMaterialId];
+            }
+
+            attrib.vertices.insert(attrib.vertices.end(), chunk.vertices.begin(), chunk.vertices.end());
+            attrib.colors.insert(attrib.colors.end(), chunk.colors.begin(), chunk.colors.end());
+            attrib.normals.insert(attrib.normals.end(), chunk.normals.begin(), chunk.normals.end());
+            attrib.texcoords.insert(attrib.texcoords.end(), chunk.texcoords.begin(), chunk.texcoords.end());
+
+            // Release the chunk's memory as we go, for large files the chunk copies are most of the working set.
+            chunk = ObjChunk();
+        }
+
+        // Shapes that only had a name (e.g. a group statement with no faces) are dropped, same as tinyobj.
+        shapes.erase(
+            std::remove_if(shapes.begin(), shapes.end(), [](const tinyobj::shape_t& shape) {
+                return shape.mesh.indices.empty();
+            }),
+            shapes.end());
+
+        auto mergeEndTime = std::chrono::steady_clock::now();
+
+        if (pStats != nullptr) {
+            pStats->fileSizeBytes = objFile.getSize();
+            pStats->chunkCount = static_cast<uint32_t>(chunks.size());
+            pStats->threadCount = threadCount;
+            pStats->parseSeconds = std::chrono::duration<double>(parseEndTime - startTime).count();
+            pStats->mergeSeconds = std::chrono::duration<double>(mergeEndTime - parseEndTime).count();
+        }
+
+        return true;
+    }
+}
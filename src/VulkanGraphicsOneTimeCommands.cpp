@@ -1,6 +1,8 @@
 #include "VulkanGraphicsOneTimeCommands.h"
 
 #include "VulkanGraphicsContext.h"
+#include "VulkanGraphicsGpuTimeline.h"
+#include "VulkanGraphicsUploadManager.h"
 
 #include <cassert>
 
@@ -31,7 +33,7 @@ namespace vgfx
         }
     }
 
-    void OneTimeCommandsRunner::submit(CommandQueue commandQueue)
+    void OneTimeCommandsRunner::submit(CommandQueue commandQueue, GpuTimeline* pGpuTimeline)
     {
         assert(commandQueue.queueFamilyIndex == m_commandBufferFactory.getCommandQueue().queueFamilyIndex);
 
@@ -40,6 +42,11 @@ namespace vgfx
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &m_commandBuffer;
 
+        if (pGpuTimeline != nullptr && pGpuTimeline->getCommandQueue().queue == commandQueue.queue) {
+            pGpuTimeline->wait(pGpuTimeline->submit(submitInfo));
+            return;
+        }
+
         vkQueueSubmit(commandQueue.queue, 1, &submitInfo, VK_NULL_HANDLE);
         vkQueueWaitIdle(commandQueue.queue);
     }
@@ -58,6 +65,29 @@ namespace vgfx
     {
     }
 
+    UploadManager* OneTimeCommandsHelper::getUploadManager()
+    {
+        // Uploads used by another queue wouldn't be ordered with this helper's commands.
+        UploadManager& uploadManager = m_context.getOrCreateUploadManager();
+        if (uploadManager.getDstCommandQueue().queue != m_commandQueue.queue) {
+            return nullptr;
+        }
+        return &uploadManager;
+    }
+
+    void OneTimeCommandsHelper::execute(const OneTimeCommandsRunner::RecordCommandsFunc& drawFunc)
+    {
+        UploadManager* pUploadManager = m_context.getUploadManager();
+        if (pUploadManager != nullptr && pUploadManager->getDstCommandQueue().queue == m_commandQueue.queue) {
+            pUploadManager->acquire(pUploadManager->flush());
+        }
+
+        OneTimeCommandsRunner runner(
+            m_commandBufferFactory,
+            drawFunc);
+        runner.submit(m_commandQueue, m_context.getGpuTimeline());
+    }
+
     void OneTimeCommandsHelper::copyDataToBuffer(
         MemoryAllocator::Buffer& buffer,
         const std::vector<uint8_t>& data)
@@ -68,8 +98,23 @@ namespace vgfx
     void OneTimeCommandsHelper::copyDataToBuffer(
         MemoryAllocator::Buffer& buffer,
         const void* pData,
-        VkDeviceSize dataSizeBytes)
+        VkDeviceSize dataSizeBytes,
+        VkDeviceSize dstOffsetBytes)
     {
+        // Direct write buffers don't need a staging copy or a submission.
+        if (buffer.pMappedData != nullptr) {
+            m_context.getMemoryAllocator().writeMappedBuffer(buffer, pData, dataSizeBytes, dstOffsetBytes);
+            return;
+        }
+
+        UploadManager* pUploadManager = getUploadManager();
+        // A concurrent buffer may not have been created for the family of the transfer queue.
+        if (pUploadManager != nullptr
+            && (buffer.sharingMode == VK_SHARING_MODE_EXCLUSIVE || !pUploadManager->releasesToDstQueueFamily())) {
+            pUploadManager->uploadToBuffer(buffer, pData, dataSizeBytes, dstOffsetBytes);
+            return;
+        }
+
         auto& memoryAllocator = m_context.getMemoryAllocator();
         auto stagingBuffer =
             memoryAllocator.createBuffer(
@@ -86,15 +131,15 @@ namespace vgfx
 
         OneTimeCommandsRunner runner(
             m_commandBufferFactory,
-            [&buffer, &dataSizeBytes, &stagingBuffer] (VkCommandBuffer commandBuffer) {
+            [&buffer, &dataSizeBytes, &dstOffsetBytes, &stagingBuffer] (VkCommandBuffer commandBuffer) {
                 VkBufferCopy copyRegion = {};
                 copyRegion.srcOffset = 0; // Optional
-                copyRegion.dstOffset = 0; // Optional
+                copyRegion.dstOffset = dstOffsetBytes;
                 copyRegion.size = dataSizeBytes;
                 vkCmdCopyBuffer(commandBuffer, stagingBuffer.handle, buffer.handle, 1, &copyRegion);
             });
 
-        runner.submit(m_commandQueue);
+        runner.submit(m_commandQueue, m_context.getGpuTimeline());
 
         memoryAllocator.destroyBuffer(stagingBuffer);
     }
@@ -233,12 +278,149 @@ namespace vgfx
             VK_FILTER_LINEAR);
     }
 
+    void OneTimeCommandsHelper::RecordCopyBufferToImageCommands(
+        VkCommandBuffer commandBuffer,
+        VkBuffer srcBuffer,
+        VkDeviceSize srcOffsetBytes,
+        const Image& image,
+        GenerateMips genMips,
+        const std::vector<VkDeviceSize>& mipLevelOffsets)
+    {
+        RecordCopyBufferToTransferDstImageCommands(commandBuffer, srcBuffer, srcOffsetBytes, image, mipLevelOffsets);
+        RecordGenerateMipsAndShaderReadCommands(commandBuffer, image, genMips);
+    }
+
+    void OneTimeCommandsHelper::RecordCopyBufferToTransferDstImageCommands(
+        VkCommandBuffer commandBuffer,
+        VkBuffer srcBuffer,
+        VkDeviceSize srcOffsetBytes,
+        const Image& image,
+        const std::vector<VkDeviceSize>& mipLevelOffsets)
+    {
+        RecordImageMemBarrierCommand(
+            commandBuffer,
+            image.getHandle(),
+            VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            0u, // base mip level
+            image.getMipLevels(),
+            0u, // base array layer,
+            VK_REMAINING_ARRAY_LAYERS);
+
+        uint32_t copyLevelCount = mipLevelOffsets.empty() ? 1u : static_cast<uint32_t>(mipLevelOffsets.size());
+        std::vector<VkBufferImageCopy> copyRegions(copyLevelCount);
+        for (uint32_t mipLevel = 0u; mipLevel < copyLevelCount; ++mipLevel) {
+            VkBufferImageCopy& copyRegion = copyRegions[mipLevel];
+            copyRegion.bufferOffset = srcOffsetBytes + (mipLevelOffsets.empty() ? 0u : mipLevelOffsets[mipLevel]);
+            copyRegion.bufferRowLength = 0;
+            copyRegion.bufferImageHeight = 0;
+
+            copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            copyRegion.imageSubresource.mipLevel = mipLevel;
+            // The layers of each level are tightly packed, one after the other.
+            copyRegion.imageSubresource.baseArrayLayer = 0;
+            copyRegion.imageSubresource.layerCount = image.getArrayLayers();
+
+            copyRegion.imageOffset = { 0, 0, 0 };
+            copyRegion.imageExtent = {
+                std::max(image.getWidth() >> mipLevel, 1u),
+                std::max(image.getHeight() >> mipLevel, 1u),
+                1
+            };
+        }
+
+        vkCmdCopyBufferToImage(
+            commandBuffer,
+            srcBuffer,
+            image.getHandle(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            copyLevelCount, copyRegions.data());
+    }
+
+    void OneTimeCommandsHelper::RecordGenerateMipsAndShaderReadCommands(
+        VkCommandBuffer commandBuffer,
+        const Image& image,
+        GenerateMips genMips)
+    {
+        bool mipsGenerated = genMips == GenerateMips::Yes && image.getMipLevels() > 1u;
+        if (mipsGenerated) {
+            VkOffset3D inputSize = {
+                static_cast<int32_t>(image.getWidth()),
+                static_cast<int32_t>(image.getHeight()),
+                1u,
+            };
+            VkOffset3D outputSize = {
+                std::max(inputSize.x >> 1, 1),
+                std::max(inputSize.y >> 1, 1),
+                1,
+            };
+            for (uint32_t mipLevel = 1; mipLevel < image.getMipLevels(); ++mipLevel) {
+                RecordImageMemBarrierCommand(
+                    commandBuffer,
+                    image.getHandle(),
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    mipLevel - 1u, // transfer source level to transfer src
+                    1u, // only 1 mip level
+                    0u, // base array layer,
+                    VK_REMAINING_ARRAY_LAYERS);
+
+                RecordImageBlitCommand(
+                    commandBuffer,
+                    image.getHandle(),
+                    inputSize,
+                    mipLevel - 1u,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    image.getHandle(),
+                    outputSize,
+                    mipLevel,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_FILTER_LINEAR);
+
+                inputSize = outputSize;
+                outputSize = {
+                    std::max(inputSize.x >> 1, 1),
+                    std::max(inputSize.y >> 1, 1),
+                    1,
+                };
+            }
+
+            // Every level but the last was transitioned to transfer src to be blitted from.
+            RecordImageMemBarrierCommand(
+                commandBuffer,
+                image.getHandle(),
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                0u, // base mip level
+                image.getMipLevels() - 1u,
+                0u, // base array layer,
+                VK_REMAINING_ARRAY_LAYERS);
+        }
+
+        RecordImageMemBarrierCommand(
+            commandBuffer,
+            image.getHandle(),
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            mipsGenerated ? image.getMipLevels() - 1u : 0u, // base mip level
+            mipsGenerated ? 1u : image.getMipLevels(),
+            0u, // base array layer,
+            VK_REMAINING_ARRAY_LAYERS);
+    }
+
     void OneTimeCommandsHelper::copyDataToImage(
         Image& image,
         const void* pData,
         VkDeviceSize dataSizeBytes,
-        GenerateMips genMips)
+        GenerateMips genMips,
+        const std::vector<VkDeviceSize>& mipLevelOffsets)
     {
+        UploadManager* pUploadManager = getUploadManager();
+        if (pUploadManager != nullptr) {
+            pUploadManager->uploadToImage(image, pData, dataSizeBytes, genMips, mipLevelOffsets);
+            return;
+        }
+
         auto& memoryAllocator = m_context.getMemoryAllocator();
         auto stagingBuffer =
             memoryAllocator.createBuffer(
@@ -255,105 +437,24 @@ namespace vgfx
 
         OneTimeCommandsRunner runner(
             m_commandBufferFactory,
-            [&image, &dataSizeBytes, &stagingBuffer, &genMips] (VkCommandBuffer commandBuffer) {
-                RecordImageMemBarrierCommand(
-                    commandBuffer,
-                    image.getHandle(),
-                    VK_IMAGE_LAYOUT_UNDEFINED,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    0u, // base mip level
-                    image.getMipLevels(),
-                    0u, // base array layer,
-                    VK_REMAINING_ARRAY_LAYERS);
-
-                VkBufferImageCopy copyRegion = {};
-                copyRegion.bufferOffset = 0;
-                copyRegion.bufferRowLength = 0;
-                copyRegion.bufferImageHeight = 0;
-
-                copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                copyRegion.imageSubresource.mipLevel = 0;
-                copyRegion.imageSubresource.baseArrayLayer = 0;
-                copyRegion.imageSubresource.layerCount = 1;
-
-                copyRegion.imageOffset = { 0, 0, 0 };
-                copyRegion.imageExtent = {
-                    image.getWidth(),
-                    image.getHeight(),
-                    1
-                };
-
-                vkCmdCopyBufferToImage(
+            [&image, &stagingBuffer, &genMips, &mipLevelOffsets] (VkCommandBuffer commandBuffer) {
+                RecordCopyBufferToImageCommands(
                     commandBuffer,
                     stagingBuffer.handle,
-                    image.getHandle(),
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    1, &copyRegion);
-
-                if (genMips == GenerateMips::Yes) {
-                    VkOffset3D inputSize = {
-                        static_cast<int32_t>(image.getWidth()),
-                        static_cast<int32_t>(image.getHeight()),
-                        1u,
-                    };
-                    VkOffset3D outputSize = {
-                        std::max(inputSize.x >> 1, 1),
-                        std::max(inputSize.y >> 1, 1),
-                        1,
-                    };
-                    for (uint32_t mipLevel = 1; mipLevel < image.getMipLevels(); ++mipLevel) {
-                        RecordImageMemBarrierCommand(
-                            commandBuffer,
-                            image.getHandle(),
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                            mipLevel - 1u, // transfer source level to transfer src
-                            1u, // only 1 mip level
-                            0u, // base array layer,
-                            VK_REMAINING_ARRAY_LAYERS);
-
-                        RecordImageBlitCommand(
-                            commandBuffer,
-                            image.getHandle(),
-                            inputSize,
-                            mipLevel - 1u,
-                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                            image.getHandle(),
-                            outputSize,
-                            mipLevel,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            VK_FILTER_LINEAR);
-
-                        inputSize = outputSize;
-                        outputSize = {
-                            std::max(inputSize.x >> 1, 1),
-                            std::max(inputSize.y >> 1, 1),
-                            1,
-                        };
-                    }
-
-                }
-
-                RecordImageMemBarrierCommand(
-                    commandBuffer,
-                    image.getHandle(),
-                    VK_IMAGE_LAYOUT_UNDEFINED,
-                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
-                    0u, // base mip level
-                    image.getMipLevels(),
-                    0u, // base array layer,
-                    VK_REMAINING_ARRAY_LAYERS);
+                    0u, // src offset
+                    image,
+                    genMips,
+                    mipLevelOffsets);
             });
 
-        runner.submit(m_commandQueue);
+        runner.submit(m_commandQueue, m_context.getGpuTimeline());
 
         memoryAllocator.destroyBuffer(stagingBuffer);
     }
 
     void OneTimeCommandsHelper::recordImageMemBarrierCommand(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount, uint32_t baseArrayLayer, uint32_t layerCount)
     {
-        OneTimeCommandsRunner runner(
-            m_commandBufferFactory,
+        execute(
             [=](VkCommandBuffer commandBuffer) {
                 RecordImageMemBarrierCommand(
                     commandBuffer,
@@ -365,6 +466,5 @@ namespace vgfx
                     baseArrayLayer,
                     layerCount);
             });
-        runner.submit(m_commandQueue);
     }
 }
\ No newline at end of file
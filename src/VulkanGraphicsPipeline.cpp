@@ -1,6 +1,7 @@
 #include "VulkanGraphicsPipeline.h"
 
 #include "VulkanGraphicsDepthStencilBuffer.h"
+#include "VulkanGraphicsHostAllocator.h"
 
 #include <stdexcept>
 
@@ -147,6 +148,9 @@ namespace vgfx
 
         for (const auto& spDescSetLayout: meshEffect.getDescriptorSetLayouts()) {
             m_descriptorSetLayouts.push_back(spDescSetLayout->getHandle());
+            if (spDescSetLayout->isDescriptorBuffer()) {
+                m_pipelineCreateFlags |= VK_PIPELINE_CREATE_DESCRIPTOR_BUFFER_BIT_EXT;
+            }
         }
 
         return *this;
@@ -195,6 +199,7 @@ namespace vgfx
         pipelineLayoutInfo.pPushConstantRanges = m_pushConstantRanges.data();
 
         VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_PIPELINE_LAYOUT);
         VkResult result =
             vkCreatePipelineLayout(
                 context.getLogicalDevice(),
@@ -214,6 +219,7 @@ namespace vgfx
 
         VkGraphicsPipelineCreateInfo pipelineInfo = {};
         pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.flags = m_pipelineCreateFlags;
         pipelineInfo.stageCount = kNumShaderStages;
         pipelineInfo.pStages = shaderStages;
 
@@ -268,6 +274,7 @@ namespace vgfx
         , m_effect(effect)
         , m_pipelineLayout(pipelineLayout)
     {
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_PIPELINE);
         VkResult result =
             vkCreateGraphicsPipelines(
                 context.getLogicalDevice(),
@@ -289,13 +296,18 @@ namespace vgfx
         VkDevice device = m_context.getLogicalDevice();
         VkAllocationCallbacks* pAllocationCallbacks = m_context.getAllocationCallbacks();
 
+        // Command buffers in flight may still be bound to them.
         if (m_graphicsPipeline != VK_NULL_HANDLE) {
-            vkDestroyPipeline(device, m_graphicsPipeline, pAllocationCallbacks);
+            m_context.retire([device, pipeline = m_graphicsPipeline, pAllocationCallbacks]() {
+                vkDestroyPipeline(device, pipeline, pAllocationCallbacks);
+            });
             m_graphicsPipeline = VK_NULL_HANDLE;
         }
 
         if (m_pipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(device, m_pipelineLayout, pAllocationCallbacks);
+            m_context.retire([device, pipelineLayout = m_pipelineLayout, pAllocationCallbacks]() {
+                vkDestroyPipelineLayout(device, pipelineLayout, pAllocationCallbacks);
+            });
             m_pipelineLayout = VK_NULL_HANDLE;
         }
     }
@@ -1,5 +1,7 @@
 #include "VulkanGraphicsProgram.h"
 
+#include "VulkanGraphicsHostAllocator.h"
+
 #include <fstream>
 #include <memory>
 #include <stdexcept>
@@ -13,6 +15,7 @@ namespace vgfx
         createInfo.codeSize = code.size();
         createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
         VkShaderModule shaderModule;
+        HostAllocator::ObjectTypeScope objectTypeScope(VK_OBJECT_TYPE_SHADER_MODULE);
         if (vkCreateShaderModule(
             context.getLogicalDevice(),
             &createInfo,
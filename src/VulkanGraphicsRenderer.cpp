@@ -1,13 +1,15 @@
 #include "VulkanGraphicsRenderer.h"
 
 #include "VulkanGraphicsCamera.h"
+#include "VulkanGraphicsDefragmenter.h"
 #include "VulkanGraphicsDepthStencilBuffer.h"
-#include "VulkanGraphicsDescriptorPoolBuilder.h"
 #include "VulkanGraphicsDrawable.h"
 #include "VulkanGraphicsEffects.h"
 #include "VulkanGraphicsRenderTarget.h"
+#include "VulkanGraphicsRetirementQueue.h"
 #include "VulkanGraphicsSampler.h"
 #include "VulkanGraphicsSceneNode.h"
+#include "VulkanGraphicsUploadManager.h"
 
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
@@ -21,27 +23,42 @@
 
 namespace vgfx
 {
+    // Transient memory of each frame in flight, e.g. for per-draw uniforms.
+    constexpr static VkDeviceSize k_transientPoolSizeBytes = 4u * 1024u * 1024u;
+    // MemoryAllocator::calculateStatistics walks every block, so fragmentation is checked rarely.
+    constexpr static size_t k_defragmentCheckFrameInterval = 300u;
+    // Fewer bytes in holes than this aren't worth moving anything for.
+    constexpr static VkDeviceSize k_defragmentMinFragmentedBytes = 64u * 1024u * 1024u;
+
+    struct LightingUniforms
+    {
+        LightState lights[2];
+        int lightCount;
+        float ambient;
+        glm::vec3 viewPos;
+    };
+
     void Renderer::createImageSamplers(Drawable& drawable)
     {
-        ImageSampler& imageSampler = drawable.getImageSampler(ImageType::Diffuse);
-
-        const Image& image = imageSampler.first->getImage();
-        uint32_t mipLevels =
-            vgfx::Image::ComputeMipLevels2D(image.getWidth(), image.getHeight());
-
-        Sampler& sampler = EffectsLibrary::GetOrCreateSampler(
-            m_context,
-            Sampler::Config(
-                VK_FILTER_LINEAR,
-                VK_FILTER_LINEAR,
-                VK_SAMPLER_MIPMAP_MODE_LINEAR,
-                0.0f, // min lod
-                static_cast<float>(mipLevels),
-                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-                VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
-                false, 0));
-        imageSampler.second = &sampler;
+        for (size_t materialIndex = 0; materialIndex < drawable.getMaterialCount(); ++materialIndex) {
+            ImageSampler& imageSampler = drawable.getImageSampler(ImageType::Diffuse, materialIndex);
+
+            // The max LOD isn't clamped to the image's mip levels since the view already limits
+            // them, and the image may be a placeholder that is replaced once it finishes loading.
+            Sampler& sampler = EffectsLibrary::GetOrCreateSampler(
+                m_context,
+                Sampler::Config(
+                    VK_FILTER_LINEAR,
+                    VK_FILTER_LINEAR,
+                    VK_SAMPLER_MIPMAP_MODE_LINEAR,
+                    0.0f, // min lod
+                    VK_LOD_CLAMP_NONE,
+                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+                    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER,
+                    false, 0));
+            imageSampler.second = &sampler;
+        }
     }
 
     void Renderer::buildPipelines(Object& object, DrawContext& drawContext)
@@ -88,7 +105,21 @@ namespace vgfx
 
     void Renderer::renderFrame(SceneNode& scene)
     {
-        size_t cpuFrameInFlight = m_frameIndex % m_descriptorPools.size();
+        RetirementQueue* pRetirementQueue = m_context.getRetirementQueue();
+        if (pRetirementQueue != nullptr) {
+            // Destroys the resources that only completed frames used.
+            pRetirementQueue->collect();
+        }
+
+        startDefragmenterIfFragmented();
+
+        Defragmenter* pDefragmenter = m_context.getDefragmenter();
+        if (pDefragmenter != nullptr) {
+            // Moves the next few allocations before anything records their handles.
+            pDefragmenter->update();
+        }
+
+        size_t cpuFrameInFlight = m_frameIndex % m_descriptorAllocators.size();
 
         VkCommandBuffer commandBuffer = m_commandBuffers[cpuFrameInFlight];
         vkResetCommandBuffer(commandBuffer, 0);
@@ -105,19 +136,39 @@ namespace vgfx
 
         m_context.beginRendering(commandBuffer, renderTarget);
 
-        DescriptorPool& descriptorPool = *m_descriptorPools[cpuFrameInFlight].get();
-        descriptorPool.reset();
+        DescriptorAllocator& descriptorAllocator = *m_descriptorAllocators[cpuFrameInFlight].get();
+        descriptorAllocator.reset();
+
+        DescriptorBuffer* pDescriptorBuffer = nullptr;
+        if (!m_descriptorBuffers.empty()) {
+            pDescriptorBuffer = m_descriptorBuffers[cpuFrameInFlight].get();
+            pDescriptorBuffer->reset();
+            // Drawables only set their sets' offsets in it.
+            pDescriptorBuffer->bind(commandBuffer);
+        }
+
+        // Frees the buffers of the frame that last used this pool, like its descriptor sets.
+        uint32_t transientPoolIndex = static_cast<uint32_t>(cpuFrameInFlight);
+        m_context.getMemoryAllocator().resetTransientPool(transientPoolIndex);
+
+        // Cleared rather than recreated, so they keep their capacity.
+        m_spDescriptorBatcher->reset();
+        m_drawQueue.clear();
 
         DrawContext drawState{
             .context = m_context,
-            .descriptorPool = descriptorPool,
+            .descriptorAllocator = descriptorAllocator,
+            .pDescriptorBuffer = pDescriptorBuffer,
+            .descriptorBatcher = *m_spDescriptorBatcher.get(),
+            .drawQueue = m_drawQueue,
             .frameIndex = m_frameIndex,
             .depthBufferEnabled = true,
             .commandBuffer = commandBuffer,
-            .renderTarget = renderTarget
+            .renderTarget = renderTarget,
+            .transientPoolIndex = transientPoolIndex
         };
 
-        m_spCamera->update();
+        m_spCamera->update(transientPoolIndex);
         drawState.pushView(
             m_spCamera->getView(),
             m_spCamera->getProj(),
@@ -125,12 +176,31 @@ namespace vgfx
             m_spCamera->getViewport(),
             m_spCamera->getRasterizerConfig());
 
-        drawState.sceneState.pLightsBuffer = m_lightsBuffers[cpuFrameInFlight].get();
+        Buffer::Config lightsBufferCfg(sizeof(LightingUniforms) * 10); // Support up to 10 lights
+        m_spLightsBuffer =
+            std::make_unique<Buffer>(
+                m_context,
+                Buffer::Type::UniformBuffer,
+                lightsBufferCfg,
+                transientPoolIndex);
+        drawState.sceneState.pLightsBuffer = m_spLightsBuffer.get();
 
         scene.draw(*this, drawState);
 
+        // All of the frame's descriptor sets are allocated and written at once, before any of the
+        // draws that bind them are recorded.
+        m_spDescriptorBatcher->flush(descriptorAllocator);
+        for (Drawable* pDrawable : m_drawQueue) {
+            pDrawable->recordDraw(drawState);
+        }
+
         m_context.endRendering(commandBuffer);
 
+        if (pDescriptorBuffer != nullptr) {
+            // The frame's sets are all written by now.
+            pDescriptorBuffer->flush();
+        }
+
         postDrawScene(commandBuffer);
 
         vkEndCommandBuffer(commandBuffer);
@@ -142,6 +212,13 @@ namespace vgfx
 
     void Renderer::submitGraphicsCommands()
     {
+        // Uploads recorded while drawing the frame are submitted first. If they are copied by a
+        // transfer queue then the frame only waits for them at the stages that use them.
+        UploadManager* pUploadManager = m_context.getUploadManager();
+        if (pUploadManager != nullptr) {
+            pUploadManager->acquire(pUploadManager->flush());
+        }
+
         QueueSubmitInfo& submitInfo = m_queueSubmitInfo;
 
         VkSubmitInfo vkSubmitInfo = {};
@@ -157,6 +234,12 @@ namespace vgfx
         vkSubmitInfo.signalSemaphoreCount = static_cast<uint32_t>(submitInfo.signalSemaphores.size());
         vkSubmitInfo.pSignalSemaphores = submitInfo.signalSemaphores.data();
 
+        GpuTimeline* pGpuTimeline = m_context.getGpuTimeline();
+        if (pGpuTimeline != nullptr) {
+            m_lastSubmittedFrameTimelineValue = pGpuTimeline->submit(vkSubmitInfo, submitInfo.fence);
+            return;
+        }
+
         vkQueueSubmit(
             m_context.getGraphicsQueue(0u).queue,
             1,
@@ -179,7 +262,7 @@ namespace vgfx
         renderer.submitGraphicsCommands();
 
         ++m_syncObjIndex;
-        if (m_syncObjIndex == m_inFlightFences.size()) {
+        if (m_syncObjIndex == m_spSwapChain->getImageAvailableSemaphoreCount()) {
             m_syncObjIndex = 0u;
         }
 
@@ -465,19 +548,32 @@ namespace vgfx
 
         renderer.initGraphicsResources(swapChainExtent.width, swapChainExtent.height, frameBufferingCount);
 
-        m_renderFinishedSemaphores.reserve(frameBufferingCount);
-        m_swapChainRenderTargets.resize(frameBufferingCount);
-        for (size_t i = 0; i < frameBufferingCount; ++i) {
+        createRenderTargets(renderer);
+    }
+
+    void SwapChainPresenter::createRenderTargets(Renderer& renderer)
+    {
+        uint32_t frameBufferingCount = m_spSwapChain->getImageCount();
 
+        const auto& swapChainExtent = m_spSwapChain->getImageExtent();
+
+        // Sync objects are only added, since frames in flight may still use them.
+        while (m_inFlightFences.size() < frameBufferingCount) {
             m_renderFinishedSemaphores.push_back(
                 std::make_unique<Semaphore>(renderer.getContext()));
 
             m_inFlightFences.push_back(
                 std::make_unique<Fence>(renderer.getContext()));
+        }
 
+        m_swapChainRenderTargets.clear();
+        m_swapChainRenderTargets.resize(frameBufferingCount);
+        for (size_t i = 0; i < frameBufferingCount; ++i) {
             m_swapChainRenderTargets[i].addRenderImage(m_spSwapChain->getImage(i));
         }
 
+        // Retired by their images' destructors if there are frames in flight.
+        m_swapChainDepthStencilBuffers.clear();
         if (m_swapChainConfig.depthStencilFormat.has_value()) {
             DepthStencilBuffer::Config dsCfg(
                 swapChainExtent.width,
@@ -493,7 +589,30 @@ namespace vgfx
         }
     }
 
-    void Renderer::createCamera(uint32_t width, uint32_t height, uint32_t framesInFlightPlusOne)
+    void Renderer::startDefragmenterIfFragmented()
+    {
+        float wastedFraction = m_context.getAppConfig().defragmentWastedFraction;
+        if (wastedFraction <= 0.0f
+            || !m_context.isDefragmenterSupported()
+            || (m_frameIndex % k_defragmentCheckFrameInterval) != 0u) {
+            return;
+        }
+
+        Defragmenter* pDefragmenter = m_context.getDefragmenter();
+        if (pDefragmenter != nullptr && pDefragmenter->isRunning()) {
+            return;
+        }
+
+        MemoryAllocator::Statistics statistics;
+        m_context.getMemoryAllocator().calculateStatistics(&statistics);
+        // The unused ends of the blocks don't count, compacting doesn't shrink them.
+        if (statistics.fragmentedBytes >= k_defragmentMinFragmentedBytes
+            && static_cast<float>(statistics.fragmentedBytes) > wastedFraction * static_cast<float>(statistics.blockBytes)) {
+            m_context.getOrCreateDefragmenter().start();
+        }
+    }
+
+    void Renderer::createCamera(uint32_t width, uint32_t height)
     {
         glm::vec3 viewPos(2.0f, 2.0f, 2.0f);
         glm::mat4 cameraView = glm::lookAt(
@@ -523,7 +642,7 @@ namespace vgfx
         };
 
         m_spCamera = std::make_unique<Camera>(
-            m_context, framesInFlightPlusOne, cameraView, cameraProj, viewport);
+            m_context, cameraView, cameraProj, viewport);
     }
 
     static void RecordImageLayoutTransition(
@@ -620,7 +739,11 @@ namespace vgfx
 
     void SwapChainPresenter::resizeWindow(uint32_t width, uint32_t height, Renderer& renderer)
     {
-        renderer.getContext().waitForDeviceToIdle();
+        // The resources of the old swap chain are retired while its frames finish rendering,
+        // without a RetirementQueue they are destroyed immediately so the device must be idle.
+        if (renderer.getContext().getRetirementQueue() == nullptr) {
+            renderer.getContext().waitForDeviceToIdle();
+        }
 
         VkExtent2D windowWidthHeight {
             .width = width,
@@ -628,8 +751,11 @@ namespace vgfx
         };
         m_swapChainConfig.imageExtent = windowWidthHeight;
         m_spSwapChain->recreate(m_surface, m_swapChainConfig);
+        m_syncObjIndex = 0u;
 
         renderer.resizeRenderTargetResources(width, height, m_spSwapChain->getImageCount());
+
+        createRenderTargets(renderer);
     }
 
     void Renderer::resizeRenderTargetResources(uint32_t width, uint32_t height, uint32_t frameBufferingCount)
@@ -638,43 +764,45 @@ namespace vgfx
         if (frameBufferingCount != m_frameBufferingCount) {
             m_frameBufferingCount = frameBufferingCount;
 
-            m_descriptorPools.clear();
+            m_descriptorAllocators.clear();
+            m_descriptorBuffers.clear();
             m_commandBuffers.clear();
-            m_lightsBuffers.clear();
 
             createResourcePools(framesInFlightPlusOne);
         }
 
-        createCamera(width, height, framesInFlightPlusOne);
+        createCamera(width, height);
     }
 
     void Renderer::createResourcePools(uint32_t framesInFlightPlusOne)
     {
-        DescriptorPoolBuilder poolBuilder;
-        poolBuilder.addDescriptors(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100);
-        poolBuilder.addDescriptors(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 100);
-        poolBuilder.addMaxSets(200);
-        //poolBuilder.setCreateFlags(VkDescriptorPoolCreateFlags);
-
-        struct LightingUniforms
-        {
-            LightState lights[2];
-            int lightCount;
-            float ambient;
-            glm::vec3 viewPos;
+        // Flushed within the frame, so one is enough for all of the frames in flight.
+        if (m_spDescriptorBatcher == nullptr) {
+            m_spDescriptorBatcher = std::make_unique<DescriptorBatcher>(m_context);
+        }
+
+        // Initial sizes, the allocators grow to fit the scene.
+        DescriptorAllocator::Config descriptorAllocatorCfg;
+        descriptorAllocatorCfg.initMaxSets = 200u;
+        descriptorAllocatorCfg.initPoolSizes = {
+            { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 100u },
+            { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 100u },
         };
 
-        Buffer::Config lightsBufferCfg(sizeof(LightingUniforms) * 10); // Support up to 10 lights
+        // Pools are only added, so if there are fewer frames in flight then some are unused.
+        m_context.getMemoryAllocator().createTransientPools(framesInFlightPlusOne, k_transientPoolSizeBytes);
+
         for (size_t i = 0; i < framesInFlightPlusOne; ++i) {
-            m_descriptorPools.emplace_back(poolBuilder.createPool(m_context));
+            m_descriptorAllocators.emplace_back(
+                std::make_unique<DescriptorAllocator>(m_context, descriptorAllocatorCfg));
 
-            m_commandBuffers.push_back(m_spCommandBufferFactory->createCommandBuffer());
+            // Used instead of the allocator by mesh effects whose layouts are descriptor buffer layouts.
+            if (m_context.areDescriptorBuffersEnabled()) {
+                m_descriptorBuffers.emplace_back(
+                    std::make_unique<DescriptorBuffer>(m_context, DescriptorBuffer::Config()));
+            }
 
-            m_lightsBuffers.emplace_back(
-                std::make_unique<Buffer>(
-                    m_context,
-                    Buffer::Type::UniformBuffer,
-                    lightsBufferCfg));
+            m_commandBuffers.push_back(m_spCommandBufferFactory->createCommandBuffer());
         }
     }
 
@@ -690,6 +818,6 @@ namespace vgfx
         uint32_t framesInFlightPlusOne = frameBufferingCount + 1;
         createResourcePools(framesInFlightPlusOne);
 
-        createCamera(renderTargetWidth, renderTargetHeight, static_cast<uint32_t>(framesInFlightPlusOne));
+        createCamera(renderTargetWidth, renderTargetHeight);
     }
 }
@@ -0,0 +1,45 @@
+#include "VulkanGraphicsRetirementQueue.h"
+
+#include <utility>
+
+namespace vgfx
+{
+    RetirementQueue::~RetirementQueue()
+    {
+        flush();
+    }
+
+    void RetirementQueue::retire(GpuTimeline::Value lastUseValue, DestroyFunc&& destroyFunc)
+    {
+        if (m_retired.empty() && m_gpuTimeline.isComplete(lastUseValue)) {
+            destroyFunc();
+            return;
+        }
+        m_retired.push_back({ lastUseValue, std::move(destroyFunc) });
+    }
+
+    void RetirementQueue::collect()
+    {
+        if (!m_retired.empty()) {
+            destroyUpTo(m_gpuTimeline.getCompletedValue());
+        }
+    }
+
+    void RetirementQueue::flush()
+    {
+        while (!m_retired.empty()) {
+            m_gpuTimeline.wait(m_retired.back().lastUseValue);
+            destroyUpTo(m_gpuTimeline.getCompletedValue());
+        }
+    }
+
+    void RetirementQueue::destroyUpTo(GpuTimeline::Value completedValue)
+    {
+        while (!m_retired.empty() && m_retired.front().lastUseValue <= completedValue) {
+            // Popped first since destroying an object can retire the objects that it owns.
+            DestroyFunc destroyFunc = std::move(m_retired.front().destroyFunc);
+            m_retired.pop_front();
+            destroyFunc();
+        }
+    }
+}
@@ -66,3 +66,8 @@ std::unique_ptr<SceneNode> SceneLoader::loadScene(const std::string&)
 
     return std::move(spScene);
 }
+
+void SceneLoader::update()
+{
+    m_spModelLibrary->update();
+}
@@ -4,6 +4,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 
@@ -177,12 +178,20 @@ namespace vgfx
             VkDevice device = m_context.getLogicalDevice();
             assert(device != VK_NULL_HANDLE && "Memory leak in WindowSwapChain!");
 
-            vkDestroySwapchainKHR(device, swapChain, m_context.getAllocationCallbacks());
-            swapChain = VK_NULL_HANDLE;
-
-            m_imageAvailableSemaphores.clear();
+            // Frames in flight may still render to the images and wait on the semaphores, so they
+            // are retired, the views first since they are destroyed in order.
             m_imageViews.clear();
             m_images.clear();
+
+            auto spImageAvailableSemaphores =
+                std::make_shared<std::vector<std::unique_ptr<Semaphore>>>(std::move(m_imageAvailableSemaphores));
+            m_imageAvailableSemaphores.clear();
+
+            m_context.retire(
+                [device, swapChain, spImageAvailableSemaphores, pAllocationCallbacks = m_context.getAllocationCallbacks()]() {
+                    spImageAvailableSemaphores->clear();
+                    vkDestroySwapchainKHR(device, swapChain, pAllocationCallbacks);
+                });
         }
     } 
 }
\ No newline at end of file
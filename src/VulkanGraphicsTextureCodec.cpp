@@ -0,0 +1,1206 @@
+#include "VulkanGraphicsTextureCodec.h"
+
+#include "VulkanGraphicsImageKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+namespace vgfx
+{
+    namespace TextureCodec
+    {
+        template<typename T>
+        static T ReadValue(const uint8_t* pData)
+        {
+            T value;
+            memcpy(&value, pData, sizeof(T));
+            return value;
+        }
+
+        // Block decoders, each writes a 4x4 block of RGBA8 texels.
+
+        static void DecodeRgb565(uint16_t color, uint8_t* pRgbaOut)
+        {
+            uint32_t r = (color >> 11u) & 0x1Fu;
+            uint32_t g = (color >> 5u) & 0x3Fu;
+            uint32_t b = color & 0x1Fu;
+            pRgbaOut[0] = static_cast<uint8_t>((r << 3u) | (r >> 2u));
+            pRgbaOut[1] = static_cast<uint8_t>((g << 2u) | (g >> 4u));
+            pRgbaOut[2] = static_cast<uint8_t>((b << 3u) | (b >> 2u));
+            pRgbaOut[3] = 255u;
+        }
+
+        static void DecodeBc1Block(const uint8_t* pBlock, bool alwaysFourColors, uint8_t texelsOut[16][4])
+        {
+            uint16_t color0 = ReadValue<uint16_t>(pBlock);
+            uint16_t color1 = ReadValue<uint16_t>(pBlock + 2u);
+            uint32_t indices = ReadValue<uint32_t>(pBlock + 4u);
+
+            uint8_t palette[4][4];
+            DecodeRgb565(color0, palette[0]);
+            DecodeRgb565(color1, palette[1]);
+            if (color0 > color1 || alwaysFourColors) {
+                for (uint32_t c = 0u; c < 3u; ++c) {
+                    palette[2][c] = static_cast<uint8_t>((2u * palette[0][c] + palette[1][c]) / 3u);
+                    palette[3][c] = static_cast<uint8_t>((palette[0][c] + 2u * palette[1][c]) / 3u);
+                }
+                palette[2][3] = 255u;
+                palette[3][3] = 255u;
+            } else {
+                for (uint32_t c = 0u; c < 3u; ++c) {
+                    palette[2][c] = static_cast<uint8_t>((palette[0][c] + palette[1][c]) / 2u);
+                    palette[3][c] = 0u;
+                }
+                palette[2][3] = 255u;
+                palette[3][3] = 0u;
+            }
+
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                memcpy(texelsOut[i], palette[(indices >> (2u * i)) & 0x3u], 4u);
+            }
+        }
+
+        // BC4 block, also used for BC3 alpha and the BC5 channels.
+        static void DecodeBc4Block(const uint8_t* pBlock, bool isSigned, uint8_t texelsOut[16][4], uint32_t channel)
+        {
+            int32_t values[8];
+            if (isSigned) {
+                values[0] = std::max(static_cast<int32_t>(static_cast<int8_t>(pBlock[0])), -127);
+                values[1] = std::max(static_cast<int32_t>(static_cast<int8_t>(pBlock[1])), -127);
+            } else {
+                values[0] = pBlock[0];
+                values[1] = pBlock[1];
+            }
+
+            if (values[0] > values[1]) {
+                for (int32_t i = 1; i < 7; ++i) {
+                    values[i + 1] = ((7 - i) * values[0] + i * values[1]) / 7;
+                }
+            } else {
+                for (int32_t i = 1; i < 5; ++i) {
+                    values[i + 1] = ((5 - i) * values[0] + i * values[1]) / 5;
+                }
+                values[6] = isSigned ? -127 : 0;
+                values[7] = isSigned ? 127 : 255;
+            }
+
+            uint64_t indices = 0u;
+            for (uint32_t i = 0u; i < 6u; ++i) {
+                indices |= static_cast<uint64_t>(pBlock[2u + i]) << (8u * i);
+            }
+
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                int32_t value = values[(indices >> (3u * i)) & 0x7u];
+                texelsOut[i][channel] = static_cast<uint8_t>(value);
+            }
+        }
+
+        static void DecodeBc2Alpha(const uint8_t* pBlock, uint8_t texelsOut[16][4])
+        {
+            uint64_t alphas = ReadValue<uint64_t>(pBlock);
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                uint32_t alpha = static_cast<uint32_t>((alphas >> (4u * i)) & 0xFu);
+                texelsOut[i][3] = static_cast<uint8_t>(alpha | (alpha << 4u));
+            }
+        }
+
+        struct Bc7ModeInfo
+        {
+            uint32_t subsetCount;
+            uint32_t partitionBits;
+            uint32_t rotationBits;
+            uint32_t indexSelectionBits;
+            uint32_t colorBits;
+            uint32_t alphaBits;
+            uint32_t endpointPBits;
+            uint32_t sharedPBits;
+            uint32_t indexBits;
+            uint32_t secondaryIndexBits;
+        };
+
+        static const Bc7ModeInfo Bc7Modes[8] = {
+            { 3u, 4u, 0u, 0u, 4u, 0u, 1u, 0u, 3u, 0u },
+            { 2u, 6u, 0u, 0u, 6u, 0u, 0u, 1u, 3u, 0u },
+            { 3u, 6u, 0u, 0u, 5u, 0u, 0u, 0u, 2u, 0u },
+            { 2u, 6u, 0u, 0u, 7u, 0u, 1u, 0u, 2u, 0u },
+            { 1u, 0u, 2u, 1u, 5u, 6u, 0u, 0u, 2u, 3u },
+            { 1u, 0u, 2u, 0u, 7u, 8u, 0u, 0u, 2u, 2u },
+            { 1u, 0u, 0u, 0u, 7u, 7u, 1u, 0u, 4u, 0u },
+            { 2u, 6u, 0u, 0u, 5u, 5u, 1u, 0u, 2u, 0u },
+        };
+
+        static const uint8_t Bc7Partitions2[64][16] = {
+            { 0,0,1,1,0,0,1,1,0,0,1,1,0,0,1,1 }, { 0,0,0,1,0,0,0,1,0,0,0,1,0,0,0,1 },
+            { 0,1,1,1,0,1,1,1,0,1,1,1,0,1,1,1 }, { 0,0,0,1,0,0,1,1,0,0,1,1,0,1,1,1 },
+            { 0,0,0,0,0,0,0,1,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,0,1,1,1,1,1,1,1 },
+            { 0,0,0,1,0,0,1,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,1,0,0,1,1,0,1,1,1 },
+            { 0,0,0,0,0,0,0,0,0,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,1,1,1,1,1,1,1,1,1 },
+            { 0,0,0,0,0,0,0,1,0,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,1,0,1,1,1 },
+            { 0,0,0,1,0,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,1,1,1,1,1,1,1,1 },
+            { 0,0,0,0,1,1,1,1,1,1,1,1,1,1,1,1 }, { 0,0,0,0,0,0,0,0,0,0,0,0,1,1,1,1 },
+            { 0,0,0,0,1,0,0,0,1,1,1,0,1,1,1,1 }, { 0,1,1,1,0,0,0,1,0,0,0,0,0,0,0,0 },
+            { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,1,0 }, { 0,1,1,1,0,0,1,1,0,0,0,1,0,0,0,0 },
+            { 0,0,1,1,0,0,0,1,0,0,0,0,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,1,0,0,1,1,1,0 },
+            { 0,0,0,0,0,0,0,0,1,0,0,0,1,1,0,0 }, { 0,1,1,1,0,0,1,1,0,0,1,1,0,0,0,1 },
+            { 0,0,1,1,0,0,0,1,0,0,0,1,0,0,0,0 }, { 0,0,0,0,1,0,0,0,1,0,0,0,1,1,0,0 },
+            { 0,1,1,0,0,1,1,0,0,1,1,0,0,1,1,0 }, { 0,0,1,1,0,1,1,0,0,1,1,0,1,1,0,0 },
+            { 0,0,0,1,0,1,1,1,1,1,1,0,1,0,0,0 }, { 0,0,0,0,1,1,1,1,1,1,1,1,0,0,0,0 },
+            { 0,1,1,1,0,0,0,1,1,0,0,0,1,1,1,0 }, { 0,0,1,1,1,0,0,1,1,0,0,1,1,1,0,0 },
+            { 0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1 }, { 0,0,0,0,1,1,1,1,0,0,0,0,1,1,1,1 },
+            { 0,1,0,1,1,0,1,0,0,1,0,1,1,0,1,0 }, { 0,0,1,1,0,0,1,1,1,1,0,0,1,1,0,0 },
+            { 0,0,1,1,1,1,0,0,0,0,1,1,1,1,0,0 }, { 0,1,0,1,0,1,0,1,1,0,1,0,1,0,1,0 },
+            { 0,1,1,0,1,0,0,1,0,1,1,0,1,0,0,1 }, { 0,1,0,1,1,0,1,0,1,0,1,0,0,1,0,1 },
+            { 0,1,1,1,0,0,1,1,1,1,0,0,1,1,1,0 }, { 0,0,0,1,0,0,1,1,1,1,0,0,1,0,0,0 },
+            { 0,0,1,1,0,0,1,0,0,1,0,0,1,1,0,0 }, { 0,0,1,1,1,0,1,1,1,1,0,1,1,1,0,0 },
+            { 0,1,1,0,1,0,0,1,1,0,0,1,0,1,1,0 }, { 0,0,1,1,1,1,0,0,1,1,0,0,0,0,1,1 },
+            { 0,1,1,0,0,1,1,0,1,0,0,1,1,0,0,1 }, { 0,0,0,0,0,1,1,0,0,1,1,0,0,0,0,0 },
+            { 0,1,0,0,1,1,1,0,0,1,0,0,0,0,0,0 }, { 0,0,1,0,0,1,1,1,0,0,1,0,0,0,0,0 },
+            { 0,0,0,0,0,0,1,0,0,1,1,1,0,0,1,0 }, { 0,0,0,0,0,1,0,0,1,1,1,0,0,1,0,0 },
+            { 0,1,1,0,1,1,0,0,1,0,0,1,0,0,1,1 }, { 0,0,1,1,0,1,1,0,1,1,0,0,1,0,0,1 },
+            { 0,1,1,0,0,0,1,1,1,0,0,1,1,1,0,0 }, { 0,0,1,1,1,0,0,1,1,1,0,0,0,1,1,0 },
+            { 0,1,1,0,1,1,0,0,1,1,0,0,1,0,0,1 }, { 0,1,1,0,0,0,1,1,0,0,1,1,1,0,0,1 },
+            { 0,1,1,1,1,1,1,0,1,0,0,0,0,0,0,1 }, { 0,0,0,1,1,0,0,0,1,1,1,0,0,1,1,1 },
+            { 0,0,0,0,1,1,1,1,0,0,1,1,0,0,1,1 }, { 0,0,1,1,0,0,1,1,1,1,1,1,0,0,0,0 },
+            { 0,0,1,0,0,0,1,0,1,1,1,0,1,1,1,0 }, { 0,1,0,0,0,1,0,0,0,1,1,1,0,1,1,1 },
+        };
+
+        static const uint8_t Bc7Partitions3[64][16] = {
+            { 0,0,1,1,0,0,1,1,0,2,2,1,2,2,2,2 }, { 0,0,0,1,0,0,1,1,2,2,1,1,2,2,2,1 },
+            { 0,0,0,0,2,0,0,1,2,2,1,1,2,2,1,1 }, { 0,2,2,2,0,0,2,2,0,0,1,1,0,1,1,1 },
+            { 0,0,0,0,0,0,0,0,1,1,2,2,1,1,2,2 }, { 0,0,1,1,0,0,1,1,0,0,2,2,0,0,2,2 },
+            { 0,0,2,2,0,0,2,2,1,1,1,1,1,1,1,1 }, { 0,0,1,1,0,0,1,1,2,2,1,1,2,2,1,1 },
+            { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2 }, { 0,0,0,0,1,1,1,1,1,1,1,1,2,2,2,2 },
+            { 0,0,0,0,1,1,1,1,2,2,2,2,2,2,2,2 }, { 0,0,1,2,0,0,1,2,0,0,1,2,0,0,1,2 },
+            { 0,1,1,2,0,1,1,2,0,1,1,2,0,1,1,2 }, { 0,1,2,2,0,1,2,2,0,1,2,2,0,1,2,2 },
+            { 0,0,1,1,0,1,1,2,1,1,2,2,1,2,2,2 }, { 0,0,1,1,2,0,0,1,2,2,0,0,2,2,2,0 },
+            { 0,0,0,1,0,0,1,1,0,1,1,2,1,1,2,2 }, { 0,1,1,1,0,0,1,1,2,0,0,1,2,2,0,0 },
+            { 0,0,0,0,1,1,2,2,1,1,2,2,1,1,2,2 }, { 0,0,2,2,0,0,2,2,0,0,2,2,1,1,1,1 },
+            { 0,1,1,1,0,1,1,1,0,2,2,2,0,2,2,2 }, { 0,0,0,1,0,0,0,1,2,2,2,1,2,2,2,1 },
+            { 0,0,0,0,0,0,1,1,0,1,2,2,0,1,2,2 }, { 0,0,0,0,1,1,0,0,2,2,1,0,2,2,1,0 },
+            { 0,1,2,2,0,1,2,2,0,0,1,1,0,0,0,0 }, { 0,0,1,2,0,0,1,2,1,1,2,2,2,2,2,2 },
+            { 0,1,1,0,1,2,2,1,1,2,2,1,0,1,1,0 }, { 0,0,0,0,0,1,1,0,1,2,2,1,1,2,2,1 },
+            { 0,0,2,2,1,1,0,2,1,1,0,2,0,0,2,2 }, { 0,1,1,0,0,1,1,0,2,0,0,2,2,2,2,2 },
+            { 0,0,1,1,0,1,2,2,0,1,2,2,0,0,1,1 }, { 0,0,0,0,2,0,0,0,2,2,1,1,2,2,2,1 },
+            { 0,0,0,0,0,0,0,2,1,1,2,2,1,2,2,2 }, { 0,2,2,2,0,0,2,2,0,0,1,2,0,0,1,1 },
+            { 0,0,1,1,0,0,1,2,0,0,2,2,0,2,2,2 }, { 0,1,2,0,0,1,2,0,0,1,2,0,0,1,2,0 },
+            { 0,0,0,0,1,1,1,1,2,2,2,2,0,0,0,0 }, { 0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0 },
+            { 0,1,2,0,2,0,1,2,1,2,0,1,0,1,2,0 }, { 0,0,1,1,2,2,0,0,1,1,2,2,0,0,1,1 },
+            { 0,0,1,1,1,1,2,2,2,2,0,0,0,0,1,1 }, { 0,1,0,1,0,1,0,1,2,2,2,2,2,2,2,2 },
+            { 0,0,0,0,0,0,0,0,2,1,2,1,2,1,2,1 }, { 0,0,2,2,1,1,2,2,0,0,2,2,1,1,2,2 },
+            { 0,0,2,2,0,0,1,1,0,0,2,2,0,0,1,1 }, { 0,2,2,0,1,2,2,1,0,2,2,0,1,2,2,1 },
+            { 0,1,0,1,2,2,2,2,2,2,2,2,0,1,0,1 }, { 0,0,0,0,2,1,2,1,2,1,2,1,2,1,2,1 },
+            { 0,1,0,1,0,1,0,1,0,1,0,1,2,2,2,2 }, { 0,2,2,2,0,1,1,1,0,2,2,2,0,1,1,1 },
+            { 0,0,0,2,1,1,1,2,0,0,0,2,1,1,1,2 }, { 0,0,0,0,2,1,1,2,2,1,1,2,2,1,1,2 },
+            { 0,2,2,2,0,1,1,1,0,1,1,1,0,2,2,2 }, { 0,0,0,2,1,1,1,2,1,1,1,2,0,0,0,2 },
+            { 0,1,1,0,0,1,1,0,0,1,1,0,2,2,2,2 }, { 0,0,0,0,0,0,0,0,2,1,1,2,2,1,1,2 },
+            { 0,1,1,0,0,1,1,0,2,2,2,2,2,2,2,2 }, { 0,0,2,2,0,0,1,1,0,0,1,1,0,0,2,2 },
+            { 0,0,2,2,1,1,2,2,1,1,2,2,0,0,2,2 }, { 0,0,0,0,0,0,0,0,0,0,0,0,2,1,1,2 },
+            { 0,0,0,2,0,0,0,1,0,0,0,2,0,0,0,1 }, { 0,2,2,2,1,2,2,2,0,2,2,2,1,2,2,2 },
+            { 0,1,0,1,2,2,2,2,2,2,2,2,2,2,2,2 }, { 0,1,1,1,2,0,1,1,2,2,0,1,2,2,2,0 },
+        };
+
+        // Texel index of the second subset's anchor, for 2 subset partitions.
+        static const uint8_t Bc7Anchors2[64] = {
+            15,15,15,15,15,15,15,15, 15,15,15,15,15,15,15,15,
+            15, 2, 8, 2, 2, 8, 8,15,  2, 8, 2, 2, 8, 8, 2, 2,
+            15,15, 6, 8, 2, 8,15,15,  2, 8, 2, 2, 2,15,15, 6,
+             6, 2, 6, 8,15,15, 2, 2, 15,15,15,15,15, 2, 2,15,
+        };
+
+        // Texel indices of the second and third subsets' anchors, for 3 subset partitions.
+        static const uint8_t Bc7Anchors3Second[64] = {
+             3, 3,15,15, 8, 3,15,15,  8, 8, 6, 6, 6, 5, 3, 3,
+             3, 3, 8,15, 3, 3, 6,10,  5, 8, 8, 6, 8, 5,15,15,
+             8,15, 3, 5, 6,10, 8,15, 15, 3,15, 5,15,15,15,15,
+             3,15, 5, 5, 5, 8, 5,10,  5,10, 8,13,15,12, 3, 3,
+        };
+
+        static const uint8_t Bc7Anchors3Third[64] = {
+            15, 8, 8, 3,15,15, 3, 8, 15,15,15,15,15,15,15, 8,
+            15, 8,15, 3,15, 8,15, 8,  3,15, 6,10,15,15,10, 8,
+            15, 3,15,10,10, 8, 9,10,  6,15, 8,15, 3, 6, 6, 8,
+            15, 3,15,15,15,15,15,15, 15,15,15,15, 3,15,15, 8,
+        };
+
+        static const uint32_t Bc7Weights2[4] = { 0, 21, 43, 64 };
+        static const uint32_t Bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+        static const uint32_t Bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        class BlockBitReader
+        {
+        public:
+            BlockBitReader(const uint8_t* pBlock, uint32_t startBit) : m_pBlock(pBlock), m_bit(startBit) { }
+
+            uint32_t read(uint32_t bitCount)
+            {
+                uint32_t value = 0u;
+                for (uint32_t i = 0u; i < bitCount; ++i, ++m_bit) {
+                    value |= ((m_pBlock[m_bit >> 3u] >> (m_bit & 7u)) & 1u) << i;
+                }
+                return value;
+            }
+
+        private:
+            const uint8_t* m_pBlock;
+            uint32_t m_bit;
+        };
+
+        static uint32_t Bc7Weight(uint32_t indexBits, uint32_t index)
+        {
+            return indexBits == 2u ? Bc7Weights2[index] : (indexBits == 3u ? Bc7Weights3[index] : Bc7Weights4[index]);
+        }
+
+        static uint8_t Bc7Interpolate(uint32_t e0, uint32_t e1, uint32_t weight)
+        {
+            return static_cast<uint8_t>(((64u - weight) * e0 + weight * e1 + 32u) >> 6u);
+        }
+
+        static uint32_t Bc7Unquantize(uint32_t value, uint32_t precision)
+        {
+            return (value << (8u - precision)) | (value >> (2u * precision - 8u));
+        }
+
+        static void DecodeBc7Block(const uint8_t* pBlock, uint8_t texelsOut[16][4])
+        {
+            uint32_t mode = 0u;
+            while (mode < 8u && (pBlock[0] & (1u << mode)) == 0u) {
+                ++mode;
+            }
+
+            if (mode == 8u) {
+                // Reserved, decodes to transparent black.
+                memset(texelsOut, 0, 16u * 4u);
+                return;
+            }
+
+            const Bc7ModeInfo& info = Bc7Modes[mode];
+            BlockBitReader reader(pBlock, mode + 1u);
+
+            uint32_t partition = reader.read(info.partitionBits);
+            uint32_t rotation = reader.read(info.rotationBits);
+            uint32_t indexSelection = reader.read(info.indexSelectionBits);
+
+            // [subset][endpoint][channel]
+            uint32_t endpoints[3][2][4] = {};
+            for (uint32_t channel = 0u; channel < 3u; ++channel) {
+                for (uint32_t subset = 0u; subset < info.subsetCount; ++subset) {
+                    endpoints[subset][0][channel] = reader.read(info.colorBits);
+                    endpoints[subset][1][channel] = reader.read(info.colorBits);
+                }
+            }
+
+            if (info.alphaBits > 0u) {
+                for (uint32_t subset = 0u; subset < info.subsetCount; ++subset) {
+                    endpoints[subset][0][3] = reader.read(info.alphaBits);
+                    endpoints[subset][1][3] = reader.read(info.alphaBits);
+                }
+            }
+
+            uint32_t pBits[3][2] = {};
+            bool hasPBits = info.endpointPBits != 0u || info.sharedPBits != 0u;
+            for (uint32_t subset = 0u; subset < info.subsetCount; ++subset) {
+                if (info.endpointPBits != 0u) {
+                    pBits[subset][0] = reader.read(1u);
+                    pBits[subset][1] = reader.read(1u);
+                } else if (info.sharedPBits != 0u) {
+                    pBits[subset][0] = pBits[subset][1] = reader.read(1u);
+                }
+            }
+
+            for (uint32_t subset = 0u; subset < info.subsetCount; ++subset) {
+                for (uint32_t endpoint = 0u; endpoint < 2u; ++endpoint) {
+                    uint32_t* pEndpoint = endpoints[subset][endpoint];
+                    for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                        uint32_t precision = channel < 3u ? info.colorBits : info.alphaBits;
+                        if (precision == 0u) {
+                            pEndpoint[channel] = 255u;
+                            continue;
+                        }
+                        if (hasPBits) {
+                            pEndpoint[channel] = (pEndpoint[channel] << 1u) | pBits[subset][endpoint];
+                            ++precision;
+                        }
+                        pEndpoint[channel] = Bc7Unquantize(pEndpoint[channel], precision);
+                    }
+                }
+            }
+
+            const uint8_t* pPartition = nullptr;
+            if (info.subsetCount == 2u) {
+                pPartition = Bc7Partitions2[partition];
+            } else if (info.subsetCount == 3u) {
+                pPartition = Bc7Partitions3[partition];
+            }
+
+            auto isAnchor = [&](uint32_t texel) {
+                if (texel == 0u) {
+                    return true;
+                }
+                if (info.subsetCount == 2u) {
+                    return texel == Bc7Anchors2[partition];
+                }
+                if (info.subsetCount == 3u) {
+                    return texel == Bc7Anchors3Second[partition] || texel == Bc7Anchors3Third[partition];
+                }
+                return false;
+            };
+
+            // Anchor texels drop the most significant bit of their index, which is always zero.
+            uint32_t indices[16];
+            for (uint32_t texel = 0u; texel < 16u; ++texel) {
+                indices[texel] = reader.read(isAnchor(texel) ? info.indexBits - 1u : info.indexBits);
+            }
+
+            uint32_t secondaryIndices[16] = {};
+            if (info.secondaryIndexBits > 0u) {
+                for (uint32_t texel = 0u; texel < 16u; ++texel) {
+                    secondaryIndices[texel] = reader.read(texel == 0u ? info.secondaryIndexBits - 1u : info.secondaryIndexBits);
+                }
+            }
+
+            for (uint32_t texel = 0u; texel < 16u; ++texel) {
+                uint32_t subset = pPartition != nullptr ? pPartition[texel] : 0u;
+                const uint32_t* pEndpoint0 = endpoints[subset][0];
+                const uint32_t* pEndpoint1 = endpoints[subset][1];
+
+                uint32_t colorWeight = 0u;
+                uint32_t alphaWeight = 0u;
+                if (info.secondaryIndexBits == 0u) {
+                    colorWeight = alphaWeight = Bc7Weight(info.indexBits, indices[texel]);
+                } else if (indexSelection == 0u) {
+                    colorWeight = Bc7Weight(info.indexBits, indices[texel]);
+                    alphaWeight = Bc7Weight(info.secondaryIndexBits, secondaryIndices[texel]);
+                } else {
+                    colorWeight = Bc7Weight(info.secondaryIndexBits, secondaryIndices[texel]);
+                    alphaWeight = Bc7Weight(info.indexBits, indices[texel]);
+                }
+
+                uint8_t* pTexel = texelsOut[texel];
+                for (uint32_t channel = 0u; channel < 3u; ++channel) {
+                    pTexel[channel] = Bc7Interpolate(pEndpoint0[channel], pEndpoint1[channel], colorWeight);
+                }
+                pTexel[3] = Bc7Interpolate(pEndpoint0[3], pEndpoint1[3], alphaWeight);
+
+                if (rotation != 0u) {
+                    std::swap(pTexel[3], pTexel[rotation - 1u]);
+                }
+            }
+        }
+
+        bool DecodeBlock(VkFormat format, const uint8_t* pBlock, uint8_t texelsOut[16][4])
+        {
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                DecodeBc1Block(pBlock, false, texelsOut);
+                // The RGB variants ignore the 1 bit alpha.
+                for (uint32_t i = 0u; i < 16u; ++i) {
+                    texelsOut[i][3] = 255u;
+                }
+                return true;
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                DecodeBc1Block(pBlock, false, texelsOut);
+                return true;
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+                DecodeBc1Block(pBlock + 8u, true, texelsOut);
+                DecodeBc2Alpha(pBlock, texelsOut);
+                return true;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                DecodeBc1Block(pBlock + 8u, true, texelsOut);
+                DecodeBc4Block(pBlock, false, texelsOut, 3u);
+                return true;
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK: {
+                bool isSigned = format == VK_FORMAT_BC4_SNORM_BLOCK;
+                DecodeBc4Block(pBlock, isSigned, texelsOut, 0u);
+                for (uint32_t i = 0u; i < 16u; ++i) {
+                    texelsOut[i][1] = 0u;
+                    texelsOut[i][2] = 0u;
+                    texelsOut[i][3] = isSigned ? 127u : 255u;
+                }
+                return true;
+            }
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK: {
+                bool isSigned = format == VK_FORMAT_BC5_SNORM_BLOCK;
+                DecodeBc4Block(pBlock, isSigned, texelsOut, 0u);
+                DecodeBc4Block(pBlock + 8u, isSigned, texelsOut, 1u);
+                for (uint32_t i = 0u; i < 16u; ++i) {
+                    texelsOut[i][2] = 0u;
+                    texelsOut[i][3] = isSigned ? 127u : 255u;
+                }
+                return true;
+            }
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                DecodeBc7Block(pBlock, texelsOut);
+                return true;
+            default:
+                return false;
+            }
+        }
+
+
+        static uint32_t GetBlockSizeBytes(VkFormat format)
+        {
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+                return 8u;
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return 16u;
+            default:
+                return 0u;
+            }
+        }
+
+        bool DecodeImage(
+            VkFormat format,
+            const uint8_t* pBlocks,
+            uint32_t width,
+            uint32_t height,
+            uint8_t* pRgba8Out)
+        {
+            uint32_t blockSizeBytes = GetBlockSizeBytes(format);
+            if (blockSizeBytes == 0u) {
+                return false;
+            }
+
+            uint32_t blocksX = (width + 3u) / 4u;
+            uint32_t blocksY = (height + 3u) / 4u;
+            const uint8_t* pBlock = pBlocks;
+            uint8_t texels[16][4];
+            for (uint32_t blockY = 0u; blockY < blocksY; ++blockY) {
+                for (uint32_t blockX = 0u; blockX < blocksX; ++blockX, pBlock += blockSizeBytes) {
+                    DecodeBlock(format, pBlock, texels);
+
+                    // Blocks on the right and bottom edges may extend past the image.
+                    for (uint32_t y = 0u; y < 4u && blockY * 4u + y < height; ++y) {
+                        for (uint32_t x = 0u; x < 4u && blockX * 4u + x < width; ++x) {
+                            size_t texelOffset = (static_cast<size_t>(blockY * 4u + y) * width + blockX * 4u + x) * 4u;
+                            memcpy(pRgba8Out + texelOffset, texels[y * 4u + x], 4u);
+                        }
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // Block encoders.
+
+        class BlockBitWriter
+        {
+        public:
+            BlockBitWriter(uint8_t* pBlock) : m_pBlock(pBlock) { }
+
+            void write(uint32_t value, uint32_t bitCount)
+            {
+                for (uint32_t i = 0u; i < bitCount; ++i, ++m_bit) {
+                    m_pBlock[m_bit >> 3u] |= static_cast<uint8_t>(((value >> i) & 1u) << (m_bit & 7u));
+                }
+            }
+
+        private:
+            uint8_t* m_pBlock;
+            uint32_t m_bit = 0u;
+        };
+
+        static void ComputeMean(const float (*pTexels)[4], uint32_t count, uint32_t channelCount, float* pMeanOut)
+        {
+            for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                float sum = 0.0f;
+                for (uint32_t i = 0u; i < count; ++i) {
+                    sum += pTexels[i][channel];
+                }
+                pMeanOut[channel] = sum / static_cast<float>(count);
+            }
+        }
+
+        // Principal axis of the texels, by power iteration on their covariance matrix.
+        static void ComputePrincipalAxis(
+            const float (*pTexels)[4],
+            uint32_t count,
+            uint32_t channelCount,
+            const float* pMean,
+            float* pAxisOut)
+        {
+            float covariance[4][4] = {};
+            for (uint32_t i = 0u; i < count; ++i) {
+                for (uint32_t row = 0u; row < channelCount; ++row) {
+                    for (uint32_t col = 0u; col < channelCount; ++col) {
+                        covariance[row][col] += (pTexels[i][row] - pMean[row]) * (pTexels[i][col] - pMean[col]);
+                    }
+                }
+            }
+
+            float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+            for (uint32_t iteration = 0u; iteration < 8u; ++iteration) {
+                float next[4] = {};
+                float maxComponent = 0.0f;
+                for (uint32_t row = 0u; row < channelCount; ++row) {
+                    for (uint32_t col = 0u; col < channelCount; ++col) {
+                        next[row] += covariance[row][col] * axis[col];
+                    }
+                    maxComponent = std::max(maxComponent, std::fabs(next[row]));
+                }
+
+                if (maxComponent == 0.0f) {
+                    // All of the texels are the same.
+                    break;
+                }
+
+                for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                    axis[channel] = next[channel] / maxComponent;
+                }
+            }
+
+            float lengthSquared = 0.0f;
+            for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                lengthSquared += axis[channel] * axis[channel];
+            }
+            float invLength = lengthSquared > 0.0f ? 1.0f / std::sqrt(lengthSquared) : 0.0f;
+            for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                pAxisOut[channel] = axis[channel] * invLength;
+            }
+        }
+
+        // Endpoints at the extents of the texels' projections onto their principal axis.
+        static void ComputeInitialEndpoints(
+            const float (*pTexels)[4],
+            uint32_t count,
+            uint32_t channelCount,
+            float* pEndpoint0Out,
+            float* pEndpoint1Out)
+        {
+            float mean[4] = {};
+            float axis[4] = {};
+            ComputeMean(pTexels, count, channelCount, mean);
+            ComputePrincipalAxis(pTexels, count, channelCount, mean, axis);
+
+            float minProjection = 0.0f;
+            float maxProjection = 0.0f;
+            for (uint32_t i = 0u; i < count; ++i) {
+                float projection = 0.0f;
+                for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                    projection += (pTexels[i][channel] - mean[channel]) * axis[channel];
+                }
+                minProjection = std::min(minProjection, projection);
+                maxProjection = std::max(maxProjection, projection);
+            }
+
+            for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                pEndpoint0Out[channel] = std::clamp(mean[channel] + axis[channel] * minProjection, 0.0f, 255.0f);
+                pEndpoint1Out[channel] = std::clamp(mean[channel] + axis[channel] * maxProjection, 0.0f, 255.0f);
+            }
+        }
+
+        // Least squares endpoints for texels that are interpolated with fixed weights, i.e.
+        // texel = (1 - weight) * endpoint0 + weight * endpoint1. Returns false if the weights
+        // don't determine the endpoints.
+        static bool FitEndpoints(
+            const float (*pTexels)[4],
+            const float* pWeights,
+            uint32_t count,
+            uint32_t channelCount,
+            float* pEndpoint0Out,
+            float* pEndpoint1Out)
+        {
+            float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+            float ax[4] = {}, bx[4] = {};
+            for (uint32_t i = 0u; i < count; ++i) {
+                float a = 1.0f - pWeights[i];
+                float b = pWeights[i];
+                aa += a * a;
+                ab += a * b;
+                bb += b * b;
+                for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                    ax[channel] += a * pTexels[i][channel];
+                    bx[channel] += b * pTexels[i][channel];
+                }
+            }
+
+            float determinant = aa * bb - ab * ab;
+            if (std::fabs(determinant) < 1e-6f) {
+                return false;
+            }
+
+            for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                pEndpoint0Out[channel] = std::clamp((ax[channel] * bb - bx[channel] * ab) / determinant, 0.0f, 255.0f);
+                pEndpoint1Out[channel] = std::clamp((bx[channel] * aa - ax[channel] * ab) / determinant, 0.0f, 255.0f);
+            }
+
+            return true;
+        }
+
+        static uint16_t QuantizeRgb565(const float* pRgb)
+        {
+            uint32_t r = static_cast<uint32_t>(std::lround(pRgb[0] * (31.0f / 255.0f)));
+            uint32_t g = static_cast<uint32_t>(std::lround(pRgb[1] * (63.0f / 255.0f)));
+            uint32_t b = static_cast<uint32_t>(std::lround(pRgb[2] * (31.0f / 255.0f)));
+            return static_cast<uint16_t>((r << 11u) | (g << 5u) | b);
+        }
+
+        struct Bc1Candidate
+        {
+            uint16_t color0 = 0u;
+            uint16_t color1 = 0u;
+            uint32_t indices = 0u;
+            float error = 0.0f;
+        };
+
+        // Picks the nearest palette entry for each texel using the palette the decoder will build.
+        static void EvaluateBc1Candidate(
+            const float (*pTexels)[4],
+            const bool* pIsTransparent,
+            Bc1Candidate* pCandidate)
+        {
+            uint8_t block[8] = {};
+            memcpy(block, &pCandidate->color0, 2u);
+            memcpy(block + 2u, &pCandidate->color1, 2u);
+            // Decode a block with indices 0, 1, 2 and 3 in its first texels to get the palette.
+            uint32_t paletteIndices = 0xE4u;
+            memcpy(block + 4u, &paletteIndices, 4u);
+            uint8_t palette[16][4];
+            DecodeBc1Block(block, false, palette);
+            bool isFourColorMode = pCandidate->color0 > pCandidate->color1;
+
+            pCandidate->indices = 0u;
+            pCandidate->error = 0.0f;
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                uint32_t bestIndex = 3u;
+                if (!pIsTransparent[i]) {
+                    float bestError = FLT_MAX;
+                    for (uint32_t index = 0u; index < (isFourColorMode ? 4u : 3u); ++index) {
+                        float error = 0.0f;
+                        for (uint32_t channel = 0u; channel < 3u; ++channel) {
+                            float diff = pTexels[i][channel] - palette[index][channel];
+                            error += diff * diff;
+                        }
+                        if (error < bestError) {
+                            bestError = error;
+                            bestIndex = index;
+                        }
+                    }
+                    pCandidate->error += bestError;
+                }
+                pCandidate->indices |= bestIndex << (2u * i);
+            }
+        }
+
+        void EncodeBc1Block(const uint8_t texels[16][4], uint8_t* pBlockOut)
+        {
+            float colors[16][4];
+            float opaqueColors[16][4];
+            bool isTransparent[16];
+            uint32_t opaqueCount = 0u;
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                    colors[i][channel] = texels[i][channel];
+                }
+                isTransparent[i] = texels[i][3] < 128u;
+                if (!isTransparent[i]) {
+                    memcpy(opaqueColors[opaqueCount++], colors[i], sizeof(colors[i]));
+                }
+            }
+
+            // Transparent texels require the 3 color mode, i.e. color0 <= color1.
+            bool hasTransparentTexels = opaqueCount < 16u;
+
+            Bc1Candidate best;
+            if (opaqueCount == 0u) {
+                best.indices = 0xFFFFFFFFu;
+            } else {
+                float endpoint0[4], endpoint1[4];
+                ComputeInitialEndpoints(opaqueColors, opaqueCount, 3u, endpoint0, endpoint1);
+
+                best.error = FLT_MAX;
+                for (uint32_t iteration = 0u; iteration < 3u; ++iteration) {
+                    Bc1Candidate candidate;
+                    candidate.color0 = QuantizeRgb565(endpoint1);
+                    candidate.color1 = QuantizeRgb565(endpoint0);
+                    if ((candidate.color0 < candidate.color1) != hasTransparentTexels
+                        && candidate.color0 != candidate.color1) {
+                        std::swap(candidate.color0, candidate.color1);
+                    }
+
+                    EvaluateBc1Candidate(colors, isTransparent, &candidate);
+                    if (candidate.error < best.error) {
+                        best = candidate;
+                    }
+
+                    // Refit the endpoints to the chosen indices.
+                    bool isFourColorMode = candidate.color0 > candidate.color1;
+                    float weights[16];
+                    uint32_t weightCount = 0u;
+                    for (uint32_t i = 0u; i < 16u; ++i) {
+                        if (isTransparent[i]) {
+                            continue;
+                        }
+                        uint32_t index = (candidate.indices >> (2u * i)) & 0x3u;
+                        static const float FourColorWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+                        static const float ThreeColorWeights[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+                        weights[weightCount++] = isFourColorMode ? FourColorWeights[index] : ThreeColorWeights[index];
+                    }
+
+                    float fitColor0[4], fitColor1[4];
+                    if (!FitEndpoints(opaqueColors, weights, opaqueCount, 3u, fitColor0, fitColor1)) {
+                        break;
+                    }
+                    // The next candidate's color0 is quantized from endpoint1.
+                    memcpy(endpoint1, fitColor0, sizeof(fitColor0));
+                    memcpy(endpoint0, fitColor1, sizeof(fitColor1));
+                }
+            }
+
+            memcpy(pBlockOut, &best.color0, 2u);
+            memcpy(pBlockOut + 2u, &best.color1, 2u);
+            memcpy(pBlockOut + 4u, &best.indices, 4u);
+        }
+
+        struct Bc7Mode6Candidate
+        {
+            uint32_t endpoints[2][4] = {};
+            uint32_t pBits[2] = {};
+            uint32_t indices[16] = {};
+            float error = 0.0f;
+        };
+
+        // Quantizes an endpoint to 7 bits per channel plus a p-bit, which is shared by the channels.
+        static void QuantizeBc7Mode6Endpoint(const float* pEndpoint, uint32_t* pQuantizedOut, uint32_t* pPBitOut)
+        {
+            float bestError = FLT_MAX;
+            for (uint32_t pBit = 0u; pBit < 2u; ++pBit) {
+                uint32_t quantized[4];
+                float error = 0.0f;
+                for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                    long value = std::lround((pEndpoint[channel] - static_cast<float>(pBit)) * 0.5f);
+                    quantized[channel] = static_cast<uint32_t>(std::clamp(value, 0l, 127l));
+                    float diff = static_cast<float>((quantized[channel] << 1u) | pBit) - pEndpoint[channel];
+                    error += diff * diff;
+                }
+                if (error < bestError) {
+                    bestError = error;
+                    memcpy(pQuantizedOut, quantized, sizeof(quantized));
+                    *pPBitOut = pBit;
+                }
+            }
+        }
+
+        static void EvaluateBc7Mode6Candidate(const float (*pTexels)[4], Bc7Mode6Candidate* pCandidate)
+        {
+            uint32_t endpoint0[4], endpoint1[4];
+            for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                endpoint0[channel] = (pCandidate->endpoints[0][channel] << 1u) | pCandidate->pBits[0];
+                endpoint1[channel] = (pCandidate->endpoints[1][channel] << 1u) | pCandidate->pBits[1];
+            }
+
+            uint8_t palette[16][4];
+            for (uint32_t index = 0u; index < 16u; ++index) {
+                for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                    palette[index][channel] = Bc7Interpolate(endpoint0[channel], endpoint1[channel], Bc7Weights4[index]);
+                }
+            }
+
+            pCandidate->error = 0.0f;
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                float bestError = FLT_MAX;
+                for (uint32_t index = 0u; index < 16u; ++index) {
+                    float error = 0.0f;
+                    for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                        float diff = pTexels[i][channel] - palette[index][channel];
+                        error += diff * diff;
+                    }
+                    if (error < bestError) {
+                        bestError = error;
+                        pCandidate->indices[i] = index;
+                    }
+                }
+                pCandidate->error += bestError;
+            }
+        }
+
+        void EncodeBc7Block(const uint8_t texels[16][4], uint8_t* pBlockOut)
+        {
+            float colors[16][4];
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                    colors[i][channel] = texels[i][channel];
+                }
+            }
+
+            float endpoints[2][4];
+            ComputeInitialEndpoints(colors, 16u, 4u, endpoints[0], endpoints[1]);
+
+            Bc7Mode6Candidate best;
+            best.error = FLT_MAX;
+            for (uint32_t iteration = 0u; iteration < 3u; ++iteration) {
+                Bc7Mode6Candidate candidate;
+                QuantizeBc7Mode6Endpoint(endpoints[0], candidate.endpoints[0], &candidate.pBits[0]);
+                QuantizeBc7Mode6Endpoint(endpoints[1], candidate.endpoints[1], &candidate.pBits[1]);
+                EvaluateBc7Mode6Candidate(colors, &candidate);
+                if (candidate.error < best.error) {
+                    best = candidate;
+                }
+
+                // Refit the endpoints to the chosen indices.
+                float weights[16];
+                for (uint32_t i = 0u; i < 16u; ++i) {
+                    weights[i] = static_cast<float>(Bc7Weights4[candidate.indices[i]]) / 64.0f;
+                }
+                if (!FitEndpoints(colors, weights, 16u, 4u, endpoints[0], endpoints[1])) {
+                    break;
+                }
+            }
+
+            // The most significant bit of the anchor texel's index is implicitly zero, the weights
+            // are symmetric so swapping the endpoints and inverting the indices is lossless.
+            if (best.indices[0] >= 8u) {
+                std::swap(best.endpoints[0], best.endpoints[1]);
+                std::swap(best.pBits[0], best.pBits[1]);
+                for (uint32_t i = 0u; i < 16u; ++i) {
+                    best.indices[i] = 15u - best.indices[i];
+                }
+            }
+
+            memset(pBlockOut, 0, 16u);
+            BlockBitWriter writer(pBlockOut);
+            writer.write(1u << 6u, 7u);
+            for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                writer.write(best.endpoints[0][channel], 7u);
+                writer.write(best.endpoints[1][channel], 7u);
+            }
+            writer.write(best.pBits[0], 1u);
+            writer.write(best.pBits[1], 1u);
+            for (uint32_t i = 0u; i < 16u; ++i) {
+                writer.write(best.indices[i], i == 0u ? 3u : 4u);
+            }
+        }
+
+        // Gathers a 4x4 block of texels, replicating the last row and column at the edges.
+        static void LoadBlock(
+            const uint8_t* pRgba8,
+            uint32_t width,
+            uint32_t height,
+            uint32_t blockX,
+            uint32_t blockY,
+            uint8_t texelsOut[16][4])
+        {
+            for (uint32_t y = 0u; y < 4u; ++y) {
+                uint32_t srcY = std::min(blockY * 4u + y, height - 1u);
+                for (uint32_t x = 0u; x < 4u; ++x) {
+                    uint32_t srcX = std::min(blockX * 4u + x, width - 1u);
+                    memcpy(texelsOut[y * 4u + x], pRgba8 + (static_cast<size_t>(srcY) * width + srcX) * 4u, 4u);
+                }
+            }
+        }
+
+        bool EncodeImage(
+            VkFormat format,
+            const uint8_t* pRgba8,
+            uint32_t width,
+            uint32_t height,
+            uint32_t threadCount,
+            std::vector<uint8_t>* pBlocksOut)
+        {
+            void (*pEncodeBlockFunc)(const uint8_t[16][4], uint8_t*) = nullptr;
+            bool isOpaque = false;
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                isOpaque = true;
+                pEncodeBlockFunc = EncodeBc1Block;
+                break;
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                pEncodeBlockFunc = EncodeBc1Block;
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                pEncodeBlockFunc = EncodeBc7Block;
+                break;
+            default:
+                return false;
+            }
+
+            uint32_t blockSizeBytes = GetBlockSizeBytes(format);
+            uint32_t blocksX = (width + 3u) / 4u;
+            uint32_t blocksY = (height + 3u) / 4u;
+            pBlocksOut->resize(static_cast<size_t>(blocksX) * blocksY * blockSizeBytes);
+
+            if (threadCount == 0u) {
+                threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+            }
+            threadCount = std::min(threadCount, blocksY);
+
+            // Each thread takes the next row of blocks until all of them have been encoded.
+            std::atomic<uint32_t> nextBlockY(0u);
+            uint8_t* pBlocks = pBlocksOut->data();
+            auto encodeRows = [&]() {
+                uint8_t texels[16][4];
+                for (uint32_t blockY = nextBlockY++; blockY < blocksY; blockY = nextBlockY++) {
+                    for (uint32_t blockX = 0u; blockX < blocksX; ++blockX) {
+                        LoadBlock(pRgba8, width, height, blockX, blockY, texels);
+                        if (isOpaque) {
+                            for (uint32_t i = 0u; i < 16u; ++i) {
+                                texels[i][3] = 255u;
+                            }
+                        }
+                        pEncodeBlockFunc(
+                            texels,
+                            pBlocks + (static_cast<size_t>(blockY) * blocksX + blockX) * blockSizeBytes);
+                    }
+                }
+            };
+
+            std::vector<std::thread> workers;
+            for (uint32_t i = 1u; i < threadCount; ++i) {
+                workers.emplace_back(encodeRows);
+            }
+            encodeRows();
+            for (auto& worker : workers) {
+                worker.join();
+            }
+
+            return true;
+        }
+
+        // Mip chain generation.
+
+        // Modified Bessel function of the first kind, order zero.
+        static double BesselI0(double x)
+        {
+            double sum = 1.0;
+            double term = 1.0;
+            for (uint32_t k = 1u; term > sum * 1e-12; ++k) {
+                double factor = x / (2.0 * k);
+                term *= factor * factor;
+                sum += term;
+            }
+            return sum;
+        }
+
+        struct FilterTap
+        {
+            uint32_t srcIndex;
+            float weight;
+        };
+
+        // Source texels, and their weights, that contribute to each destination texel when
+        // halving a dimension. The exact scale is used so that the last texel of an odd
+        // dimension still contributes.
+        static std::vector<std::vector<FilterTap>> CreateFilterTaps(
+            MipFilter filter,
+            uint32_t srcSize,
+            uint32_t dstSize)
+        {
+            // Kaiser windowed sinc, 3 destination texels wide on either side, with alpha 4.
+            const double KaiserWidth = 3.0;
+            const double KaiserAlpha = 4.0;
+            const double Pi = 3.14159265358979323846;
+
+            double scale = static_cast<double>(srcSize) / static_cast<double>(dstSize);
+            std::vector<std::vector<FilterTap>> filterTaps(dstSize);
+            for (uint32_t dstIndex = 0u; dstIndex < dstSize; ++dstIndex) {
+                auto& taps = filterTaps[dstIndex];
+                double weightSum = 0.0;
+                std::vector<double> weights;
+                if (filter == MipFilter::Box) {
+                    // Area of each source texel that is covered by the destination texel.
+                    double lo = dstIndex * scale;
+                    double hi = (dstIndex + 1u) * scale;
+                    for (int64_t srcIndex = static_cast<int64_t>(lo); static_cast<double>(srcIndex) < hi; ++srcIndex) {
+                        double weight = std::min(hi, static_cast<double>(srcIndex + 1)) - std::max(lo, static_cast<double>(srcIndex));
+                        if (weight > 0.0) {
+                            taps.push_back({ static_cast<uint32_t>(srcIndex), 0.0f });
+                            weights.push_back(weight);
+                            weightSum += weight;
+                        }
+                    }
+                } else {
+                    double center = (dstIndex + 0.5) * scale;
+                    double radius = KaiserWidth * scale;
+                    int64_t first = static_cast<int64_t>(std::floor(center - radius));
+                    int64_t last = static_cast<int64_t>(std::ceil(center + radius));
+                    for (int64_t srcIndex = first; srcIndex <= last; ++srcIndex) {
+                        // Distance from the destination texel's center, in destination texels.
+                        double t = (static_cast<double>(srcIndex) + 0.5 - center) / scale;
+                        if (std::fabs(t) >= KaiserWidth) {
+                            continue;
+                        }
+                        double sinc = t == 0.0 ? 1.0 : std::sin(Pi * t) / (Pi * t);
+                        double window =
+                            BesselI0(KaiserAlpha * std::sqrt(1.0 - (t / KaiserWidth) * (t / KaiserWidth)))
+                            / BesselI0(KaiserAlpha);
+                        // Clamp at the edges.
+                        int64_t clampedIndex = std::clamp(srcIndex, int64_t(0), static_cast<int64_t>(srcSize) - 1);
+                        taps.push_back({ static_cast<uint32_t>(clampedIndex), 0.0f });
+                        weights.push_back(sinc * window);
+                        weightSum += sinc * window;
+                    }
+                }
+
+                for (size_t i = 0u; i < taps.size(); ++i) {
+                    taps[i].weight = static_cast<float>(weights[i] / weightSum);
+                }
+            }
+
+            return filterTaps;
+        }
+
+        // Halves the width of a float RGBA image.
+        static void ReduceWidth(
+            const std::vector<float>& src,
+            uint32_t srcWidth,
+            uint32_t height,
+            MipFilter filter,
+            std::vector<float>* pDst)
+        {
+            uint32_t dstWidth = std::max(srcWidth / 2u, 1u);
+            auto filterTaps = CreateFilterTaps(filter, srcWidth, dstWidth);
+            pDst->assign(static_cast<size_t>(dstWidth) * height * 4u, 0.0f);
+            for (uint32_t y = 0u; y < height; ++y) {
+                const float* pSrcRow = src.data() + static_cast<size_t>(y) * srcWidth * 4u;
+                float* pDstRow = pDst->data() + static_cast<size_t>(y) * dstWidth * 4u;
+                for (uint32_t x = 0u; x < dstWidth; ++x) {
+                    float* pDstTexel = pDstRow + x * 4u;
+                    for (const auto& tap : filterTaps[x]) {
+                        const float* pSrcTexel = pSrcRow + tap.srcIndex * 4u;
+                        for (uint32_t channel = 0u; channel < 4u; ++channel) {
+                            pDstTexel[channel] += tap.weight * pSrcTexel[channel];
+                        }
+                    }
+                }
+            }
+        }
+
+        // Halves the height of a float RGBA image. Whole rows are accumulated at a time so that
+        // the inner loop vectorizes.
+        static void ReduceHeight(
+            const std::vector<float>& src,
+            uint32_t width,
+            uint32_t srcHeight,
+            MipFilter filter,
+            std::vector<float>* pDst)
+        {
+            uint32_t dstHeight = std::max(srcHeight / 2u, 1u);
+            auto filterTaps = CreateFilterTaps(filter, srcHeight, dstHeight);
+            size_t rowSize = static_cast<size_t>(width) * 4u;
+            pDst->assign(rowSize * dstHeight, 0.0f);
+            for (uint32_t y = 0u; y < dstHeight; ++y) {
+                float* pDstRow = pDst->data() + y * rowSize;
+                for (const auto& tap : filterTaps[y]) {
+                    const float* pSrcRow = src.data() + tap.srcIndex * rowSize;
+                    for (size_t i = 0u; i < rowSize; ++i) {
+                        pDstRow[i] += tap.weight * pSrcRow[i];
+                    }
+                }
+            }
+        }
+
+        std::vector<MipLevel> GenerateMipChain(
+            const uint8_t* pRgba8,
+            uint32_t width,
+            uint32_t height,
+            MipFilter filter,
+            bool isSrgb)
+        {
+            std::vector<MipLevel> levels(1);
+            levels[0].width = width;
+            levels[0].height = height;
+            levels[0].pixels.assign(pRgba8, pRgba8 + static_cast<size_t>(width) * height * 4u);
+
+            // A box filter of a power of two image averages 2x2 blocks, so each level is reduced
+            // from the previous one without converting to float.
+            bool isPowerOfTwo = (width & (width - 1u)) == 0u && (height & (height - 1u)) == 0u;
+            if (filter == MipFilter::Box && !isSrgb && isPowerOfTwo) {
+                while (width > 1u || height > 1u) {
+                    MipLevel level;
+                    level.width = std::max(width / 2u, 1u);
+                    level.height = std::max(height / 2u, 1u);
+                    level.pixels.resize(static_cast<size_t>(level.width) * level.height * 4u);
+                    ImageKernels::Reduce2x2(levels.back().pixels.data(), width, height, level.pixels.data());
+                    width = level.width;
+                    height = level.height;
+                    levels.emplace_back(std::move(level));
+                }
+                return levels;
+            }
+
+            // Alpha is always linear.
+            std::vector<float> current(levels[0].pixels.size());
+            ImageKernels::ConvertRgba8ToFloat(pRgba8, static_cast<size_t>(width) * height, isSrgb, current.data());
+
+            std::vector<float> reduced;
+            while (width > 1u || height > 1u) {
+                if (width > 1u) {
+                    ReduceWidth(current, width, height, filter, &reduced);
+                    current.swap(reduced);
+                    width /= 2u;
+                }
+                if (height > 1u) {
+                    ReduceHeight(current, width, height, filter, &reduced);
+                    current.swap(reduced);
+                    height /= 2u;
+                }
+
+                MipLevel level;
+                level.width = width;
+                level.height = height;
+                level.pixels.resize(current.size());
+                // The Kaiser filter's negative lobes can overshoot, the next level is filtered from
+                // the clamped values.
+                for (size_t i = 0u; i < current.size(); ++i) {
+                    current[i] = std::clamp(current[i], 0.0f, 1.0f);
+                }
+                ImageKernels::ConvertFloatToRgba8(
+                    current.data(), static_cast<size_t>(width) * height, isSrgb, level.pixels.data());
+                levels.emplace_back(std::move(level));
+            }
+
+            return levels;
+        }
+
+        double ComputePsnr(
+            const uint8_t* pRgba8,
+            const uint8_t* pReferenceRgba8,
+            size_t pixelCount,
+            bool includeAlpha)
+        {
+            uint32_t channelCount = includeAlpha ? 4u : 3u;
+            double squaredErrorSum = 0.0;
+            for (size_t i = 0u; i < pixelCount; ++i) {
+                for (uint32_t channel = 0u; channel < channelCount; ++channel) {
+                    double diff = static_cast<double>(pRgba8[i * 4u + channel]) - pReferenceRgba8[i * 4u + channel];
+                    squaredErrorSum += diff * diff;
+                }
+            }
+
+            if (squaredErrorSum == 0.0) {
+                return std::numeric_limits<double>::infinity();
+            }
+
+            double meanSquaredError = squaredErrorSum / (static_cast<double>(pixelCount) * channelCount);
+            return 10.0 * std::log10((255.0 * 255.0) / meanSquaredError);
+        }
+    }
+}
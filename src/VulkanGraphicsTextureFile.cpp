@@ -0,0 +1,623 @@
+#include "VulkanGraphicsTextureFile.h"
+
+#include "VulkanGraphicsImageKernels.h"
+#include "VulkanGraphicsTextureCodec.h"
+
+#include <stb_image.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace vgfx
+{
+    namespace TextureFile
+    {
+        struct FormatBlockInfo
+        {
+            VkFormat format;
+            uint32_t blockWidth;
+            uint32_t blockHeight;
+            uint32_t blockSizeBytes;
+        };
+
+        static const FormatBlockInfo FormatBlockInfos[] = {
+            { VK_FORMAT_R8G8B8A8_UNORM, 1u, 1u, 4u },
+            { VK_FORMAT_R8G8B8A8_SRGB, 1u, 1u, 4u },
+            { VK_FORMAT_R8G8B8A8_SNORM, 1u, 1u, 4u },
+            { VK_FORMAT_BC1_RGB_UNORM_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC1_RGB_SRGB_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC1_RGBA_UNORM_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC2_UNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC2_SRGB_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC3_UNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC3_SRGB_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC4_UNORM_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC4_SNORM_BLOCK, 4u, 4u, 8u },
+            { VK_FORMAT_BC5_UNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC5_SNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC7_UNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_BC7_SRGB_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_ASTC_4x4_UNORM_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_ASTC_4x4_SRGB_BLOCK, 4u, 4u, 16u },
+            { VK_FORMAT_ASTC_5x4_UNORM_BLOCK, 5u, 4u, 16u },
+            { VK_FORMAT_ASTC_5x4_SRGB_BLOCK, 5u, 4u, 16u },
+            { VK_FORMAT_ASTC_5x5_UNORM_BLOCK, 5u, 5u, 16u },
+            { VK_FORMAT_ASTC_5x5_SRGB_BLOCK, 5u, 5u, 16u },
+            { VK_FORMAT_ASTC_6x5_UNORM_BLOCK, 6u, 5u, 16u },
+            { VK_FORMAT_ASTC_6x5_SRGB_BLOCK, 6u, 5u, 16u },
+            { VK_FORMAT_ASTC_6x6_UNORM_BLOCK, 6u, 6u, 16u },
+            { VK_FORMAT_ASTC_6x6_SRGB_BLOCK, 6u, 6u, 16u },
+            { VK_FORMAT_ASTC_8x5_UNORM_BLOCK, 8u, 5u, 16u },
+            { VK_FORMAT_ASTC_8x5_SRGB_BLOCK, 8u, 5u, 16u },
+            { VK_FORMAT_ASTC_8x6_UNORM_BLOCK, 8u, 6u, 16u },
+            { VK_FORMAT_ASTC_8x6_SRGB_BLOCK, 8u, 6u, 16u },
+            { VK_FORMAT_ASTC_8x8_UNORM_BLOCK, 8u, 8u, 16u },
+            { VK_FORMAT_ASTC_8x8_SRGB_BLOCK, 8u, 8u, 16u },
+            { VK_FORMAT_ASTC_10x5_UNORM_BLOCK, 10u, 5u, 16u },
+            { VK_FORMAT_ASTC_10x5_SRGB_BLOCK, 10u, 5u, 16u },
+            { VK_FORMAT_ASTC_10x6_UNORM_BLOCK, 10u, 6u, 16u },
+            { VK_FORMAT_ASTC_10x6_SRGB_BLOCK, 10u, 6u, 16u },
+            { VK_FORMAT_ASTC_10x8_UNORM_BLOCK, 10u, 8u, 16u },
+            { VK_FORMAT_ASTC_10x8_SRGB_BLOCK, 10u, 8u, 16u },
+            { VK_FORMAT_ASTC_10x10_UNORM_BLOCK, 10u, 10u, 16u },
+            { VK_FORMAT_ASTC_10x10_SRGB_BLOCK, 10u, 10u, 16u },
+            { VK_FORMAT_ASTC_12x10_UNORM_BLOCK, 12u, 10u, 16u },
+            { VK_FORMAT_ASTC_12x10_SRGB_BLOCK, 12u, 10u, 16u },
+            { VK_FORMAT_ASTC_12x12_UNORM_BLOCK, 12u, 12u, 16u },
+            { VK_FORMAT_ASTC_12x12_SRGB_BLOCK, 12u, 12u, 16u },
+        };
+
+        bool GetFormatBlockInfo(
+            VkFormat format,
+            uint32_t* pBlockWidth,
+            uint32_t* pBlockHeight,
+            uint32_t* pBlockSizeBytes)
+        {
+            for (const auto& info : FormatBlockInfos) {
+                if (info.format == format) {
+                    *pBlockWidth = info.blockWidth;
+                    *pBlockHeight = info.blockHeight;
+                    *pBlockSizeBytes = info.blockSizeBytes;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool IsBlockCompressedFormat(VkFormat format)
+        {
+            uint32_t blockWidth = 0u, blockHeight = 0u, blockSizeBytes = 0u;
+            return GetFormatBlockInfo(format, &blockWidth, &blockHeight, &blockSizeBytes) && blockWidth > 1u;
+        }
+
+        VkDeviceSize ComputeMipLevelSizeBytes(VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevel)
+        {
+            uint32_t blockWidth = 0u, blockHeight = 0u, blockSizeBytes = 0u;
+            if (!GetFormatBlockInfo(format, &blockWidth, &blockHeight, &blockSizeBytes)) {
+                return 0u;
+            }
+
+            uint32_t levelWidth = std::max(width >> mipLevel, 1u);
+            uint32_t levelHeight = std::max(height >> mipLevel, 1u);
+            VkDeviceSize blocksX = (levelWidth + blockWidth - 1u) / blockWidth;
+            VkDeviceSize blocksY = (levelHeight + blockHeight - 1u) / blockHeight;
+            return blocksX * blocksY * blockSizeBytes;
+        }
+
+        static VkDeviceSize AlignOffset(VkDeviceSize offset)
+        {
+            return (offset + 15u) & ~VkDeviceSize(15u);
+        }
+
+        // Appends a mip level to the texture data at an aligned offset.
+        static void AppendMipLevel(const uint8_t* pLevelData, VkDeviceSize levelSizeBytes, TextureData* pTextureData)
+        {
+            VkDeviceSize offset = AlignOffset(pTextureData->data.size());
+            pTextureData->data.resize(static_cast<size_t>(offset + levelSizeBytes));
+            if (pLevelData != nullptr) {
+                memcpy(pTextureData->data.data() + offset, pLevelData, static_cast<size_t>(levelSizeBytes));
+            }
+            pTextureData->mipLevelOffsets.push_back(offset);
+        }
+
+        template<typename T>
+        static T ReadValue(const uint8_t* pData)
+        {
+            T value;
+            memcpy(&value, pData, sizeof(T));
+            return value;
+        }
+
+        static const uint8_t Ktx2Identifier[12] = {
+            0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+        };
+
+        static bool IsKtx2(const uint8_t* pFileData, size_t fileSizeBytes)
+        {
+            return fileSizeBytes >= sizeof(Ktx2Identifier)
+                && memcmp(pFileData, Ktx2Identifier, sizeof(Ktx2Identifier)) == 0;
+        }
+
+        static bool IsDds(const uint8_t* pFileData, size_t fileSizeBytes)
+        {
+            return fileSizeBytes >= 4u && memcmp(pFileData, "DDS ", 4u) == 0;
+        }
+
+        static bool LoadKtx2(const uint8_t* pFileData, size_t fileSizeBytes, TextureData* pTextureData, std::string* pErr)
+        {
+            // Identifier, 9 uint32 header fields, and the dfd/kvd/sgd index.
+            const size_t headerSizeBytes = 12u + 9u * 4u + 4u * 4u + 2u * 8u;
+            if (fileSizeBytes < headerSizeBytes) {
+                *pErr = "KTX2 file is truncated.";
+                return false;
+            }
+
+            const uint8_t* pHeader = pFileData + 12u;
+            uint32_t vkFormat = ReadValue<uint32_t>(pHeader);
+            uint32_t pixelWidth = ReadValue<uint32_t>(pHeader + 8u);
+            uint32_t pixelHeight = ReadValue<uint32_t>(pHeader + 12u);
+            uint32_t pixelDepth = ReadValue<uint32_t>(pHeader + 16u);
+            uint32_t layerCount = ReadValue<uint32_t>(pHeader + 20u);
+            uint32_t faceCount = ReadValue<uint32_t>(pHeader + 24u);
+            uint32_t levelCount = std::max(ReadValue<uint32_t>(pHeader + 28u), 1u);
+            uint32_t supercompressionScheme = ReadValue<uint32_t>(pHeader + 32u);
+
+            if (vkFormat == VK_FORMAT_UNDEFINED || supercompressionScheme != 0u) {
+                *pErr = "Basis Universal and supercompressed KTX2 files are not supported.";
+                return false;
+            }
+
+            if (pixelWidth == 0u || pixelHeight == 0u || pixelDepth > 1u || layerCount > 1u || faceCount != 1u) {
+                *pErr = "Only 2D KTX2 textures are supported.";
+                return false;
+            }
+
+            if (levelCount > Image::ComputeMipLevels2D(pixelWidth, pixelHeight)) {
+                *pErr = "KTX2 file has more mip levels than its size allows.";
+                return false;
+            }
+
+            VkFormat format = static_cast<VkFormat>(vkFormat);
+            uint32_t blockWidth = 0u, blockHeight = 0u, blockSizeBytes = 0u;
+            if (!GetFormatBlockInfo(format, &blockWidth, &blockHeight, &blockSizeBytes)) {
+                *pErr = "Unsupported KTX2 format: " + std::to_string(vkFormat);
+                return false;
+            }
+
+            const uint8_t* pLevelIndex = pFileData + headerSizeBytes;
+            if (fileSizeBytes < headerSizeBytes + levelCount * 24u) {
+                *pErr = "KTX2 level index is truncated.";
+                return false;
+            }
+
+            pTextureData->format = format;
+            pTextureData->width = pixelWidth;
+            pTextureData->height = pixelHeight;
+            pTextureData->data.clear();
+            pTextureData->mipLevelOffsets.clear();
+
+            // Level 0 is the largest level, but the levels are stored in the file smallest first.
+            for (uint32_t level = 0u; level < levelCount; ++level) {
+                uint64_t byteOffset = ReadValue<uint64_t>(pLevelIndex + level * 24u);
+                uint64_t byteLength = ReadValue<uint64_t>(pLevelIndex + level * 24u + 8u);
+
+                VkDeviceSize expectedSizeBytes = ComputeMipLevelSizeBytes(format, pixelWidth, pixelHeight, level);
+                // Compared without adding them, which could wrap around.
+                if (byteLength != expectedSizeBytes
+                    || byteOffset > fileSizeBytes
+                    || byteLength > fileSizeBytes - byteOffset) {
+                    *pErr = "KTX2 level " + std::to_string(level) + " has an invalid size or offset.";
+                    return false;
+                }
+
+                AppendMipLevel(pFileData + byteOffset, byteLength, pTextureData);
+            }
+
+            return true;
+        }
+
+        static constexpr uint32_t MakeFourCC(char a, char b, char c, char d)
+        {
+            return static_cast<uint32_t>(a)
+                | (static_cast<uint32_t>(b) << 8u)
+                | (static_cast<uint32_t>(c) << 16u)
+                | (static_cast<uint32_t>(d) << 24u);
+        }
+
+        static VkFormat DxgiFormatToVkFormat(uint32_t dxgiFormat)
+        {
+            switch (dxgiFormat) {
+            case 28: return VK_FORMAT_R8G8B8A8_UNORM;
+            case 29: return VK_FORMAT_R8G8B8A8_SRGB;
+            case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+            case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+            case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+            case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+            case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+            case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+            case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+            case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+            case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+            case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+            default: return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+        static bool LoadDds(const uint8_t* pFileData, size_t fileSizeBytes, TextureData* pTextureData, std::string* pErr)
+        {
+            // Magic plus the 124 byte DDS_HEADER.
+            const size_t headerSizeBytes = 4u + 124u;
+            if (fileSizeBytes < headerSizeBytes) {
+                *pErr = "DDS file is truncated.";
+                return false;
+            }
+
+            const uint8_t* pHeader = pFileData + 4u;
+            uint32_t flags = ReadValue<uint32_t>(pHeader + 4u);
+            uint32_t height = ReadValue<uint32_t>(pHeader + 8u);
+            uint32_t width = ReadValue<uint32_t>(pHeader + 12u);
+            uint32_t mipMapCount = ReadValue<uint32_t>(pHeader + 24u);
+            const uint8_t* pPixelFormat = pHeader + 72u;
+            uint32_t pixelFormatFlags = ReadValue<uint32_t>(pPixelFormat + 4u);
+            uint32_t fourCC = ReadValue<uint32_t>(pPixelFormat + 8u);
+            uint32_t caps2 = ReadValue<uint32_t>(pHeader + 108u);
+
+            const uint32_t DDSD_MIPMAPCOUNT = 0x20000u;
+            const uint32_t DDPF_FOURCC = 0x4u;
+            const uint32_t DDPF_RGB = 0x40u;
+            const uint32_t DDSCAPS2_CUBEMAP = 0x200u;
+            const uint32_t DDSCAPS2_VOLUME = 0x200000u;
+
+            if ((caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME)) != 0u) {
+                *pErr = "Only 2D DDS textures are supported.";
+                return false;
+            }
+
+            if (width == 0u || height == 0u) {
+                *pErr = "DDS texture has no size.";
+                return false;
+            }
+
+            uint32_t levelCount = (flags & DDSD_MIPMAPCOUNT) != 0u ? std::max(mipMapCount, 1u) : 1u;
+            if (levelCount > Image::ComputeMipLevels2D(width, height)) {
+                *pErr = "DDS file has more mip levels than its size allows.";
+                return false;
+            }
+
+            size_t dataOffset = headerSizeBytes;
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            if ((pixelFormatFlags & DDPF_FOURCC) != 0u) {
+                switch (fourCC) {
+                case MakeFourCC('D', 'X', 'T', '1'): format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+                case MakeFourCC('D', 'X', 'T', '3'): format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+                case MakeFourCC('D', 'X', 'T', '5'): format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+                case MakeFourCC('A', 'T', 'I', '1'):
+                case MakeFourCC('B', 'C', '4', 'U'): format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+                case MakeFourCC('B', 'C', '4', 'S'): format = VK_FORMAT_BC4_SNORM_BLOCK; break;
+                case MakeFourCC('A', 'T', 'I', '2'):
+                case MakeFourCC('B', 'C', '5', 'U'): format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+                case MakeFourCC('B', 'C', '5', 'S'): format = VK_FORMAT_BC5_SNORM_BLOCK; break;
+                case MakeFourCC('D', 'X', '1', '0'): {
+                    // DDS_HEADER_DXT10 follows the header.
+                    if (fileSizeBytes < headerSizeBytes + 20u) {
+                        *pErr = "DDS DX10 header is truncated.";
+                        return false;
+                    }
+                    const uint8_t* pDx10Header = pFileData + headerSizeBytes;
+                    uint32_t dxgiFormat = ReadValue<uint32_t>(pDx10Header);
+                    uint32_t resourceDimension = ReadValue<uint32_t>(pDx10Header + 4u);
+                    uint32_t arraySize = ReadValue<uint32_t>(pDx10Header + 12u);
+                    const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3u;
+                    if (resourceDimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || arraySize > 1u) {
+                        *pErr = "Only 2D DDS textures are supported.";
+                        return false;
+                    }
+                    format = DxgiFormatToVkFormat(dxgiFormat);
+                    dataOffset += 20u;
+                    break;
+                }
+                default:
+                    break;
+                }
+            } else if ((pixelFormatFlags & DDPF_RGB) != 0u
+                && ReadValue<uint32_t>(pPixelFormat + 12u) == 32u
+                && ReadValue<uint32_t>(pPixelFormat + 16u) == 0x000000FFu
+                && ReadValue<uint32_t>(pPixelFormat + 20u) == 0x0000FF00u
+                && ReadValue<uint32_t>(pPixelFormat + 24u) == 0x00FF0000u) {
+                format = VK_FORMAT_R8G8B8A8_UNORM;
+            }
+
+            if (format == VK_FORMAT_UNDEFINED) {
+                *pErr = "Unsupported DDS pixel format.";
+                return false;
+            }
+
+            pTextureData->format = format;
+            pTextureData->width = width;
+            pTextureData->height = height;
+            pTextureData->data.clear();
+            pTextureData->mipLevelOffsets.clear();
+
+            // The levels are stored contiguously, largest first.
+            for (uint32_t level = 0u; level < levelCount; ++level) {
+                VkDeviceSize levelSizeBytes = ComputeMipLevelSizeBytes(format, width, height, level);
+                if (dataOffset > fileSizeBytes || levelSizeBytes > fileSizeBytes - dataOffset) {
+                    *pErr = "DDS level " + std::to_string(level) + " is truncated.";
+                    return false;
+                }
+
+                AppendMipLevel(pFileData + dataOffset, levelSizeBytes, pTextureData);
+                dataOffset += static_cast<size_t>(levelSizeBytes);
+            }
+
+            return true;
+        }
+
+        static bool LoadWithStb(const uint8_t* pFileData, size_t fileSizeBytes, TextureData* pTextureData, std::string* pErr)
+        {
+            int32_t width = 0;
+            int32_t height = 0;
+            int32_t channels = 0;
+            if (!stbi_info_from_memory(pFileData, static_cast<int>(fileSizeBytes), &width, &height, &channels)) {
+                *pErr = stbi_failure_reason();
+                return false;
+            }
+
+            // RGB images, the most common, are expanded to RGBA by the ImageKernels, which is faster
+            // than stb_image's conversion. The others are converted by stb_image.
+            int32_t loadChannels = channels == STBI_rgb ? STBI_rgb : STBI_rgb_alpha;
+            stbi_uc* pPixels = stbi_load_from_memory(
+                pFileData,
+                static_cast<int>(fileSizeBytes),
+                &width, &height, &channels,
+                loadChannels);
+            if (pPixels == nullptr) {
+                *pErr = stbi_failure_reason();
+                return false;
+            }
+
+            pTextureData->format = VK_FORMAT_R8G8B8A8_UNORM;
+            pTextureData->width = static_cast<uint32_t>(width);
+            pTextureData->height = static_cast<uint32_t>(height);
+            pTextureData->data.clear();
+            pTextureData->mipLevelOffsets.clear();
+            size_t texelCount = static_cast<size_t>(width) * static_cast<size_t>(height);
+            if (loadChannels == STBI_rgb) {
+                AppendMipLevel(nullptr, texelCount * 4u, pTextureData);
+                ImageKernels::ExpandRgbToRgba(
+                    pPixels,
+                    texelCount,
+                    pTextureData->data.data() + pTextureData->mipLevelOffsets.back());
+            } else {
+                AppendMipLevel(pPixels, texelCount * 4u, pTextureData);
+            }
+
+            stbi_image_free(pPixels);
+
+            return true;
+        }
+
+        bool LoadFromMemory(
+            Context& context,
+            const uint8_t* pFileData,
+            size_t fileSizeBytes,
+            TextureData* pTextureData,
+            std::string* pErr)
+        {
+            bool loaded = false;
+            if (IsKtx2(pFileData, fileSizeBytes)) {
+                loaded = LoadKtx2(pFileData, fileSizeBytes, pTextureData, pErr);
+            } else if (IsDds(pFileData, fileSizeBytes)) {
+                loaded = LoadDds(pFileData, fileSizeBytes, pTextureData, pErr);
+            } else {
+                loaded = LoadWithStb(pFileData, fileSizeBytes, pTextureData, pErr);
+            }
+
+            if (!loaded) {
+                return false;
+            }
+
+            if (IsBlockCompressedFormat(pTextureData->format)
+                && !context.isImageFormatSupported(
+                    pTextureData->format,
+                    VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT
+                    | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT
+                    | VK_FORMAT_FEATURE_TRANSFER_DST_BIT)) {
+                TextureData decoded;
+                if (!DecodeToRgba8(*pTextureData, &decoded)) {
+                    *pErr = "Texture format " + std::to_string(pTextureData->format)
+                        + " is not supported by the device, and has no software decoder.";
+                    return false;
+                }
+                *pTextureData = std::move(decoded);
+            }
+
+            return true;
+        }
+
+        std::string GetCookedFilePath(const std::string& filePath)
+        {
+            return std::filesystem::path(filePath).replace_extension(".ktx2").string();
+        }
+
+        bool Load(
+            Context& context,
+            const std::string& filePath,
+            TextureData* pTextureData,
+            std::string* pErr)
+        {
+            std::string loadPath = GetCookedFilePath(filePath);
+            std::error_code errorCode;
+            if (!std::filesystem::exists(loadPath, errorCode)) {
+                loadPath = filePath;
+            } else if (loadPath != filePath && std::filesystem::exists(filePath, errorCode)) {
+                // The source was edited after it was cooked, so the cooked file is out of date.
+                std::error_code sourceErrorCode;
+                auto cookedWriteTime = std::filesystem::last_write_time(loadPath, errorCode);
+                auto sourceWriteTime = std::filesystem::last_write_time(filePath, sourceErrorCode);
+                if (!errorCode && !sourceErrorCode && sourceWriteTime > cookedWriteTime) {
+                    std::cerr << "Cooked texture is older than its source, loading the source instead: "
+                        << loadPath << std::endl;
+                    loadPath = filePath;
+                }
+            }
+
+            std::ifstream file(loadPath, std::ios::binary | std::ios::ate);
+            if (!file.is_open()) {
+                *pErr = "Failed to open file: " + loadPath;
+                return false;
+            }
+
+            std::vector<uint8_t> fileData(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(fileData.data()), fileData.size());
+
+            if (!LoadFromMemory(context, fileData.data(), fileData.size(), pTextureData, pErr)) {
+                *pErr = loadPath + ": " + *pErr;
+                return false;
+            }
+
+            return true;
+        }
+
+        Image::Config CreateImageConfig(const TextureData& textureData)
+        {
+            if (!IsBlockCompressedFormat(textureData.format)
+                && textureData.getMipLevelCount() == 1u
+                && textureData.layerCount == 1u) {
+                VkImageUsageFlags usage =
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT
+                    | VK_IMAGE_USAGE_SAMPLED_BIT
+                    | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                // The ImageDownsampler writes the mip levels of R8G8B8A8_UNORM images as storage
+                // images, the other formats (e.g. sRGB) can't be storage images and are blitted.
+                if (textureData.format == VK_FORMAT_R8G8B8A8_UNORM) {
+                    usage |= VK_IMAGE_USAGE_STORAGE_BIT;
+                }
+                Image::Config config(
+                    textureData.width,
+                    textureData.height,
+                    textureData.format,
+                    VK_IMAGE_TILING_OPTIMAL,
+                    usage,
+                    Image::ComputeMipLevels2D(textureData.width, textureData.height));
+                return config;
+            }
+
+            Image::Config config(
+                textureData.width,
+                textureData.height,
+                textureData.format,
+                VK_IMAGE_TILING_OPTIMAL,
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                textureData.getMipLevelCount());
+            config.imageInfo.arrayLayers = textureData.layerCount;
+            config.mipLevelOffsets = textureData.mipLevelOffsets;
+            return config;
+        }
+
+        static VkFormat GetDecodedFormat(VkFormat format)
+        {
+            switch (format) {
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return VK_FORMAT_R8G8B8A8_SRGB;
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+                return VK_FORMAT_R8G8B8A8_SNORM;
+            default:
+                return VK_FORMAT_R8G8B8A8_UNORM;
+            }
+        }
+
+        bool DecodeToRgba8(const TextureData& compressed, TextureData* pDecoded)
+        {
+            uint32_t blockWidth = 0u, blockHeight = 0u, blockSizeBytes = 0u;
+            if (!GetFormatBlockInfo(compressed.format, &blockWidth, &blockHeight, &blockSizeBytes)
+                || blockWidth != 4u || blockHeight != 4u) {
+                return false;
+            }
+
+            pDecoded->format = GetDecodedFormat(compressed.format);
+            pDecoded->width = compressed.width;
+            pDecoded->height = compressed.height;
+            pDecoded->data.clear();
+            pDecoded->mipLevelOffsets.clear();
+
+            for (uint32_t level = 0u; level < compressed.getMipLevelCount(); ++level) {
+                uint32_t levelWidth = std::max(compressed.width >> level, 1u);
+                uint32_t levelHeight = std::max(compressed.height >> level, 1u);
+
+                AppendMipLevel(nullptr, static_cast<VkDeviceSize>(levelWidth) * levelHeight * 4u, pDecoded);
+                if (!TextureCodec::DecodeImage(
+                        compressed.format,
+                        compressed.data.data() + compressed.mipLevelOffsets[level],
+                        levelWidth,
+                        levelHeight,
+                        pDecoded->data.data() + pDecoded->mipLevelOffsets.back())) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        bool DropLevelsLargerThan(TextureData* pTextureData, uint32_t maxSize)
+        {
+            TextureData& textureData = *pTextureData;
+            if (std::max(textureData.width, textureData.height) <= maxSize) {
+                return true;
+            }
+
+            bool isRgba8 =
+                textureData.format == VK_FORMAT_R8G8B8A8_UNORM
+                || textureData.format == VK_FORMAT_R8G8B8A8_SRGB;
+            if (textureData.getMipLevelCount() == 1u && isRgba8) {
+                std::vector<TextureCodec::MipLevel> mipChain =
+                    TextureCodec::GenerateMipChain(
+                        textureData.data.data(),
+                        textureData.width,
+                        textureData.height,
+                        TextureCodec::MipFilter::Box,
+                        textureData.format == VK_FORMAT_R8G8B8A8_SRGB);
+
+                textureData.data.clear();
+                textureData.mipLevelOffsets.clear();
+                for (const auto& mipLevel : mipChain) {
+                    AppendMipLevel(mipLevel.pixels.data(), mipLevel.pixels.size(), &textureData);
+                }
+            }
+
+            uint32_t baseLevel = 0u;
+            while (baseLevel < textureData.getMipLevelCount()
+                && std::max(textureData.width >> baseLevel, textureData.height >> baseLevel) > maxSize) {
+                ++baseLevel;
+            }
+            if (baseLevel == textureData.getMipLevelCount()) {
+                return false;
+            }
+
+            // The levels are 16 byte aligned, so they stay aligned relative to the new base level.
+            VkDeviceSize baseOffset = textureData.mipLevelOffsets[baseLevel];
+            textureData.data.erase(textureData.data.begin(), textureData.data.begin() + static_cast<size_t>(baseOffset));
+            textureData.mipLevelOffsets.erase(
+                textureData.mipLevelOffsets.begin(),
+                textureData.mipLevelOffsets.begin() + baseLevel);
+            for (auto& mipLevelOffset : textureData.mipLevelOffsets) {
+                mipLevelOffset -= baseOffset;
+            }
+            textureData.width = std::max(textureData.width >> baseLevel, 1u);
+            textureData.height = std::max(textureData.height >> baseLevel, 1u);
+            return true;
+        }
+    }
+}
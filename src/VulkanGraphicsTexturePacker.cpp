@@ -0,0 +1,342 @@
+#include "VulkanGraphicsTexturePacker.h"
+
+#include "VulkanGraphicsTextureCodec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+namespace vgfx
+{
+    namespace TexturePacker
+    {
+        using TextureData = TextureFile::TextureData;
+
+        static bool IsRgba8(VkFormat format)
+        {
+            return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB;
+        }
+
+        static uint32_t ComputeFullMipLevelCount(uint32_t width, uint32_t height)
+        {
+            uint32_t levelCount = 1u;
+            while ((width >> levelCount) > 0u || (height >> levelCount) > 0u) {
+                ++levelCount;
+            }
+            return levelCount;
+        }
+
+        static uint32_t AlignUp(uint32_t value, uint32_t alignment)
+        {
+            return (value + alignment - 1u) / alignment * alignment;
+        }
+
+        // Adds a zeroed level at a 16 byte aligned offset, like the levels that TextureFile loads.
+        static uint8_t* AppendLevel(VkDeviceSize levelSizeBytes, TextureData* pTextureData)
+        {
+            VkDeviceSize offset = (pTextureData->data.size() + 15u) & ~VkDeviceSize(15u);
+            pTextureData->data.resize(static_cast<size_t>(offset + levelSizeBytes), 0u);
+            pTextureData->mipLevelOffsets.push_back(offset);
+            return pTextureData->data.data() + offset;
+        }
+
+        // Single level RGBA8 textures have their mip chain generated, so that they can be packed
+        // with textures that were loaded with one.
+        static bool NeedsMipChain(const TextureData& texture)
+        {
+            return IsRgba8(texture.format)
+                && texture.getMipLevelCount() == 1u
+                && ComputeFullMipLevelCount(texture.width, texture.height) > 1u;
+        }
+
+        static std::vector<TextureCodec::MipLevel> GetRgba8MipChain(const TextureData& texture)
+        {
+            if (NeedsMipChain(texture)) {
+                return TextureCodec::GenerateMipChain(
+                    texture.data.data(),
+                    texture.width,
+                    texture.height,
+                    TextureCodec::MipFilter::Box,
+                    texture.format == VK_FORMAT_R8G8B8A8_SRGB);
+            }
+
+            std::vector<TextureCodec::MipLevel> mipChain(texture.getMipLevelCount());
+            for (uint32_t mipLevel = 0u; mipLevel < texture.getMipLevelCount(); ++mipLevel) {
+                TextureCodec::MipLevel& level = mipChain[mipLevel];
+                level.width = std::max(texture.width >> mipLevel, 1u);
+                level.height = std::max(texture.height >> mipLevel, 1u);
+                const uint8_t* pLevelData = texture.data.data() + texture.mipLevelOffsets[mipLevel];
+                level.pixels.assign(pLevelData, pLevelData + static_cast<size_t>(level.width) * level.height * 4u);
+            }
+            return mipChain;
+        }
+
+        static void PackArray(
+            const std::vector<const TextureData*>& textures,
+            const std::vector<size_t>& layerTextureIndices,
+            std::vector<TextureData>* pPackedTextures,
+            std::vector<Placement>* pPlacements)
+        {
+            // RGBA8 layers may have been loaded with or without their mip chain.
+            const TextureData& firstTexture = *textures[layerTextureIndices[0]];
+            bool generateMipChains = IsRgba8(firstTexture.format);
+
+            std::vector<std::vector<TextureCodec::MipLevel>> mipChains;
+            if (generateMipChains) {
+                for (size_t textureIndex : layerTextureIndices) {
+                    mipChains.push_back(GetRgba8MipChain(*textures[textureIndex]));
+                }
+            }
+
+            uint32_t packedTextureIndex = static_cast<uint32_t>(pPackedTextures->size());
+            pPackedTextures->emplace_back();
+            TextureData& packedTexture = pPackedTextures->back();
+            packedTexture.format = firstTexture.format;
+            packedTexture.width = firstTexture.width;
+            packedTexture.height = firstTexture.height;
+            packedTexture.layerCount = static_cast<uint32_t>(layerTextureIndices.size());
+
+            uint32_t mipLevelCount =
+                generateMipChains ?
+                    static_cast<uint32_t>(mipChains[0].size()) :
+                    firstTexture.getMipLevelCount();
+            for (uint32_t mipLevel = 0u; mipLevel < mipLevelCount; ++mipLevel) {
+                VkDeviceSize layerSizeBytes =
+                    TextureFile::ComputeMipLevelSizeBytes(
+                        packedTexture.format, packedTexture.width, packedTexture.height, mipLevel);
+                uint8_t* pLevel = AppendLevel(layerSizeBytes * packedTexture.layerCount, &packedTexture);
+
+                for (uint32_t layer = 0u; layer < packedTexture.layerCount; ++layer) {
+                    const TextureData& texture = *textures[layerTextureIndices[layer]];
+                    const uint8_t* pSrc =
+                        generateMipChains ?
+                            mipChains[layer][mipLevel].pixels.data() :
+                            texture.data.data() + texture.mipLevelOffsets[mipLevel];
+                    std::memcpy(pLevel + layer * layerSizeBytes, pSrc, static_cast<size_t>(layerSizeBytes));
+                }
+            }
+
+            for (uint32_t layer = 0u; layer < packedTexture.layerCount; ++layer) {
+                Placement& placement = (*pPlacements)[layerTextureIndices[layer]];
+                placement.packedTextureIndex = packedTextureIndex;
+                placement.layer = layer;
+            }
+        }
+
+        struct AtlasEntry
+        {
+            size_t textureIndex = 0u;
+            uint32_t slotWidth = 0u;
+            uint32_t slotHeight = 0u;
+            uint32_t x = 0u;
+            uint32_t y = 0u;
+            uint32_t layer = 0u;
+            std::vector<TextureCodec::MipLevel> mipChain;
+        };
+
+        static void PackAtlas(
+            const std::vector<const TextureData*>& textures,
+            const std::vector<size_t>& textureIndices,
+            const Config& config,
+            std::vector<TextureData>* pPackedTextures,
+            std::vector<Placement>* pPlacements)
+        {
+            const uint32_t border = config.borderTexels;
+            const uint32_t atlasSize = config.atlasSize;
+
+            // Textures start at multiples of the border, so that their offset is exact in each of
+            // the atlas' levels.
+            std::vector<AtlasEntry> entries(textureIndices.size());
+            for (size_t i = 0u; i < textureIndices.size(); ++i) {
+                const TextureData& texture = *textures[textureIndices[i]];
+                entries[i].textureIndex = textureIndices[i];
+                entries[i].slotWidth = AlignUp(texture.width, border) + 2u * border;
+                entries[i].slotHeight = AlignUp(texture.height, border) + 2u * border;
+            }
+            std::stable_sort(
+                entries.begin(),
+                entries.end(),
+                [](const AtlasEntry& lhs, const AtlasEntry& rhs) {
+                    return std::tie(lhs.slotHeight, lhs.slotWidth) > std::tie(rhs.slotHeight, rhs.slotWidth);
+                });
+
+            // Shelf packing, the tallest textures first.
+            uint32_t layer = 0u, shelfX = 0u, shelfY = 0u, shelfHeight = 0u;
+            size_t packedCount = 0u;
+            for (; packedCount < entries.size(); ++packedCount) {
+                AtlasEntry& entry = entries[packedCount];
+                if (shelfX + entry.slotWidth > atlasSize) {
+                    shelfY += shelfHeight;
+                    shelfX = 0u;
+                    shelfHeight = 0u;
+                }
+                if (shelfY + entry.slotHeight > atlasSize) {
+                    ++layer;
+                    shelfX = 0u;
+                    shelfY = 0u;
+                    shelfHeight = 0u;
+                }
+                if (layer == config.maxArrayLayerCount) {
+                    // The rest are left unpacked.
+                    break;
+                }
+
+                entry.x = shelfX;
+                entry.y = shelfY;
+                entry.layer = layer;
+                shelfX += entry.slotWidth;
+                shelfHeight = std::max(shelfHeight, entry.slotHeight);
+            }
+            entries.resize(packedCount);
+            if (entries.size() < 2u) {
+                return;
+            }
+
+            // An atlas with a single layer is shrunk to the power of two that fits its textures,
+            // which keeps the textures' offsets multiples of the border.
+            uint32_t atlasWidth = atlasSize;
+            uint32_t atlasHeight = atlasSize;
+            if (layer == 0u) {
+                uint32_t usedWidth = 0u, usedHeight = 0u;
+                for (const auto& entry : entries) {
+                    usedWidth = std::max(usedWidth, entry.x + entry.slotWidth);
+                    usedHeight = std::max(usedHeight, entry.y + entry.slotHeight);
+                }
+                while ((atlasWidth >> 1u) >= usedWidth) {
+                    atlasWidth >>= 1u;
+                }
+                while ((atlasHeight >> 1u) >= usedHeight) {
+                    atlasHeight >>= 1u;
+                }
+            }
+
+            uint32_t packedTextureIndex = static_cast<uint32_t>(pPackedTextures->size());
+            pPackedTextures->emplace_back();
+            TextureData& atlas = pPackedTextures->back();
+            atlas.format = textures[entries[0].textureIndex]->format;
+            atlas.width = atlasWidth;
+            atlas.height = atlasHeight;
+            atlas.layerCount = entries.back().layer + 1u;
+
+            for (auto& entry : entries) {
+                entry.mipChain = GetRgba8MipChain(*textures[entry.textureIndex]);
+            }
+
+            uint32_t mipLevelCount = 1u;
+            while ((border >> mipLevelCount) > 0u) {
+                ++mipLevelCount;
+            }
+            mipLevelCount = std::min(mipLevelCount, ComputeFullMipLevelCount(atlasWidth, atlasHeight));
+
+            for (uint32_t mipLevel = 0u; mipLevel < mipLevelCount; ++mipLevel) {
+                uint32_t levelWidth = std::max(atlasWidth >> mipLevel, 1u);
+                uint32_t levelHeight = std::max(atlasHeight >> mipLevel, 1u);
+                size_t layerSizeBytes = static_cast<size_t>(levelWidth) * levelHeight * 4u;
+                uint8_t* pLevel = AppendLevel(layerSizeBytes * atlas.layerCount, &atlas);
+
+                uint32_t levelBorder = std::max(border >> mipLevel, 1u);
+                for (const auto& entry : entries) {
+                    // The texture's smallest levels are repeated if it has fewer than the atlas.
+                    const TextureCodec::MipLevel& src =
+                        entry.mipChain[std::min<size_t>(mipLevel, entry.mipChain.size() - 1u)];
+                    int32_t originX = static_cast<int32_t>((entry.x + border) >> mipLevel);
+                    int32_t originY = static_cast<int32_t>((entry.y + border) >> mipLevel);
+                    uint32_t slotX = originX - levelBorder;
+                    uint32_t slotY = originY - levelBorder;
+                    uint32_t slotWidth = entry.slotWidth >> mipLevel;
+                    uint32_t slotHeight = entry.slotHeight >> mipLevel;
+
+                    // The border and the alignment padding repeat the nearest edge texel.
+                    uint8_t* pLayer = pLevel + entry.layer * layerSizeBytes;
+                    for (uint32_t y = slotY; y < slotY + slotHeight; ++y) {
+                        int32_t srcY = std::clamp(static_cast<int32_t>(y) - originY, 0, static_cast<int32_t>(src.height) - 1);
+                        for (uint32_t x = slotX; x < slotX + slotWidth; ++x) {
+                            int32_t srcX = std::clamp(static_cast<int32_t>(x) - originX, 0, static_cast<int32_t>(src.width) - 1);
+                            std::memcpy(
+                                pLayer + (static_cast<size_t>(y) * levelWidth + x) * 4u,
+                                src.pixels.data() + (static_cast<size_t>(srcY) * src.width + srcX) * 4u,
+                                4u);
+                        }
+                    }
+                }
+            }
+
+            for (const auto& entry : entries) {
+                const TextureData& texture = *textures[entry.textureIndex];
+                Placement& placement = (*pPlacements)[entry.textureIndex];
+                placement.packedTextureIndex = packedTextureIndex;
+                placement.layer = entry.layer;
+                placement.uvScale =
+                    glm::vec2(
+                        static_cast<float>(texture.width) / atlasWidth,
+                        static_cast<float>(texture.height) / atlasHeight);
+                placement.uvOffset =
+                    glm::vec2(
+                        static_cast<float>(entry.x + border) / atlasWidth,
+                        static_cast<float>(entry.y + border) / atlasHeight);
+            }
+        }
+
+        void Pack(
+            const std::vector<const TextureData*>& textures,
+            const Config& config,
+            std::vector<TextureData>* pPackedTexturesOut,
+            std::vector<Placement>* pPlacementsOut)
+        {
+            pPackedTexturesOut->clear();
+            pPlacementsOut->assign(textures.size(), Placement());
+
+            // Textures of the same format and size become the layers of an array.
+            using ArrayKey = std::tuple<VkFormat, uint32_t, uint32_t, uint32_t>;
+            std::map<ArrayKey, std::vector<size_t>> arrayGroups;
+            for (size_t textureIndex = 0u; textureIndex < textures.size(); ++textureIndex) {
+                const TextureData& texture = *textures[textureIndex];
+                if (texture.layerCount != 1u || texture.data.empty()) {
+                    continue;
+                }
+                uint32_t mipLevelCount =
+                    NeedsMipChain(texture) ?
+                        ComputeFullMipLevelCount(texture.width, texture.height) :
+                        texture.getMipLevelCount();
+                arrayGroups[ArrayKey(texture.format, texture.width, texture.height, mipLevelCount)].push_back(textureIndex);
+            }
+
+            uint32_t maxLayerCount = std::max(config.maxArrayLayerCount, 1u);
+            for (const auto& keyAndTextureIndices : arrayGroups) {
+                const std::vector<size_t>& textureIndices = keyAndTextureIndices.second;
+                for (size_t first = 0u; first < textureIndices.size(); first += maxLayerCount) {
+                    size_t last = std::min(first + maxLayerCount, textureIndices.size());
+                    if (last - first < std::max(config.minArrayLayerCount, 2u)) {
+                        continue;
+                    }
+                    std::vector<size_t> layerTextureIndices(textureIndices.begin() + first, textureIndices.begin() + last);
+                    PackArray(textures, layerTextureIndices, pPackedTexturesOut, pPlacementsOut);
+                }
+            }
+
+            // The small RGBA8 textures that are left are packed into an atlas for each format.
+            std::map<VkFormat, std::vector<size_t>> atlasGroups;
+            for (size_t textureIndex = 0u; textureIndex < textures.size(); ++textureIndex) {
+                const TextureData& texture = *textures[textureIndex];
+                if ((*pPlacementsOut)[textureIndex].packedTextureIndex != NotPacked
+                    || !IsRgba8(texture.format)
+                    || texture.layerCount != 1u
+                    || texture.data.empty()
+                    || texture.width > config.maxAtlasTextureSize
+                    || texture.height > config.maxAtlasTextureSize
+                    || AlignUp(texture.width, config.borderTexels) + 2u * config.borderTexels > config.atlasSize
+                    || AlignUp(texture.height, config.borderTexels) + 2u * config.borderTexels > config.atlasSize) {
+                    continue;
+                }
+                atlasGroups[texture.format].push_back(textureIndex);
+            }
+
+            for (const auto& formatAndTextureIndices : atlasGroups) {
+                if (formatAndTextureIndices.second.size() >= 2u) {
+                    PackAtlas(textures, formatAndTextureIndices.second, config, pPackedTexturesOut, pPlacementsOut);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,387 @@
+#include "VulkanGraphicsTextureResidencyManager.h"
+
+#include "VulkanGraphicsTextureFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+namespace vgfx
+{
+    static uint32_t GetMaxSide(VkExtent2D extent)
+    {
+        return std::max(extent.width, extent.height);
+    }
+
+    static uint32_t NextPowerOfTwo(uint32_t value)
+    {
+        uint32_t powerOfTwo = 1u;
+        while (powerOfTwo < value && powerOfTwo < (1u << 31u)) {
+            powerOfTwo <<= 1u;
+        }
+        return powerOfTwo;
+    }
+
+    static VkDeviceSize ComputeImageSizeBytes(const Image& image)
+    {
+        VkDeviceSize sizeBytes = 0u;
+        for (uint32_t mipLevel = 0u; mipLevel < image.getMipLevels(); ++mipLevel) {
+            sizeBytes +=
+                TextureFile::ComputeMipLevelSizeBytes(
+                    image.getFormat(), image.getWidth(), image.getHeight(), mipLevel);
+        }
+        return sizeBytes;
+    }
+
+    TextureResidencyManager::TextureResidencyManager(
+        Context& context,
+        AsyncImageLoader& imageLoader,
+        const Config& config)
+        : m_context(context)
+        , m_imageLoader(imageLoader)
+        , m_config(config)
+    {
+    }
+
+    TextureResidencyManager::TextureId TextureResidencyManager::getOrAddTexture(const std::string& path)
+    {
+        auto findIt = m_textureIds.find(path);
+        if (findIt != m_textureIds.end()) {
+            return findIt->second;
+        }
+
+        TextureId textureId = static_cast<TextureId>(m_textures.size());
+        m_textures.emplace_back();
+        m_textures.back().path = path;
+        m_textureIds[path] = textureId;
+
+        requestLoad(textureId, m_config.initialMaxSize);
+
+        return textureId;
+    }
+
+    const ImageView& TextureResidencyManager::getImageView(TextureId textureId) const
+    {
+        const Texture& texture = m_textures.at(textureId);
+        return texture.pImageView != nullptr ? *texture.pImageView : getPlaceholderImageView();
+    }
+
+    const ImageView& TextureResidencyManager::getPlaceholderImageView() const
+    {
+        const Image& placeholderImage = m_imageLoader.getPlaceholderImage();
+        return placeholderImage.getOrCreateView(
+            ImageView::Config(placeholderImage.getFormat(), VK_IMAGE_VIEW_TYPE_2D_ARRAY));
+    }
+
+    void TextureResidencyManager::bindTexture(
+        TextureId textureId,
+        Drawable& drawable,
+        ImageType imageType,
+        size_t materialIndex)
+    {
+        Binding binding;
+        binding.pDrawable = &drawable;
+        binding.imageType = imageType;
+        binding.materialIndex = materialIndex;
+        m_textures.at(textureId).bindings.push_back(binding);
+
+        drawable.getImageSampler(imageType, materialIndex).first = &getImageView(textureId);
+
+        std::vector<TextureId>& drawableTextures = m_drawableTextures[&drawable];
+        if (std::find(drawableTextures.begin(), drawableTextures.end(), textureId) == drawableTextures.end()) {
+            drawableTextures.push_back(textureId);
+        }
+    }
+
+    void TextureResidencyManager::onDrawn(const Drawable& drawable, float screenSizePixels)
+    {
+        auto findIt = m_drawableTextures.find(&drawable);
+        if (findIt == m_drawableTextures.end()) {
+            return;
+        }
+
+        // Drawables with unknown bounds, or that contain the camera, need their full resolution.
+        uint32_t drawnSize = std::numeric_limits<uint32_t>::max();
+        float texels = screenSizePixels * m_config.texelsPerPixel;
+        if (texels < static_cast<float>(1u << 31u)) {
+            drawnSize = NextPowerOfTwo(static_cast<uint32_t>(std::ceil(std::max(texels, 1.0f))));
+        }
+
+        for (TextureId textureId : findIt->second) {
+            Texture& texture = m_textures[textureId];
+            if (texture.lastDrawnFrame != m_frame) {
+                texture.lastDrawnFrame = m_frame;
+                texture.drawnSize = 0u;
+            }
+            texture.drawnSize = std::max(texture.drawnSize, drawnSize);
+        }
+    }
+
+    VkDeviceSize TextureResidencyManager::computeBudgetBytes() const
+    {
+        if (m_config.budgetBytes != 0u) {
+            return m_config.budgetBytes;
+        }
+
+        VkDeviceSize budgetBytes = 0u;
+        VkDeviceSize usageBytes = 0u;
+        m_context.getMemoryAllocator().getDeviceLocalBudget(&budgetBytes, &usageBytes);
+        return static_cast<VkDeviceSize>(static_cast<double>(budgetBytes) * m_config.budgetFraction);
+    }
+
+    VkDeviceSize TextureResidencyManager::estimateBytes(const Texture& texture, uint32_t maxSize) const
+    {
+        uint32_t fileSize = GetMaxSide(texture.fileExtent);
+        if (fileSize == 0u) {
+            // Unknown until the first load completes, assume a square RGBA8 texture with mip levels.
+            return static_cast<VkDeviceSize>(maxSize) * maxSize * 4u * 4u / 3u;
+        }
+
+        double scale = (maxSize == 0u || maxSize >= fileSize) ? 1.0 : static_cast<double>(maxSize) / fileSize;
+        double texels = (texture.fileExtent.width * scale) * (texture.fileExtent.height * scale);
+        return static_cast<VkDeviceSize>(texels * texture.bytesPerTexel);
+    }
+
+    uint32_t TextureResidencyManager::computeTargetMaxSize(const Texture& texture) const
+    {
+        uint32_t fileSize = GetMaxSide(texture.fileExtent);
+        uint32_t targetMaxSize = std::max(texture.drawnSize, m_config.initialMaxSize);
+        if (fileSize != 0u && targetMaxSize >= fileSize) {
+            return fileSize;
+        }
+        return targetMaxSize;
+    }
+
+    void TextureResidencyManager::requestLoad(TextureId textureId, uint32_t maxSize)
+    {
+        Texture& texture = m_textures[textureId];
+        texture.isLoading = true;
+        texture.requestedMaxSize = maxSize;
+
+        // Loading all of the file's levels lets the GPU generate the mip chain of single level
+        // files, rather than the worker thread.
+        uint32_t fileSize = GetMaxSide(texture.fileExtent);
+        uint32_t loadMaxSize = (fileSize != 0u && maxSize >= fileSize) ? 0u : maxSize;
+
+        m_imageLoader.loadImageLevels(
+            texture.path,
+            loadMaxSize,
+            [this, textureId](std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent) {
+                onLoaded(textureId, std::move(spImage), fileExtent);
+            });
+    }
+
+    void TextureResidencyManager::onLoaded(TextureId textureId, std::unique_ptr<Image>&& spImage, VkExtent2D fileExtent)
+    {
+        Texture& texture = m_textures[textureId];
+        texture.isLoading = false;
+
+        if (spImage == nullptr) {
+            // Keep whatever is resident (or the placeholder) rather than fail the frame, and don't
+            // retry a file that can't be loaded.
+            texture.loadFailed = true;
+            std::cerr << "Failed to load image: " << texture.path << std::endl;
+            return;
+        }
+
+        texture.fileExtent = fileExtent;
+
+        uint32_t maxSize = std::max(texture.requestedMaxSize, std::max(spImage->getWidth(), spImage->getHeight()));
+        setImage(texture, std::move(spImage), std::min(maxSize, GetMaxSide(fileExtent)));
+    }
+
+    void TextureResidencyManager::setImage(Texture& texture, std::unique_ptr<Image>&& spImage, uint32_t maxSize)
+    {
+        retireImage(texture);
+
+        Image& image = *spImage.get();
+        texture.spImage = std::move(spImage);
+        texture.pImageView =
+            &image.getOrCreateView(
+                ImageView::Config(
+                    image.getFormat(), VK_IMAGE_VIEW_TYPE_2D_ARRAY, 0u, image.getMipLevels()));
+        texture.residentMaxSize = maxSize;
+        texture.residentBytes = ComputeImageSizeBytes(image);
+        texture.bytesPerTexel =
+            static_cast<double>(texture.residentBytes) / (static_cast<double>(image.getWidth()) * image.getHeight());
+
+        updateBindings(texture);
+    }
+
+    void TextureResidencyManager::retireImage(Texture& texture)
+    {
+        if (texture.spImage != nullptr) {
+            // Image retires its memory and views with the Context, since frames that were recorded
+            // with the image may still be executing. Without a RetirementQueue they are destroyed
+            // right away, so wait for those frames.
+            if (m_context.getRetirementQueue() == nullptr) {
+                m_context.waitForDeviceToIdle();
+            }
+            texture.spImage.reset();
+        }
+        texture.pImageView = nullptr;
+        texture.residentMaxSize = 0u;
+        texture.residentBytes = 0u;
+
+        updateBindings(texture);
+    }
+
+    void TextureResidencyManager::updateBindings(const Texture& texture)
+    {
+        const ImageView& imageView = texture.pImageView != nullptr ? *texture.pImageView : getPlaceholderImageView();
+
+        // Drawables rewrite their descriptor sets each frame, so the new view is used starting with
+        // the next frame that is recorded.
+        for (const Binding& binding : texture.bindings) {
+            binding.pDrawable->getImageSampler(binding.imageType, binding.materialIndex).first = &imageView;
+        }
+    }
+
+    void TextureResidencyManager::update()
+    {
+        VkDeviceSize budgetBytes = computeBudgetBytes();
+
+        // Usage once the loads in flight complete, assuming each replaces its texture's image.
+        VkDeviceSize usageBytes = 0u;
+        for (const Texture& texture : m_textures) {
+            VkDeviceSize textureBytes = texture.residentBytes;
+            if (texture.isLoading) {
+                textureBytes = std::max(textureBytes, estimateBytes(texture, texture.requestedMaxSize));
+            }
+            usageBytes += textureBytes;
+        }
+
+        std::vector<TextureId> candidates;
+        auto sortLeastRecentlyDrawn = [this, &candidates]() {
+            std::stable_sort(
+                candidates.begin(),
+                candidates.end(),
+                [this](TextureId lhs, TextureId rhs) {
+                    const Texture& lhsTexture = m_textures[lhs];
+                    const Texture& rhsTexture = m_textures[rhs];
+                    if (lhsTexture.lastDrawnFrame != rhsTexture.lastDrawnFrame) {
+                        return lhsTexture.lastDrawnFrame < rhsTexture.lastDrawnFrame;
+                    }
+                    return lhsTexture.residentBytes > rhsTexture.residentBytes;
+                });
+        };
+
+        // Evict the textures that weren't drawn by the last frame, least recently drawn first.
+        if (usageBytes > budgetBytes) {
+            candidates.clear();
+            for (TextureId textureId = 0u; textureId < m_textures.size(); ++textureId) {
+                const Texture& texture = m_textures[textureId];
+                if (texture.spImage != nullptr && !texture.isLoading && texture.lastDrawnFrame != m_frame) {
+                    candidates.push_back(textureId);
+                }
+            }
+            sortLeastRecentlyDrawn();
+
+            for (TextureId textureId : candidates) {
+                if (usageBytes <= budgetBytes) {
+                    break;
+                }
+                Texture& texture = m_textures[textureId];
+                usageBytes -= texture.residentBytes;
+                retireImage(texture);
+                ++m_stats.evictedCount;
+            }
+        }
+
+        uint32_t loadCount = 0u;
+
+        // Then reduce the resolution of the drawn textures, to what they are drawn at if they are
+        // larger than that, otherwise to half.
+        if (usageBytes > budgetBytes) {
+            candidates.clear();
+            for (TextureId textureId = 0u; textureId < m_textures.size(); ++textureId) {
+                const Texture& texture = m_textures[textureId];
+                if (texture.spImage != nullptr
+                    && !texture.isLoading
+                    && !texture.loadFailed
+                    && texture.residentMaxSize > m_config.initialMaxSize) {
+                    candidates.push_back(textureId);
+                }
+            }
+            sortLeastRecentlyDrawn();
+
+            for (TextureId textureId : candidates) {
+                if (usageBytes <= budgetBytes || loadCount == m_config.maxLoadsPerUpdate) {
+                    break;
+                }
+                Texture& texture = m_textures[textureId];
+                uint32_t targetMaxSize = computeTargetMaxSize(texture);
+                uint32_t maxSize =
+                    std::max(
+                        targetMaxSize < texture.residentMaxSize ? targetMaxSize : texture.residentMaxSize / 2u,
+                        m_config.initialMaxSize);
+                VkDeviceSize reducedBytes = estimateBytes(texture, maxSize);
+                if (reducedBytes >= texture.residentBytes) {
+                    continue;
+                }
+
+                // The resident image is kept until the reduced one replaces it.
+                usageBytes -= texture.residentBytes - reducedBytes;
+                requestLoad(textureId, maxSize);
+                ++loadCount;
+                ++m_stats.reducedCount;
+            }
+        }
+
+        // Stream in the levels that the drawn textures are missing, the least resident first.
+        candidates.clear();
+        for (TextureId textureId = 0u; textureId < m_textures.size(); ++textureId) {
+            const Texture& texture = m_textures[textureId];
+            if (texture.lastDrawnFrame == m_frame
+                && !texture.isLoading
+                && !texture.loadFailed
+                && computeTargetMaxSize(texture) > texture.residentMaxSize) {
+                candidates.push_back(textureId);
+            }
+        }
+        std::stable_sort(
+            candidates.begin(),
+            candidates.end(),
+            [this](TextureId lhs, TextureId rhs) {
+                return m_textures[lhs].residentMaxSize < m_textures[rhs].residentMaxSize;
+            });
+
+        for (TextureId textureId : candidates) {
+            if (loadCount == m_config.maxLoadsPerUpdate) {
+                break;
+            }
+            Texture& texture = m_textures[textureId];
+
+            // Evicted textures reload their initial levels first, which are loaded regardless of
+            // the budget so that nothing is left sampling the placeholder.
+            uint32_t maxSize =
+                texture.residentMaxSize == 0u ? m_config.initialMaxSize : computeTargetMaxSize(texture);
+            VkDeviceSize loadBytes = estimateBytes(texture, maxSize);
+            VkDeviceSize addedBytes = loadBytes - std::min(loadBytes, texture.residentBytes);
+            if (texture.residentMaxSize != 0u && usageBytes + addedBytes > budgetBytes) {
+                continue;
+            }
+
+            usageBytes += addedBytes;
+            requestLoad(textureId, maxSize);
+            ++loadCount;
+            if (texture.residentMaxSize != 0u) {
+                ++m_stats.streamedInCount;
+            }
+        }
+
+        m_stats.budgetBytes = budgetBytes;
+        m_stats.residentBytes = 0u;
+        m_stats.textureCount = static_cast<uint32_t>(m_textures.size());
+        m_stats.residentTextureCount = 0u;
+        for (const Texture& texture : m_textures) {
+            if (texture.spImage != nullptr) {
+                m_stats.residentBytes += texture.residentBytes;
+                ++m_stats.residentTextureCount;
+            }
+        }
+
+        ++m_frame;
+    }
+}
@@ -0,0 +1,572 @@
+#include "VulkanGraphicsUploadManager.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace vgfx
+{
+    // Stages of the dst queue that may use uploaded resources first. Its semaphore waits and
+    // acquire barriers only block these, e.g. not the clears at the start of a frame.
+    static const VkPipelineStageFlags AcquireStages =
+        VK_PIPELINE_STAGE_TRANSFER_BIT
+        | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+        | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+        | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+        | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    // Makes the writes of a batch visible to everything submitted to its queue after it.
+    static void RecordBatchEndBarrier(VkCommandBuffer commandBuffer)
+    {
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+        vkCmdPipelineBarrier(
+            commandBuffer,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, // VkDependencyFlags
+            1, &barrier,
+            0, nullptr,
+            0, nullptr);
+    }
+
+    UploadManager::UploadManager(
+        Context& context,
+        CommandBufferFactory& commandBufferFactory,
+        const Config& config,
+        CommandBufferFactory* pDstCommandBufferFactory)
+        : m_context(context)
+        , m_commandBufferFactory(commandBufferFactory)
+        , m_commandQueue(commandBufferFactory.getCommandQueue())
+        , m_dstCommandQueue(commandBufferFactory.getCommandQueue())
+        , m_config(config)
+    {
+        // Queues of the same family don't need ownership transfers.
+        if (pDstCommandBufferFactory != nullptr
+            && pDstCommandBufferFactory->getCommandQueue().queueFamilyIndex != m_commandQueue.queueFamilyIndex) {
+            m_pDstCommandBufferFactory = pDstCommandBufferFactory;
+            m_dstCommandQueue = pDstCommandBufferFactory->getCommandQueue();
+        }
+
+        VkPhysicalDeviceProperties props = {};
+        vkGetPhysicalDeviceProperties(m_context.getPhysicalDevice(), &props);
+        // Both are powers of two, the larger one keeps copies to images on their optimal alignment.
+        m_stagingAlignment = std::max<VkDeviceSize>(16u, props.limits.optimalBufferCopyOffsetAlignment);
+
+        m_openBatch.id = 1u;
+    }
+
+    UploadManager::~UploadManager()
+    {
+        flush();
+        while (!m_submittedBatches.empty()) {
+            retireBatches(true);
+        }
+        // Batches that were never acquired only leave their semaphores signaled.
+        while (!m_submittedAcquireBatches.empty()) {
+            retireAcquireBatches(true);
+        }
+
+        if (m_stagingRing.handle != VK_NULL_HANDLE) {
+            auto& memoryAllocator = m_context.getMemoryAllocator();
+            memoryAllocator.unmapBuffer(m_stagingRing);
+            memoryAllocator.destroyBuffer(m_stagingRing);
+        }
+    }
+
+    VkCommandBuffer UploadManager::getOpenCommandBuffer()
+    {
+        if (m_openBatch.commandBuffer == VK_NULL_HANDLE) {
+            m_openBatch.commandBuffer = m_commandBufferFactory.createCommandBuffer();
+
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            vkBeginCommandBuffer(m_openBatch.commandBuffer, &beginInfo);
+        }
+        return m_openBatch.commandBuffer;
+    }
+
+    bool UploadManager::allocateFromRing(VkDeviceSize sizeBytes, VkDeviceSize* pOffset)
+    {
+        VkDeviceSize ringSize = m_config.stagingRingSizeBytes;
+        if (m_ringUsedBytes == 0u) {
+            m_ringHead = 0u;
+            m_ringTail = 0u;
+        }
+
+        VkDeviceSize alignedSize = (sizeBytes + m_stagingAlignment - 1u) & ~(m_stagingAlignment - 1u);
+        if (m_ringHead >= m_ringTail && (m_ringUsedBytes == 0u || m_ringHead != m_ringTail)) {
+            // The free space is after the head, and before the tail once the ring wraps.
+            if (ringSize - m_ringHead >= sizeBytes) {
+                *pOffset = m_ringHead;
+                VkDeviceSize usedBytes = std::min(alignedSize, ringSize - m_ringHead);
+                m_ringHead += usedBytes;
+                m_ringUsedBytes += usedBytes;
+                m_openBatch.ringBytes += usedBytes;
+                return true;
+            }
+            if (m_ringTail < sizeBytes) {
+                return false;
+            }
+            // Skips the bytes at the end of the ring, they are reclaimed with this batch.
+            VkDeviceSize skippedBytes = ringSize - m_ringHead;
+            VkDeviceSize usedBytes = std::min(alignedSize, m_ringTail);
+            m_ringUsedBytes += skippedBytes + usedBytes;
+            m_openBatch.ringBytes += skippedBytes + usedBytes;
+            *pOffset = 0u;
+            m_ringHead = usedBytes;
+            return true;
+        }
+
+        if (m_ringTail - m_ringHead < sizeBytes) {
+            return false;
+        }
+        *pOffset = m_ringHead;
+        VkDeviceSize usedBytes = std::min(alignedSize, m_ringTail - m_ringHead);
+        m_ringHead += usedBytes;
+        m_ringUsedBytes += usedBytes;
+        m_openBatch.ringBytes += usedBytes;
+        return true;
+    }
+
+    void UploadManager::stage(
+        const void* pData,
+        VkDeviceSize dataSizeBytes,
+        VkBuffer* pStagingBuffer,
+        VkDeviceSize* pStagingOffset)
+    {
+        auto& memoryAllocator = m_context.getMemoryAllocator();
+        if (dataSizeBytes > m_config.stagingRingSizeBytes) {
+            MemoryAllocator::Buffer stagingBuffer =
+                memoryAllocator.createBuffer(
+                    dataSizeBytes,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY,
+                    "UploadManagerDedicatedStaging");
+
+            void* pDataDst = nullptr;
+            memoryAllocator.mapBuffer(stagingBuffer, &pDataDst);
+            memcpy(pDataDst, pData, dataSizeBytes);
+            memoryAllocator.unmapBuffer(stagingBuffer);
+
+            *pStagingBuffer = stagingBuffer.handle;
+            *pStagingOffset = 0u;
+            m_openBatch.dedicatedStagingBuffers.push_back(stagingBuffer);
+            ++m_stats.dedicatedStagingCount;
+            return;
+        }
+
+        if (m_stagingRing.handle == VK_NULL_HANDLE) {
+            m_stagingRing =
+                memoryAllocator.createBuffer(
+                    m_config.stagingRingSizeBytes,
+                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                    VmaMemoryUsage::VMA_MEMORY_USAGE_CPU_ONLY,
+                    "UploadManagerStagingRing");
+
+            void* pRingData = nullptr;
+            if (!memoryAllocator.mapBuffer(m_stagingRing, &pRingData)) {
+                throw std::runtime_error("Failed to map upload staging ring!");
+            }
+            m_pStagingRingData = reinterpret_cast<uint8_t*>(pRingData);
+        }
+
+        VkDeviceSize offset = 0u;
+        while (!allocateFromRing(dataSizeBytes, &offset)) {
+            if (m_submittedBatches.empty()) {
+                // Only the open batch holds ring space, so it has to be submitted to reclaim it.
+                flush();
+            }
+            ++m_stats.stagingStallCount;
+            retireBatches(true);
+        }
+
+        memcpy(m_pStagingRingData + offset, pData, dataSizeBytes);
+        *pStagingBuffer = m_stagingRing.handle;
+        *pStagingOffset = offset;
+    }
+
+    UploadManager::UploadId UploadManager::uploadToBuffer(
+        const MemoryAllocator::Buffer& buffer,
+        const void* pData,
+        VkDeviceSize dataSizeBytes,
+        VkDeviceSize dstOffsetBytes)
+    {
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceSize stagingOffset = 0u;
+        stage(pData, dataSizeBytes, &stagingBuffer, &stagingOffset);
+
+        VkBufferCopy copyRegion = {};
+        copyRegion.srcOffset = stagingOffset;
+        copyRegion.dstOffset = dstOffsetBytes;
+        copyRegion.size = dataSizeBytes;
+        vkCmdCopyBuffer(getOpenCommandBuffer(), stagingBuffer, buffer.handle, 1, &copyRegion);
+
+        // Concurrent buffers have no owner, the semaphore wait of the acquire makes them visible.
+        if (releasesToDstQueueFamily() && buffer.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_commandQueue.queueFamilyIndex;
+            barrier.dstQueueFamilyIndex = m_dstCommandQueue.queueFamilyIndex;
+            barrier.buffer = buffer.handle;
+            barrier.offset = dstOffsetBytes;
+            barrier.size = dataSizeBytes;
+            m_openBatch.ownershipTransfer.bufferBarriers.push_back(barrier);
+        }
+
+        ++m_stats.uploadCount;
+        m_stats.uploadedBytes += dataSizeBytes;
+
+        return m_openBatch.id;
+    }
+
+    UploadManager::UploadId UploadManager::uploadToImage(
+        const Image& image,
+        const void* pData,
+        VkDeviceSize dataSizeBytes,
+        OneTimeCommandsHelper::GenerateMips genMips,
+        const std::vector<VkDeviceSize>& mipLevelOffsets)
+    {
+        VkBuffer stagingBuffer = VK_NULL_HANDLE;
+        VkDeviceSize stagingOffset = 0u;
+        stage(pData, dataSizeBytes, &stagingBuffer, &stagingOffset);
+
+        if (!releasesToDstQueueFamily()) {
+            OneTimeCommandsHelper::RecordCopyBufferToImageCommands(
+                getOpenCommandBuffer(),
+                stagingBuffer,
+                stagingOffset,
+                image,
+                genMips,
+                mipLevelOffsets);
+        } else {
+            OneTimeCommandsHelper::RecordCopyBufferToTransferDstImageCommands(
+                getOpenCommandBuffer(),
+                stagingBuffer,
+                stagingOffset,
+                image,
+                mipLevelOffsets);
+
+            // Transfer queues can't blit, so the image stays in transfer dst layout for the dst
+            // queue to generate its mip levels.
+            bool blitMips = genMips == OneTimeCommandsHelper::GenerateMips::Yes && image.getMipLevels() > 1u;
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout =
+                blitMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcQueueFamilyIndex = m_commandQueue.queueFamilyIndex;
+            barrier.dstQueueFamilyIndex = m_dstCommandQueue.queueFamilyIndex;
+            barrier.image = image.getHandle();
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0u;
+            barrier.subresourceRange.levelCount = image.getMipLevels();
+            barrier.subresourceRange.baseArrayLayer = 0u;
+            barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+            m_openBatch.ownershipTransfer.imageBarriers.push_back(barrier);
+
+            if (blitMips) {
+                const Image* pImage = &image;
+                m_openBatch.ownershipTransfer.recordFuncs.push_back(
+                    [pImage](VkCommandBuffer commandBuffer) {
+                        OneTimeCommandsHelper::RecordGenerateMipsAndShaderReadCommands(
+                            commandBuffer,
+                            *pImage,
+                            OneTimeCommandsHelper::GenerateMips::Yes);
+                    });
+            }
+        }
+
+        ++m_stats.uploadCount;
+        m_stats.uploadedBytes += dataSizeBytes;
+
+        return m_openBatch.id;
+    }
+
+    UploadManager::UploadId UploadManager::recordCommands(const OneTimeCommandsRunner::RecordCommandsFunc& recordFunc)
+    {
+        VkCommandBuffer commandBuffer = getOpenCommandBuffer();
+        if (releasesToDstQueueFamily()) {
+            m_openBatch.ownershipTransfer.recordFuncs.push_back(recordFunc);
+        } else {
+            recordFunc(commandBuffer);
+        }
+        return m_openBatch.id;
+    }
+
+    void UploadManager::submit(const CommandQueue& commandQueue, const VkSubmitInfo& submitInfo, Submission* pSubmission)
+    {
+        GpuTimeline* pGpuTimeline = m_context.getGpuTimeline();
+        if (pGpuTimeline != nullptr && pGpuTimeline->getCommandQueue().queue == commandQueue.queue) {
+            pSubmission->timelineValue = pGpuTimeline->submit(submitInfo);
+            return;
+        }
+
+        if (!m_freeFences.empty()) {
+            pSubmission->spFence = std::move(m_freeFences.back());
+            m_freeFences.pop_back();
+        } else {
+            pSubmission->spFence = std::make_unique<Fence>(m_context);
+        }
+        VkFence fence = pSubmission->spFence->getHandle();
+        // Fences are created signaled.
+        vkResetFences(m_context.getLogicalDevice(), 1, &fence);
+
+        VkResult result = vkQueueSubmit(commandQueue.queue, 1, &submitInfo, fence);
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit upload batch!");
+        }
+    }
+
+    bool UploadManager::isSubmissionComplete(Submission& submission, bool wait)
+    {
+        if (submission.spFence == nullptr) {
+            GpuTimeline* pGpuTimeline = m_context.getGpuTimeline();
+            return wait ?
+                pGpuTimeline->wait(submission.timelineValue) :
+                pGpuTimeline->isComplete(submission.timelineValue);
+        }
+
+        VkDevice device = m_context.getLogicalDevice();
+        VkFence fence = submission.spFence->getHandle();
+        if (wait) {
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+        } else if (vkGetFenceStatus(device, fence) != VK_SUCCESS) {
+            return false;
+        }
+
+        m_freeFences.push_back(std::move(submission.spFence));
+        return true;
+    }
+
+    UploadManager::UploadId UploadManager::flush()
+    {
+        // Reclaims the command buffers, staging memory, semaphores and fences of the submissions
+        // that have completed, since it is called every frame, e.g. by the Renderer.
+        retireBatches(false);
+        retireAcquireBatches(false);
+
+        if (m_openBatch.commandBuffer == VK_NULL_HANDLE) {
+            return m_openBatch.id - 1u;
+        }
+
+        OwnershipTransfer& ownershipTransfer = m_openBatch.ownershipTransfer;
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        if (releasesToDstQueueFamily()) {
+            const auto& bufferBarriers = ownershipTransfer.bufferBarriers;
+            const auto& imageBarriers = ownershipTransfer.imageBarriers;
+            if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+                vkCmdPipelineBarrier(
+                    m_openBatch.commandBuffer,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    0, // VkDependencyFlags
+                    0, nullptr,
+                    static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                    static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+            }
+
+            if (!m_freeSemaphores.empty()) {
+                ownershipTransfer.spSemaphore = std::move(m_freeSemaphores.back());
+                m_freeSemaphores.pop_back();
+            } else {
+                ownershipTransfer.spSemaphore = std::make_unique<Semaphore>(m_context);
+            }
+            semaphore = ownershipTransfer.spSemaphore->getHandle();
+        } else {
+            RecordBatchEndBarrier(m_openBatch.commandBuffer);
+        }
+
+        vkEndCommandBuffer(m_openBatch.commandBuffer);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &m_openBatch.commandBuffer;
+        if (semaphore != VK_NULL_HANDLE) {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &semaphore;
+        }
+
+        submit(m_commandQueue, submitInfo, &m_openBatch.submission);
+
+        m_openBatch.ringEnd = m_ringHead;
+        UploadId submittedId = m_openBatch.id;
+        if (releasesToDstQueueFamily()) {
+            ownershipTransfer.id = submittedId;
+            m_pendingOwnershipTransfers.push_back(std::move(ownershipTransfer));
+        }
+        m_submittedBatches.push_back(std::move(m_openBatch));
+        ++m_stats.batchCount;
+
+        m_openBatch = Batch();
+        m_openBatch.id = submittedId + 1u;
+
+        return submittedId;
+    }
+
+    void UploadManager::retireBatches(bool waitForOldest)
+    {
+        while (!m_submittedBatches.empty()) {
+            Batch& batch = m_submittedBatches.front();
+            if (!isSubmissionComplete(batch.submission, waitForOldest)) {
+                break;
+            }
+            waitForOldest = false;
+
+            m_commandBufferFactory.freeCommandBuffer(batch.commandBuffer);
+            auto& memoryAllocator = m_context.getMemoryAllocator();
+            for (auto& stagingBuffer : batch.dedicatedStagingBuffers) {
+                memoryAllocator.destroyBuffer(stagingBuffer);
+            }
+
+            // Batches complete in order, so everything before its end is free.
+            m_ringTail = batch.ringEnd;
+            assert(m_ringUsedBytes >= batch.ringBytes);
+            m_ringUsedBytes -= batch.ringBytes;
+
+            m_copiedId = batch.id;
+            if (!releasesToDstQueueFamily()) {
+                m_completedId = batch.id;
+            }
+            m_submittedBatches.pop_front();
+        }
+    }
+
+    void UploadManager::acquire(UploadId uploadId)
+    {
+        if (m_pendingOwnershipTransfers.empty() || m_pendingOwnershipTransfers.front().id > uploadId) {
+            return;
+        }
+
+        AcquireBatch acquireBatch;
+        acquireBatch.commandBuffer = m_pDstCommandBufferFactory->createCommandBuffer();
+
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(acquireBatch.commandBuffer, &beginInfo);
+
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitStages;
+        while (!m_pendingOwnershipTransfers.empty() && m_pendingOwnershipTransfers.front().id <= uploadId) {
+            OwnershipTransfer& ownershipTransfer = m_pendingOwnershipTransfers.front();
+
+            // The acquire barriers must match the release barriers, other than their access masks.
+            for (auto& barrier : ownershipTransfer.bufferBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            }
+            for (auto& barrier : ownershipTransfer.imageBarriers) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            }
+
+            const auto& bufferBarriers = ownershipTransfer.bufferBarriers;
+            const auto& imageBarriers = ownershipTransfer.imageBarriers;
+            if (!bufferBarriers.empty() || !imageBarriers.empty()) {
+                vkCmdPipelineBarrier(
+                    acquireBatch.commandBuffer,
+                    AcquireStages,
+                    AcquireStages,
+                    0, // VkDependencyFlags
+                    0, nullptr,
+                    static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                    static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+            }
+
+            for (const auto& recordFunc : ownershipTransfer.recordFuncs) {
+                recordFunc(acquireBatch.commandBuffer);
+            }
+
+            waitSemaphores.push_back(ownershipTransfer.spSemaphore->getHandle());
+            waitStages.push_back(AcquireStages);
+            acquireBatch.semaphores.push_back(std::move(ownershipTransfer.spSemaphore));
+            acquireBatch.id = ownershipTransfer.id;
+
+            m_pendingOwnershipTransfers.pop_front();
+        }
+
+        RecordBatchEndBarrier(acquireBatch.commandBuffer);
+
+        vkEndCommandBuffer(acquireBatch.commandBuffer);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &acquireBatch.commandBuffer;
+
+        submit(m_dstCommandQueue, submitInfo, &acquireBatch.submission);
+
+        ++m_stats.acquireCount;
+        m_submittedAcquireBatches.push_back(std::move(acquireBatch));
+    }
+
+    void UploadManager::retireAcquireBatches(bool waitForOldest)
+    {
+        while (!m_submittedAcquireBatches.empty()) {
+            AcquireBatch& acquireBatch = m_submittedAcquireBatches.front();
+            if (!isSubmissionComplete(acquireBatch.submission, waitForOldest)) {
+                break;
+            }
+            waitForOldest = false;
+
+            m_pDstCommandBufferFactory->freeCommandBuffer(acquireBatch.commandBuffer);
+
+            // The waits have unsignaled the semaphores, so they can be signaled again.
+            for (auto& spSemaphore : acquireBatch.semaphores) {
+                m_freeSemaphores.push_back(std::move(spSemaphore));
+            }
+
+            m_completedId = acquireBatch.id;
+            m_submittedAcquireBatches.pop_front();
+        }
+    }
+
+    bool UploadManager::isComplete(UploadId uploadId)
+    {
+        if (uploadId <= m_completedId) {
+            return true;
+        }
+        retireBatches(false);
+        if (releasesToDstQueueFamily()) {
+            // Their semaphores have already been signaled, so the dst queue won't wait on them.
+            acquire(m_copiedId);
+            retireAcquireBatches(false);
+        }
+        return uploadId <= m_completedId;
+    }
+
+    void UploadManager::wait(UploadId uploadId)
+    {
+        if (uploadId >= m_openBatch.id) {
+            flush();
+        }
+
+        if (!releasesToDstQueueFamily()) {
+            while (m_completedId < uploadId && !m_submittedBatches.empty()) {
+                retireBatches(true);
+            }
+            return;
+        }
+
+        acquire(uploadId);
+        while (m_completedId < uploadId && !m_submittedAcquireBatches.empty()) {
+            retireAcquireBatches(true);
+        }
+        retireBatches(false);
+    }
+}
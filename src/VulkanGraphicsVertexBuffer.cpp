@@ -1,5 +1,6 @@
 #include "VulkanGraphicsVertexBuffer.h"
 
+#include "VulkanGraphicsGeometryArena.h"
 #include "VulkanGraphicsOneTimeCommands.h"
 
 #include <cassert>
@@ -30,23 +31,44 @@ namespace vgfx
         const Config& config,
         const VertexData* pVertexData,
         size_t vertexDataSizeBytes)
-        : m_context(context)
+        : m_pContext(&context)
         , m_config(config)
     {
-        if (config.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
-            m_buffer =
-                context.getMemoryAllocator().createBuffer(
-                    vertexDataSizeBytes,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
-        } else {
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = vertexDataSizeBytes;
+        // Transfer src so that the Defragmenter can copy it.
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+        bufferCreateInfo.sharingMode = config.sharingMode;
+        if (config.sharingMode == VK_SHARING_MODE_CONCURRENT) {
             assert(!config.queueFamilyIndices.empty());
+            bufferCreateInfo.pQueueFamilyIndices = config.queueFamilyIndices.data();
+            bufferCreateInfo.queueFamilyIndexCount = static_cast<uint32_t>(config.queueFamilyIndices.size());
+        }
+
+        MemoryAllocator& memoryAllocator = context.getMemoryAllocator();
+        if (memoryAllocator.shouldWriteDirectly()) {
             m_buffer =
-                context.getMemoryAllocator().createSharedBuffer(
-                    vertexDataSizeBytes,
-                    VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                    config.queueFamilyIndices,
-                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY);
+                memoryAllocator.createDirectWriteBuffer(
+                    bufferCreateInfo,
+                    nullptr,
+                    MemoryAllocator::AllocationClass::Static);
+        }
+        if (!m_buffer.isValid()) {
+            m_buffer =
+                memoryAllocator.createBuffer(
+                    bufferCreateInfo,
+                    VmaMemoryUsage::VMA_MEMORY_USAGE_GPU_ONLY,
+                    nullptr,
+                    MemoryAllocator::AllocationClass::Static);
+        }
+
+        if (config.sharingMode == VK_SHARING_MODE_EXCLUSIVE) {
+            memoryAllocator.setMovable(m_buffer, bufferCreateInfo, [this](VkBuffer newHandle) {
+                m_buffer.handle = newHandle;
+                // The mapping moves with the memory, direct writes are only made when it is created.
+                m_buffer.pMappedData = nullptr;
+            });
         }
 
         OneTimeCommandsHelper helper(context, commandBufferFactory);
@@ -54,10 +76,56 @@ namespace vgfx
         helper.copyDataToBuffer(m_buffer, pVertexData, vertexDataSizeBytes); 
     }
 
+    VertexBuffer::VertexBuffer(
+        GeometryArena& geometryArena,
+        const Config& config,
+        const VertexData* pVertexData,
+        size_t vertexDataSizeBytes)
+        : m_config(config)
+        , m_pGeometryArena(&geometryArena)
+    {
+        assert(config.sharingMode == VK_SHARING_MODE_EXCLUSIVE);
+        assert(vertexDataSizeBytes % config.vertexStride == 0u);
+
+        m_pGeometryRange =
+            &geometryArena.allocateVertices(
+                config,
+                pVertexData,
+                static_cast<uint32_t>(vertexDataSizeBytes / config.vertexStride));
+    }
+
+    void VertexBuffer::writeVertices(
+        const VertexData* pVertexData,
+        uint32_t firstVertex,
+        uint32_t vertexCount)
+    {
+        assert(m_pGeometryRange != nullptr);
+        m_pGeometryArena->write(*m_pGeometryRange, pVertexData, firstVertex, vertexCount);
+    }
+
+    VkBuffer VertexBuffer::getHandle()
+    {
+        return m_pGeometryRange != nullptr ? m_pGeometryRange->getBuffer() : m_buffer.handle;
+    }
+
+    int32_t VertexBuffer::getFirstVertex() const
+    {
+        return m_pGeometryRange != nullptr ? static_cast<int32_t>(m_pGeometryRange->getFirstElement()) : 0;
+    }
+
     void VertexBuffer::destroy()
     {
+        if (m_pGeometryRange != nullptr) {
+            m_pGeometryArena->free(*m_pGeometryRange);
+            m_pGeometryRange = nullptr;
+        }
         if (m_buffer.isValid()) {
-            m_context.getMemoryAllocator().destroyBuffer(m_buffer);
+            MemoryAllocator& memoryAllocator = m_pContext->getMemoryAllocator();
+            memoryAllocator.clearMovable(m_buffer.allocation);
+            m_pContext->retire([&memoryAllocator, buffer = m_buffer]() mutable {
+                memoryAllocator.destroyBuffer(buffer);
+            });
+            m_buffer = MemoryAllocator::Buffer();
         }
     }
 